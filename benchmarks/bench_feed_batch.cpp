@@ -0,0 +1,164 @@
+// benchmarks/bench_feed_batch.cpp
+// Scans over many feed pages: top-k by engagement, a time window and
+// per-author sums, run over a BlueskyFeedBatch and over the same posts as a
+// vector of Post structs, the way callers loop over PostsResult today.
+//
+// Usage: bluesky-bench-feed-batch [--posts=N]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bluesky_feed_batch.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+static const double RUN_SECONDS = 0.5;
+static const size_t TOP_K = 50;
+static const unsigned AUTHORS = 5000;
+
+static std::vector<BlueskyClient::Post> makePosts(size_t count) {
+    std::vector<BlueskyClient::Post> posts;
+    posts.reserve(count);
+
+    const int64_t start = BlueskyTimestamp::parse("2024-06-01T00:00:00Z").microseconds();
+
+    uint64_t seed = 42;
+    for (size_t i = 0; i < count; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        const unsigned author = (unsigned)(seed >> 33) % AUTHORS;
+
+        BlueskyClient::Post post = BlueskyClient::Post();
+        post.uri = "at://did:plc:" + std::to_string(author) + "/app.bsky.feed.post/" + std::to_string(i);
+        post.cid = "bafy" + std::to_string(i);
+        post.text = "a post of some typical length, with a few words in it " + std::to_string(i);
+        post.author.did = "did:plc:" + std::to_string(author);
+        post.author.handle = std::to_string(author) + ".bsky.social";
+        post.indexedAtTime = BlueskyTimestamp::fromMicroseconds(start + (int64_t)i * 1000000);
+        post.indexedAt = post.indexedAtTime.toTimeT();
+        post.likeCount = (unsigned)(seed >> 20) % 500;
+        post.repostCount = (unsigned)(seed >> 12) % 50;
+        post.replyCount = (unsigned)(seed >> 8) % 20;
+        post.quoteCount = (unsigned)(seed >> 4) % 5;
+        posts.push_back(post);
+    }
+
+    return posts;
+}
+
+static float legacyScore(const BlueskyClient::Post& post, const BlueskyFeedBatch::Weights& weights) {
+    return post.likeCount * weights.likes + post.repostCount * weights.reposts +
+        post.replyCount * weights.replies + post.quoteCount * weights.quotes;
+}
+
+static std::vector<uint32_t> legacyTopK(const std::vector<BlueskyClient::Post>& posts, size_t k,
+    const BlueskyFeedBatch::Weights& weights) {
+    std::vector<uint32_t> indexes(posts.size());
+    for (size_t i = 0; i < indexes.size(); i++)
+        indexes[i] = (uint32_t)i;
+
+    k = std::min(k, indexes.size());
+    std::partial_sort(indexes.begin(), indexes.begin() + k, indexes.end(), [&](uint32_t a, uint32_t b) {
+        const float scoreA = legacyScore(posts[a], weights);
+        const float scoreB = legacyScore(posts[b], weights);
+        return scoreA > scoreB || (scoreA == scoreB && a < b);
+    });
+
+    indexes.resize(k);
+    return indexes;
+}
+
+static std::vector<uint32_t> legacyWindow(const std::vector<BlueskyClient::Post>& posts, int64_t from, int64_t to) {
+    std::vector<uint32_t> indexes;
+    for (size_t i = 0; i < posts.size(); i++) {
+        const int64_t time = posts[i].indexedAtTime.microseconds();
+        if (time >= from && time < to)
+            indexes.push_back((uint32_t)i);
+    }
+
+    return indexes;
+}
+
+static uint64_t legacyAuthorLikes(const std::vector<BlueskyClient::Post>& posts) {
+    std::unordered_map<std::string, uint64_t> likes;
+    for (const BlueskyClient::Post& post : posts)
+        likes[post.author.did] += post.likeCount;
+
+    return likes.size();
+}
+
+// Runs/s of fn
+template <typename Fn>
+static double runsPerSecond(Fn fn) {
+    uint64_t runs = 0;
+    uint64_t sink = 0;
+
+    const Clock::time_point start = Clock::now();
+    while (std::chrono::duration<double>(Clock::now() - start).count() < RUN_SECONDS) {
+        sink += fn();
+        runs++;
+    }
+
+    // Keeps the results alive
+    if (sink == 1)
+        std::printf(" ");
+
+    return runs / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void report(const char* name, double legacy, double current) {
+    std::printf("  %-22s %12.1f/s %12.1f/s (%.2fx)\n", name, legacy, current, current / legacy);
+}
+
+int main(int argc, char** argv) {
+    size_t count = 200000;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "--posts=", 8) == 0)
+            count = (size_t)std::max(1, std::atoi(argv[i] + 8));
+    }
+
+    const std::vector<BlueskyClient::Post> posts = makePosts(count);
+
+    // Built page by page, as a poller would
+    BlueskyFeedBatch batch;
+    for (size_t i = 0; i < posts.size(); i += 100) {
+        BlueskyClient::PostsResult page;
+        page.posts.assign(posts.begin() + i, posts.begin() + std::min(i + 100, posts.size()));
+        batch.append(page);
+    }
+
+    const BlueskyFeedBatch::Weights weights(1, 2, 3, 2);
+    if (legacyTopK(posts, TOP_K, weights) != batch.topK(TOP_K, weights)) {
+        std::fprintf(stderr, "top-k results disagree\n");
+        return 1;
+    }
+
+    const int64_t from = posts[posts.size() / 4].indexedAtTime.microseconds();
+    const int64_t to = posts[posts.size() / 2].indexedAtTime.microseconds();
+
+    std::printf("Feed batch scans over %zu posts by %u authors\n\n", posts.size(), AUTHORS);
+    std::printf("  %-22s %14s %14s\n", "", "vector<Post>", "BlueskyFeedBatch");
+
+    report("top-50 by engagement",
+        runsPerSecond([&] { return (uint64_t)legacyTopK(posts, TOP_K, weights)[0]; }),
+        runsPerSecond([&] { return (uint64_t)batch.topK(TOP_K, weights)[0]; }));
+
+    report("time window",
+        runsPerSecond([&] { return (uint64_t)legacyWindow(posts, from, to).size(); }),
+        runsPerSecond([&] {
+            return (uint64_t)batch.indexedBetween(
+                BlueskyTimestamp::fromMicroseconds(from), BlueskyTimestamp::fromMicroseconds(to)).size();
+        }));
+
+    report("likes per author",
+        runsPerSecond([&] { return legacyAuthorLikes(posts); }),
+        runsPerSecond([&] { return (uint64_t)batch.authorTotals().size(); }));
+
+    return 0;
+}
@@ -0,0 +1,127 @@
+// benchmarks/bench_feed_parse.cpp
+// Feed decoding throughput on 100-entry getFeed pages: the shared
+// single-pass decoder against the original per-index lookup loop.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <yyjson.h>
+
+#include "bluesky_client.hpp"
+
+#include "bench_payloads.hpp"
+
+static const unsigned PAGE_SIZE = 100;
+static const double RUN_SECONDS = 2.0;
+
+static time_t legacyDatetimeToTimeT(const char* datetime) {
+    if (datetime == nullptr)
+        return (time_t)(-1);
+
+    struct tm tm {};
+
+    char formattedDatetime[32];
+    strncpy(formattedDatetime, datetime, sizeof(formattedDatetime) - 1);
+    formattedDatetime[sizeof(formattedDatetime) - 1] = '\0';
+
+    if (strptime(formattedDatetime, "%Y-%m-%dT%H:%M:%S", &tm) == nullptr)
+        return (time_t)(-1);
+
+    return timegm(&tm);
+}
+
+// The loop getFeedPosts/getAuthorPosts used before the shared decoder
+static BlueskyClient::PostsResult legacyParseFeed(const std::string& json) {
+    BlueskyClient::PostsResult result { .error = BlueskyClient::Error_None };
+
+    yyjson_doc* doc = yyjson_read(json.c_str(), json.length(), 0);
+    if (!doc) {
+        result.error = BlueskyClient::Error_ResponseParseFail;
+        return result;
+    }
+
+    yyjson_val* root = yyjson_doc_get_root(doc);
+    yyjson_val* feed = yyjson_obj_get(root, "feed");
+
+    unsigned postCount = yyjson_arr_size(feed);
+    result.posts.resize(postCount);
+
+    for (unsigned i = 0; i < postCount; i++) {
+        yyjson_val* arrEntry = yyjson_arr_get(feed, i);
+        auto& outPost = result.posts[i];
+
+        yyjson_val* post = yyjson_obj_get(arrEntry, "post");
+
+        outPost.uri = yyjson_get_str(yyjson_obj_get(post, "uri"));
+        outPost.cid = yyjson_get_str(yyjson_obj_get(post, "cid"));
+
+        outPost.replyCount = yyjson_get_uint(yyjson_obj_get(post, "replyCount"));
+        outPost.repostCount = yyjson_get_uint(yyjson_obj_get(post, "repostCount"));
+        outPost.likeCount = yyjson_get_uint(yyjson_obj_get(post, "likeCount"));
+        outPost.quoteCount = yyjson_get_uint(yyjson_obj_get(post, "quoteCount"));
+
+        outPost.indexedAt = legacyDatetimeToTimeT(yyjson_get_str(yyjson_obj_get(post, "indexedAt")));
+
+        yyjson_val* record = yyjson_obj_get(post, "record");
+        outPost.createdAt = legacyDatetimeToTimeT(yyjson_get_str(yyjson_obj_get(record, "createdAt")));
+        outPost.text = yyjson_get_str(yyjson_obj_get(record, "text"));
+
+        yyjson_val* author = yyjson_obj_get(post, "author");
+        outPost.author.did = yyjson_get_str(yyjson_obj_get(author, "did"));
+        outPost.author.handle = yyjson_get_str(yyjson_obj_get(author, "handle"));
+
+        const char* displayName = yyjson_get_str(yyjson_obj_get(author, "displayName"));
+        if (displayName)
+            outPost.author.displayName = displayName;
+
+        const char* avatarUrl = yyjson_get_str(yyjson_obj_get(author, "avatar"));
+        if (avatarUrl)
+            outPost.author.avatarUrl = avatarUrl;
+
+        outPost.author.createdAt = legacyDatetimeToTimeT(yyjson_get_str(yyjson_obj_get(author, "createdAt")));
+    }
+
+    yyjson_doc_free(doc);
+    return result;
+}
+
+template <typename ParseFn>
+static double postsPerSecond(const std::string& page, ParseFn parse) {
+    typedef std::chrono::steady_clock Clock;
+
+    size_t posts = 0;
+    const Clock::time_point start = Clock::now();
+    double elapsed = 0;
+
+    do {
+        for (int i = 0; i < 100; i++)
+            posts += parse(page).posts.size();
+
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < RUN_SECONDS);
+
+    return posts / elapsed;
+}
+
+int main() {
+    const std::string page = makeFeedPage(PAGE_SIZE);
+
+    if (BlueskyClient::parseFeed(page).posts.size() != PAGE_SIZE) {
+        std::fprintf(stderr, "decoder returned the wrong number of posts\n");
+        return 1;
+    }
+
+    std::printf("Feed parse throughput, %u-entry pages (%zu bytes)\n\n", PAGE_SIZE, page.size());
+
+    const double legacy = postsPerSecond(page, legacyParseFeed);
+    std::printf("  per-index loop:      %12.0f posts/s\n", legacy);
+
+    const double current = postsPerSecond(page, BlueskyClient::parseFeed);
+    std::printf("  single-pass decoder: %12.0f posts/s (%.2fx)\n", current, current / legacy);
+
+    return 0;
+}
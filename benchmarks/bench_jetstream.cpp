@@ -0,0 +1,100 @@
+// benchmarks/bench_jetstream.cpp
+// Event stream throughput: a local stand-in server replays synthetic
+// Jetstream frames as fast as the socket takes them, and BlueskyJetstream
+// decodes and delivers them. Prints events/s, MB/s and queue high water.
+//
+// Usage: bluesky-bench-jetstream [--events=N] [--workers=N] [--queue=N]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bluesky_jetstream.hpp"
+
+#include "bench_payloads.hpp"
+#include "ws_replay_server.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    unsigned events;
+    unsigned workers;
+    unsigned queue;
+};
+
+static Options parseOptions(int argc, char** argv) {
+    Options options = { 200000, 4, 4096 };
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = std::strchr(arg, '=');
+        if (!value)
+            continue;
+        value++;
+
+        if (std::strncmp(arg, "--events=", 9) == 0)
+            options.events = std::max(1, std::atoi(value));
+        else if (std::strncmp(arg, "--workers=", 10) == 0)
+            options.workers = std::max(1, std::atoi(value));
+        else if (std::strncmp(arg, "--queue=", 8) == 0)
+            options.queue = std::max(1, std::atoi(value));
+    }
+
+    return options;
+}
+
+int main(int argc, char** argv) {
+    const Options options = parseOptions(argc, argv);
+
+    std::vector<std::string> frames;
+    frames.reserve(options.events);
+
+    size_t bytes = 0;
+    for (unsigned i = 0; i < options.events; i++) {
+        frames.push_back(makeJetstreamFrame(i));
+        bytes += frames.back().size();
+    }
+
+    WsReplayServer server(frames);
+
+    std::atomic<unsigned> posts(0);
+
+    BlueskyJetstream::Options streamOptions;
+    streamOptions.endpoint = server.url();
+    streamOptions.workers = options.workers;
+    streamOptions.queueCapacity = options.queue;
+
+    BlueskyJetstream stream([&posts](const BlueskyJetstream::Event& event) {
+        if (event.isPost)
+            posts++;
+    }, streamOptions);
+
+    std::printf("%u events (%.1f MB), %u workers, queue of %u\n\n",
+        options.events, bytes / 1e6, options.workers, options.queue);
+
+    const Clock::time_point start = Clock::now();
+    stream.start();
+
+    while (stream.stats().delivered < options.events) {
+        if (Clock::now() - start > std::chrono::seconds(60)) {
+            std::fprintf(stderr, "timed out after %llu events\n", (unsigned long long)stream.stats().delivered);
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    const BlueskyJetstream::Stats stats = stream.stats();
+    stream.stop();
+
+    std::printf("  %10.0f events/s  %7.1f MB/s  %u posts  max queued %zu\n",
+        options.events / seconds, bytes / 1e6 / seconds, posts.load(), stats.maxQueued);
+
+    return 0;
+}
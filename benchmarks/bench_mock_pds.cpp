@@ -0,0 +1,223 @@
+// benchmarks/bench_mock_pds.cpp
+// End-to-end cost of the public API against an in-process stand-in PDS:
+// calls/s, p50/p99 latency, client-side allocations per call and parse
+// throughput, with configurable payload size and server latency. Also shows
+// how many requests reached the server per call, which drops below one when
+// identical concurrent GETs are coalesced or served from a response cache.
+// Feed responses carry an ETag and are answered with 304 when it matches.
+//
+// Usage: bluesky-bench-mock-pds [--posts=N] [--latency-ms=N] [--threads=N] [--seconds=N]
+//                               [--coalesce | --coalesce-ms=N] [--cache-ttl-ms=N]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bluesky_client.hpp"
+#include "bluesky_metrics.hpp"
+#include "bluesky_response_cache.hpp"
+
+#include "bench_payloads.hpp"
+#include "mock_pds_server.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+// The feed never changes, so one ETag will do
+static const char* const FEED_ETAG = "\"feed-1\"";
+
+// Allocations are only counted on threads that make client calls, so the
+// in-process server does not show up in the numbers
+static std::atomic<unsigned long long> g_allocations(0);
+static thread_local bool t_countAllocations = false;
+
+void* operator new(size_t size) {
+    if (t_countAllocations)
+        g_allocations++;
+
+    void* ptr = std::malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+struct Options {
+    unsigned posts;
+    unsigned latencyMs;
+    unsigned threads;
+    double seconds;
+    int coalesceMs; // Coalescing window, -1 for no coalescing
+    int cacheTtlMs; // Response cache TTL, -1 for no cache
+};
+
+static Options parseOptions(int argc, char** argv) {
+    // Coalescing is off by default, as in the client
+    Options options = { 100, 0, 1, 2.0, -1, -1 };
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "--coalesce") == 0)
+            options.coalesceMs = 0;
+
+        const char* value = std::strchr(arg, '=');
+        if (!value)
+            continue;
+        value++;
+
+        if (std::strncmp(arg, "--posts=", 8) == 0)
+            options.posts = (unsigned)std::atoi(value);
+        else if (std::strncmp(arg, "--latency-ms=", 13) == 0)
+            options.latencyMs = (unsigned)std::atoi(value);
+        else if (std::strncmp(arg, "--threads=", 10) == 0)
+            options.threads = std::max(1, std::atoi(value));
+        else if (std::strncmp(arg, "--seconds=", 10) == 0)
+            options.seconds = std::atof(value);
+        else if (std::strncmp(arg, "--coalesce-ms=", 14) == 0)
+            options.coalesceMs = std::max(0, std::atoi(value));
+        else if (std::strncmp(arg, "--cache-ttl-ms=", 15) == 0)
+            options.cacheTtlMs = std::max(0, std::atoi(value));
+    }
+
+    return options;
+}
+
+// Runs call on every thread until the time is up and prints the results
+static void run(const char* name, const Options& options, MockPdsServer& pds, BlueskyClient& client,
+    const std::function<bool()>& call) {
+    std::vector<std::vector<double>> latencies(options.threads);
+    std::atomic<unsigned long long> failures(0);
+
+    client.metrics().reset();
+    pds.takeServed();
+    g_allocations = 0;
+
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point end = start + std::chrono::microseconds((long long)(options.seconds * 1e6));
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < options.threads; t++) {
+        threads.emplace_back([&, t] {
+            std::vector<double>& samples = latencies[t];
+            samples.reserve(1 << 16);
+
+            while (Clock::now() < end) {
+                const Clock::time_point callStart = Clock::now();
+
+                t_countAllocations = true;
+                const bool ok = call();
+                t_countAllocations = false;
+
+                samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - callStart).count());
+                if (!ok)
+                    failures++;
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<double> all;
+    for (const std::vector<double>& samples : latencies)
+        all.insert(all.end(), samples.begin(), samples.end());
+
+    if (all.empty()) {
+        std::printf("  %-18s no calls completed\n", name);
+        return;
+    }
+
+    std::sort(all.begin(), all.end());
+    const double p50 = all[all.size() / 2];
+    const double p99 = all[std::min(all.size() - 1, all.size() * 99 / 100)];
+
+    // Parse throughput from the client's own metrics
+    uint64_t parsedBytes = 0, parseMicros = 0;
+    for (const auto& entry : client.metrics().snapshot()) {
+        parsedBytes += entry.second.bytesParsed;
+        parseMicros += entry.second.latency[BlueskyMetrics::Phase_Parse].sum;
+    }
+
+    std::printf("  %-18s %10.0f calls/s  p50 %8.1fus  p99 %8.1fus  %8.1f allocs/call  %5.2f requests/call",
+                name, all.size() / elapsed, p50, p99, (double)g_allocations / all.size(),
+                (double)pds.takeServed() / all.size());
+    if (parseMicros > 0)
+        std::printf("  parse %7.1f MB/s", parsedBytes / (double)parseMicros);
+    if (failures > 0)
+        std::printf("  (%llu failed)", (unsigned long long)failures);
+    std::printf("\n");
+}
+
+int main(int argc, char** argv) {
+    const Options options = parseOptions(argc, argv);
+
+    const std::string feed = makeFeedPage(options.posts);
+
+    MockPdsServer pds;
+    pds.setRecording(false);
+    pds.setLatency(std::chrono::milliseconds(options.latencyMs));
+    pds.post("com.atproto.server.createSession", MockPdsServer::reply(makeSessionResponse()));
+    pds.post("com.atproto.repo.createRecord", MockPdsServer::reply(makeCreateRecordResponse()));
+    pds.get("app.bsky.feed.getFeed", MockPdsServer::reply(feed, FEED_ETAG));
+    pds.get("app.bsky.feed.getAuthorFeed", MockPdsServer::reply(feed, FEED_ETAG));
+
+    BlueskyClient client(pds.url(), options.threads);
+    client.setRequestCoalescing(options.coalesceMs >= 0, std::chrono::milliseconds(std::max(0, options.coalesceMs)));
+
+    std::shared_ptr<BlueskyResponseCache> cache;
+    if (options.cacheTtlMs >= 0) {
+        cache.reset(new BlueskyResponseCache(BlueskyResponseCache::DEFAULT_MAX_BYTES,
+            std::chrono::milliseconds(options.cacheTtlMs)));
+        client.setResponseCache(cache);
+    }
+
+    if (!client.login("user0.bsky.social", "password")) {
+        std::fprintf(stderr, "login against the mock PDS failed\n");
+        return 1;
+    }
+
+    std::printf("Mock PDS at %s: %u-entry pages (%zu bytes), %ums latency, %u threads, ",
+                pds.url().c_str(), options.posts, feed.size(), options.latencyMs, options.threads);
+    if (options.coalesceMs < 0)
+        std::printf("no coalescing");
+    else
+        std::printf("%dms coalescing window", options.coalesceMs);
+    if (options.cacheTtlMs >= 0)
+        std::printf(", response cache with %dms TTL", options.cacheTtlMs);
+    std::printf("\n\n");
+
+    run("login", options, pds, client, [&] {
+        return client.login("user0.bsky.social", "password");
+    });
+    run("createPost", options, pds, client, [&] {
+        return client.createPost("Hello from the benchmark") == BlueskyClient::Error_None;
+    });
+    run("getFeedPosts", options, pds, client, [&] {
+        return client.getFeedPosts("at://did:plc:abcdefghijklmnopqrstu0/app.bsky.feed.generator/bench", options.posts).error == BlueskyClient::Error_None;
+    });
+    run("getAuthorPosts", options, pds, client, [&] {
+        return client.getAuthorPosts("user0.bsky.social", options.posts).error == BlueskyClient::Error_None;
+    });
+    run("getFeedPostsView", options, pds, client, [&] {
+        return client.getFeedPostsView("at://did:plc:abcdefghijklmnopqrstu0/app.bsky.feed.generator/bench", options.posts).error() == BlueskyClient::Error_None;
+    });
+
+    if (cache) {
+        const BlueskyResponseCache::Stats stats = cache->stats();
+        std::printf("\n  response cache: %llu hits, %llu revalidated, %llu misses\n",
+                    (unsigned long long)stats.hits, (unsigned long long)stats.revalidated, (unsigned long long)stats.misses);
+    }
+
+    return 0;
+}
@@ -0,0 +1,142 @@
+// benchmarks/bench_text.cpp
+// Text helper throughput on post-like text: the BlueskyText scanners against
+// the byte-at-a-time loops BlueskyClient used before.
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bluesky_text.hpp"
+
+static const double RUN_SECONDS = 1.0;
+
+// Mostly ASCII, like most posts, with some accents, quotes and emoji
+static std::string makeText(size_t size) {
+    static const char* const WORDS[] = {
+        "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dogs", "caf\xC3\xA9",
+        "\xE2\x80\x9Chello\xE2\x80\x9D", "posting", "from", "bluesky", "\xF0\x9F\x91\x8B\xF0\x9F\x8F\xBD",
+    };
+
+    std::string text;
+    for (unsigned i = 0; text.size() < size; i++) {
+        text += WORDS[(i * 7 + i / 3) % (sizeof(WORDS) / sizeof(WORDS[0]))];
+        text += i % 11 == 10 ? '\n' : ' ';
+    }
+
+    return text;
+}
+
+static std::string legacyFilterText(const std::string& str) {
+    static const std::unordered_map<wchar_t, char> replacements = {
+        { L'\u2018', '\'' },
+        { L'\u2019', '\'' },
+        { L'\u201C', '"'  },
+        { L'\u201D', '"'  }
+    };
+
+    std::string out;
+    out.reserve(str.size());
+
+    for (char c : str) {
+        auto it = replacements.find(c);
+        if (it != replacements.end())
+            out.push_back(it->second);
+        else if (c >= 32 && c <= 126)
+            out.push_back(c);
+    }
+
+    return out;
+}
+
+static std::vector<std::string> legacySplitIntoWords(const std::string& str) {
+    std::vector<std::string> words;
+    std::istringstream ss(str);
+
+    std::string word;
+    while (ss >> word)
+        words.push_back(word);
+
+    return words;
+}
+
+static std::string legacyUrlEncode(const std::string& str) {
+    std::string escaped;
+
+    for (unsigned char c : str) {
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~')
+            escaped += c;
+        else if (c == ' ')
+            escaped += '+';
+        else {
+            escaped += '%';
+            escaped += "0123456789ABCDEF"[c / 16];
+            escaped += "0123456789ABCDEF"[c % 16];
+        }
+    }
+
+    return escaped;
+}
+
+// MB/s of input the function gets through
+template <typename Fn>
+static double megabytesPerSecond(const std::string& text, Fn fn) {
+    typedef std::chrono::steady_clock Clock;
+
+    size_t bytes = 0;
+    size_t sink = 0;
+    const Clock::time_point start = Clock::now();
+    double elapsed = 0;
+
+    do {
+        for (int i = 0; i < 10; i++) {
+            sink += fn(text);
+            bytes += text.size();
+        }
+
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < RUN_SECONDS);
+
+    // Keeps the results alive
+    if (sink == 1)
+        std::printf(" ");
+
+    return bytes / elapsed / 1e6;
+}
+
+static void compare(const char* name, double legacy, double current) {
+    std::printf("  %-16s %10.0f MB/s  %10.0f MB/s (%.2fx)\n", name, legacy, current, current / legacy);
+}
+
+static void report(const char* name, double current) {
+    std::printf("  %-16s %10s       %10.0f MB/s\n", name, "-", current);
+}
+
+int main() {
+    const std::string text = makeText(64 * 1024);
+
+    std::printf("Text throughput, %zu bytes, %s\n\n", text.size(), BlueskyText::simdLevel());
+    std::printf("  %-16s %15s  %15s\n", "", "byte loop", "BlueskyText");
+
+    compare("filterText",
+        megabytesPerSecond(text, [](const std::string& s) { return legacyFilterText(s).size(); }),
+        megabytesPerSecond(text, [](const std::string& s) { return BlueskyText::toAscii(s).size(); }));
+
+    compare("splitIntoWords",
+        megabytesPerSecond(text, [](const std::string& s) { return legacySplitIntoWords(s).size(); }),
+        megabytesPerSecond(text, [](const std::string& s) { return BlueskyText::splitWords(s).size(); }));
+
+    compare("urlEncode",
+        megabytesPerSecond(text, [](const std::string& s) { return legacyUrlEncode(s).size(); }),
+        megabytesPerSecond(text, [](const std::string& s) { return BlueskyText::urlEncode(s).size(); }));
+
+    report("isValidUtf8",
+        megabytesPerSecond(text, [](const std::string& s) { return (size_t)BlueskyText::isValidUtf8(s); }));
+
+    report("countGraphemes",
+        megabytesPerSecond(text, [](const std::string& s) { return BlueskyText::countGraphemes(s); }));
+
+    return 0;
+}
@@ -0,0 +1,140 @@
+// benchmarks/bench_timestamp.cpp
+// Timestamp parse and format throughput: BlueskyTimestamp against the
+// strncpy/strptime/timegm path datetimeToTimeT took and the gmtime/strftime
+// call createPost made. The same parse loops also run on several threads at
+// once, where the libc calls contend on the locale.
+//
+// Usage: bluesky-bench-timestamp [--threads=N]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bluesky_timestamp.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+static const double RUN_SECONDS = 1.0;
+
+static time_t legacyDatetimeToTimeT(const char* datetime) {
+    if (datetime == nullptr)
+        return (time_t)(-1);
+
+    struct tm tm {};
+
+    char formattedDatetime[32];
+    strncpy(formattedDatetime, datetime, sizeof(formattedDatetime) - 1);
+    formattedDatetime[sizeof(formattedDatetime) - 1] = '\0';
+
+    if (strptime(formattedDatetime, "%Y-%m-%dT%H:%M:%S", &tm) == nullptr)
+        return (time_t)(-1);
+
+    return timegm(&tm);
+}
+
+static size_t legacyFormat(time_t now, char* out) {
+    struct tm tm;
+    gmtime_r(&now, &tm);
+    return strftime(out, BlueskyTimestamp::MAX_FORMAT_SIZE, "%Y-%m-%dT%H:%M:%SZ", &tm);
+}
+
+// Timestamps as they appear in feed responses, a few seconds apart
+static std::vector<std::string> makeTimestamps(size_t count) {
+    std::vector<std::string> timestamps;
+    timestamps.reserve(count);
+
+    const int64_t start = BlueskyTimestamp::parse("2024-06-01T00:00:00Z").microseconds();
+    for (size_t i = 0; i < count; i++)
+        timestamps.push_back(BlueskyTimestamp::fromMicroseconds(start + (int64_t)i * 2345678).format());
+
+    return timestamps;
+}
+
+// Calls/s of fn over the timestamps, summed over threads
+template <typename Fn>
+static double callsPerSecond(const std::vector<std::string>& timestamps, unsigned threads, Fn fn) {
+    std::atomic<uint64_t> calls(0);
+    std::atomic<int64_t> sink(0);
+
+    const Clock::time_point start = Clock::now();
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            uint64_t done = 0;
+            int64_t sum = 0;
+
+            while (std::chrono::duration<double>(Clock::now() - start).count() < RUN_SECONDS) {
+                for (const std::string& timestamp : timestamps)
+                    sum += fn(timestamp);
+
+                done += timestamps.size();
+            }
+
+            calls += done;
+            sink += sum;
+        });
+    }
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    // Keeps the results alive
+    if (sink == 1)
+        std::printf(" ");
+
+    return calls / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void report(const char* name, double legacy, double current) {
+    std::printf("  %-22s %12.0f/s %12.0f/s (%.2fx)\n", name, legacy, current, current / legacy);
+}
+
+int main(int argc, char** argv) {
+    unsigned threads = std::max(2u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "--threads=", 10) == 0)
+            threads = (unsigned)std::max(1, std::atoi(argv[i] + 10));
+    }
+
+    const std::vector<std::string> timestamps = makeTimestamps(1000);
+
+    for (const std::string& timestamp : timestamps) {
+        if (BlueskyTimestamp::parse(timestamp).toTimeT() != legacyDatetimeToTimeT(timestamp.c_str())) {
+            std::fprintf(stderr, "parsers disagree on %s\n", timestamp.c_str());
+            return 1;
+        }
+    }
+
+    std::printf("Timestamp throughput, e.g. %s\n\n", timestamps[0].c_str());
+    std::printf("  %-22s %14s %14s\n", "", "libc", "BlueskyTimestamp");
+
+    const auto legacyParse = [](const std::string& s) { return (int64_t)legacyDatetimeToTimeT(s.c_str()); };
+    const auto currentParse = [](const std::string& s) { return BlueskyTimestamp::parse(s).microseconds(); };
+
+    report("parse, 1 thread", callsPerSecond(timestamps, 1, legacyParse), callsPerSecond(timestamps, 1, currentParse));
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "parse, %u threads", threads);
+    report(name, callsPerSecond(timestamps, threads, legacyParse), callsPerSecond(timestamps, threads, currentParse));
+
+    report("format, 1 thread",
+        callsPerSecond(timestamps, 1, [](const std::string& s) {
+            char out[BlueskyTimestamp::MAX_FORMAT_SIZE];
+            return (int64_t)legacyFormat((time_t)s.size(), out);
+        }),
+        callsPerSecond(timestamps, 1, [](const std::string& s) {
+            char out[BlueskyTimestamp::MAX_FORMAT_SIZE];
+            return (int64_t)BlueskyTimestamp::fromMicroseconds((int64_t)s.size()).format(out);
+        }));
+
+    return 0;
+}
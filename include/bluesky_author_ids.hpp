@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Maps author DIDs to dense ids, 0, 1, 2... in the order they were first
+// seen, so per-author data can live in plain vectors indexed by id. Shared
+// by BlueskyAuthorTable and BlueskyFeedBatch. Not thread-safe.
+class BlueskyAuthorIds {
+public:
+    typedef uint32_t AuthorId;
+    static const AuthorId NO_AUTHOR = UINT32_MAX;
+
+    BlueskyAuthorIds();
+
+    // Id of did, the next free one if it is new; added tells which
+    AuthorId intern(const char* did, size_t size, bool& added);
+
+    // NO_AUTHOR if did was never interned
+    AuthorId find(const std::string& did) const;
+
+    size_t size() const { return m_ids.size(); }
+    void clear() { m_ids.clear(); }
+
+private:
+    std::unordered_map<std::string, AuthorId> m_ids;
+    std::string m_key; // Reused for lookups
+};
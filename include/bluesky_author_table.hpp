@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bluesky_author_ids.hpp"
+#include "bluesky_client.hpp"
+#include "bluesky_timestamp.hpp"
+
+// Interned authors: each DID is stored once and gets a stable AuthorId, so
+// cached posts can hold an id instead of a full PostAuthor copy. When an
+// author is seen again, the stored profile is updated in place if the new
+// copy is at least as recent. Ids stay valid until clear(). Thread-safe.
+class BlueskyAuthorTable {
+public:
+    typedef BlueskyAuthorIds::AuthorId AuthorId;
+    static const AuthorId NO_AUTHOR = BlueskyAuthorIds::NO_AUTHOR;
+
+    // A Post that refers to its author by id
+    struct Post {
+        std::string uri;
+        time_t indexedAt;
+        time_t createdAt;
+
+        BlueskyTimestamp indexedAtTime;
+        BlueskyTimestamp createdAtTime;
+
+        AuthorId author;
+
+        std::string cid;
+
+        std::string text;
+
+        unsigned int likeCount, quoteCount, replyCount, repostCount;
+    };
+
+    BlueskyAuthorTable();
+
+    // Disable copying
+    BlueskyAuthorTable(const BlueskyAuthorTable&) = delete;
+    BlueskyAuthorTable& operator=(const BlueskyAuthorTable&) = delete;
+
+    // seenAt orders copies of a profile; a copy older than the stored one
+    // is ignored. Returns NO_AUTHOR for an author without a DID.
+    AuthorId intern(const BlueskyClient::PostAuthor& author, BlueskyTimestamp seenAt = BlueskyTimestamp::now());
+
+    // Reads the profile straight from the response; strings are only copied
+    // when the author is new or they changed
+    AuthorId intern(const BlueskyClient::AuthorView& author, BlueskyTimestamp seenAt = BlueskyTimestamp::now());
+
+    Post intern(const BlueskyClient::Post& post, BlueskyTimestamp seenAt = BlueskyTimestamp::now());
+    Post intern(const BlueskyClient::PostView& post, BlueskyTimestamp seenAt = BlueskyTimestamp::now());
+    std::vector<Post> intern(const BlueskyClient::PostsResult& result, BlueskyTimestamp seenAt = BlueskyTimestamp::now());
+    std::vector<Post> intern(const BlueskyClient::FeedView& page, BlueskyTimestamp seenAt = BlueskyTimestamp::now());
+
+    AuthorId find(const std::string& did) const;
+
+    // Copy of the current profile; false for an unknown id
+    bool author(AuthorId id, BlueskyClient::PostAuthor& out) const;
+
+    // The post with its author filled in from the table
+    BlueskyClient::Post expand(const Post& post) const;
+
+    size_t size() const;
+    void clear();
+
+private:
+    struct Entry {
+        BlueskyClient::PostAuthor author;
+        BlueskyTimestamp seenAt;
+    };
+
+    // Returns the id of did, adding an empty entry if it is new
+    AuthorId slotLocked(const char* did, size_t size, bool& added);
+
+    static Post strip(const BlueskyClient::Post& post, AuthorId author);
+
+    mutable std::mutex m_mutex;
+
+    std::vector<Entry> m_entries; // Indexed by AuthorId
+    BlueskyAuthorIds m_ids;
+};
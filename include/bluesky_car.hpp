@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "bluesky_cbor.hpp"
+
+// Streaming reader for CAR v1 files, as returned by com.atproto.sync.getRepo.
+// Data is fed in chunks of any size as it arrives; each block is handed out
+// as soon as it is complete, so only the block being received is buffered.
+class BlueskyCarReader {
+public:
+    struct Block {
+        const BlueskyCid& cid;
+        const uint8_t* data;
+        size_t size;
+    };
+
+    // Return false to stop reading
+    typedef std::function<bool(const Block& block)> BlockHandler;
+
+    // With verifyCids, every block is hashed and checked against its CID
+    explicit BlueskyCarReader(BlockHandler handler, bool verifyCids = true);
+
+    // Returns false once the data is malformed, a CID does not match or the
+    // handler stopped; error() says which
+    bool feed(const char* data, size_t size);
+
+    // Checks that the data ended on a block boundary
+    bool finish();
+
+    const std::vector<BlueskyCid>& roots() const { return m_roots; }
+    uint64_t blockCount() const { return m_blocks; }
+    const std::string& error() const { return m_error; }
+
+    // Whether data hashes to the digest in cid; false for unknown hashes
+    static bool verify(const BlueskyCid& cid, const uint8_t* data, size_t size);
+
+private:
+    // Reads complete sections from data, returns how many bytes were used
+    size_t consume(const uint8_t* data, size_t size);
+
+    bool readHeader(const uint8_t* data, size_t size);
+    bool fail(const std::string& error);
+
+    BlockHandler m_handler;
+    const bool m_verify;
+
+    std::string m_pending; // Start of a section not yet complete
+    bool m_header_read;
+    bool m_failed;
+    uint64_t m_blocks;
+    std::vector<BlueskyCid> m_roots;
+    std::string m_error;
+};
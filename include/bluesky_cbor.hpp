@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Content identifier (CIDv1), kept in its binary form
+struct BlueskyCid {
+    // Multicodec of the content and multihash function of the digest
+    enum {
+        Codec_Raw = 0x55,
+        Codec_DagCbor = 0x71,
+
+        Hash_Identity = 0x00,
+        Hash_Sha256 = 0x12,
+    };
+
+    std::string bytes;
+    uint64_t codec;
+    uint64_t hash;
+    size_t digestOffset; // Within bytes
+    size_t digestLength;
+
+    BlueskyCid() : codec(0), hash(0), digestOffset(0), digestLength(0) {}
+
+    bool empty() const { return bytes.empty(); }
+
+    // Base32 multibase form, e.g. "bafyrei..."
+    std::string toString() const;
+
+    // Parses a binary CIDv1 at the start of data. Returns its length, or 0
+    // if it is malformed or truncated.
+    static size_t parse(const uint8_t* data, size_t size, BlueskyCid& cid);
+};
+
+// Reads an unsigned LEB128 varint; returns its length, 0 if malformed or
+// truncated
+size_t blueskyReadVarint(const uint8_t* data, size_t size, uint64_t& value);
+
+// Pull decoder for DAG-CBOR. Items are read one head at a time: arrays,
+// maps and tags report their size and their content follows as the next
+// items. Indefinite lengths are rejected, as DAG-CBOR forbids them.
+class BlueskyCborReader {
+public:
+    enum Type {
+        Type_Unsigned = 0,
+        Type_Negative,
+        Type_Bytes,
+        Type_Text,
+        Type_Array,
+        Type_Map,
+        Type_Tag,
+        Type_False,
+        Type_True,
+        Type_Null,
+        Type_Float,
+    };
+
+    struct Item {
+        Type type;
+        uint64_t value; // Integer, payload length, entry count or tag number
+        const uint8_t* data; // Payload of bytes and text
+        double number; // Value of a float
+    };
+
+    BlueskyCborReader(const uint8_t* data, size_t size)
+        : m_data(data), m_size(size), m_pos(0), m_failed(false) {}
+
+    // Reads the next item head; for bytes and text, also steps over the
+    // payload. Returns false at the end of the data or if it is malformed.
+    bool read(Item& item);
+
+    // Skips the next item with everything nested in it
+    bool skip();
+
+    // Convenience readers for the next item, failing on a type mismatch
+    bool readText(std::string& out);
+    bool readInt(int64_t& out);
+    bool readCid(BlueskyCid& out); // Tag 42
+    bool readMap(uint64_t& entries);
+    bool readArray(uint64_t& entries);
+
+    // Reads the next item if it is null
+    bool readNull();
+
+    size_t offset() const { return m_pos; }
+    bool atEnd() const { return m_pos >= m_size; }
+    bool failed() const { return m_failed; }
+
+private:
+    bool fail() { m_failed = true; return false; }
+
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_pos;
+    bool m_failed;
+};
@@ -6,12 +6,35 @@
 #include <string>
 
 #include <memory>
+#include <functional>
+#include <future>
+#include <atomic>
+#include <mutex>
+#include <chrono>
 
 #include <httplib.h>
 
+#include "bluesky_json_builder.hpp"
+#include "bluesky_metrics.hpp"
+#include "bluesky_timestamp.hpp"
+
+struct yyjson_doc;
+struct yyjson_val;
+
+class BlueskyAuthorTable;
+class BlueskyConnectionPool;
+struct BlueskyConnection;
+class BlueskyExecutor;
+class BlueskyRateLimiter;
+class BlueskyResponseCache;
+template <typename Value> class BlueskySingleFlight;
+
+// All methods may be called from several threads at once. Requests run in
+// parallel on up to maxConnections keep-alive connections to the server.
+// A client must not be moved or destroyed while async calls are pending.
 class BlueskyClient {
 public:
-    explicit BlueskyClient(const std::string& server = "bsky.social");
+    explicit BlueskyClient(const std::string& server = "bsky.social", unsigned maxConnections = 1);
     ~BlueskyClient();
 
     // Disable copying
@@ -28,13 +51,25 @@ public:
         Error_ResponseParseFail, // Failed to parse response JSON
         Error_ResponseFail, // Response was empty or code was not 200
         Error_BadInput, // Bad user input
+        Error_NotFound, // Item does not exist or is not visible to the user
     };
 
     bool login(const std::string& identifier, const std::string& password);
 
+    // Exchanges the refresh token for a new session. Runs on its own shortly
+    // before the access token expires, and when a request is rejected with
+    // ExpiredToken; returns false if there is no session or the refresh failed.
+    bool refreshSession();
+
+    // The session as JSON, for importSession after a restart to skip logging
+    // in again. Contains the tokens, so store it like a password.
+    std::string exportSession() const;
+    bool importSession(const std::string& json);
+
     struct PostAuthor {
         std::string did;
         time_t createdAt;
+        BlueskyTimestamp createdAtTime; // createdAt with sub-second precision
 
         std::string handle;
         std::string displayName;
@@ -46,11 +81,103 @@ public:
     
     Error createPost(const std::string& text);
 
+    // Strong reference to a record
+    struct RecordRef {
+        std::string uri;
+        std::string cid;
+    };
+
+    // Rich text annotation over a byte range of a post's UTF-8 text
+    struct Facet {
+        enum Type {
+            Type_Link = 0, // value is a URL
+            Type_Mention, // value is a DID
+            Type_Tag, // value is a hashtag without the '#'
+        };
+
+        Type type;
+        size_t byteStart, byteEnd;
+        std::string value;
+    };
+
+    // Link card embed
+    struct ExternalEmbed {
+        std::string uri;
+        std::string title;
+        std::string description;
+    };
+
+    struct PostRecord {
+        std::string text;
+        std::vector<std::string> langs;
+        std::vector<Facet> facets;
+
+        // Set replyParent to make the post a reply; replyRoot defaults to it
+        RecordRef replyRoot;
+        RecordRef replyParent;
+
+        // Quoted post, takes precedence over external
+        RecordRef quote;
+        ExternalEmbed external;
+    };
+
+    Error createPost(const PostRecord& record);
+
+    // Writes an app.bsky.feed.post record, stamped with the current time
+    static void writePostRecord(BlueskyJsonBuilder::Object& out, const PostRecord& record);
+
+    enum WriteAction {
+        WriteAction_Create = 0,
+        WriteAction_Update,
+        WriteAction_Delete,
+    };
+
+    struct WriteOp {
+        WriteAction action;
+        std::string collection; // NSID, e.g. "app.bsky.feed.post"
+        std::string rkey; // Optional for creates
+        std::string record; // Record object as JSON, unused for deletes
+    };
+
+    struct WriteResult {
+        Error error;
+        std::string uri; // Empty for deletes
+        std::string cid; // Empty for deletes
+        std::string validationStatus;
+        bool retryable; // Nothing was applied, so sending the write again is safe
+    };
+
+    // Most operations com.atproto.repo.applyWrites accepts in one request
+    static const size_t MAX_WRITES_PER_REQUEST = 200;
+
+    // Applies up to MAX_WRITES_PER_REQUEST operations to the user's repo in one
+    // atomic request. Returns one result per operation, in order; if the
+    // request fails, every result carries the error. A failure is retryable
+    // only when the request was never sent or the server refused it with a
+    // 4xx; after a timeout or 5xx the writes may have been applied.
+    std::vector<WriteResult> applyWrites(const std::vector<WriteOp>& ops);
+
+    struct RecordResult {
+        Error error;
+        std::string uri;
+        std::string cid;
+        std::string value; // Record object as JSON
+    };
+
+    // Reads one record from a repo. Public records need no login, so this
+    // also works on a client for the account's own PDS, see
+    // BlueskyIdentity::pdsClient.
+    RecordResult getRecord(const std::string& repo, const std::string& collection, const std::string& rkey);
+
     struct Post {
         std::string uri;
         time_t indexedAt;
         time_t createdAt;
 
+        // The same times with sub-second precision, to order posts within a second
+        BlueskyTimestamp indexedAtTime;
+        BlueskyTimestamp createdAtTime;
+
         PostAuthor author;
 
         std::string cid;
@@ -63,27 +190,226 @@ public:
     struct PostsResult {
         std::vector<Post> posts;
         Error error;
+
+        // Cursor for the page after this one, empty when there are no more
+        std::string cursor;
     };
 
-    PostsResult getFeedPosts(const std::string& feedUri, int limit = 1);
+    PostsResult getFeedPosts(const std::string& feedUri, int limit = 1, const std::string& cursor = std::string());
 
     // atId can be either DID or handle
-    PostsResult getAuthorPosts(const std::string& atId, int limit = 1);
+    PostsResult getAuthorPosts(const std::string& atId, int limit = 1, const std::string& cursor = std::string());
+
+    // Non-owning reference to a string inside a FeedView's document
+    class StringRef {
+    public:
+        StringRef() : m_data(""), m_size(0) {}
+        StringRef(const char* data, size_t size) : m_data(data), m_size(size) {}
+
+        const char* data() const { return m_data; }
+        size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+
+        std::string str() const { return std::string(m_data, m_size); }
+
+        bool operator==(const StringRef& other) const {
+            return m_size == other.m_size && std::char_traits<char>::compare(m_data, other.m_data, m_size) == 0;
+        }
+        bool operator!=(const StringRef& other) const { return !(*this == other); }
+        bool operator==(const std::string& other) const { return *this == StringRef(other.data(), other.size()); }
+        bool operator!=(const std::string& other) const { return !(*this == other); }
+
+    private:
+        const char* m_data;
+        size_t m_size;
+    };
+
+    // Lazy accessors over an author object; fields are looked up on demand
+    class AuthorView {
+    public:
+        explicit AuthorView(yyjson_val* author = nullptr) : m_author(author) {}
+
+        StringRef did() const;
+        StringRef handle() const;
+        StringRef displayName() const;
+        StringRef avatarUrl() const;
+        time_t createdAt() const;
+        BlueskyTimestamp createdAtTime() const;
+        bool blockedByViewer() const;
+        bool mutedByViewer() const;
+
+        PostAuthor toAuthor() const;
+
+    private:
+        yyjson_val* m_author;
+    };
+
+    // Lazy accessors over a post object; fields are looked up on demand
+    class PostView {
+    public:
+        explicit PostView(yyjson_val* post = nullptr) : m_post(post) {}
+
+        StringRef uri() const;
+        StringRef cid() const;
+        StringRef text() const;
+        AuthorView author() const;
+
+        time_t indexedAt() const;
+        time_t createdAt() const;
+        BlueskyTimestamp indexedAtTime() const;
+        BlueskyTimestamp createdAtTime() const;
+
+        unsigned int likeCount() const;
+        unsigned int quoteCount() const;
+        unsigned int replyCount() const;
+        unsigned int repostCount() const;
+
+        Post toPost() const;
+
+    private:
+        yyjson_val* m_post;
+    };
+
+    // A feed page that keeps the response body and its parsed document alive,
+    // so posts can be inspected without copying them into Post structs
+    class FeedView {
+    public:
+        FeedView();
+        ~FeedView();
+
+        // Disable copying
+        FeedView(const FeedView&) = delete;
+        FeedView& operator=(const FeedView&) = delete;
+
+        // Enable moving
+        FeedView(FeedView&&);
+        FeedView& operator=(FeedView&&);
+
+        // Takes over the response body and parses it in place
+        static FeedView parse(std::string json);
+
+        Error error() const { return m_error; }
+        StringRef cursor() const { return m_cursor; }
+
+        const std::vector<PostView>& posts() const { return m_posts; }
+        size_t size() const { return m_posts.size(); }
+        const PostView& operator[](size_t i) const { return m_posts[i]; }
+
+        // Copies every post out of the document
+        PostsResult toPostsResult() const;
+
+    private:
+        friend class BlueskyClient;
+
+        void reset();
+
+        std::unique_ptr<std::string> m_buffer;
+        yyjson_doc* m_doc;
+        std::vector<PostView> m_posts;
+        StringRef m_cursor;
+        Error m_error;
+    };
+
+    // Same requests as getFeedPosts/getAuthorPosts, returning views into the response
+    FeedView getFeedPostsView(const std::string& feedUri, int limit = 1, const std::string& cursor = std::string());
+    FeedView getAuthorPostsView(const std::string& atId, int limit = 1, const std::string& cursor = std::string());
+
+    // Most URIs/actors getPosts and getProfiles accept in one request
+    static const size_t MAX_HYDRATION_BATCH = 25;
+
+    // Hydrates up to MAX_HYDRATION_BATCH posts by at:// URI. Posts that were
+    // deleted or are not visible are left out, so match results by uri.
+    PostsResult getPosts(const std::vector<std::string>& uris);
+
+    struct ProfilesResult {
+        std::vector<PostAuthor> profiles;
+        Error error;
+    };
+
+    // Hydrates up to MAX_HYDRATION_BATCH profiles by DID or handle. Unknown
+    // actors are left out.
+    ProfilesResult getProfiles(const std::vector<std::string>& actors);
 
     int getUnreadCount();
 
+    // Receives chunks of a response body as they arrive; return false to stop
+    typedef std::function<bool(const char* data, size_t size)> DataHandler;
+
+    // Downloads the whole repo of did as a CAR file, handing it to onData
+    // chunk by chunk while it arrives; see BlueskyRepoReader to decode it.
+    // Public repos need no login. Best sent to the account's own PDS, see
+    // BlueskyIdentity::pdsClient.
+    Error getRepo(const std::string& did, const DataHandler& onData);
+
+    // Async counterparts of the calls above. They run on the client's worker
+    // threads and either return a future or invoke the callback from a worker.
+    std::future<bool> loginAsync(const std::string& identifier, const std::string& password);
+    std::future<Error> createPostAsync(const std::string& text);
+    std::future<PostsResult> getFeedPostsAsync(const std::string& feedUri, int limit = 1, const std::string& cursor = std::string());
+    std::future<PostsResult> getAuthorPostsAsync(const std::string& atId, int limit = 1, const std::string& cursor = std::string());
+    std::future<int> getUnreadCountAsync();
+
+    void loginAsync(const std::string& identifier, const std::string& password, std::function<void(bool)> callback);
+    void createPostAsync(const std::string& text, std::function<void(Error)> callback);
+    void getFeedPostsAsync(const std::string& feedUri, int limit, const std::string& cursor, std::function<void(PostsResult)> callback);
+    void getAuthorPostsAsync(const std::string& atId, int limit, const std::string& cursor, std::function<void(PostsResult)> callback);
+    void getUnreadCountAsync(std::function<void(int)> callback);
+
+    // Fetches the first page of every author feed in parallel; results are in
+    // the same order as atIds. At most maxConnections requests run at once, so
+    // a client with the default single connection fetches them one by one.
+    // Must not be called from an async callback.
+    std::vector<PostsResult> getAuthorPostsBatch(const std::vector<std::string>& atIds, int limit = 1);
+
+    // Number of worker threads for async calls, defaults to maxConnections;
+    // more would only wait for a free connection. Changing it waits for
+    // pending async calls to finish.
+    void setWorkerThreads(unsigned threads);
+
+    // Latency, size and status stats of every request this client sent
+    BlueskyMetrics& metrics() { return *m_metrics; }
+
+    // Identical GETs (same endpoint, params and account) sent while one is
+    // in flight wait for it and share its response and decoded result. With
+    // a window, a result is also shared for that long after its request
+    // finished. Off by default.
+    void setRequestCoalescing(bool enabled, std::chrono::milliseconds window = std::chrono::milliseconds(0));
+
+    // Calls answered by another caller's request
+    uint64_t coalescedRequests() const { return m_coalesced; }
+
+    // Serves feed pages, unread counts and feed views from cache, see
+    // BlueskyResponseCache. Off (nullptr) by default.
+    void setResponseCache(std::shared_ptr<BlueskyResponseCache> cache);
+    std::shared_ptr<BlueskyResponseCache> responseCache() const;
+
+    // Shared table to intern the authors of posts this client fetched, see
+    // BlueskyAuthorTable
+    BlueskyAuthorTable& authors() { return *m_authors; }
+
     // Helper functions
     static std::string filterText(const std::string& str);
     static std::vector<std::string> splitIntoWords(const std::string& str);
     static std::string urlEncode(const std::string& str);
     static std::string createJsonString(const std::map<std::string, std::string>& data);
 
+    // Decodes a getFeed/getAuthorFeed response body
+    static PostsResult parseFeed(const std::string& json);
+
+    static const char* const USER_AGENT;
+
     // Status checks and getters
-    bool isLoggedIn() const { return !m_access_token.empty(); }
-    const std::string& getHandle() const { return m_user_handle; }
-    const std::string& getDid() const { return m_user_did; }
+    bool isLoggedIn() const;
+    std::string getHandle() const;
+    std::string getDid() const;
+
+    // Expiry of the access token, 0 if not logged in or unknown
+    time_t getSessionExpiry() const;
 
 private:
+    // Query parameters; a key may repeat for array parameters
+    typedef std::multimap<std::string, std::string> QueryParams;
+
     enum RequestMethod {
         RequestMethod_GET = 0,
         RequestMethod_POST,
@@ -92,21 +418,177 @@ private:
         RequestMethod_Max
     };
 
+    // Which token a request is authorized with
+    enum RequestAuth {
+        RequestAuth_Access = 0,
+        RequestAuth_Refresh, // Only for refreshSession
+    };
+
+    // Fetch one page of a feed endpoint with the given limit and cursor
+    PostsResult fetchFeedPosts(
+        const std::string& endpoint,
+        QueryParams params,
+        int limit,
+        const std::string& cursor
+    );
+    FeedView fetchFeedView(
+        const std::string& endpoint,
+        QueryParams params,
+        int limit,
+        const std::string& cursor
+    );
+
+    // Tokens and identity of the logged in account. A session is never
+    // modified once published; login and refreshes swap in a new one.
+    struct Session {
+        std::string accessToken; // Including the "Bearer " prefix
+        std::string refreshToken;
+        std::string did;
+        std::string handle;
+        time_t expiresAt; // Access token expiry, 0 if unknown
+    };
+
+    std::shared_ptr<const Session> loadSession() const;
+    void storeSession(std::shared_ptr<const Session> session);
+
+    // Reads a createSession/refreshSession response, nullptr if incomplete
+    static std::shared_ptr<Session> decodeSession(yyjson_val* root);
+
+    // Refreshes unless another thread already replaced observed. After a
+    // failed refresh, further ones for the same session fail without a
+    // request until a backoff has passed, unless force is set.
+    bool refreshSessionFrom(const std::shared_ptr<const Session>& observed, bool force = false);
+
+    // Starts a background refresh when the access token is about to expire,
+    // refreshes in place when it already has
+    void refreshSessionIfExpiring(const std::shared_ptr<const Session>& session);
+
+    // Queue a call on the worker threads, with first ahead of calls still
+    // waiting. The executor is only touched under m_executor_mutex, so
+    // setWorkerThreads cannot destroy it meanwhile.
+    void postTask(std::function<void()> task, bool first = false);
+    template <typename Fn> auto submitTask(Fn fn) -> std::future<decltype(fn())>;
+    BlueskyExecutor& executorLocked();
+
+    // Runs every pending async call to completion
+    void drainExecutor();
+
+    // Request body builders are recycled between requests so their arenas
+    // and output buffers stay allocated
+    class BuilderLease;
+
+    std::unique_ptr<BlueskyJsonBuilder> takeBuilder();
+    void returnBuilder(std::unique_ptr<BlueskyJsonBuilder> builder);
+
     // HTTP request helpers
+
+    // ETag handling of a cached GET
+    struct Validators {
+        Validators() : notModified(false) {}
+
+        std::string ifNoneMatch; // Sent as If-None-Match when set
+        std::string etag; // ETag of a 200 response
+        bool notModified; // The response was a 304
+    };
+
+    // Runs fetch, or serves the result from the response cache or shares
+    // that of an identical GET, see setResponseCache and
+    // setRequestCoalescing. kind tells apart the result types of calls to
+    // the same endpoint.
+    template <typename Result>
+    Result sharedGet(
+        const char* kind,
+        const std::string& endpoint,
+        const QueryParams& params,
+        const std::function<Result(Validators& validators)>& fetch
+    );
+
+    // Cache and coalescing key of a GET, without the account
+    std::string sharedKey(const char* kind, const std::string& path) const;
+
+    // Drops cached pages of the account's own author feed after a write
+    void invalidateAuthorFeeds(const Session& session);
+
+    // Endpoint and URL-encoded query string
+    static std::string requestPath(const std::string& endpoint, const QueryParams& params);
+
+    // Returns a copy of the body of a 200 response, otherwise an empty string
     std::string makeRequest(
         RequestMethod method,
         const std::string& endpoint,
-        const std::map<std::string, std::string>& params = std::map<std::string, std::string>(),
+        const QueryParams& params = QueryParams(),
         const std::string& body = std::string()
     );
 
+    // Parses the body of a 200 response in place, in the connection's receive
+    // buffer, and hands the root to handler before the connection is released
+    Error makeJsonRequest(
+        RequestMethod method,
+        const std::string& endpoint,
+        const QueryParams& params,
+        const std::string& body,
+        const std::function<void(yyjson_val* root)>& handler,
+        RequestAuth auth = RequestAuth_Access,
+        Validators* validators = nullptr,
+        int* status = nullptr // HTTP status, -1 if no response arrived
+    );
+
+    // Sends the request, paced by the server's rate limits and retried on
+    // 429, and once more after a refresh if the access token expired.
+    // onSuccess runs with the connection holding the body of a 200 response,
+    // unless stream is set: then the body goes to stream instead.
+    // With validators, If-None-Match is sent and the ETag or a 304 reported.
+    // Returns the final HTTP status, or -1 if there was no response.
+    int performRequest(
+        RequestMethod method,
+        const std::string& endpoint,
+        const QueryParams& params,
+        const std::string& body,
+        const std::function<void(BlueskyConnection& connection)>& onSuccess,
+        RequestAuth auth = RequestAuth_Access,
+        const DataHandler& stream = DataHandler(),
+        Validators* validators = nullptr
+    );
+
+    // Sends a single request, receiving the body into the connection's
+    // buffer, or handing it to stream as it arrives if the status is 200
+    httplib::Result sendRequest(
+        BlueskyConnection& connection,
+        RequestMethod method,
+        const std::string& path,
+        const httplib::Headers& headers,
+        const std::string& body,
+        const DataHandler& stream,
+        BlueskyMetrics::Sample& sample
+    );
+
     // Member variables
-    std::unique_ptr<httplib::Client> m_client;
     std::string m_server_host;
-    std::string m_access_token;
-    std::string m_user_did;
-    std::string m_user_handle;
-    std::string m_refresh_token;
-    
-    static const char* const USER_AGENT;
+    std::unique_ptr<BlueskyConnectionPool> m_pool;
+    std::unique_ptr<BlueskyRateLimiter> m_rate_limiter;
+    std::unique_ptr<BlueskyMetrics> m_metrics;
+    std::unique_ptr<BlueskyAuthorTable> m_authors;
+
+    std::atomic<bool> m_coalesce;
+    std::atomic<uint64_t> m_coalesced;
+    std::unique_ptr<BlueskySingleFlight<std::shared_ptr<const void>>> m_flights;
+    std::shared_ptr<BlueskyResponseCache> m_cache;
+    std::shared_ptr<const Session> m_session;
+
+    std::mutex m_refresh_mutex;
+    std::atomic<bool> m_refresh_pending;
+
+    // Last failed refresh, under m_refresh_mutex
+    std::shared_ptr<const Session> m_refresh_failed; // Session it was for
+    unsigned m_refresh_failures; // In a row, for that session
+    std::chrono::steady_clock::time_point m_refresh_retry_at;
+
+    std::mutex m_builders_mutex;
+    std::vector<std::unique_ptr<BlueskyJsonBuilder>> m_builders;
+
+    // Last, so pending async calls are done before anything they use goes
+    // away; ~BlueskyClient also drains it explicitly
+    std::mutex m_executor_mutex;
+    unsigned m_worker_threads;
+    std::unique_ptr<BlueskyExecutor> m_executor;
 };
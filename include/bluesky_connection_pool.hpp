@@ -0,0 +1,89 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <httplib.h>
+
+struct yyjson_alc;
+
+// One keep-alive connection plus the buffers its responses are received and
+// parsed in. Both are reused from response to response.
+struct BlueskyConnection {
+    explicit BlueskyConnection(const std::string& baseUrl);
+    ~BlueskyConnection();
+
+    // Disable copying
+    BlueskyConnection(const BlueskyConnection&) = delete;
+    BlueskyConnection& operator=(const BlueskyConnection&) = delete;
+
+    httplib::Client client;
+
+    // Body of the last response, followed by zeroed padding so yyjson can
+    // parse it in place
+    std::string body;
+    size_t bodyLength;
+
+    // Allocator for documents parsed from body; memory freed by one document
+    // is handed out again to the next
+    yyjson_alc* alc;
+};
+
+// A bounded set of keep-alive connections to one host. Each connection is
+// used by one request at a time; requests beyond the limit wait for a
+// connection to be released.
+class BlueskyConnectionPool {
+public:
+    typedef BlueskyConnection Connection;
+
+    // Hands a connection back to the pool when destroyed
+    class Lease {
+    public:
+        Lease(BlueskyConnectionPool* pool, std::unique_ptr<Connection> connection)
+            : m_pool(pool), m_connection(std::move(connection)) {}
+        ~Lease();
+
+        // Disable copying
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        // Enable moving
+        Lease(Lease&& other) : m_pool(other.m_pool), m_connection(std::move(other.m_connection)) {}
+
+        Connection& operator*() const { return *m_connection; }
+        Connection* operator->() const { return m_connection.get(); }
+
+    private:
+        BlueskyConnectionPool* m_pool;
+        std::unique_ptr<Connection> m_connection;
+    };
+
+    // baseUrl is scheme and host, e.g. "https://bsky.social"
+    explicit BlueskyConnectionPool(const std::string& baseUrl, unsigned maxConnections = 1);
+    ~BlueskyConnectionPool();
+
+    // Disable copying
+    BlueskyConnectionPool(const BlueskyConnectionPool&) = delete;
+    BlueskyConnectionPool& operator=(const BlueskyConnectionPool&) = delete;
+
+    // Returns an idle connection, opens a new one if under the limit, or
+    // blocks until another thread releases one
+    Lease acquire();
+
+    const std::string& baseUrl() const { return m_base_url; }
+    unsigned maxConnections() const { return m_max_connections; }
+
+private:
+    void release(std::unique_ptr<Connection> connection);
+
+    const std::string m_base_url;
+    const unsigned m_max_connections;
+
+    std::mutex m_mutex;
+    std::condition_variable m_available;
+    std::vector<std::unique_ptr<Connection>> m_idle;
+    unsigned m_open;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads running queued tasks in FIFO order.
+class BlueskyExecutor {
+public:
+    explicit BlueskyExecutor(unsigned threads = 4);
+
+    // Runs every task still queued, then joins the workers
+    ~BlueskyExecutor();
+
+    // Disable copying
+    BlueskyExecutor(const BlueskyExecutor&) = delete;
+    BlueskyExecutor& operator=(const BlueskyExecutor&) = delete;
+
+    void post(std::function<void()> task);
+
+    // Queues task ahead of every task still waiting
+    void postFront(std::function<void()> task);
+
+    // Queues fn and returns a future for its result
+    template <typename Fn>
+    auto submit(Fn fn) -> std::future<decltype(fn())> {
+        typedef decltype(fn()) Result;
+
+        std::shared_ptr<std::packaged_task<Result()>> task(new std::packaged_task<Result()>(std::move(fn)));
+        std::future<Result> future = task->get_future();
+
+        post([task] { (*task)(); });
+
+        return future;
+    }
+
+    // Runs fn on every input in parallel and returns the results in input
+    // order. Must not be called from one of this executor's own workers.
+    template <typename Input, typename Fn>
+    auto map(const std::vector<Input>& inputs, Fn fn) -> std::vector<decltype(fn(inputs[0]))> {
+        typedef decltype(fn(inputs[0])) Result;
+
+        std::vector<std::future<Result>> futures;
+        futures.reserve(inputs.size());
+
+        for (const Input& input : inputs) {
+            const Input* inputPtr = &input;
+            futures.push_back(submit([fn, inputPtr] { return fn(*inputPtr); }));
+        }
+
+        std::vector<Result> results;
+        results.reserve(futures.size());
+
+        for (auto& future : futures)
+            results.push_back(future.get());
+
+        return results;
+    }
+
+    unsigned threadCount() const { return (unsigned)m_threads.size(); }
+
+private:
+    void run();
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<std::function<void()>> m_tasks;
+    bool m_stopping;
+
+    std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bluesky_author_ids.hpp"
+#include "bluesky_client.hpp"
+#include "bluesky_timestamp.hpp"
+
+// Posts of many feed pages in columns (structure of arrays): every counter
+// and timestamp is a contiguous array, authors are interned to small ids,
+// and all strings sit in one shared heap. Meant for scanning many posts at
+// once; the scoring and filtering loops run 8 or 4 posts at a time with
+// AVX2 where the CPU has it. Not thread-safe.
+class BlueskyFeedBatch {
+public:
+    // Same ids as BlueskyAuthorTable hands out, numbered per batch
+    typedef BlueskyAuthorIds::AuthorId AuthorId;
+    static const AuthorId NO_AUTHOR = BlueskyAuthorIds::NO_AUTHOR;
+
+    // Engagement score of a post: weighted sum of its counters
+    struct Weights {
+        float likes, reposts, replies, quotes;
+
+        Weights(float likes = 1, float reposts = 1, float replies = 1, float quotes = 1)
+            : likes(likes), reposts(reposts), replies(replies), quotes(quotes)
+        {}
+    };
+
+    // Sums over every post of one author
+    struct AuthorTotals {
+        uint64_t posts;
+        uint64_t likes, reposts, replies, quotes;
+    };
+
+    BlueskyFeedBatch();
+
+    void reserve(size_t posts);
+    void clear();
+
+    void append(const BlueskyClient::Post& post);
+    void append(const BlueskyClient::PostsResult& result);
+
+    // Reads the page's fields straight out of its document
+    void append(const BlueskyClient::FeedView& page);
+
+    size_t size() const { return m_likes.size(); }
+
+    // Columns, one entry per post
+    const std::vector<uint32_t>& likeCounts() const { return m_likes; }
+    const std::vector<uint32_t>& repostCounts() const { return m_reposts; }
+    const std::vector<uint32_t>& replyCounts() const { return m_replies; }
+    const std::vector<uint32_t>& quoteCounts() const { return m_quotes; }
+    const std::vector<AuthorId>& authors() const { return m_authors; }
+
+    // BlueskyTimestamp microseconds; INT64_MIN where a time was missing
+    const std::vector<int64_t>& indexedAt() const { return m_indexed_at; }
+    const std::vector<int64_t>& createdAt() const { return m_created_at; }
+
+    // Valid until the next append or clear
+    BlueskyClient::StringRef uri(size_t i) const;
+    BlueskyClient::StringRef cid(size_t i) const;
+    BlueskyClient::StringRef text(size_t i) const;
+
+    size_t authorCount() const { return m_author_offsets.size(); }
+    AuthorId findAuthor(const std::string& did) const;
+
+    // The author as first seen in the batch
+    BlueskyClient::StringRef authorDid(AuthorId id) const;
+    BlueskyClient::StringRef authorHandle(AuthorId id) const;
+    BlueskyClient::StringRef authorDisplayName(AuthorId id) const;
+    BlueskyClient::StringRef authorAvatarUrl(AuthorId id) const;
+
+    // Copies post i out of the batch
+    BlueskyClient::Post post(size_t i) const;
+
+    void scores(const Weights& weights, std::vector<float>& out) const;
+
+    // Indexes of the k posts with the highest score, highest first
+    std::vector<uint32_t> topK(size_t k, const Weights& weights = Weights()) const;
+
+    // Indexes of the posts indexed or created in [from, to), in batch order
+    std::vector<uint32_t> indexedBetween(BlueskyTimestamp from, BlueskyTimestamp to) const;
+    std::vector<uint32_t> createdBetween(BlueskyTimestamp from, BlueskyTimestamp to) const;
+
+    // Indexed by AuthorId
+    std::vector<AuthorTotals> authorTotals() const;
+
+private:
+    AuthorId internAuthor(
+        BlueskyClient::StringRef did,
+        BlueskyClient::StringRef handle,
+        BlueskyClient::StringRef displayName,
+        BlueskyClient::StringRef avatarUrl
+    );
+
+    void appendStrings(BlueskyClient::StringRef uri, BlueskyClient::StringRef cid, BlueskyClient::StringRef text);
+
+    BlueskyClient::StringRef heapString(uint64_t offset, uint32_t size) const;
+
+    std::vector<uint32_t> m_likes;
+    std::vector<uint32_t> m_reposts;
+    std::vector<uint32_t> m_replies;
+    std::vector<uint32_t> m_quotes;
+    std::vector<int64_t> m_indexed_at;
+    std::vector<int64_t> m_created_at;
+    std::vector<AuthorId> m_authors;
+
+    // Each post's uri, cid and text follow one another in the heap
+    std::string m_heap;
+    std::vector<uint64_t> m_string_offsets;
+    std::vector<uint32_t> m_uri_sizes;
+    std::vector<uint32_t> m_cid_sizes;
+    std::vector<uint32_t> m_text_sizes;
+
+    // Likewise each author's did, handle, display name and avatar URL
+    std::vector<uint64_t> m_author_offsets;
+    std::vector<uint32_t> m_author_sizes; // Four per author
+    BlueskyAuthorIds m_author_ids;
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "bluesky_client.hpp"
+#include "bluesky_feed_stream.hpp"
+#include "bluesky_seen_set.hpp"
+#include "bluesky_timestamp.hpp"
+
+// Polls a feed for posts that are new since the last poll. Each poll fetches
+// a small first page and only pages further while every post on it is new,
+// i.e. there may be a gap to the previous poll. If a page in a gap fails,
+// the next poll resumes the gap at that page once it has caught up with the
+// head of the feed. Posts are recognized by CID
+// hash and only new posts are decoded; the rest of each page is never copied
+// out of the response. Meant for feeds sorted newest first: reposts of posts
+// older than the newest one seen count as old. Not thread-safe.
+class BlueskyFeedPoller {
+public:
+    // Fetches one page of the feed
+    typedef std::function<BlueskyClient::FeedView(int limit, const std::string& cursor)> PageFetcher;
+
+    struct Result {
+        std::vector<BlueskyClient::Post> posts; // New posts, in feed order
+        BlueskyClient::Error error; // Posts from pages before a failed one are still returned
+        unsigned pages; // Pages fetched
+        size_t fetched; // Posts on those pages
+        bool complete; // False if a page failed or maxPages ran out before reaching seen posts
+    };
+
+    // The client must outlive the poller. Polls fetch at least minLimit
+    // posts, more after polls that found many new ones, and give up on a
+    // gap after maxPages pages. seenCapacity CIDs are remembered.
+    BlueskyFeedPoller(
+        BlueskyClient& client,
+        BlueskyFeedStream::Source source,
+        const std::string& id,
+        int minLimit = 10,
+        unsigned maxPages = 5,
+        size_t seenCapacity = 4096
+    );
+
+    BlueskyFeedPoller(PageFetcher fetcher, int minLimit = 10, unsigned maxPages = 5, size_t seenCapacity = 4096);
+
+    // Disable copying
+    BlueskyFeedPoller(const BlueskyFeedPoller&) = delete;
+    BlueskyFeedPoller& operator=(const BlueskyFeedPoller&) = delete;
+
+    // The first poll returns the first page of the feed as new posts
+    Result poll();
+
+    // Newest indexedAt seen so far and the post it belongs to
+    BlueskyTimestamp highWaterMark() const { return m_high_water; }
+    const std::string& highWaterUri() const { return m_high_water_uri; }
+
+    // Totals over every poll, to see how much of what was fetched was new
+    uint64_t fetchedPosts() const { return m_fetched; }
+    uint64_t newPosts() const { return m_new; }
+
+private:
+    enum Walk {
+        Walk_Closed = 0, // Reached seen posts or the end of the feed
+        Walk_Failed, // cursor is left at the page that failed
+        Walk_OutOfPages, // cursor is left at the next page
+    };
+
+    // Fetches pages from cursor while every post is new. A post at or below
+    // floor ends the walk, and so does a seen one unless skipSeen is set.
+    Walk walk(
+        std::string& cursor,
+        int limit,
+        unsigned maxPages,
+        const BlueskyTimestamp& floor,
+        const std::string& floorUri,
+        bool skipSeen,
+        Result& result,
+        BlueskyTimestamp& newest,
+        std::string& newestUri
+    );
+
+    PageFetcher m_fetch;
+    const int m_min_limit;
+    const unsigned m_max_pages;
+
+    int m_limit; // First page size of the next poll
+    bool m_polled;
+
+    BlueskySeenSet m_seen;
+    BlueskyTimestamp m_high_water;
+    std::string m_high_water_uri;
+
+    // Where a failed poll left a gap, empty if none, and where the gap ends
+    std::string m_gap_cursor;
+    BlueskyTimestamp m_gap_floor;
+    std::string m_gap_floor_uri;
+
+    uint64_t m_fetched;
+    uint64_t m_new;
+};
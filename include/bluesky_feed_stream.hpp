@@ -0,0 +1,68 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "bluesky_client.hpp"
+
+// Walks a feed page by page, carrying the cursor forward. The page after the
+// one the caller is working on is fetched on a background thread, so network
+// round trips overlap with processing.
+class BlueskyFeedStream {
+public:
+    enum Source {
+        Source_Feed = 0, // app.bsky.feed.getFeed, id is a feed generator URI
+        Source_Author, // app.bsky.feed.getAuthorFeed, id is a DID or handle
+    };
+
+    // The client must outlive the stream. At most maxQueuedPages fetched pages
+    // wait for the caller; prefetching pauses until next() makes room.
+    BlueskyFeedStream(
+        BlueskyClient& client,
+        Source source,
+        const std::string& id,
+        int pageSize = 100,
+        unsigned maxQueuedPages = 2,
+        const std::string& cursor = std::string()
+    );
+    ~BlueskyFeedStream();
+
+    // Disable copying
+    BlueskyFeedStream(const BlueskyFeedStream&) = delete;
+    BlueskyFeedStream& operator=(const BlueskyFeedStream&) = delete;
+
+    // Blocks until the next page is available. Returns false once the feed is
+    // exhausted or the stream was stopped. A page with an error is handed out
+    // once and ends the stream.
+    bool next(BlueskyClient::PostsResult& page);
+
+    // Stops prefetching and discards queued pages. Waits for a request that
+    // is already in flight to finish.
+    void stop();
+
+    // Cursor following the last successful page returned by next(), usable to
+    // resume the walk later.
+    std::string cursor() const;
+
+private:
+    void run(std::string cursor);
+
+    BlueskyClient& m_client;
+    const Source m_source;
+    const std::string m_id;
+    const int m_page_size;
+    const unsigned m_max_queued;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::condition_variable m_space;
+    std::deque<BlueskyClient::PostsResult> m_pages;
+    std::string m_cursor;
+    bool m_finished;
+    bool m_stopped;
+
+    std::thread m_thread;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "bluesky_client.hpp"
+
+// Collects single post and profile lookups from any number of threads and
+// sends them as getPosts/getProfiles batches. A batch goes out once it is
+// full or its oldest lookup has waited maxDelay; lookups of a key already
+// pending share one slot.
+class BlueskyHydrator {
+public:
+    struct PostResult {
+        BlueskyClient::Error error;
+        BlueskyClient::Post post;
+    };
+
+    struct ProfileResult {
+        BlueskyClient::Error error;
+        BlueskyClient::PostAuthor profile;
+    };
+
+    // threads is how many batches may be in flight at once
+    explicit BlueskyHydrator(
+        BlueskyClient& client,
+        std::chrono::milliseconds maxDelay = std::chrono::milliseconds(10),
+        size_t batchSize = BlueskyClient::MAX_HYDRATION_BATCH,
+        unsigned threads = 2
+    );
+
+    // Sends whatever is still pending, then stops
+    ~BlueskyHydrator();
+
+    // Disable copying
+    BlueskyHydrator(const BlueskyHydrator&) = delete;
+    BlueskyHydrator& operator=(const BlueskyHydrator&) = delete;
+
+    // uri must use the author's DID, as the server returns it; posts that
+    // are gone or hidden resolve to Error_NotFound
+    std::future<PostResult> getPost(const std::string& uri);
+
+    // actor is a DID or handle
+    std::future<ProfileResult> getProfile(const std::string& actor);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    // Pending keys of one kind, oldest first, and everyone waiting on them
+    template <typename Result>
+    struct Queue {
+        std::deque<std::pair<std::string, Clock::time_point>> order;
+        std::unordered_map<std::string, std::vector<std::promise<Result>>> waiters;
+    };
+
+    template <typename Result>
+    struct Batch {
+        std::vector<std::string> keys;
+        std::vector<std::vector<std::promise<Result>>> waiters; // Parallel to keys
+    };
+
+    template <typename Result>
+    std::future<Result> enqueue(Queue<Result>& queue, const std::string& key);
+
+    template <typename Result>
+    bool ready(const Queue<Result>& queue, Clock::time_point now) const;
+
+    template <typename Result>
+    Batch<Result> take(Queue<Result>& queue);
+
+    void sendPosts(Batch<PostResult>& batch);
+    void sendProfiles(Batch<ProfileResult>& batch);
+
+    void run();
+
+    BlueskyClient& m_client;
+    const std::chrono::milliseconds m_max_delay;
+    const size_t m_batch_size;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    Queue<PostResult> m_posts;
+    Queue<ProfileResult> m_profiles;
+    bool m_stop;
+
+    std::vector<std::thread> m_threads;
+};
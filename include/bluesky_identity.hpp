@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "bluesky_client.hpp"
+#include "bluesky_single_flight.hpp"
+#include "bluesky_ttl_cache.hpp"
+
+class BlueskyConnectionPool;
+
+// Resolves handles to DIDs and DIDs to their documents, and hands out
+// clients that talk to an account's own PDS. Lookups go through a bounded
+// TTL cache that also remembers what does not exist, and concurrent
+// lookups of the same identity share one request.
+class BlueskyIdentity {
+public:
+    struct DidDocument {
+        std::string did;
+        std::string handle; // From alsoKnownAs, not verified
+        std::string pdsEndpoint; // e.g. "https://morel.us-east.host.bsky.network"
+    };
+
+    // resolver serves com.atproto.identity.resolveHandle; DID documents come
+    // from plc.directory (did:plc) or the DID's own host (did:web)
+    explicit BlueskyIdentity(
+        const std::string& resolver = "bsky.social",
+        size_t capacity = 100000,
+        std::chrono::seconds ttl = std::chrono::seconds(3600),
+        std::chrono::seconds negativeTtl = std::chrono::seconds(300),
+        unsigned connectionsPerHost = 4
+    );
+    ~BlueskyIdentity();
+
+    // Disable copying
+    BlueskyIdentity(const BlueskyIdentity&) = delete;
+    BlueskyIdentity& operator=(const BlueskyIdentity&) = delete;
+
+    // Error_NotFound if the identity does not exist, Error_ResponseFail if
+    // the lookup could not be completed
+    BlueskyClient::Error resolveHandle(const std::string& handle, std::string& did);
+    BlueskyClient::Error resolveDid(const std::string& did, DidDocument& document);
+
+    // Accepts a handle or a DID
+    BlueskyClient::Error resolve(const std::string& atId, DidDocument& document);
+
+    // Client for the PDS hosting atId, shared by every account on that host
+    // and owned by this object. nullptr if the identity does not resolve.
+    BlueskyClient* pdsClient(const std::string& atId);
+
+    // Drops cached results, e.g. after an identity event for the account
+    void invalidate(const std::string& atId);
+
+    static bool isDid(const std::string& atId);
+
+private:
+    // Result of one lookup, shared with callers waiting on the same key
+    template <typename Value>
+    struct Lookup {
+        BlueskyClient::Error error;
+        Value value;
+
+        Lookup() : error(BlueskyClient::Error_None) {}
+    };
+
+    Lookup<std::string> fetchHandle(const std::string& handle);
+    Lookup<DidDocument> fetchDidDocument(const std::string& did);
+
+    // GETs baseUrl + path from the pool for that host; returns the HTTP
+    // status, -1 without a response
+    int get(const std::string& baseUrl, const std::string& path, std::string& body);
+
+    BlueskyConnectionPool& hostPool(const std::string& baseUrl);
+
+    const std::string m_resolver_url;
+    const std::chrono::seconds m_ttl;
+    const std::chrono::seconds m_negative_ttl;
+    const unsigned m_connections_per_host;
+
+    BlueskyTtlCache<std::string> m_handles;
+    BlueskyTtlCache<DidDocument> m_documents;
+    BlueskySingleFlight<Lookup<std::string>> m_handle_flights;
+    BlueskySingleFlight<Lookup<DidDocument>> m_document_flights;
+
+    std::mutex m_hosts_mutex;
+    std::map<std::string, std::unique_ptr<BlueskyConnectionPool>> m_host_pools;
+    std::map<std::string, std::unique_ptr<BlueskyClient>> m_pds_clients;
+};
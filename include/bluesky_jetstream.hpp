@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bluesky_client.hpp"
+#include "bluesky_websocket.hpp"
+
+// Consumes the Jetstream event stream, the JSON rendering of
+// com.atproto.sync.subscribeRepos, over a WebSocket. A reader thread receives
+// frames into bounded per-worker queues; workers decode them and run the
+// handler. Events of one repo always go to the same worker, so they are
+// handled in stream order; events of different repos run in parallel.
+// Lost connections are resumed from cursor() after a backoff.
+class BlueskyJetstream {
+public:
+    enum Kind {
+        Kind_Commit = 0, // A record was created, updated or deleted
+        Kind_Identity, // The account's handle or DID document changed
+        Kind_Account, // The account was activated, deactivated or taken down
+    };
+
+    enum Operation {
+        Operation_Create = 0,
+        Operation_Update,
+        Operation_Delete,
+    };
+
+    struct Event {
+        Kind kind;
+        std::string did;
+        uint64_t timeUs; // Stream position, usable as a cursor
+
+        // Kind_Commit
+        Operation operation;
+        std::string collection;
+        std::string rkey;
+        std::string rev;
+        std::string cid; // Empty for deletes
+        std::string record; // Record object as JSON, empty for deletes
+
+        // Set for creates and updates of app.bsky.feed.post
+        bool isPost;
+        BlueskyClient::Post post;
+
+        // Kind_Identity
+        std::string handle;
+
+        // Kind_Account
+        bool active;
+        std::string status; // Why the account is inactive, e.g. "takendown"
+    };
+
+    // Called on a worker thread. Runs concurrently for events of different
+    // repos, so it must be thread-safe.
+    typedef std::function<void(const Event& event)> EventHandler;
+
+    // What the reader does when a worker's queue is full
+    enum Overflow {
+        Overflow_Block = 0, // Stop reading, so the server sees the backpressure
+        Overflow_Drop, // Drop the frame and count it in Stats::dropped
+    };
+
+    struct Options {
+        std::string endpoint; // ws:// or wss:// URL without path
+        std::vector<std::string> collections; // NSIDs to receive, all if empty
+        std::vector<std::string> dids; // Repos to receive, all if empty
+        uint64_t cursor; // timeUs to start from, 0 for live events
+        unsigned workers;
+        size_t queueCapacity; // Frames waiting for the workers, in total
+        Overflow overflow;
+        std::chrono::milliseconds reconnectDelay; // Doubles per failed attempt
+        std::chrono::milliseconds maxReconnectDelay;
+        std::chrono::milliseconds idleTimeout; // Reconnect after this long without a frame
+
+        Options();
+    };
+
+    struct Stats {
+        uint64_t received; // Frames read from the socket
+        uint64_t delivered; // Events handed to the handler
+        uint64_t dropped; // Frames dropped on a full queue
+        uint64_t malformed; // Frames that were not valid events
+        uint64_t reconnects;
+        size_t queued; // Frames waiting right now
+        size_t maxQueued; // Most frames ever waiting at once
+        uint64_t lagMicros; // Wall clock minus timeUs of the last delivered event
+        bool connected;
+    };
+
+    explicit BlueskyJetstream(EventHandler handler, const Options& options = Options());
+
+    // Stops the stream
+    ~BlueskyJetstream();
+
+    // Disable copying
+    BlueskyJetstream(const BlueskyJetstream&) = delete;
+    BlueskyJetstream& operator=(const BlueskyJetstream&) = delete;
+
+    // Connects and starts delivering events
+    void start();
+
+    // Disconnects and waits for handlers that are running to return. Frames
+    // still queued are not delivered; cursor() accounts for them.
+    void stop();
+
+    // Position to resume from so that no received event is missed: every
+    // event before it was handled. Events at or after it may be delivered
+    // again. 0 before the first event.
+    uint64_t cursor() const;
+
+    Stats stats() const;
+
+    // Subscription URL for the given cursor
+    std::string url(uint64_t cursor) const;
+
+    // Decodes one Jetstream frame, parsing it in place; frame must have
+    // YYJSON_PADDING_SIZE zero bytes past its size
+    static bool decodeEvent(char* frame, size_t size, Event& event);
+
+private:
+    struct Frame {
+        std::string data; // Zero padded for in-place parsing
+        uint64_t timeUs;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::condition_variable space;
+        std::deque<Frame> frames;
+        uint64_t current; // timeUs of the frame being handled, 0 if idle
+        std::thread thread;
+
+        Worker() : current(0) {}
+    };
+
+    void read();
+    void work(Worker& worker);
+
+    // Hands a frame to the worker of its repo; false if stopped meanwhile
+    bool dispatch(std::string& data);
+
+    // Sleeps for delay unless stopped first
+    bool backoff(std::chrono::milliseconds delay);
+
+    const EventHandler m_handler;
+    const Options m_options;
+    const size_t m_worker_capacity;
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::thread m_reader;
+    BlueskyWebSocket m_socket;
+
+    std::mutex m_state_mutex;
+    std::condition_variable m_state_changed;
+    bool m_running;
+    std::atomic<bool> m_stopping;
+    std::atomic<bool> m_connected;
+
+    std::atomic<uint64_t> m_last_read; // timeUs of the newest frame received
+    std::atomic<uint64_t> m_last_delivered;
+
+    std::atomic<uint64_t> m_received;
+    std::atomic<uint64_t> m_delivered;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<uint64_t> m_malformed;
+    std::atomic<uint64_t> m_reconnects;
+    std::atomic<size_t> m_queued;
+    std::atomic<size_t> m_max_queued;
+};
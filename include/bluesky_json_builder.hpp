@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+struct yyjson_alc;
+struct yyjson_mut_doc;
+struct yyjson_mut_val;
+
+// Builds JSON documents on yyjson's mutable API. Document memory comes from
+// an arena that is recycled, not freed, between documents, and output is
+// written into a buffer that keeps its capacity, so building the same kind
+// of request over and over stops allocating once the buffers are warm.
+//
+// Keys are not copied and must outlive finish(); string values are copied.
+class BlueskyJsonBuilder {
+public:
+    class Array;
+
+    class Object {
+    public:
+        Object& addString(const char* key, const std::string& value);
+        Object& addString(const char* key, const char* value);
+        Object& addInt(const char* key, int64_t value);
+        Object& addBool(const char* key, bool value);
+        Object addObject(const char* key);
+        Array addArray(const char* key);
+
+        // Parses json and inserts it as the value; returns false if it is invalid
+        bool addJson(const char* key, const std::string& json);
+
+        // Like addJson, but json must be an object
+        bool addJsonObject(const char* key, const std::string& json);
+
+    private:
+        friend class BlueskyJsonBuilder;
+        friend class Array;
+
+        Object(BlueskyJsonBuilder* builder, yyjson_mut_val* val) : m_builder(builder), m_val(val) {}
+
+        bool addParsed(const char* key, const std::string& json, bool objectOnly);
+
+        BlueskyJsonBuilder* m_builder;
+        yyjson_mut_val* m_val;
+    };
+
+    class Array {
+    public:
+        Array& addString(const std::string& value);
+        Array& addInt(int64_t value);
+        Object addObject();
+
+    private:
+        friend class BlueskyJsonBuilder;
+        friend class Object;
+
+        Array(BlueskyJsonBuilder* builder, yyjson_mut_val* val) : m_builder(builder), m_val(val) {}
+
+        BlueskyJsonBuilder* m_builder;
+        yyjson_mut_val* m_val;
+    };
+
+    BlueskyJsonBuilder();
+    ~BlueskyJsonBuilder();
+
+    // Disable copying
+    BlueskyJsonBuilder(const BlueskyJsonBuilder&) = delete;
+    BlueskyJsonBuilder& operator=(const BlueskyJsonBuilder&) = delete;
+
+    // Discards the previous document and starts a new one with an empty
+    // object as its root
+    Object begin();
+
+    // Serializes the document. The returned buffer is reused by the next
+    // finish(); it is empty if serialization failed.
+    const std::string& finish();
+
+private:
+    void releaseDocument();
+
+    yyjson_alc* m_alc;
+    yyjson_mut_doc* m_doc;
+    std::string m_output;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Per-endpoint request metrics. Every attempt sent by the client is recorded
+// as a Sample, aggregated into counters and histograms that can be read with
+// snapshot(), and handed to an optional sink for export elsewhere.
+class BlueskyMetrics {
+public:
+    // Parts of a request that are timed separately. httplib does not report
+    // DNS/TCP/TLS on their own; attempts that had to open a connection are
+    // timed under Phase_Connect instead of Phase_FirstByte, so the gap between
+    // the two is the cost of connection setup.
+    enum Phase {
+        Phase_Wait = 0, // Rate limiter and connection pool
+        Phase_Connect, // Send to response headers, on a new connection
+        Phase_FirstByte, // Send to response headers, on a kept-alive connection
+        Phase_Transfer, // Response headers to last body byte
+        Phase_Parse, // Decoding the body
+        Phase_Total, // Whole attempt, including the wait
+
+        Phase_Max
+    };
+
+    // Log2-bucketed histogram: bucket i counts values below 2^i
+    struct Histogram {
+        static const size_t BUCKETS = 40;
+
+        uint64_t buckets[BUCKETS];
+        uint64_t count;
+        uint64_t sum;
+        uint64_t max;
+
+        Histogram();
+
+        void add(uint64_t value);
+
+        // Upper bound of the bucket holding the given quantile (0..1)
+        uint64_t quantile(double q) const;
+    };
+
+    // One request attempt. Durations are in microseconds; a phase that did
+    // not run, e.g. parsing a 429 or the transfer of a request that got no
+    // response, is left out of its histogram.
+    struct Sample {
+        std::string endpoint;
+        int status; // HTTP status, -1 if no response arrived
+        unsigned attempt; // 0 for the first try, one more for every resend
+        bool refreshRetry; // Resent because the token expired, not for a 429
+        bool newConnection;
+        uint64_t micros[Phase_Max];
+        size_t responseBytes; // Decoded body size
+        size_t bytesParsed; // Bytes handed to the JSON parser
+
+        Sample();
+    };
+
+    struct EndpointStats {
+        uint64_t requests;
+        uint64_t retries; // 429 retries
+        uint64_t refreshRetries; // Resends after an ExpiredToken refresh
+        uint64_t failures; // Attempts without a response
+        uint64_t newConnections;
+        uint64_t responseBytes;
+        uint64_t bytesParsed;
+        std::map<int, uint64_t> statuses;
+        Histogram latency[Phase_Max];
+        Histogram responseSize;
+
+        EndpointStats();
+    };
+
+    typedef std::map<std::string, EndpointStats> Snapshot;
+
+    // Receives every sample, after it was aggregated. Called from the thread
+    // that made the request, so it must be thread-safe.
+    class Sink {
+    public:
+        virtual ~Sink() {}
+        virtual void record(const Sample& sample) = 0;
+    };
+
+    BlueskyMetrics();
+
+    // Disable copying
+    BlueskyMetrics(const BlueskyMetrics&) = delete;
+    BlueskyMetrics& operator=(const BlueskyMetrics&) = delete;
+
+    void record(const Sample& sample);
+
+    // Replaces the sink; nullptr removes it
+    void setSink(std::shared_ptr<Sink> sink);
+
+    // Copy of the aggregated stats, keyed by endpoint
+    Snapshot snapshot() const;
+    void reset();
+
+    static const char* phaseName(Phase phase);
+
+private:
+    mutable std::mutex m_mutex;
+    Snapshot m_stats;
+    std::shared_ptr<Sink> m_sink;
+};
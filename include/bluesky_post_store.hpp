@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bluesky_client.hpp"
+
+// Local, persistent store of decoded posts. Posts are appended to a log file
+// that is memory-mapped for reading; a hash index next to it (path + ".idx",
+// also mapped) finds a post by URI or CID, decoding only that one record.
+// Each record carries a checksum: on open, every record appended since the
+// last sync() is checked, the log is cut off at the first one a crash tore,
+// and records the index has not seen yet are indexed. Appends are durable
+// after sync(). Thread-safe; the files are locked, so only one store at a
+// time can have them open.
+class BlueskyPostStore {
+public:
+    // Return false to stop
+    typedef std::function<bool(const BlueskyClient::Post& post)> PostHandler;
+
+    BlueskyPostStore();
+    ~BlueskyPostStore();
+
+    // Disable copying
+    BlueskyPostStore(const BlueskyPostStore&) = delete;
+    BlueskyPostStore& operator=(const BlueskyPostStore&) = delete;
+
+    // Opens the store at path, creating it if missing. Returns false on
+    // failure, including when another store has it open; see error().
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const;
+
+    // Appends posts whose CID is not stored yet. Returns whether the post
+    // was appended, or how many were; see error() for write failures.
+    bool append(const BlueskyClient::Post& post);
+    size_t append(const BlueskyClient::PostsResult& result);
+
+    // Appends the new posts of a feed page; posts stored already are
+    // recognized from the response and never decoded
+    size_t append(const BlueskyClient::FeedView& page);
+
+    bool containsUri(const char* uri, size_t size) const;
+    bool containsUri(const std::string& uri) const { return containsUri(uri.data(), uri.size()); }
+    bool containsCid(const char* cid, size_t size) const;
+    bool containsCid(const std::string& cid) const { return containsCid(cid.data(), cid.size()); }
+
+    bool findByUri(const std::string& uri, BlueskyClient::Post& post) const;
+    bool findByCid(const std::string& cid, BlueskyClient::Post& post) const;
+
+    // Every stored post, oldest first. The handler must not call the store.
+    void forEach(const PostHandler& handler) const;
+
+    // Flushes the log, then the index, to disk
+    bool sync();
+
+    uint64_t size() const;
+    uint64_t logBytes() const;
+    std::string error() const;
+
+private:
+    enum Key {
+        Key_Uri = 0,
+        Key_Cid,
+    };
+
+    void closeLocked();
+    bool openIndex();
+    bool createIndex(uint64_t capacity, bool rehash);
+    bool recover();
+    bool mapLog(uint64_t size);
+
+    bool isOpenLocked() const { return m_log_fd >= 0; }
+    uint64_t findLocked(Key key, const char* data, size_t size) const;
+    bool indexRecord(uint64_t offset);
+    bool insertKey(Key key, const char* data, size_t size, uint64_t offset);
+
+    // Key of the record at offset
+    bool recordKey(uint64_t offset, Key key, const char*& data, size_t& size) const;
+
+    // Encodes post into m_pending unless its CID is stored or pending
+    bool stage(const BlueskyClient::Post& post);
+    size_t commit();
+
+    bool fail(const std::string& message);
+    void unmapIndex();
+
+    mutable std::mutex m_mutex;
+
+    std::string m_path;
+    std::string m_error;
+
+    int m_log_fd;
+    char* m_log; // Read-only mapping of the log
+    uint64_t m_log_mapped; // Bytes mapped, may run past the end of the file
+    uint64_t m_log_size;
+
+    int m_index_fd;
+    char* m_index;
+    size_t m_index_size;
+
+    std::string m_pending; // Records to write in one go
+    std::vector<std::string> m_pending_cids;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+
+#include <httplib.h>
+
+// Paces outgoing requests with one token bucket per endpoint class. The
+// buckets follow the RateLimit-Limit/Remaining/Reset/Policy headers the
+// server sends back, so requests are spread out to stay inside the budget
+// instead of running into 429s.
+class BlueskyRateLimiter {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // Endpoints sharing a server-side limit
+    enum EndpointClass {
+        EndpointClass_Read = 0, // Queries, limited per IP
+        EndpointClass_Write, // Repo writes, limited per account
+        EndpointClass_Session, // createSession and refreshSession
+
+        EndpointClass_Max
+    };
+
+    static EndpointClass classify(const std::string& endpoint);
+
+    BlueskyRateLimiter();
+
+    // Takes a token for the class and returns how long the caller has to
+    // wait before sending. Zero while the server has not reported a limit.
+    std::chrono::milliseconds reserve(EndpointClass endpointClass);
+
+    // Same as reserve, but sleeps for the returned time
+    void acquire(EndpointClass endpointClass);
+
+    // Syncs the bucket with the RateLimit-* headers of a response. A 429
+    // empties the bucket until the reported reset.
+    void update(EndpointClass endpointClass, const httplib::Response& response);
+
+    // Delay before retry number attempt (0-based) after a 429: the
+    // Retry-After header if present, otherwise jittered exponential backoff
+    std::chrono::milliseconds backoff(unsigned attempt, const httplib::Response& response);
+
+private:
+    struct Bucket {
+        bool known; // Whether the server reported a limit yet
+        bool resetPending; // Whether resetAt is an upcoming window reset
+        double capacity;
+        double tokens;
+        double refillPerSecond;
+        Clock::time_point refilledAt;
+        Clock::time_point resetAt;
+    };
+
+    void refill(Bucket& bucket, Clock::time_point now);
+
+    std::mutex m_mutex;
+    Bucket m_buckets[EndpointClass_Max];
+    std::mt19937 m_random;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include "bluesky_car.hpp"
+#include "bluesky_client.hpp"
+
+// Decodes app.bsky.feed.post records out of a repo CAR stream, as returned
+// by BlueskyClient::getRepo, while it downloads. Records are handed out as
+// their blocks arrive and dropped right after; what is kept is the path of
+// every record listed in the repo's MST nodes, to build record URIs.
+class BlueskyRepoReader {
+public:
+    // Return false to stop reading
+    typedef std::function<bool(const BlueskyClient::Post& post)> PostHandler;
+
+    explicit BlueskyRepoReader(PostHandler handler, bool verifyCids = true);
+
+    // Disable copying
+    BlueskyRepoReader(const BlueskyRepoReader&) = delete;
+    BlueskyRepoReader& operator=(const BlueskyRepoReader&) = delete;
+
+    bool feed(const char* data, size_t size);
+    bool finish();
+
+    // DID of the repo, once its commit block was read
+    const std::string& did() const { return m_did; }
+
+    // at:// URI of the record with the given CID string, if the MST node
+    // listing it was read already. A post that arrives before its MST node
+    // is handed out without uri; look it up here after finish().
+    std::string uriOf(const std::string& cid) const;
+
+    uint64_t postCount() const { return m_posts; }
+    uint64_t blockCount() const { return m_car.blockCount(); }
+    const std::string& error() const { return m_car.error(); }
+
+private:
+    bool onBlock(const BlueskyCarReader::Block& block);
+
+    bool readCommit(const uint8_t* data, size_t size);
+    bool readMstNode(const uint8_t* data, size_t size);
+    bool readPost(const BlueskyCid& cid, const uint8_t* data, size_t size);
+
+    PostHandler m_handler;
+    BlueskyCarReader m_car;
+
+    std::string m_did;
+    std::unordered_map<std::string, std::string> m_paths; // CID string -> "collection/rkey"
+    uint64_t m_posts;
+};
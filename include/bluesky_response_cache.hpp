@@ -0,0 +1,98 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Cache of GET results, see BlueskyClient::setResponseCache: decoded
+// results, or for feed views the body they read from. Entries are kept in
+// LRU order until their estimated total size exceeds maxBytes.
+// A fresh entry (younger than its endpoint's TTL) is served without a
+// request. An expired entry with an ETag is revalidated with
+// If-None-Match; a 304 reuses the entry without transferring or decoding
+// the body again. Thread-safe, and may be shared between clients.
+//
+// Storage can be replaced by overriding get/put/erase/clear.
+class BlueskyResponseCache {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static const size_t DEFAULT_MAX_BYTES = 32 * 1024 * 1024;
+
+    struct Entry {
+        std::shared_ptr<const void> value; // Result; the client knows its type
+        std::string etag; // Empty if the server sent none
+        size_t bytes; // Estimated memory use, counted against maxBytes
+        Clock::time_point expiresAt;
+    };
+
+    struct Stats {
+        uint64_t hits; // Served without a request
+        uint64_t revalidated; // Served after a 304
+        uint64_t misses; // Fetched in full
+        uint64_t evictions;
+        size_t entries;
+        size_t bytes;
+    };
+
+    // With the default TTL of zero, every call revalidates: responses are
+    // only reused when the server says they did not change
+    explicit BlueskyResponseCache(
+        size_t maxBytes = DEFAULT_MAX_BYTES,
+        std::chrono::milliseconds defaultTtl = std::chrono::milliseconds(0)
+    );
+    virtual ~BlueskyResponseCache();
+
+    // Disable copying
+    BlueskyResponseCache(const BlueskyResponseCache&) = delete;
+    BlueskyResponseCache& operator=(const BlueskyResponseCache&) = delete;
+
+    // TTL of one endpoint, e.g. "xrpc/app.bsky.notification.getUnreadCount"
+    void setTtl(const std::string& endpoint, std::chrono::milliseconds ttl);
+    std::chrono::milliseconds ttl(const std::string& endpoint) const;
+
+    // Returns expired entries too, for revalidation
+    virtual bool get(const std::string& key, Entry& entry);
+    virtual void put(const std::string& key, const Entry& entry);
+    virtual void erase(const std::string& key);
+    virtual void erasePrefix(const std::string& prefix);
+    virtual void clear();
+
+    // Counted by the client
+    void recordHit();
+    void recordRevalidated();
+    void recordMiss();
+
+    Stats stats() const;
+    void resetStats();
+
+    size_t maxBytes() const { return m_max_bytes; }
+
+private:
+    struct Node {
+        std::string key;
+        Entry entry;
+    };
+
+    void evictLocked();
+
+    const size_t m_max_bytes;
+
+    mutable std::mutex m_mutex;
+
+    std::chrono::milliseconds m_default_ttl;
+    std::map<std::string, std::chrono::milliseconds> m_ttls;
+
+    // Most recently used entries live at the front
+    std::list<Node> m_entries;
+    std::unordered_map<std::string, std::list<Node>::iterator> m_index;
+    size_t m_bytes;
+
+    Stats m_stats;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bounded set of 64-bit hashes, to remember which items were seen already
+// without keeping the items. Hashes sit in a flat open-addressed table; once
+// capacity is reached, every insert forgets the oldest hash. Not thread-safe.
+class BlueskySeenSet {
+public:
+    explicit BlueskySeenSet(size_t capacity = 4096);
+
+    // Returns false if hash was in the set already
+    bool insert(uint64_t hash);
+    bool contains(uint64_t hash) const;
+    void clear();
+
+    size_t size() const { return m_size; }
+    size_t capacity() const { return m_order.size(); }
+
+    // Hash of a key, e.g. a CID string
+    static uint64_t hash(const char* data, size_t size);
+
+private:
+    // Slot holding hash, or the empty slot where it would go
+    size_t find(uint64_t hash) const;
+    size_t home(uint64_t hash) const;
+    void erase(uint64_t hash);
+
+    std::vector<uint64_t> m_table; // 0 marks an empty slot
+    size_t m_mask;
+    unsigned m_shift;
+
+    std::vector<uint64_t> m_order; // Ring of hashes in insertion order
+    size_t m_next; // Oldest entry once the ring is full
+    size_t m_size;
+};
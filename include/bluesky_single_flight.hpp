@@ -0,0 +1,135 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Collapses concurrent calls for the same key into one: the first caller
+// runs the function, callers arriving while it runs wait and get a copy of
+// its result, or the exception it threw. Nothing is kept once the call
+// finishes, unless a window is set: then the result also goes to callers
+// arriving within the window.
+template <typename Value>
+class BlueskySingleFlight {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    BlueskySingleFlight() : m_window(Clock::duration::zero()) {}
+
+    // Disable copying
+    BlueskySingleFlight(const BlueskySingleFlight&) = delete;
+    BlueskySingleFlight& operator=(const BlueskySingleFlight&) = delete;
+
+    // How long a finished call's result is handed out, zero by default
+    void setWindow(Clock::duration window) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_window = window;
+
+        if (m_window <= Clock::duration::zero())
+            sweepLocked(Clock::now());
+    }
+
+    // shared is set to whether the result came from another caller's call
+    Value run(const std::string& key, const std::function<Value()>& fn, bool* shared = nullptr) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        auto it = m_calls.find(key);
+        if (it != m_calls.end() && !expiredLocked(*it->second, Clock::now())) {
+            std::shared_ptr<Call> call = it->second;
+            m_done.wait(lock, [&call] { return call->done; });
+
+            if (shared)
+                *shared = true;
+            if (call->error)
+                std::rethrow_exception(call->error);
+            return call->value;
+        }
+
+        if (m_window > Clock::duration::zero())
+            sweepLocked(Clock::now());
+
+        std::shared_ptr<Call> call(new Call());
+        m_calls[key] = call;
+        lock.unlock();
+
+        // Waiters must not hang if fn throws
+        struct Finish {
+            BlueskySingleFlight* flight;
+            const std::string& key;
+            std::shared_ptr<Call>& call;
+            bool returned;
+
+            ~Finish() {
+                {
+                    std::lock_guard<std::mutex> guard(flight->m_mutex);
+                    call->done = true;
+                    call->finished = Clock::now();
+
+                    // Kept for the window, but not after a throw
+                    if (!returned || flight->m_window <= Clock::duration::zero())
+                        flight->m_calls.erase(key);
+                }
+                flight->m_done.notify_all();
+            }
+        } finish = { this, key, call, false };
+
+        try {
+            call->value = fn();
+        }
+        catch (...) {
+            // Set before Finish marks the call done
+            call->error = std::current_exception();
+            throw;
+        }
+        finish.returned = true;
+
+        if (shared)
+            *shared = false;
+        return call->value;
+    }
+
+    // Number of calls currently running
+    size_t inFlight() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        size_t running = 0;
+        for (const auto& entry : m_calls)
+            running += !entry.second->done;
+
+        return running;
+    }
+
+private:
+    struct Call {
+        Call() : value(), done(false) {}
+
+        Value value;
+        std::exception_ptr error; // Set if fn threw
+        bool done;
+        Clock::time_point finished;
+    };
+
+    bool expiredLocked(const Call& call, Clock::time_point now) const {
+        return call.done && now - call.finished >= m_window;
+    }
+
+    // Drops results past the window
+    void sweepLocked(Clock::time_point now) {
+        for (auto it = m_calls.begin(); it != m_calls.end(); ) {
+            if (expiredLocked(*it->second, now))
+                it = m_calls.erase(it);
+            else
+                it++;
+        }
+    }
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_done;
+    std::map<std::string, std::shared_ptr<Call>> m_calls;
+    Clock::duration m_window;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// UTF-8 text helpers for post text. ASCII runs, the bulk of most posts, are
+// scanned 16 or 32 bytes at a time with SSE2/AVX2, picked at runtime; other
+// CPUs use the scalar loops. Multi-byte sequences are decoded strictly: no
+// overlong forms, surrogates or code points past U+10FFFF.
+class BlueskyText {
+public:
+    // Longest post text, in graphemes, the app.bsky.feed.post lexicon allows
+    static const size_t MAX_POST_GRAPHEMES = 300;
+
+    static bool isValidUtf8(const char* data, size_t size);
+    static bool isValidUtf8(const std::string& str) { return isValidUtf8(str.data(), str.size()); }
+
+    // Decodes the code point at data. Returns its length in bytes, 0 if the
+    // bytes there are not valid UTF-8.
+    static size_t decode(const char* data, size_t size, uint32_t& codePoint);
+
+    // Replaces every invalid byte with U+FFFD
+    static std::string repairUtf8(const std::string& str);
+
+    // Printable ASCII only: typographic quotes become ASCII quotes, control
+    // characters and everything else outside ASCII is dropped
+    static std::string toAscii(const std::string& str);
+
+    // Percent-encodes all but unreserved characters, spaces become '+'
+    static std::string urlEncode(const std::string& str);
+
+    // Splits on ASCII whitespace; multi-byte characters are never split
+    static std::vector<std::string> splitWords(const std::string& str);
+
+    // User-perceived characters, following the UAX #29 extended grapheme
+    // cluster rules: combining marks, emoji modifiers and ZWJ sequences, flag
+    // pairs, Hangul syllables and CR LF each count once. Mark properties are
+    // approximated from general categories.
+    static size_t countGraphemes(const char* data, size_t size);
+    static size_t countGraphemes(const std::string& str) { return countGraphemes(str.data(), str.size()); }
+
+    // Bytes taken by the first maxGraphemes graphemes, to cut text to a limit
+    static size_t graphemePrefix(const char* data, size_t size, size_t maxGraphemes);
+
+    // Byte offset of the code point, or UTF-16 code unit as counted by
+    // JavaScript, at index; for facet ranges. size if index is past the end.
+    static size_t byteOffsetOfCodePoint(const char* data, size_t size, size_t index);
+    static size_t byteOffsetOfUtf16(const char* data, size_t size, size_t index);
+
+    // "avx2", "sse2" or "scalar"
+    static const char* simdLevel();
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+// UTC point in time with microsecond resolution, as found in createdAt and
+// indexedAt fields. Parsing and formatting are done by hand: no locale, no
+// libc time functions, safe to use from any number of threads.
+class BlueskyTimestamp {
+public:
+    // Longest string format() writes, with the terminating '\0'
+    static const size_t MAX_FORMAT_SIZE = 32;
+
+    // An invalid timestamp
+    BlueskyTimestamp() : m_us(INVALID) {}
+
+    static BlueskyTimestamp fromMicroseconds(int64_t us) { return BlueskyTimestamp(us); }
+    static BlueskyTimestamp fromTimeT(time_t seconds) { return BlueskyTimestamp((int64_t)seconds * 1000000); }
+    static BlueskyTimestamp now();
+
+    // Parses an RFC 3339 date-time, e.g. "2024-05-01T12:30:00.123+02:00".
+    // Digits past microseconds are truncated and a missing offset is taken
+    // as UTC. Returns an invalid timestamp if str is null or malformed.
+    static BlueskyTimestamp parse(const char* str, size_t size);
+    static BlueskyTimestamp parse(const char* str);
+    static BlueskyTimestamp parse(const std::string& str) { return parse(str.data(), str.size()); }
+
+    bool valid() const { return m_us != INVALID; }
+
+    // Microseconds since the Unix epoch
+    int64_t microseconds() const { return m_us; }
+
+    // Whole seconds since the Unix epoch, (time_t)(-1) if invalid
+    time_t toTimeT() const;
+
+    // Writes "YYYY-MM-DDTHH:MM:SS.sssZ", the form the app writes, into out
+    // and returns its length. Invalid timestamps format as an empty string.
+    size_t format(char* out) const;
+    std::string format() const;
+
+    bool operator==(const BlueskyTimestamp& other) const { return m_us == other.m_us; }
+    bool operator!=(const BlueskyTimestamp& other) const { return m_us != other.m_us; }
+    bool operator<(const BlueskyTimestamp& other) const { return m_us < other.m_us; }
+    bool operator>(const BlueskyTimestamp& other) const { return m_us > other.m_us; }
+    bool operator<=(const BlueskyTimestamp& other) const { return m_us <= other.m_us; }
+    bool operator>=(const BlueskyTimestamp& other) const { return m_us >= other.m_us; }
+
+private:
+    // Sorts before every valid timestamp
+    static const int64_t INVALID = INT64_MIN;
+
+    explicit BlueskyTimestamp(int64_t us) : m_us(us) {}
+
+    int64_t m_us;
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// Thread-safe LRU cache whose entries also expire after a per-entry TTL.
+// An entry can record that a key has no value (negative caching), so
+// repeated lookups of something that does not exist stay cheap too.
+template <typename Value>
+class BlueskyTtlCache {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit BlueskyTtlCache(size_t capacity)
+        : m_capacity(capacity > 0 ? capacity : 1)
+    {}
+
+    // Disable copying
+    BlueskyTtlCache(const BlueskyTtlCache&) = delete;
+    BlueskyTtlCache& operator=(const BlueskyTtlCache&) = delete;
+
+    // Returns false on a miss or an expired entry. On a hit, found tells
+    // whether a value was cached (copied to value) or a negative result.
+    bool get(const std::string& key, Value& value, bool& found) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_index.find(key);
+        if (it == m_index.end())
+            return false;
+
+        Entry& entry = *it->second;
+        if (Clock::now() >= entry.expiresAt) {
+            m_entries.erase(it->second);
+            m_index.erase(it);
+            return false;
+        }
+
+        // Most recently used entries live at the front
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+        found = entry.found;
+        if (found)
+            value = entry.value;
+
+        return true;
+    }
+
+    void put(const std::string& key, const Value& value, std::chrono::seconds ttl) {
+        insert(key, value, true, ttl);
+    }
+
+    void putNegative(const std::string& key, std::chrono::seconds ttl) {
+        insert(key, Value(), false, ttl);
+    }
+
+    void erase(const std::string& key) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_index.find(key);
+        if (it == m_index.end())
+            return;
+
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.clear();
+        m_index.clear();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+
+    size_t capacity() const { return m_capacity; }
+
+private:
+    struct Entry {
+        std::string key;
+        Value value;
+        bool found;
+        Clock::time_point expiresAt;
+    };
+
+    void insert(const std::string& key, const Value& value, bool found, std::chrono::seconds ttl) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        const Clock::time_point expiresAt = Clock::now() + ttl;
+
+        auto it = m_index.find(key);
+        if (it != m_index.end()) {
+            Entry& entry = *it->second;
+            entry.value = value;
+            entry.found = found;
+            entry.expiresAt = expiresAt;
+
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+            return;
+        }
+
+        if (m_entries.size() >= m_capacity) {
+            m_index.erase(m_entries.back().key);
+            m_entries.pop_back();
+        }
+
+        Entry entry = { key, value, found, expiresAt };
+        m_entries.push_front(std::move(entry));
+        m_index.emplace(key, m_entries.begin());
+    }
+
+    const size_t m_capacity;
+
+    mutable std::mutex m_mutex;
+    std::list<Entry> m_entries;
+    std::unordered_map<std::string, typename std::list<Entry>::iterator> m_index;
+};
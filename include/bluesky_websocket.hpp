@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct ssl_st;
+struct ssl_ctx_st;
+
+// Minimal blocking RFC 6455 client, enough to receive an event stream: text
+// and binary messages, fragmented or not, with pings answered on the way.
+// Extensions such as permessage-deflate are not negotiated.
+class BlueskyWebSocket {
+public:
+    enum Result {
+        Result_Message = 0, // A complete message was read
+        Result_Closed, // The server closed the connection
+        Result_Error, // See error()
+    };
+
+    // Largest message accepted; event stream frames are far smaller
+    static const size_t MAX_MESSAGE_SIZE = 16 * 1024 * 1024;
+
+    BlueskyWebSocket();
+    ~BlueskyWebSocket();
+
+    // Disable copying
+    BlueskyWebSocket(const BlueskyWebSocket&) = delete;
+    BlueskyWebSocket& operator=(const BlueskyWebSocket&) = delete;
+
+    // Connects to a ws:// or wss:// URL, path and query included, and does
+    // the opening handshake. A read waiting longer than idleTimeout fails.
+    bool connect(
+        const std::string& url,
+        std::chrono::milliseconds connectTimeout = std::chrono::seconds(10),
+        std::chrono::milliseconds idleTimeout = std::chrono::seconds(60)
+    );
+
+    // Blocks until the next message arrived
+    Result read(std::string& message, bool* binary = nullptr);
+
+    // Sends a close frame and closes the connection
+    void close();
+
+    // Makes a read blocked on another thread return Result_Error. The
+    // connection is unusable afterwards; call close() or connect() again.
+    void interrupt();
+
+    bool isOpen() const { return m_socket >= 0; }
+    const std::string& error() const { return m_error; }
+
+private:
+    bool fail(const std::string& error);
+
+    // Reads more bytes into m_buffer
+    bool fill();
+    bool writeAll(const char* data, size_t size);
+    bool sendFrame(uint8_t opcode, const char* data, size_t size);
+
+    void disconnect();
+
+    std::atomic<int> m_socket;
+    ssl_ctx_st* m_ssl_ctx;
+    ssl_st* m_ssl;
+
+    std::string m_buffer;
+    size_t m_offset; // Start of unread data in m_buffer
+    size_t m_end; // End of received data in m_buffer
+    std::string m_error;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "bluesky_client.hpp"
+
+// Collects record writes and sends them through com.atproto.repo.applyWrites,
+// many operations per request instead of one createRecord call each.
+class BlueskyWriteBatch {
+public:
+    // The client must outlive the batch. chunkSize is capped at
+    // BlueskyClient::MAX_WRITES_PER_REQUEST.
+    explicit BlueskyWriteBatch(BlueskyClient& client, size_t chunkSize = BlueskyClient::MAX_WRITES_PER_REQUEST);
+
+    // Disable copying
+    BlueskyWriteBatch(const BlueskyWriteBatch&) = delete;
+    BlueskyWriteBatch& operator=(const BlueskyWriteBatch&) = delete;
+
+    // record is the record object as JSON; an empty rkey lets the server pick
+    // one. Returns false, queuing nothing, if record is not a JSON object.
+    bool create(const std::string& collection, const std::string& record, const std::string& rkey = std::string());
+    bool update(const std::string& collection, const std::string& rkey, const std::string& record);
+    void remove(const std::string& collection, const std::string& rkey);
+
+    // Creates an app.bsky.feed.post record with the current time
+    void createPost(const std::string& text);
+    void createPost(const BlueskyClient::PostRecord& record);
+
+    size_t size() const { return m_pending.size(); }
+    bool empty() const { return m_pending.empty(); }
+
+    // Sends pending operations, chunkSize per request, in the order they were
+    // added, and returns one result per operation sent. Each chunk is applied
+    // atomically, so a failed request fails all of its operations. Sending
+    // stops at the first failed chunk and later ones stay queued for the next
+    // flush(). The failed chunk stays queued too if it is retryable, i.e.
+    // nothing was applied; otherwise its outcome is unknown (the server may
+    // have committed it) and it is dropped rather than risk writing it twice.
+    std::vector<BlueskyClient::WriteResult> flush();
+
+    // Drops pending operations, e.g. ones the server keeps rejecting
+    void clear() { m_pending.clear(); }
+
+private:
+    bool isRecord(const std::string& json);
+
+    BlueskyClient& m_client;
+    const size_t m_chunk_size;
+    std::vector<BlueskyClient::WriteOp> m_pending;
+    BlueskyJsonBuilder m_builder;
+};
@@ -0,0 +1,26 @@
+#include "bluesky_author_ids.hpp"
+
+const BlueskyAuthorIds::AuthorId BlueskyAuthorIds::NO_AUTHOR;
+
+BlueskyAuthorIds::BlueskyAuthorIds() {}
+
+BlueskyAuthorIds::AuthorId BlueskyAuthorIds::intern(const char* did, size_t size, bool& added) {
+    m_key.assign(did, size);
+
+    auto it = m_ids.find(m_key);
+    if (it != m_ids.end()) {
+        added = false;
+        return it->second;
+    }
+
+    const AuthorId id = (AuthorId)m_ids.size();
+    m_ids.emplace(m_key, id);
+
+    added = true;
+    return id;
+}
+
+BlueskyAuthorIds::AuthorId BlueskyAuthorIds::find(const std::string& did) const {
+    auto it = m_ids.find(did);
+    return it != m_ids.end() ? it->second : NO_AUTHOR;
+}
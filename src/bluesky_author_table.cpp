@@ -0,0 +1,182 @@
+#include "bluesky_author_table.hpp"
+
+const BlueskyAuthorTable::AuthorId BlueskyAuthorTable::NO_AUTHOR;
+
+BlueskyAuthorTable::BlueskyAuthorTable() {}
+
+BlueskyAuthorTable::AuthorId BlueskyAuthorTable::slotLocked(const char* did, size_t size, bool& added) {
+    const AuthorId id = m_ids.intern(did, size, added);
+    if (!added)
+        return id;
+
+    Entry entry;
+    entry.author = BlueskyClient::PostAuthor();
+    entry.author.did.assign(did, size);
+    entry.seenAt = BlueskyTimestamp();
+    m_entries.push_back(std::move(entry));
+
+    return id;
+}
+
+BlueskyAuthorTable::AuthorId BlueskyAuthorTable::intern(const BlueskyClient::PostAuthor& author, BlueskyTimestamp seenAt) {
+    if (author.did.empty())
+        return NO_AUTHOR;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    bool added;
+    const AuthorId id = slotLocked(author.did.data(), author.did.size(), added);
+
+    Entry& entry = m_entries[id];
+    if (!added && seenAt < entry.seenAt)
+        return id;
+
+    entry.author = author;
+    entry.seenAt = seenAt;
+    return id;
+}
+
+BlueskyAuthorTable::AuthorId BlueskyAuthorTable::intern(const BlueskyClient::AuthorView& author, BlueskyTimestamp seenAt) {
+    const BlueskyClient::StringRef did = author.did();
+    if (did.empty())
+        return NO_AUTHOR;
+
+    // Read before locking; the strings stay in the response and are only
+    // copied below if they changed
+    const BlueskyClient::StringRef handle = author.handle();
+    const BlueskyClient::StringRef displayName = author.displayName();
+    const BlueskyClient::StringRef avatarUrl = author.avatarUrl();
+    const BlueskyTimestamp createdAt = author.createdAtTime();
+    const bool blocked = author.blockedByViewer();
+    const bool muted = author.mutedByViewer();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    bool added;
+    const AuthorId id = slotLocked(did.data(), did.size(), added);
+
+    Entry& entry = m_entries[id];
+    if (!added && seenAt < entry.seenAt)
+        return id;
+
+    // In place: unchanged strings keep their buffers
+    BlueskyClient::PostAuthor& stored = entry.author;
+    if (handle != stored.handle)
+        stored.handle.assign(handle.data(), handle.size());
+    if (displayName != stored.displayName)
+        stored.displayName.assign(displayName.data(), displayName.size());
+    if (avatarUrl != stored.avatarUrl)
+        stored.avatarUrl.assign(avatarUrl.data(), avatarUrl.size());
+
+    stored.createdAtTime = createdAt;
+    stored.createdAt = createdAt.toTimeT();
+    stored.blockedByViewer = blocked;
+    stored.mutedByViewer = muted;
+
+    entry.seenAt = seenAt;
+    return id;
+}
+
+BlueskyAuthorTable::Post BlueskyAuthorTable::strip(const BlueskyClient::Post& post, AuthorId author) {
+    Post out = Post();
+    out.uri = post.uri;
+    out.indexedAt = post.indexedAt;
+    out.createdAt = post.createdAt;
+    out.indexedAtTime = post.indexedAtTime;
+    out.createdAtTime = post.createdAtTime;
+    out.author = author;
+    out.cid = post.cid;
+    out.text = post.text;
+    out.likeCount = post.likeCount;
+    out.quoteCount = post.quoteCount;
+    out.replyCount = post.replyCount;
+    out.repostCount = post.repostCount;
+    return out;
+}
+
+BlueskyAuthorTable::Post BlueskyAuthorTable::intern(const BlueskyClient::Post& post, BlueskyTimestamp seenAt) {
+    return strip(post, intern(post.author, seenAt));
+}
+
+BlueskyAuthorTable::Post BlueskyAuthorTable::intern(const BlueskyClient::PostView& post, BlueskyTimestamp seenAt) {
+    Post out = Post();
+    out.uri = post.uri().str();
+    out.indexedAtTime = post.indexedAtTime();
+    out.indexedAt = out.indexedAtTime.toTimeT();
+    out.createdAtTime = post.createdAtTime();
+    out.createdAt = out.createdAtTime.toTimeT();
+    out.author = intern(post.author(), seenAt);
+    out.cid = post.cid().str();
+    out.text = post.text().str();
+    out.likeCount = post.likeCount();
+    out.quoteCount = post.quoteCount();
+    out.replyCount = post.replyCount();
+    out.repostCount = post.repostCount();
+    return out;
+}
+
+std::vector<BlueskyAuthorTable::Post> BlueskyAuthorTable::intern(const BlueskyClient::PostsResult& result, BlueskyTimestamp seenAt) {
+    std::vector<Post> posts;
+    posts.reserve(result.posts.size());
+
+    for (const BlueskyClient::Post& post : result.posts)
+        posts.push_back(intern(post, seenAt));
+
+    return posts;
+}
+
+std::vector<BlueskyAuthorTable::Post> BlueskyAuthorTable::intern(const BlueskyClient::FeedView& page, BlueskyTimestamp seenAt) {
+    std::vector<Post> posts;
+    posts.reserve(page.size());
+
+    for (const BlueskyClient::PostView& post : page.posts())
+        posts.push_back(intern(post, seenAt));
+
+    return posts;
+}
+
+BlueskyAuthorTable::AuthorId BlueskyAuthorTable::find(const std::string& did) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_ids.find(did);
+}
+
+bool BlueskyAuthorTable::author(AuthorId id, BlueskyClient::PostAuthor& out) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (id >= m_entries.size())
+        return false;
+
+    out = m_entries[id].author;
+    return true;
+}
+
+BlueskyClient::Post BlueskyAuthorTable::expand(const Post& post) const {
+    BlueskyClient::Post out = BlueskyClient::Post();
+    out.uri = post.uri;
+    out.indexedAt = post.indexedAt;
+    out.createdAt = post.createdAt;
+    out.indexedAtTime = post.indexedAtTime;
+    out.createdAtTime = post.createdAtTime;
+    out.cid = post.cid;
+    out.text = post.text;
+    out.likeCount = post.likeCount;
+    out.quoteCount = post.quoteCount;
+    out.replyCount = post.replyCount;
+    out.repostCount = post.repostCount;
+
+    if (!author(post.author, out.author))
+        out.author.createdAt = (time_t)(-1);
+
+    return out;
+}
+
+size_t BlueskyAuthorTable::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+}
+
+void BlueskyAuthorTable::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_ids.clear();
+}
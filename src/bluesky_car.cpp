@@ -0,0 +1,190 @@
+#include "bluesky_car.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <openssl/sha.h>
+
+// Largest section accepted; blocks in atproto repos are at most 1 MiB
+static const uint64_t MAX_SECTION_SIZE = 2 * 1024 * 1024;
+
+BlueskyCarReader::BlueskyCarReader(BlockHandler handler, bool verifyCids)
+    : m_handler(std::move(handler))
+    , m_verify(verifyCids)
+    , m_header_read(false)
+    , m_failed(false)
+    , m_blocks(0)
+{}
+
+bool BlueskyCarReader::fail(const std::string& error) {
+    m_failed = true;
+    m_error = error;
+    return false;
+}
+
+bool BlueskyCarReader::feed(const char* data, size_t size) {
+    if (m_failed)
+        return false;
+
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    // Complete the section left over from the previous chunk first. Only the
+    // missing part is copied; whatever follows is read straight from data.
+    while (!m_pending.empty() && size > 0) {
+        uint64_t sectionSize = 0;
+        const size_t prefix = blueskyReadVarint((const uint8_t*)m_pending.data(), m_pending.size(), sectionSize);
+
+        size_t wanted = 1;
+        if (prefix > 0)
+            wanted = (size_t)std::min<uint64_t>(prefix + sectionSize - m_pending.size(), size);
+
+        m_pending.append((const char*)bytes, wanted);
+        bytes += wanted;
+        size -= wanted;
+
+        const size_t used = consume((const uint8_t*)m_pending.data(), m_pending.size());
+        if (m_failed)
+            return false;
+
+        m_pending.erase(0, used);
+    }
+
+    const size_t used = consume(bytes, size);
+    if (m_failed)
+        return false;
+
+    m_pending.append((const char*)bytes + used, size - used);
+    return true;
+}
+
+bool BlueskyCarReader::finish() {
+    if (m_failed)
+        return false;
+    if (!m_header_read)
+        return fail("missing CAR header");
+    if (!m_pending.empty())
+        return fail("truncated block");
+
+    return true;
+}
+
+size_t BlueskyCarReader::consume(const uint8_t* data, size_t size) {
+    size_t pos = 0;
+
+    while (pos < size) {
+        uint64_t sectionSize = 0;
+        const size_t prefix = blueskyReadVarint(data + pos, size - pos, sectionSize);
+        if (prefix == 0) {
+            if (size - pos >= 9)
+                fail("malformed section length");
+            break;
+        }
+
+        if (sectionSize > MAX_SECTION_SIZE) {
+            fail("section too large");
+            break;
+        }
+        if (sectionSize > size - pos - prefix)
+            break; // Wait for more data
+
+        const uint8_t* section = data + pos + prefix;
+        pos += prefix + (size_t)sectionSize;
+
+        if (!m_header_read) {
+            if (!readHeader(section, (size_t)sectionSize))
+                break;
+            continue;
+        }
+
+        BlueskyCid cid;
+        const size_t cidLength = BlueskyCid::parse(section, (size_t)sectionSize, cid);
+        if (cidLength == 0) {
+            fail("malformed CID");
+            break;
+        }
+
+        const uint8_t* blockData = section + cidLength;
+        const size_t blockSize = (size_t)sectionSize - cidLength;
+
+        if (m_verify && !verify(cid, blockData, blockSize)) {
+            fail("block does not match CID " + cid.toString());
+            break;
+        }
+
+        m_blocks++;
+
+        const Block block = { cid, blockData, blockSize };
+        if (!m_handler(block)) {
+            fail("stopped by handler");
+            break;
+        }
+    }
+
+    return pos;
+}
+
+bool BlueskyCarReader::readHeader(const uint8_t* data, size_t size) {
+    BlueskyCborReader reader(data, size);
+
+    uint64_t entries = 0;
+    if (!reader.readMap(entries))
+        return fail("malformed CAR header");
+
+    bool versionOk = false;
+
+    for (uint64_t i = 0; i < entries; i++) {
+        std::string key;
+        if (!reader.readText(key))
+            return fail("malformed CAR header");
+
+        if (key == "version") {
+            int64_t version = 0;
+            if (!reader.readInt(version))
+                return fail("malformed CAR header");
+
+            versionOk = version == 1;
+        }
+        else if (key == "roots") {
+            uint64_t count = 0;
+            if (!reader.readArray(count))
+                return fail("malformed CAR header");
+
+            for (uint64_t r = 0; r < count; r++) {
+                BlueskyCid root;
+                if (!reader.readCid(root))
+                    return fail("malformed CAR root");
+
+                m_roots.push_back(root);
+            }
+        }
+        else if (!reader.skip()) {
+            return fail("malformed CAR header");
+        }
+    }
+
+    if (!versionOk)
+        return fail("unsupported CAR version");
+
+    m_header_read = true;
+    return true;
+}
+
+bool BlueskyCarReader::verify(const BlueskyCid& cid, const uint8_t* data, size_t size) {
+    const uint8_t* digest = (const uint8_t*)cid.bytes.data() + cid.digestOffset;
+
+    switch (cid.hash) {
+    case BlueskyCid::Hash_Sha256: {
+        if (cid.digestLength != SHA256_DIGEST_LENGTH)
+            return false;
+
+        uint8_t hash[SHA256_DIGEST_LENGTH];
+        SHA256(data, size, hash);
+
+        return std::memcmp(hash, digest, SHA256_DIGEST_LENGTH) == 0;
+    }
+    case BlueskyCid::Hash_Identity:
+        return cid.digestLength == size && std::memcmp(digest, data, size) == 0;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,240 @@
+#include "bluesky_cbor.hpp"
+
+#include <cstring>
+
+size_t blueskyReadVarint(const uint8_t* data, size_t size, uint64_t& value) {
+    value = 0;
+
+    // 9 bytes hold 63 bits, all multiformats ever needs
+    for (size_t i = 0; i < size && i < 9; i++) {
+        value |= (uint64_t)(data[i] & 0x7F) << (7 * i);
+        if ((data[i] & 0x80) == 0)
+            return i + 1;
+    }
+
+    return 0;
+}
+
+size_t BlueskyCid::parse(const uint8_t* data, size_t size, BlueskyCid& cid) {
+    uint64_t version = 0, codec = 0, hash = 0, digestLength = 0;
+    size_t pos = 0, length = 0;
+
+    if (!(length = blueskyReadVarint(data + pos, size - pos, version)) || version != 1)
+        return 0;
+    pos += length;
+
+    if (!(length = blueskyReadVarint(data + pos, size - pos, codec)))
+        return 0;
+    pos += length;
+
+    if (!(length = blueskyReadVarint(data + pos, size - pos, hash)))
+        return 0;
+    pos += length;
+
+    if (!(length = blueskyReadVarint(data + pos, size - pos, digestLength)))
+        return 0;
+    pos += length;
+
+    if (digestLength > size - pos)
+        return 0;
+
+    cid.bytes.assign((const char*)data, pos + digestLength);
+    cid.codec = codec;
+    cid.hash = hash;
+    cid.digestOffset = pos;
+    cid.digestLength = (size_t)digestLength;
+
+    return pos + digestLength;
+}
+
+std::string BlueskyCid::toString() const {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz234567";
+
+    std::string out;
+    out.reserve(1 + (bytes.size() * 8 + 4) / 5);
+    out.push_back('b');
+
+    unsigned buffer = 0;
+    int bits = 0;
+
+    for (unsigned char c : bytes) {
+        buffer = (buffer << 8) | c;
+        bits += 8;
+
+        while (bits >= 5) {
+            bits -= 5;
+            out.push_back(alphabet[(buffer >> bits) & 0x1F]);
+        }
+    }
+
+    if (bits > 0)
+        out.push_back(alphabet[(buffer << (5 - bits)) & 0x1F]);
+
+    return out;
+}
+
+bool BlueskyCborReader::read(Item& item) {
+    if (m_failed || m_pos >= m_size)
+        return false;
+
+    const uint8_t initial = m_data[m_pos++];
+    const uint8_t major = initial >> 5;
+    const uint8_t minor = initial & 0x1F;
+
+    uint64_t value = minor;
+    if (minor >= 24) {
+        if (minor > 27)
+            return fail(); // Indefinite lengths and reserved values
+
+        const size_t length = (size_t)1 << (minor - 24);
+        if (length > m_size - m_pos)
+            return fail();
+
+        value = 0;
+        for (size_t i = 0; i < length; i++)
+            value = (value << 8) | m_data[m_pos++];
+    }
+
+    item.value = value;
+    item.data = nullptr;
+    item.number = 0;
+
+    switch (major) {
+    case 0:
+        item.type = Type_Unsigned;
+        break;
+    case 1:
+        item.type = Type_Negative;
+        break;
+    case 2:
+    case 3:
+        if (value > m_size - m_pos)
+            return fail();
+
+        item.type = major == 2 ? Type_Bytes : Type_Text;
+        item.data = m_data + m_pos;
+        m_pos += (size_t)value;
+        break;
+    case 4:
+        item.type = Type_Array;
+        break;
+    case 5:
+        item.type = Type_Map;
+        break;
+    case 6:
+        item.type = Type_Tag;
+        break;
+    case 7:
+        if (minor == 20)
+            item.type = Type_False;
+        else if (minor == 21)
+            item.type = Type_True;
+        else if (minor == 22)
+            item.type = Type_Null;
+        else if (minor == 27) {
+            // DAG-CBOR only allows 64-bit floats
+            item.type = Type_Float;
+            std::memcpy(&item.number, &value, sizeof(item.number));
+        }
+        else
+            return fail();
+        break;
+    }
+
+    return true;
+}
+
+bool BlueskyCborReader::skip() {
+    // Items still to be read; every item takes at least one byte, so a
+    // count beyond what is left cannot be valid
+    uint64_t pending = 1;
+
+    while (pending > 0) {
+        Item item;
+        if (!read(item))
+            return fail();
+        pending--;
+
+        uint64_t nested = 0;
+        if (item.type == Type_Array)
+            nested = item.value;
+        else if (item.type == Type_Map)
+            nested = item.value * 2;
+        else if (item.type == Type_Tag)
+            nested = 1;
+
+        if (nested > m_size - m_pos || (item.type == Type_Map && item.value > m_size))
+            return fail();
+
+        pending += nested;
+    }
+
+    return true;
+}
+
+bool BlueskyCborReader::readText(std::string& out) {
+    Item item;
+    if (!read(item) || item.type != Type_Text)
+        return fail();
+
+    out.assign((const char*)item.data, (size_t)item.value);
+    return true;
+}
+
+bool BlueskyCborReader::readInt(int64_t& out) {
+    Item item;
+    if (!read(item))
+        return false;
+
+    // DAG-CBOR integers fit in 64 bits signed; anything wider would wrap
+    if (item.type == Type_Unsigned && item.value <= (uint64_t)INT64_MAX)
+        out = (int64_t)item.value;
+    else if (item.type == Type_Negative && item.value <= (uint64_t)INT64_MAX)
+        out = -1 - (int64_t)item.value;
+    else
+        return fail();
+
+    return true;
+}
+
+bool BlueskyCborReader::readCid(BlueskyCid& out) {
+    Item item;
+    if (!read(item) || item.type != Type_Tag || item.value != 42)
+        return fail();
+    if (!read(item) || item.type != Type_Bytes || item.value < 1)
+        return fail();
+
+    // The binary CID is prefixed with the identity multibase byte
+    if (item.data[0] != 0x00)
+        return fail();
+    if (BlueskyCid::parse(item.data + 1, (size_t)item.value - 1, out) != item.value - 1)
+        return fail();
+
+    return true;
+}
+
+bool BlueskyCborReader::readMap(uint64_t& entries) {
+    Item item;
+    if (!read(item) || item.type != Type_Map)
+        return fail();
+
+    entries = item.value;
+    return true;
+}
+
+bool BlueskyCborReader::readArray(uint64_t& entries) {
+    Item item;
+    if (!read(item) || item.type != Type_Array)
+        return fail();
+
+    entries = item.value;
+    return true;
+}
+
+bool BlueskyCborReader::readNull() {
+    if (m_failed || m_pos >= m_size || m_data[m_pos] != 0xF6)
+        return false;
+
+    m_pos++;
+    return true;
+}
@@ -1,326 +1,1262 @@
 #include "bluesky_client.hpp"
+#include "bluesky_author_table.hpp"
+#include "bluesky_connection_pool.hpp"
+#include "bluesky_executor.hpp"
+#include "bluesky_metrics.hpp"
+#include "bluesky_rate_limiter.hpp"
+#include "bluesky_response_cache.hpp"
+#include "bluesky_single_flight.hpp"
+#include "bluesky_text.hpp"
 
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <chrono>
 #include <ctime>
-#include <unordered_map>
+#include <cstdlib>
+#include <cstring>
 #include <string>
+#include <thread>
 
 #include <yyjson.h>
 
 const char* const BlueskyClient::USER_AGENT = "BlueskyClient/1.0";
 
-BlueskyClient::BlueskyClient(const std::string& server) 
-    : m_server_host(server)
-    , m_client(new httplib::Client("https://" + server))
-{
-    m_client->set_connection_timeout(10);
-    m_client->set_read_timeout(10);
-    m_client->enable_server_certificate_verification(false);
-    m_client->set_follow_location(true);
+// Retries of a request answered with 429 before giving up
+static const unsigned MAX_RATE_LIMIT_RETRIES = 3;
+
+// Access tokens are refreshed in the background this many seconds before
+// they expire
+static const time_t SESSION_REFRESH_MARGIN = 300;
+
+// Wait after a failed refresh before the next, doubling up to the maximum
+static const std::chrono::seconds REFRESH_RETRY_DELAY(1);
+static const std::chrono::seconds MAX_REFRESH_RETRY_DELAY(60);
+
+// Receive buffers larger than this are released instead of kept for reuse
+static const size_t MAX_RETAINED_BODY_SIZE = 4 * 1024 * 1024;
+
+typedef std::chrono::steady_clock Clock;
+
+static uint64_t elapsedMicros(Clock::time_point from, Clock::time_point to) {
+    return to > from ? (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(to - from).count() : 0;
 }
 
-BlueskyClient::~BlueskyClient() = default;
+// Encodings httplib was built to decode, best first. httplib inflates them
+// chunk by chunk before content_receiver sees the data.
+static const char* const ACCEPT_ENCODING =
+#if defined(CPPHTTPLIB_BROTLI_SUPPORT) && defined(CPPHTTPLIB_ZLIB_SUPPORT)
+    "br, gzip, deflate";
+#elif defined(CPPHTTPLIB_BROTLI_SUPPORT)
+    "br";
+#elif defined(CPPHTTPLIB_ZLIB_SUPPORT)
+    "gzip, deflate";
+#else
+    nullptr;
+#endif
+
+// HTTPS unless the server string names its own scheme, e.g. a local test server
+static std::string serverUrl(const std::string& server) {
+    if (server.find("://") != std::string::npos)
+        return server;
+
+    return "https://" + server;
+}
 
-BlueskyClient::BlueskyClient(BlueskyClient&& other)
-    : m_client(std::move(other.m_client))
-    , m_server_host(std::move(other.m_server_host))
-    , m_access_token(std::move(other.m_access_token))
-    , m_user_did(std::move(other.m_user_did))
-    , m_user_handle(std::move(other.m_user_handle))
-    , m_refresh_token(std::move(other.m_refresh_token))
+BlueskyClient::BlueskyClient(const std::string& server, unsigned maxConnections)
+    : m_server_host(server)
+    , m_pool(new BlueskyConnectionPool(serverUrl(server), maxConnections))
+    , m_rate_limiter(new BlueskyRateLimiter())
+    , m_metrics(new BlueskyMetrics())
+    , m_authors(new BlueskyAuthorTable())
+    , m_coalesce(false)
+    , m_coalesced(0)
+    , m_flights(new BlueskySingleFlight<std::shared_ptr<const void>>())
+    , m_cache(nullptr)
+    , m_refresh_pending(false)
+    , m_refresh_failures(0)
+    , m_worker_threads(m_pool->maxConnections())
 {}
 
+BlueskyClient::~BlueskyClient() {
+    // Pending async calls use the pool, the session and the builders
+    drainExecutor();
+}
+
+BlueskyClient::BlueskyClient(BlueskyClient&& other)
+    : m_server_host(std::move(other.m_server_host))
+    , m_pool(std::move(other.m_pool))
+    , m_rate_limiter(std::move(other.m_rate_limiter))
+    , m_metrics(std::move(other.m_metrics))
+    , m_authors(std::move(other.m_authors))
+    , m_coalesce(other.m_coalesce.load())
+    , m_coalesced(other.m_coalesced.load())
+    , m_flights(std::move(other.m_flights))
+    , m_cache(other.responseCache())
+    , m_session(other.loadSession())
+    , m_refresh_pending(false)
+    , m_refresh_failures(0)
+    , m_worker_threads(other.m_worker_threads)
+    , m_executor(std::move(other.m_executor))
+{
+    other.storeSession(nullptr);
+}
+
 BlueskyClient& BlueskyClient::operator=(BlueskyClient&& other) {
     if (this != &other) {
-        m_client = std::move(other.m_client);
+        // Finishes our own pending async calls before the pool goes away
+        drainExecutor();
+        {
+            std::lock_guard<std::mutex> lock(m_executor_mutex);
+            m_executor = std::move(other.m_executor);
+            m_worker_threads = other.m_worker_threads;
+        }
+
         m_server_host = std::move(other.m_server_host);
-        m_access_token = std::move(other.m_access_token);
-        m_user_did = std::move(other.m_user_did);
-        m_user_handle = std::move(other.m_user_handle);
-        m_refresh_token = std::move(other.m_refresh_token);
+        m_pool = std::move(other.m_pool);
+        m_rate_limiter = std::move(other.m_rate_limiter);
+        m_metrics = std::move(other.m_metrics);
+        m_authors = std::move(other.m_authors);
+        m_coalesce = other.m_coalesce.load();
+        m_coalesced = other.m_coalesced.load();
+        m_flights = std::move(other.m_flights);
+        setResponseCache(other.responseCache());
+        storeSession(other.loadSession());
+        other.storeSession(nullptr);
     }
     return *this;
 }
 
-static std::string escapeJson(const std::string& str) {
-    std::string escaped;
-    escaped.reserve(str.size());
-
-    for (char c : str) {
-        switch (c) {
-            case '\"': escaped.append("\\\""); break;
-            case '\\': escaped.append("\\\\"); break;
-            case '\b': escaped.append("\\b"); break;
-            case '\f': escaped.append("\\f"); break;
-            case '\n': escaped.append("\\n"); break;
-            case '\r': escaped.append("\\r"); break;
-            case '\t': escaped.append("\\t"); break;
-            default: escaped.push_back(c); break;
+std::shared_ptr<const BlueskyClient::Session> BlueskyClient::loadSession() const {
+    return std::atomic_load(&m_session);
+}
+
+void BlueskyClient::storeSession(std::shared_ptr<const Session> session) {
+    std::atomic_store(&m_session, std::move(session));
+}
+
+bool BlueskyClient::isLoggedIn() const {
+    std::shared_ptr<const Session> session = loadSession();
+    return session && !session->accessToken.empty();
+}
+
+std::string BlueskyClient::getHandle() const {
+    std::shared_ptr<const Session> session = loadSession();
+    return session ? session->handle : std::string();
+}
+
+std::string BlueskyClient::getDid() const {
+    std::shared_ptr<const Session> session = loadSession();
+    return session ? session->did : std::string();
+}
+
+time_t BlueskyClient::getSessionExpiry() const {
+    std::shared_ptr<const Session> session = loadSession();
+    return session ? session->expiresAt : 0;
+}
+
+static bool base64UrlDecode(const char* data, size_t length, std::string& out) {
+    out.clear();
+    out.reserve(length * 3 / 4);
+
+    unsigned buffer = 0;
+    int bits = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        const char c = data[i];
+
+        unsigned value;
+        if (c >= 'A' && c <= 'Z')
+            value = c - 'A';
+        else if (c >= 'a' && c <= 'z')
+            value = c - 'a' + 26;
+        else if (c >= '0' && c <= '9')
+            value = c - '0' + 52;
+        else if (c == '-' || c == '+')
+            value = 62;
+        else if (c == '_' || c == '/')
+            value = 63;
+        else if (c == '=')
+            break;
+        else
+            return false;
+
+        buffer = (buffer << 6) | value;
+        bits += 6;
+
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back((char)((buffer >> bits) & 0xFF));
         }
     }
-    return escaped;
+
+    return true;
 }
 
-static time_t datetimeToTimeT(const char* datetime) {
-    if (datetime == nullptr)
-        return (time_t)(-1);
+// Reads the exp claim of a JWT, 0 if it has none. The signature is not
+// checked; the server does that, this only schedules the refresh.
+static time_t jwtExpiry(const char* token) {
+    const char* payload = strchr(token, '.');
+    if (!payload)
+        return 0;
+    payload++;
+
+    const char* end = strchr(payload, '.');
+    if (!end)
+        return 0;
+
+    std::string json;
+    if (!base64UrlDecode(payload, end - payload, json))
+        return 0;
 
-    struct tm tm {};
+    yyjson_doc* doc = yyjson_read(json.data(), json.size(), 0);
+    if (!doc)
+        return 0;
 
-    char formattedDatetime[32];
-    strncpy(formattedDatetime, datetime, sizeof(formattedDatetime) - 1);
-    formattedDatetime[sizeof(formattedDatetime) - 1] = '\0';
+    yyjson_val* exp = yyjson_obj_get(yyjson_doc_get_root(doc), "exp");
+    const time_t expiry = yyjson_is_int(exp) ? (time_t)yyjson_get_sint(exp) : 0;
 
-    if (strptime(formattedDatetime, "%Y-%m-%dT%H:%M:%S", &tm) == nullptr)
-        return (time_t)(-1);
+    yyjson_doc_free(doc);
+    return expiry;
+}
+
+template <size_t N>
+static inline bool keyEquals(yyjson_val* key, const char (&name)[N]) {
+    return yyjson_get_len(key) == N - 1 && memcmp(yyjson_get_str(key), name, N - 1) == 0;
+}
 
-    return timegm(&tm);
+static inline void assignStr(std::string& out, yyjson_val* val) {
+    if (yyjson_is_str(val))
+        out.assign(yyjson_get_str(val), yyjson_get_len(val));
 }
 
 std::string BlueskyClient::createJsonString(const std::map<std::string, std::string>& data) {
-    std::ostringstream ss;
+    BlueskyJsonBuilder builder;
 
-    ss << "{";
-    for (auto it = data.begin(); it != data.end(); it++) {
-        if (it != data.begin())
-            ss << ',';
+    BlueskyJsonBuilder::Object root = builder.begin();
+    for (auto it = data.begin(); it != data.end(); it++)
+        root.addString(it->first.c_str(), it->second);
 
-        ss << "\"" << escapeJson(it->first) << "\":\"" << escapeJson(it->second) << "\"";
+    return builder.finish();
+}
+
+// Borrows a request body builder from the client for the duration of a request
+class BlueskyClient::BuilderLease {
+public:
+    explicit BuilderLease(BlueskyClient& client) : m_client(client), m_builder(client.takeBuilder()) {}
+    ~BuilderLease() { m_client.returnBuilder(std::move(m_builder)); }
+
+    BlueskyJsonBuilder* operator->() const { return m_builder.get(); }
+
+private:
+    BlueskyClient& m_client;
+    std::unique_ptr<BlueskyJsonBuilder> m_builder;
+};
+
+std::unique_ptr<BlueskyJsonBuilder> BlueskyClient::takeBuilder() {
+    {
+        std::lock_guard<std::mutex> lock(m_builders_mutex);
+        if (!m_builders.empty()) {
+            std::unique_ptr<BlueskyJsonBuilder> builder = std::move(m_builders.back());
+            m_builders.pop_back();
+            return builder;
+        }
     }
-    ss << "}";
+    return std::unique_ptr<BlueskyJsonBuilder>(new BlueskyJsonBuilder());
+}
 
-    return ss.str();
+void BlueskyClient::returnBuilder(std::unique_ptr<BlueskyJsonBuilder> builder) {
+    std::lock_guard<std::mutex> lock(m_builders_mutex);
+
+    // More builders than connections would never be in use at once
+    if (m_builders.size() < m_pool->maxConnections())
+        m_builders.push_back(std::move(builder));
 }
 
 bool BlueskyClient::login(const std::string& identifier, const std::string& password) {
-    std::map<std::string, std::string> loginData = {
-        { "identifier", identifier },
-        { "password", password }
-    };
-    
-    auto response = makeRequest(
+    BuilderLease builder(*this);
+    builder->begin()
+        .addString("identifier", identifier)
+        .addString("password", password);
+
+    bool loggedIn = false;
+
+    makeJsonRequest(
         RequestMethod_POST, "xrpc/com.atproto.server.createSession", 
-        std::map<std::string, std::string>(), 
-        createJsonString(loginData)
-    );
-    
-    if (!response.empty()) {
-        yyjson_doc* doc = yyjson_read(response.c_str(), response.length(), 0);
-        if (!doc)
-            return false;
-        
-        yyjson_val* root = yyjson_doc_get_root(doc);
-        if (!root) {
-            yyjson_doc_free(doc);
-            return false;
+        QueryParams(), 
+        builder->finish(),
+        [this, &loggedIn](yyjson_val* root) {
+            std::shared_ptr<Session> session = decodeSession(root);
+            if (!session)
+                return;
+
+            storeSession(session);
+            loggedIn = true;
         }
+    );
 
-        yyjson_val* jwt = yyjson_obj_get(root, "accessJwt");
-        yyjson_val* did = yyjson_obj_get(root, "did");
-        yyjson_val* handle = yyjson_obj_get(root, "handle");
-        yyjson_val* refresh = yyjson_obj_get(root, "refreshJwt");
+    return loggedIn;
+}
 
-        if (jwt && did && handle) {
-            m_access_token = std::string("Bearer ") + yyjson_get_str(jwt);
-            m_user_did = yyjson_get_str(did);
-            m_user_handle = yyjson_get_str(handle);
-            if (refresh)
-                m_refresh_token = yyjson_get_str(refresh);
+std::shared_ptr<BlueskyClient::Session> BlueskyClient::decodeSession(yyjson_val* root) {
+    yyjson_val* jwt = yyjson_obj_get(root, "accessJwt");
+    yyjson_val* did = yyjson_obj_get(root, "did");
+    yyjson_val* handle = yyjson_obj_get(root, "handle");
+    yyjson_val* refresh = yyjson_obj_get(root, "refreshJwt");
 
-            yyjson_doc_free(doc);
-            return true;
-        }
+    if (!yyjson_is_str(jwt) || !yyjson_is_str(did) || !yyjson_is_str(handle))
+        return nullptr;
 
-        yyjson_doc_free(doc);
+    std::shared_ptr<Session> session(new Session());
+    session->accessToken = std::string("Bearer ") + yyjson_get_str(jwt);
+    session->did = yyjson_get_str(did);
+    session->handle = yyjson_get_str(handle);
+    session->expiresAt = jwtExpiry(yyjson_get_str(jwt));
+    assignStr(session->refreshToken, refresh);
+
+    return session;
+}
+
+bool BlueskyClient::refreshSession() {
+    std::shared_ptr<const Session> session = loadSession();
+    if (!session || session->refreshToken.empty())
+        return false;
+
+    return refreshSessionFrom(session, true);
+}
+
+bool BlueskyClient::refreshSessionFrom(const std::shared_ptr<const Session>& observed, bool force) {
+    std::lock_guard<std::mutex> lock(m_refresh_mutex);
+
+    // Someone else refreshed (or logged in) while we waited for the lock
+    std::shared_ptr<const Session> current = loadSession();
+    if (current != observed)
+        return current != nullptr;
+
+    // Every request past expiry lands here; while the server or network is
+    // down, or the refresh token was revoked, they fail fast instead of each
+    // sending another refresh
+    if (m_refresh_failed != observed)
+        m_refresh_failures = 0;
+    else if (!force && Clock::now() < m_refresh_retry_at)
+        return false;
+
+    bool refreshed = false;
+
+    makeJsonRequest(
+        RequestMethod_POST, "xrpc/com.atproto.server.refreshSession",
+        QueryParams(), std::string(),
+        [this, &refreshed](yyjson_val* root) {
+            std::shared_ptr<Session> session = decodeSession(root);
+            if (!session)
+                return;
+
+            storeSession(session);
+            refreshed = true;
+        },
+        RequestAuth_Refresh
+    );
+
+    if (refreshed) {
+        m_refresh_failed.reset();
+        m_refresh_failures = 0;
+    }
+    else {
+        const std::chrono::seconds delay = std::min(
+            REFRESH_RETRY_DELAY * (1 << std::min(m_refresh_failures, 6u)), MAX_REFRESH_RETRY_DELAY
+        );
+
+        m_refresh_failed = observed;
+        m_refresh_failures++;
+        m_refresh_retry_at = Clock::now() + delay;
     }
 
-    return false;
+    return refreshed;
+}
+
+void BlueskyClient::refreshSessionIfExpiring(const std::shared_ptr<const Session>& session) {
+    if (!session || session->expiresAt == 0 || session->refreshToken.empty())
+        return;
+
+    const time_t now = time(nullptr);
+    if (now < session->expiresAt - SESSION_REFRESH_MARGIN)
+        return;
+
+    // Past expiry every request would fail, so wait for the new token
+    if (now >= session->expiresAt) {
+        refreshSessionFrom(session);
+        return;
+    }
+
+    // Still valid: keep using it while one refresh runs in the background,
+    // ahead of async calls already queued so it is not stuck behind them
+    if (m_refresh_pending.exchange(true))
+        return;
+
+    postTask([this, session] {
+        refreshSessionFrom(session);
+        m_refresh_pending = false;
+    }, true);
+}
+
+std::string BlueskyClient::exportSession() const {
+    std::shared_ptr<const Session> session = loadSession();
+    if (!session)
+        return std::string();
+
+    static const size_t BEARER_LENGTH = sizeof("Bearer ") - 1;
+
+    BlueskyJsonBuilder builder;
+    builder.begin()
+        .addString("accessJwt", session->accessToken.substr(BEARER_LENGTH))
+        .addString("refreshJwt", session->refreshToken)
+        .addString("did", session->did)
+        .addString("handle", session->handle);
+
+    return builder.finish();
+}
+
+bool BlueskyClient::importSession(const std::string& json) {
+    yyjson_doc* doc = yyjson_read(json.c_str(), json.length(), 0);
+    if (!doc)
+        return false;
+
+    std::shared_ptr<Session> session = decodeSession(yyjson_doc_get_root(doc));
+    yyjson_doc_free(doc);
+
+    if (!session)
+        return false;
+
+    storeSession(session);
+    return true;
 }
 
 BlueskyClient::Error BlueskyClient::createPost(const std::string& text) {
-    if (!isLoggedIn())
+    PostRecord record;
+    record.text = text;
+
+    return createPost(record);
+}
+
+BlueskyClient::Error BlueskyClient::createPost(const PostRecord& record) {
+    std::shared_ptr<const Session> session = loadSession();
+    if (!session)
         return Error_NotLoggedIn;
-    if (text.empty())
+    if (record.text.empty() && record.quote.uri.empty() && record.external.uri.empty())
         return Error_BadInput;
-    
-    // Get current time in ISO 8601 format
-    time_t now; time(&now);
 
-    char timestamp[32];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
-    
-    std::stringstream ss;
-    ss << "{\"collection\":\"app.bsky.feed.post\",\"repo\":\"" 
-       << m_user_did 
-       << "\",\"record\":{\"text\":\"" 
-       << text 
-       << "\",\"createdAt\":\"" 
-       << timestamp 
-       << "\"}}";
-    
+    BuilderLease builder(*this);
+
+    BlueskyJsonBuilder::Object root = builder->begin();
+    root.addString("collection", "app.bsky.feed.post")
+        .addString("repo", session->did);
+
+    BlueskyJsonBuilder::Object recordObject = root.addObject("record");
+    writePostRecord(recordObject, record);
+
     auto response = makeRequest(
         RequestMethod_POST, "xrpc/com.atproto.repo.createRecord", 
-        std::map<std::string, std::string>(), 
-        ss.str()
+        QueryParams(), 
+        builder->finish()
     );
 
+    // Even a failed request may have gone through
+    invalidateAuthorFeeds(*session);
+
     if (response.empty())
         return Error_ResponseFail;
     
     return Error_None;
 }
 
-BlueskyClient::PostsResult BlueskyClient::getFeedPosts(const std::string& feedUri, int limit) {
-    PostsResult result { .error = Error_None };
-    if (!isLoggedIn()) {
-        result.error = Error_NotLoggedIn;
-        return result;
+void BlueskyClient::writePostRecord(BlueskyJsonBuilder::Object& out, const PostRecord& record) {
+    char timestamp[BlueskyTimestamp::MAX_FORMAT_SIZE];
+    BlueskyTimestamp::now().format(timestamp);
+
+    out.addString("$type", "app.bsky.feed.post")
+        .addString("text", record.text)
+        .addString("createdAt", timestamp);
+
+    if (!record.langs.empty()) {
+        BlueskyJsonBuilder::Array langs = out.addArray("langs");
+        for (const std::string& lang : record.langs)
+            langs.addString(lang);
     }
 
-    std::map<std::string, std::string> params = {
-        { "feed", feedUri },
-        { "limit", std::to_string(limit) }
-    };
-    auto response = makeRequest(RequestMethod_GET, "xrpc/app.bsky.feed.getFeed", params);
+    if (!record.facets.empty()) {
+        BlueskyJsonBuilder::Array facets = out.addArray("facets");
+
+        for (const Facet& facet : record.facets) {
+            BlueskyJsonBuilder::Object entry = facets.addObject();
+            entry.addObject("index")
+                .addInt("byteStart", (int64_t)facet.byteStart)
+                .addInt("byteEnd", (int64_t)facet.byteEnd);
+
+            BlueskyJsonBuilder::Object feature = entry.addArray("features").addObject();
+            switch (facet.type) {
+            case Facet::Type_Link:
+                feature.addString("$type", "app.bsky.richtext.facet#link").addString("uri", facet.value);
+                break;
+            case Facet::Type_Mention:
+                feature.addString("$type", "app.bsky.richtext.facet#mention").addString("did", facet.value);
+                break;
+            case Facet::Type_Tag:
+                feature.addString("$type", "app.bsky.richtext.facet#tag").addString("tag", facet.value);
+                break;
+            }
+        }
+    }
 
-    if (!response.empty()) {
-        yyjson_doc* doc = yyjson_read(response.c_str(), response.length(), 0);
-        if (!doc) {
-            result.error = Error_ResponseParseFail;
-            return result;
+    if (!record.replyParent.uri.empty()) {
+        const RecordRef& replyRoot = record.replyRoot.uri.empty() ? record.replyParent : record.replyRoot;
+
+        BlueskyJsonBuilder::Object reply = out.addObject("reply");
+        reply.addObject("root")
+            .addString("uri", replyRoot.uri)
+            .addString("cid", replyRoot.cid);
+        reply.addObject("parent")
+            .addString("uri", record.replyParent.uri)
+            .addString("cid", record.replyParent.cid);
+    }
+
+    if (!record.quote.uri.empty()) {
+        BlueskyJsonBuilder::Object embed = out.addObject("embed");
+        embed.addString("$type", "app.bsky.embed.record");
+        embed.addObject("record")
+            .addString("uri", record.quote.uri)
+            .addString("cid", record.quote.cid);
+    }
+    else if (!record.external.uri.empty()) {
+        BlueskyJsonBuilder::Object embed = out.addObject("embed");
+        embed.addString("$type", "app.bsky.embed.external");
+        embed.addObject("external")
+            .addString("uri", record.external.uri)
+            .addString("title", record.external.title)
+            .addString("description", record.external.description);
+    }
+}
+
+const size_t BlueskyClient::MAX_WRITES_PER_REQUEST;
+
+static const char* writeActionType(BlueskyClient::WriteAction action) {
+    switch (action) {
+    case BlueskyClient::WriteAction_Create: return "com.atproto.repo.applyWrites#create";
+    case BlueskyClient::WriteAction_Update: return "com.atproto.repo.applyWrites#update";
+    case BlueskyClient::WriteAction_Delete: return "com.atproto.repo.applyWrites#delete";
+    }
+    return nullptr;
+}
+
+std::vector<BlueskyClient::WriteResult> BlueskyClient::applyWrites(const std::vector<WriteOp>& ops) {
+    WriteResult status = WriteResult();
+    status.error = Error_None;
+
+    std::shared_ptr<const Session> session = loadSession();
+    if (!session) {
+        status.error = Error_NotLoggedIn;
+        status.retryable = true;
+    }
+    else if (ops.empty() || ops.size() > MAX_WRITES_PER_REQUEST)
+        status.error = Error_BadInput;
+
+    if (status.error != Error_None)
+        return std::vector<WriteResult>(ops.size(), status);
+
+    BuilderLease builder(*this);
+
+    BlueskyJsonBuilder::Object root = builder->begin();
+    root.addString("repo", session->did);
+
+    BlueskyJsonBuilder::Array writes = root.addArray("writes");
+
+    for (const WriteOp& op : ops) {
+        const char* type = writeActionType(op.action);
+        if (!type) {
+            status.error = Error_BadInput;
+            break;
+        }
+
+        BlueskyJsonBuilder::Object write = writes.addObject();
+        write.addString("$type", type)
+            .addString("collection", op.collection);
+        if (!op.rkey.empty())
+            write.addString("rkey", op.rkey);
+
+        // Records are objects; "42" or "[]" fails here instead of at the server
+        if (op.action != WriteAction_Delete && !write.addJsonObject("value", op.record)) {
+            status.error = Error_BadInput;
+            break;
         }
+    }
 
-        yyjson_val* root = yyjson_doc_get_root(doc);
-        yyjson_val* feed = yyjson_obj_get(root, "feed");
+    const std::string& body = builder->finish();
+    if (status.error == Error_None && body.empty())
+        status.error = Error_BadInput;
 
-        unsigned postCount = yyjson_arr_size(feed);
+    if (status.error != Error_None)
+        return std::vector<WriteResult>(ops.size(), status);
 
-        if (feed && postCount > 0) {
-            result.posts.resize(postCount);
+    std::vector<WriteResult> results(ops.size(), status);
 
-            for (unsigned i = 0; i < postCount; i++) {
-                yyjson_val* arrEntry = yyjson_arr_get(feed, i);
+    int httpStatus = -1;
+    const Error error = makeJsonRequest(
+        RequestMethod_POST, "xrpc/com.atproto.repo.applyWrites",
+        QueryParams(),
+        body,
+        [&results](yyjson_val* root) {
+            // Servers that predate per-write results only report the commit
+            yyjson_arr_iter it = yyjson_arr_iter_with(yyjson_obj_get(root, "results"));
 
-                auto& outPost = result.posts[i];
+            for (WriteResult& result : results) {
+                yyjson_val* entry = yyjson_arr_iter_next(&it);
+                if (!entry)
+                    break;
 
-                yyjson_val* post = yyjson_obj_get(arrEntry, "post");
+                assignStr(result.uri, yyjson_obj_get(entry, "uri"));
+                assignStr(result.cid, yyjson_obj_get(entry, "cid"));
+                assignStr(result.validationStatus, yyjson_obj_get(entry, "validationStatus"));
+            }
+        },
+        RequestAuth_Access,
+        nullptr,
+        &httpStatus
+    );
 
-                outPost.uri = yyjson_get_str(yyjson_obj_get(post, "uri"));
-                outPost.cid = yyjson_get_str(yyjson_obj_get(post, "cid"));
+    // Even a failed request may have gone through
+    invalidateAuthorFeeds(*session);
 
-                outPost.replyCount = yyjson_get_uint(yyjson_obj_get(post, "replyCount"));
-                outPost.repostCount = yyjson_get_uint(yyjson_obj_get(post, "repostCount"));
-                outPost.likeCount = yyjson_get_uint(yyjson_obj_get(post, "likeCount"));
-                outPost.quoteCount = yyjson_get_uint(yyjson_obj_get(post, "quoteCount"));
+    // An unreadable 200 response still means the writes were applied
+    if (error == Error_ResponseFail) {
+        status.error = error;
+        // A 4xx, 429 included, is refused before anything is committed
+        status.retryable = httpStatus >= 400 && httpStatus < 500;
+        return std::vector<WriteResult>(ops.size(), status);
+    }
 
-                outPost.indexedAt = datetimeToTimeT(yyjson_get_str(yyjson_obj_get(post, "indexedAt")));
-            
-                yyjson_val* record = yyjson_obj_get(post, "record");
+    return results;
+}
 
-                outPost.createdAt = datetimeToTimeT(yyjson_get_str(yyjson_obj_get(record, "createdAt")));
+BlueskyClient::RecordResult BlueskyClient::getRecord(const std::string& repo, const std::string& collection, const std::string& rkey) {
+    RecordResult result { .error = Error_None };
+    if (repo.empty() || collection.empty() || rkey.empty()) {
+        result.error = Error_BadInput;
+        return result;
+    }
 
-                outPost.text = yyjson_get_str(yyjson_obj_get(record, "text"));
+    result.error = makeJsonRequest(
+        RequestMethod_GET, "xrpc/com.atproto.repo.getRecord",
+        { { "repo", repo }, { "collection", collection }, { "rkey", rkey } },
+        std::string(),
+        [&result](yyjson_val* root) {
+            assignStr(result.uri, yyjson_obj_get(root, "uri"));
+            assignStr(result.cid, yyjson_obj_get(root, "cid"));
+
+            size_t length = 0;
+            char* value = yyjson_val_write(yyjson_obj_get(root, "value"), YYJSON_WRITE_NOFLAG, &length);
+            if (value) {
+                result.value.assign(value, length);
+                free(value);
+            }
+        }
+    );
 
-                yyjson_val* author = yyjson_obj_get(post, "author");
+    return result;
+}
 
-                outPost.author.did = yyjson_get_str(yyjson_obj_get(author, "did"));
+static void decodeAuthor(yyjson_val* author, BlueskyClient::PostAuthor& out) {
+    yyjson_obj_iter it = yyjson_obj_iter_with(author);
+
+    yyjson_val* key;
+    while ((key = yyjson_obj_iter_next(&it))) {
+        yyjson_val* val = yyjson_obj_iter_get_val(key);
+
+        switch (yyjson_get_len(key)) {
+        case 3:
+            if (keyEquals(key, "did"))
+                assignStr(out.did, val);
+            break;
+        case 6:
+            if (keyEquals(key, "handle"))
+                assignStr(out.handle, val);
+            else if (keyEquals(key, "avatar"))
+                assignStr(out.avatarUrl, val);
+            else if (keyEquals(key, "viewer")) {
+                out.blockedByViewer = yyjson_is_true(yyjson_obj_get(val, "blockedBy"));
+                out.mutedByViewer = yyjson_is_true(yyjson_obj_get(val, "muted"));
+            }
+            break;
+        case 9:
+            if (keyEquals(key, "createdAt")) {
+                out.createdAtTime = BlueskyTimestamp::parse(yyjson_get_str(val), yyjson_get_len(val));
+                out.createdAt = out.createdAtTime.toTimeT();
+            }
+            break;
+        case 11:
+            if (keyEquals(key, "displayName"))
+                assignStr(out.displayName, val);
+            break;
+        }
+    }
+}
 
-                outPost.author.handle = yyjson_get_str(yyjson_obj_get(author, "handle"));
+static void decodeRecord(yyjson_val* record, BlueskyClient::Post& out) {
+    yyjson_obj_iter it = yyjson_obj_iter_with(record);
 
-                const char* displayName = yyjson_get_str(yyjson_obj_get(author, "displayName"));
-                if (displayName)
-                    outPost.author.displayName = displayName;
+    yyjson_val* key;
+    while ((key = yyjson_obj_iter_next(&it))) {
+        yyjson_val* val = yyjson_obj_iter_get_val(key);
 
-                const char* avatarUrl = yyjson_get_str(yyjson_obj_get(author, "avatar"));
-                if (avatarUrl)
-                    outPost.author.avatarUrl = avatarUrl;
+        if (keyEquals(key, "text"))
+            assignStr(out.text, val);
+        else if (keyEquals(key, "createdAt")) {
+            out.createdAtTime = BlueskyTimestamp::parse(yyjson_get_str(val), yyjson_get_len(val));
+            out.createdAt = out.createdAtTime.toTimeT();
+        }
+    }
+}
 
-                outPost.author.createdAt = datetimeToTimeT(yyjson_get_str(yyjson_obj_get(author, "createdAt")));
+static void decodePost(yyjson_val* post, BlueskyClient::Post& out) {
+    yyjson_obj_iter it = yyjson_obj_iter_with(post);
+
+    yyjson_val* key;
+    while ((key = yyjson_obj_iter_next(&it))) {
+        yyjson_val* val = yyjson_obj_iter_get_val(key);
+
+        switch (yyjson_get_len(key)) {
+        case 3:
+            if (keyEquals(key, "uri"))
+                assignStr(out.uri, val);
+            else if (keyEquals(key, "cid"))
+                assignStr(out.cid, val);
+            break;
+        case 6:
+            if (keyEquals(key, "author"))
+                decodeAuthor(val, out.author);
+            else if (keyEquals(key, "record"))
+                decodeRecord(val, out);
+            break;
+        case 9:
+            if (keyEquals(key, "likeCount"))
+                out.likeCount = (unsigned)yyjson_get_uint(val);
+            else if (keyEquals(key, "indexedAt")) {
+                out.indexedAtTime = BlueskyTimestamp::parse(yyjson_get_str(val), yyjson_get_len(val));
+                out.indexedAt = out.indexedAtTime.toTimeT();
             }
+            break;
+        case 10:
+            if (keyEquals(key, "replyCount"))
+                out.replyCount = (unsigned)yyjson_get_uint(val);
+            else if (keyEquals(key, "quoteCount"))
+                out.quoteCount = (unsigned)yyjson_get_uint(val);
+            break;
+        case 11:
+            if (keyEquals(key, "repostCount"))
+                out.repostCount = (unsigned)yyjson_get_uint(val);
+            break;
         }
-        yyjson_doc_free(doc);
     }
-    else
-        result.error = Error_ResponseFail;
+}
+
+// Walks the feed array and every post object exactly once
+static void decodeFeed(yyjson_val* root, BlueskyClient::PostsResult& result) {
+    yyjson_val* feed = nullptr;
+
+    yyjson_obj_iter it = yyjson_obj_iter_with(root);
+
+    yyjson_val* key;
+    while ((key = yyjson_obj_iter_next(&it))) {
+        yyjson_val* val = yyjson_obj_iter_get_val(key);
+
+        if (keyEquals(key, "feed"))
+            feed = val;
+        else if (keyEquals(key, "cursor"))
+            assignStr(result.cursor, val);
+    }
+
+    result.posts.reserve(yyjson_arr_size(feed));
 
+    yyjson_arr_iter feedIt = yyjson_arr_iter_with(feed);
+
+    yyjson_val* entry;
+    while ((entry = yyjson_arr_iter_next(&feedIt))) {
+        yyjson_val* post = yyjson_obj_get(entry, "post");
+        if (!yyjson_is_obj(post))
+            continue;
+
+        result.posts.emplace_back();
+        decodePost(post, result.posts.back());
+    }
+}
+
+BlueskyClient::PostsResult BlueskyClient::parseFeed(const std::string& json) {
+    PostsResult result { .error = Error_None };
+
+    yyjson_doc* doc = yyjson_read(json.c_str(), json.length(), 0);
+    if (!doc) {
+        result.error = Error_ResponseParseFail;
+        return result;
+    }
+
+    decodeFeed(yyjson_doc_get_root(doc), result);
+
+    yyjson_doc_free(doc);
     return result;
 }
 
-BlueskyClient::PostsResult BlueskyClient::getAuthorPosts(const std::string& atId, int limit) {
+void BlueskyClient::setRequestCoalescing(bool enabled, std::chrono::milliseconds window) {
+    m_flights->setWindow(enabled ? window : std::chrono::milliseconds(0));
+    m_coalesce = enabled;
+}
+
+void BlueskyClient::setResponseCache(std::shared_ptr<BlueskyResponseCache> cache) {
+    std::atomic_store(&m_cache, cache);
+}
+
+std::shared_ptr<BlueskyResponseCache> BlueskyClient::responseCache() const {
+    return std::atomic_load(&m_cache);
+}
+
+// Whether a result is worth caching
+static inline bool succeeded(const BlueskyClient::PostsResult& result) { return result.error == BlueskyClient::Error_None; }
+static inline bool succeeded(int count) { return count >= 0; }
+static inline bool succeeded(const std::string& body) { return !body.empty(); }
+
+// Memory a cached result holds, roughly: its structs and string contents
+static size_t resultBytes(const BlueskyClient::PostsResult& result) {
+    size_t bytes = sizeof(result) + result.cursor.size();
+
+    for (const BlueskyClient::Post& post : result.posts) {
+        bytes += sizeof(post) + post.uri.size() + post.cid.size() + post.text.size();
+        bytes += post.author.did.size() + post.author.handle.size() +
+            post.author.displayName.size() + post.author.avatarUrl.size();
+    }
+
+    return bytes;
+}
+static inline size_t resultBytes(int count) { return sizeof(count); }
+static inline size_t resultBytes(const std::string& body) { return sizeof(body) + body.size(); }
+
+std::string BlueskyClient::sharedKey(const char* kind, const std::string& path) const {
+    std::string key(kind);
+    key += ' ';
+    key += m_server_host;
+    key += path;
+    return key;
+}
+
+void BlueskyClient::invalidateAuthorFeeds(const Session& session) {
+    const std::shared_ptr<BlueskyResponseCache> cache = responseCache();
+    if (!cache)
+        return;
+
+    // Pages of every size and cursor, for every viewer, whether the feed was
+    // asked for by DID or by handle. actor sorts first among the params.
+    for (const char* kind : { "posts", "body" }) {
+        for (const std::string* actor : { &session.did, &session.handle }) {
+            if (actor->empty())
+                continue;
+
+            const std::string prefix = sharedKey(kind, requestPath("xrpc/app.bsky.feed.getAuthorFeed", { { "actor", *actor } }));
+            cache->erasePrefix(prefix + '&');
+            cache->erasePrefix(prefix + ' ');
+        }
+    }
+}
+
+template <typename Result>
+Result BlueskyClient::sharedGet(
+    const char* kind,
+    const std::string& endpoint,
+    const QueryParams& params,
+    const std::function<Result(Validators& validators)>& fetch
+) {
+    const std::shared_ptr<BlueskyResponseCache> cache = responseCache();
+    if (!m_coalesce && !cache) {
+        Validators validators;
+        return fetch(validators);
+    }
+
+    // Other accounts may see other results. A cache may be shared with
+    // clients for other servers, hence the host.
+    const std::shared_ptr<const Session> session = loadSession();
+
+    std::string key = sharedKey(kind, requestPath(endpoint, params));
+    key += ' ';
+    if (session)
+        key += session->did;
+
+    BlueskyResponseCache::Entry cached;
+    bool revalidate = false;
+    if (cache && cache->get(key, cached)) {
+        if (Clock::now() < cached.expiresAt) {
+            cache->recordHit();
+            return *std::static_pointer_cast<const Result>(cached.value);
+        }
+
+        revalidate = !cached.etag.empty();
+    }
+
+    const std::function<std::shared_ptr<const void>()> load = [&]() -> std::shared_ptr<const void> {
+        Validators validators;
+        if (revalidate)
+            validators.ifNoneMatch = cached.etag;
+
+        Result result = fetch(validators);
+        if (!cache)
+            return std::make_shared<Result>(std::move(result));
+
+        const Clock::time_point expiresAt = Clock::now() + cache->ttl(endpoint);
+
+        // Only answered with 304 when we sent an ETag, but never trust that
+        if (validators.notModified && cached.value) {
+            cache->recordRevalidated();
+
+            cached.expiresAt = expiresAt;
+            cache->put(key, cached);
+            return cached.value;
+        }
+
+        cache->recordMiss();
+
+        const bool keep = succeeded(result) && (expiresAt > Clock::now() || !validators.etag.empty());
+        const size_t bytes = keep ? key.size() + resultBytes(result) : 0;
+        const std::shared_ptr<const void> value = std::make_shared<Result>(std::move(result));
+
+        // Without a TTL or an ETag there would be no way to reuse it
+        if (keep) {
+            BlueskyResponseCache::Entry entry;
+            entry.value = value;
+            entry.etag = validators.etag;
+            entry.bytes = bytes;
+            entry.expiresAt = expiresAt;
+            cache->put(key, entry);
+        }
+
+        return value;
+    };
+
+    if (!m_coalesce)
+        return *std::static_pointer_cast<const Result>(load());
+
+    bool shared = false;
+    const std::shared_ptr<const void> result = m_flights->run(key, load, &shared);
+
+    if (shared)
+        m_coalesced++;
+
+    return *std::static_pointer_cast<const Result>(result);
+}
+
+static void addPageParams(std::multimap<std::string, std::string>& params, int limit, const std::string& cursor) {
+    params.emplace("limit", std::to_string(limit));
+    if (!cursor.empty())
+        params.emplace("cursor", cursor);
+}
+
+BlueskyClient::PostsResult BlueskyClient::fetchFeedPosts(
+    const std::string& endpoint,
+    QueryParams params,
+    int limit,
+    const std::string& cursor
+) {
     PostsResult result { .error = Error_None };
     if (!isLoggedIn()) {
         result.error = Error_NotLoggedIn;
         return result;
     }
 
-    std::map<std::string, std::string> params = {
-        { "actor", atId },
-        { "limit", std::to_string(limit) },
-        { "filter", "posts_no_replies" }
-    };
-    auto response = makeRequest(RequestMethod_GET, "xrpc/app.bsky.feed.getAuthorFeed", params);
+    addPageParams(params, limit, cursor);
 
-    if (!response.empty()) {
-        yyjson_doc* doc = yyjson_read(response.c_str(), response.length(), 0);
-        if (!doc) {
-            result.error = Error_ResponseParseFail;
-            return result;
-        }
+    return sharedGet<PostsResult>("posts", endpoint, params, [this, &endpoint, &params](Validators& validators) {
+        PostsResult result { .error = Error_None };
+        result.error = makeJsonRequest(
+            RequestMethod_GET, endpoint, params, std::string(),
+            [&result](yyjson_val* root) { decodeFeed(root, result); },
+            RequestAuth_Access, &validators
+        );
+
+        return result;
+    });
+}
+
+BlueskyClient::FeedView BlueskyClient::fetchFeedView(
+    const std::string& endpoint,
+    QueryParams params,
+    int limit,
+    const std::string& cursor
+) {
+    FeedView view;
+    if (!isLoggedIn()) {
+        view.m_error = Error_NotLoggedIn;
+        return view;
+    }
 
-        yyjson_val* root = yyjson_doc_get_root(doc);
-        yyjson_val* feed = yyjson_obj_get(root, "feed");
+    addPageParams(params, limit, cursor);
 
-        unsigned postCount = yyjson_arr_size(feed);
+    // The view outlives the connection, so it gets its own copy of the body
+    std::string response = makeRequest(RequestMethod_GET, endpoint, params);
+    if (response.empty()) {
+        view.m_error = Error_ResponseFail;
+        return view;
+    }
 
-        if (feed && postCount > 0) {
-            result.posts.resize(postCount);
+    return FeedView::parse(std::move(response));
+}
 
-            for (unsigned i = 0; i < postCount; i++) {
-                yyjson_val* arrEntry = yyjson_arr_get(feed, i);
+BlueskyClient::PostsResult BlueskyClient::getFeedPosts(const std::string& feedUri, int limit, const std::string& cursor) {
+    return fetchFeedPosts("xrpc/app.bsky.feed.getFeed", { { "feed", feedUri } }, limit, cursor);
+}
 
-                auto& outPost = result.posts[i];
+BlueskyClient::PostsResult BlueskyClient::getAuthorPosts(const std::string& atId, int limit, const std::string& cursor) {
+    return fetchFeedPosts(
+        "xrpc/app.bsky.feed.getAuthorFeed", { { "actor", atId }, { "filter", "posts_no_replies" } },
+        limit, cursor
+    );
+}
+
+BlueskyClient::FeedView BlueskyClient::getFeedPostsView(const std::string& feedUri, int limit, const std::string& cursor) {
+    return fetchFeedView("xrpc/app.bsky.feed.getFeed", { { "feed", feedUri } }, limit, cursor);
+}
 
-                yyjson_val* post = yyjson_obj_get(arrEntry, "post");
+BlueskyClient::FeedView BlueskyClient::getAuthorPostsView(const std::string& atId, int limit, const std::string& cursor) {
+    return fetchFeedView(
+        "xrpc/app.bsky.feed.getAuthorFeed", { { "actor", atId }, { "filter", "posts_no_replies" } },
+        limit, cursor
+    );
+}
 
-                outPost.uri = yyjson_get_str(yyjson_obj_get(post, "uri"));
-                outPost.cid = yyjson_get_str(yyjson_obj_get(post, "cid"));
+BlueskyClient::PostsResult BlueskyClient::getPosts(const std::vector<std::string>& uris) {
+    PostsResult result { .error = Error_None };
+    if (uris.empty() || uris.size() > MAX_HYDRATION_BATCH) {
+        result.error = Error_BadInput;
+        return result;
+    }
+    if (!isLoggedIn()) {
+        result.error = Error_NotLoggedIn;
+        return result;
+    }
 
-                outPost.replyCount = yyjson_get_uint(yyjson_obj_get(post, "replyCount"));
-                outPost.repostCount = yyjson_get_uint(yyjson_obj_get(post, "repostCount"));
-                outPost.likeCount = yyjson_get_uint(yyjson_obj_get(post, "likeCount"));
-                outPost.quoteCount = yyjson_get_uint(yyjson_obj_get(post, "quoteCount"));
+    QueryParams params;
+    for (const std::string& uri : uris)
+        params.emplace("uris", uri);
 
-                outPost.indexedAt = datetimeToTimeT(yyjson_get_str(yyjson_obj_get(post, "indexedAt")));
-            
-                yyjson_val* record = yyjson_obj_get(post, "record");
+    result.error = makeJsonRequest(
+        RequestMethod_GET, "xrpc/app.bsky.feed.getPosts", params, std::string(),
+        [&result](yyjson_val* root) {
+            yyjson_val* posts = yyjson_obj_get(root, "posts");
+            result.posts.reserve(yyjson_arr_size(posts));
 
-                outPost.createdAt = datetimeToTimeT(yyjson_get_str(yyjson_obj_get(record, "createdAt")));
+            yyjson_arr_iter it = yyjson_arr_iter_with(posts);
 
-                outPost.text = yyjson_get_str(yyjson_obj_get(record, "text"));
+            yyjson_val* post;
+            while ((post = yyjson_arr_iter_next(&it))) {
+                result.posts.emplace_back();
+                decodePost(post, result.posts.back());
+            }
+        }
+    );
 
-                yyjson_val* author = yyjson_obj_get(post, "author");
+    return result;
+}
 
-                outPost.author.did = yyjson_get_str(yyjson_obj_get(author, "did"));
+BlueskyClient::ProfilesResult BlueskyClient::getProfiles(const std::vector<std::string>& actors) {
+    ProfilesResult result { .error = Error_None };
+    if (actors.empty() || actors.size() > MAX_HYDRATION_BATCH) {
+        result.error = Error_BadInput;
+        return result;
+    }
+    if (!isLoggedIn()) {
+        result.error = Error_NotLoggedIn;
+        return result;
+    }
 
-                outPost.author.handle = yyjson_get_str(yyjson_obj_get(author, "handle"));
+    QueryParams params;
+    for (const std::string& actor : actors)
+        params.emplace("actors", actor);
 
-                const char* displayName = yyjson_get_str(yyjson_obj_get(author, "displayName"));
-                if (displayName)
-                    outPost.author.displayName = displayName;
+    result.error = makeJsonRequest(
+        RequestMethod_GET, "xrpc/app.bsky.actor.getProfiles", params, std::string(),
+        [&result](yyjson_val* root) {
+            yyjson_val* profiles = yyjson_obj_get(root, "profiles");
+            result.profiles.reserve(yyjson_arr_size(profiles));
 
-                const char* avatarUrl = yyjson_get_str(yyjson_obj_get(author, "avatar"));
-                if (avatarUrl)
-                    outPost.author.avatarUrl = avatarUrl;
+            yyjson_arr_iter it = yyjson_arr_iter_with(profiles);
 
-                outPost.author.createdAt = datetimeToTimeT(yyjson_get_str(yyjson_obj_get(author, "createdAt")));
+            yyjson_val* profile;
+            while ((profile = yyjson_arr_iter_next(&it))) {
+                result.profiles.emplace_back();
+                decodeAuthor(profile, result.profiles.back());
             }
         }
-        yyjson_doc_free(doc);
+    );
+
+    return result;
+}
+
+BlueskyClient::Error BlueskyClient::getRepo(const std::string& did, const DataHandler& onData) {
+    if (did.empty() || !onData)
+        return Error_BadInput;
+
+    const int status = performRequest(
+        RequestMethod_GET, "xrpc/com.atproto.sync.getRepo", { { "did", did } }, std::string(),
+        [](BlueskyConnection&) {}, RequestAuth_Access, onData
+    );
+
+    return status == 200 ? Error_None : Error_ResponseFail;
+}
+
+template <size_t N>
+static inline BlueskyClient::StringRef getStrRef(yyjson_val* obj, const char (&key)[N]) {
+    yyjson_val* val = yyjson_obj_getn(obj, key, N - 1);
+    if (!yyjson_is_str(val))
+        return BlueskyClient::StringRef();
+
+    return BlueskyClient::StringRef(yyjson_get_str(val), yyjson_get_len(val));
+}
+
+BlueskyClient::StringRef BlueskyClient::AuthorView::did() const { return getStrRef(m_author, "did"); }
+BlueskyClient::StringRef BlueskyClient::AuthorView::handle() const { return getStrRef(m_author, "handle"); }
+BlueskyClient::StringRef BlueskyClient::AuthorView::displayName() const { return getStrRef(m_author, "displayName"); }
+BlueskyClient::StringRef BlueskyClient::AuthorView::avatarUrl() const { return getStrRef(m_author, "avatar"); }
+
+template <size_t N>
+static inline BlueskyTimestamp getTimestamp(yyjson_val* obj, const char (&key)[N]) {
+    yyjson_val* val = yyjson_obj_getn(obj, key, N - 1);
+    return BlueskyTimestamp::parse(yyjson_get_str(val), yyjson_get_len(val));
+}
+
+time_t BlueskyClient::AuthorView::createdAt() const { return createdAtTime().toTimeT(); }
+BlueskyTimestamp BlueskyClient::AuthorView::createdAtTime() const { return getTimestamp(m_author, "createdAt"); }
+
+bool BlueskyClient::AuthorView::blockedByViewer() const {
+    return yyjson_is_true(yyjson_obj_get(yyjson_obj_get(m_author, "viewer"), "blockedBy"));
+}
+
+bool BlueskyClient::AuthorView::mutedByViewer() const {
+    return yyjson_is_true(yyjson_obj_get(yyjson_obj_get(m_author, "viewer"), "muted"));
+}
+
+BlueskyClient::PostAuthor BlueskyClient::AuthorView::toAuthor() const {
+    PostAuthor author = PostAuthor();
+    decodeAuthor(m_author, author);
+    return author;
+}
+
+BlueskyClient::StringRef BlueskyClient::PostView::uri() const { return getStrRef(m_post, "uri"); }
+BlueskyClient::StringRef BlueskyClient::PostView::cid() const { return getStrRef(m_post, "cid"); }
+BlueskyClient::StringRef BlueskyClient::PostView::text() const { return getStrRef(yyjson_obj_get(m_post, "record"), "text"); }
+
+BlueskyClient::AuthorView BlueskyClient::PostView::author() const {
+    return AuthorView(yyjson_obj_get(m_post, "author"));
+}
+
+time_t BlueskyClient::PostView::indexedAt() const { return indexedAtTime().toTimeT(); }
+time_t BlueskyClient::PostView::createdAt() const { return createdAtTime().toTimeT(); }
+
+BlueskyTimestamp BlueskyClient::PostView::indexedAtTime() const { return getTimestamp(m_post, "indexedAt"); }
+
+BlueskyTimestamp BlueskyClient::PostView::createdAtTime() const {
+    return getTimestamp(yyjson_obj_get(m_post, "record"), "createdAt");
+}
+
+unsigned int BlueskyClient::PostView::likeCount() const { return (unsigned)yyjson_get_uint(yyjson_obj_get(m_post, "likeCount")); }
+unsigned int BlueskyClient::PostView::quoteCount() const { return (unsigned)yyjson_get_uint(yyjson_obj_get(m_post, "quoteCount")); }
+unsigned int BlueskyClient::PostView::replyCount() const { return (unsigned)yyjson_get_uint(yyjson_obj_get(m_post, "replyCount")); }
+unsigned int BlueskyClient::PostView::repostCount() const { return (unsigned)yyjson_get_uint(yyjson_obj_get(m_post, "repostCount")); }
+
+BlueskyClient::Post BlueskyClient::PostView::toPost() const {
+    Post post = Post();
+    decodePost(m_post, post);
+    return post;
+}
+
+BlueskyClient::FeedView::FeedView()
+    : m_doc(nullptr)
+    , m_error(Error_None)
+{}
+
+BlueskyClient::FeedView::~FeedView() {
+    reset();
+}
+
+BlueskyClient::FeedView::FeedView(FeedView&& other)
+    : m_buffer(std::move(other.m_buffer))
+    , m_doc(other.m_doc)
+    , m_posts(std::move(other.m_posts))
+    , m_cursor(other.m_cursor)
+    , m_error(other.m_error)
+{
+    other.m_doc = nullptr;
+    other.reset();
+}
+
+BlueskyClient::FeedView& BlueskyClient::FeedView::operator=(FeedView&& other) {
+    if (this != &other) {
+        reset();
+
+        m_buffer = std::move(other.m_buffer);
+        m_doc = other.m_doc;
+        m_posts = std::move(other.m_posts);
+        m_cursor = other.m_cursor;
+        m_error = other.m_error;
+
+        other.m_doc = nullptr;
+        other.reset();
+    }
+    return *this;
+}
+
+void BlueskyClient::FeedView::reset() {
+    if (m_doc)
+        yyjson_doc_free(m_doc);
+
+    m_doc = nullptr;
+    m_buffer.reset();
+    m_posts.clear();
+    m_cursor = StringRef();
+}
+
+BlueskyClient::FeedView BlueskyClient::FeedView::parse(std::string json) {
+    FeedView view;
+
+    // The buffer lives on the heap so moving the view never moves the strings
+    // the document points into
+    const size_t length = json.size();
+    json.append(YYJSON_PADDING_SIZE, '\0');
+    view.m_buffer.reset(new std::string(std::move(json)));
+
+    view.m_doc = yyjson_read_opts(&(*view.m_buffer)[0], length, YYJSON_READ_INSITU, nullptr, nullptr);
+    if (!view.m_doc) {
+        view.m_error = Error_ResponseParseFail;
+        return view;
+    }
+
+    yyjson_val* root = yyjson_doc_get_root(view.m_doc);
+
+    view.m_cursor = getStrRef(root, "cursor");
+
+    yyjson_val* feed = yyjson_obj_get(root, "feed");
+    view.m_posts.reserve(yyjson_arr_size(feed));
+
+    yyjson_arr_iter feedIt = yyjson_arr_iter_with(feed);
+
+    yyjson_val* entry;
+    while ((entry = yyjson_arr_iter_next(&feedIt))) {
+        yyjson_val* post = yyjson_obj_get(entry, "post");
+        if (yyjson_is_obj(post))
+            view.m_posts.push_back(PostView(post));
     }
-    else
-        result.error = Error_ResponseFail;
+
+    return view;
+}
+
+BlueskyClient::PostsResult BlueskyClient::FeedView::toPostsResult() const {
+    PostsResult result { .error = m_error };
+    result.cursor = m_cursor.str();
+
+    result.posts.reserve(m_posts.size());
+    for (const PostView& post : m_posts)
+        result.posts.push_back(post.toPost());
 
     return result;
 }
@@ -330,42 +1266,78 @@ int BlueskyClient::getUnreadCount() {
     if (!isLoggedIn())
         return -1;
 
-    auto response = makeRequest(RequestMethod_GET, "xrpc/app.bsky.notification.getUnreadCount");
-    
-    if (!response.empty()) {
-        yyjson_doc* doc = yyjson_read(response.c_str(), response.length(), 0);
-        if (!doc)
-            return -1;
+    const std::string endpoint = "xrpc/app.bsky.notification.getUnreadCount";
 
-        yyjson_val* root = yyjson_doc_get_root(doc);
-        yyjson_val* count = yyjson_obj_get(root, "count");
-        
-        int result = yyjson_get_int(count);
+    return sharedGet<int>("count", endpoint, QueryParams(), [this, &endpoint](Validators& validators) {
+        int result = -1;
 
-        yyjson_doc_free(doc);
-        return result;
-    }
+        makeJsonRequest(
+            RequestMethod_GET, endpoint, QueryParams(), std::string(),
+            [&result](yyjson_val* root) { result = yyjson_get_int(yyjson_obj_get(root, "count")); },
+            RequestAuth_Access, &validators
+        );
 
-    return -1;
+        return result;
+    });
 }
 
 std::string BlueskyClient::makeRequest(
     RequestMethod method,
     const std::string& endpoint,
-    const std::map<std::string, std::string>& params,
+    const QueryParams& params,
     const std::string& body
 ) {
-    if (method >= RequestMethod_Max)
-        return "";
+    const std::function<std::string(Validators&)> fetch = [this, method, &endpoint, &params, &body](Validators& validators) {
+        std::string result;
 
-    httplib::Headers headers = {
-        { "User-Agent", USER_AGENT },
-        { "Content-Type", "application/json" }
+        performRequest(method, endpoint, params, body, [&result](BlueskyConnection& connection) {
+            result.assign(connection.body.data(), connection.bodyLength);
+        }, RequestAuth_Access, DataHandler(), &validators);
+
+        return result;
     };
-    
-    if (!m_access_token.empty())
-        headers.emplace("Authorization", m_access_token);
 
+    // Each caller gets its own copy, e.g. for a FeedView to parse in place
+    if (method == RequestMethod_GET && body.empty())
+        return sharedGet<std::string>("body", endpoint, params, fetch);
+
+    Validators validators;
+    return fetch(validators);
+}
+
+BlueskyClient::Error BlueskyClient::makeJsonRequest(
+    RequestMethod method,
+    const std::string& endpoint,
+    const QueryParams& params,
+    const std::string& body,
+    const std::function<void(yyjson_val* root)>& handler,
+    RequestAuth auth,
+    Validators* validators,
+    int* status
+) {
+    Error error = Error_ResponseFail;
+
+    const int code = performRequest(method, endpoint, params, body, [&error, &handler](BlueskyConnection& connection) {
+        yyjson_doc* doc = yyjson_read_opts(
+            &connection.body[0], connection.bodyLength, YYJSON_READ_INSITU, connection.alc, nullptr
+        );
+        if (!doc) {
+            error = Error_ResponseParseFail;
+            return;
+        }
+
+        handler(yyjson_doc_get_root(doc));
+
+        yyjson_doc_free(doc);
+        error = Error_None;
+    }, auth, DataHandler(), validators);
+
+    if (status)
+        *status = code;
+    return error;
+}
+
+std::string BlueskyClient::requestPath(const std::string& endpoint, const QueryParams& params) {
     std::ostringstream sstream;
 
     sstream << '/' << endpoint;
@@ -381,77 +1353,215 @@ std::string BlueskyClient::makeRequest(
         }
     }
 
-    httplib::Result response;
-    switch (method) {
-    case RequestMethod_GET:
-        response = m_client->Get(sstream.str(), headers);
-        break;
-    case RequestMethod_POST:
-        response = m_client->Post(sstream.str(), headers, body, "application/json");
-        break;
-    case RequestMethod_DELETE:
-        response = m_client->Delete(sstream.str(), headers, body, "application/json");
-        break;
-    
-    default:
-        return "";
-    }
-
-    if (response && response->status == 200)
-        return response->body;
-
-    return "";
+    return sstream.str();
 }
 
-std::string BlueskyClient::filterText(const std::string& str) {
-    static const std::unordered_map<wchar_t, char> replacements = {
-        { L'\u2018', '\'' }, // Left single quote
-        { L'\u2019', '\'' }, // Right single quote
-        { L'\u201C', '"'  }, // Left double quote
-        { L'\u201D', '"'  }  // Right double quote
+int BlueskyClient::performRequest(
+    RequestMethod method,
+    const std::string& endpoint,
+    const QueryParams& params,
+    const std::string& body,
+    const std::function<void(BlueskyConnection& connection)>& onSuccess,
+    RequestAuth auth,
+    const DataHandler& stream,
+    Validators* validators
+) {
+    if (method >= RequestMethod_Max)
+        return -1;
+
+    httplib::Headers headers = {
+        { "User-Agent", USER_AGENT },
+        { "Content-Type", "application/json" }
     };
 
-    std::string out;
-    out.reserve(str.size());
+    if (ACCEPT_ENCODING)
+        headers.emplace("Accept-Encoding", ACCEPT_ENCODING);
 
-    for (char c : str) {
-        auto it = replacements.find(c);
-        if (it != replacements.end())
-            out.push_back(it->second);
-        else if (c >= 32 && c <= 126) // Only keep printable ASCII
-            out.push_back(c);
-    }
+    if (validators && !validators->ifNoneMatch.empty())
+        headers.emplace("If-None-Match", validators->ifNoneMatch);
 
-    return out;
-}
+    const std::string path = requestPath(endpoint, params);
+    const BlueskyRateLimiter::EndpointClass endpointClass = BlueskyRateLimiter::classify(endpoint);
 
-std::vector<std::string> BlueskyClient::splitIntoWords(const std::string& str) {
-    std::vector<std::string> words;
-    std::istringstream ss(str);
+    unsigned rateLimitRetries = 0;
+    bool expiryRetried = false;
+    bool refreshed = false; // This attempt resends after a refresh
 
-    std::string word;
-    while (ss >> word) {
-        if (!word.empty())
-            words.push_back(word);
+    for (unsigned attempt = 0; ; attempt++) {
+        std::shared_ptr<const Session> session = loadSession();
+        if (auth == RequestAuth_Access && session) {
+            refreshSessionIfExpiring(session);
+            session = loadSession();
+        }
+
+        headers.erase("Authorization");
+        if (session) {
+            if (auth == RequestAuth_Refresh)
+                headers.emplace("Authorization", "Bearer " + session->refreshToken);
+            else
+                headers.emplace("Authorization", session->accessToken);
+        }
+
+        BlueskyMetrics::Sample sample;
+        sample.endpoint = endpoint;
+        sample.attempt = attempt;
+        sample.refreshRetry = refreshed;
+        refreshed = false;
+
+        const Clock::time_point start = Clock::now();
+
+        m_rate_limiter->acquire(endpointClass);
+
+        std::chrono::milliseconds retryDelay(0);
+        bool refreshFirst = false;
+        {
+            BlueskyConnectionPool::Lease connection = m_pool->acquire();
+            sample.micros[BlueskyMetrics::Phase_Wait] = elapsedMicros(start, Clock::now());
+
+            httplib::Result response = sendRequest(*connection, method, path, headers, body, stream, sample);
+            if (!response) {
+                sample.micros[BlueskyMetrics::Phase_Total] = elapsedMicros(start, Clock::now());
+                m_metrics->record(sample);
+                return -1;
+            }
+
+            m_rate_limiter->update(endpointClass, *response);
+            sample.status = response->status;
+
+            // The token expired earlier than its exp claim said, e.g. a
+            // session imported with a stale clock
+            const bool expired = (response->status == 400 || response->status == 401) &&
+                connection->body.find("ExpiredToken") != std::string::npos;
+
+            if (expired && auth == RequestAuth_Access && session && !expiryRetried) {
+                refreshFirst = true;
+                expiryRetried = true;
+            }
+            else if (response->status != 429 || rateLimitRetries >= MAX_RATE_LIMIT_RETRIES) {
+                if (validators) {
+                    validators->notModified = response->status == 304;
+                    if (response->status == 200)
+                        validators->etag = response->get_header_value("ETag");
+                }
+
+                if (response->status == 200) {
+                    const Clock::time_point parseStart = Clock::now();
+                    onSuccess(*connection);
+
+                    sample.micros[BlueskyMetrics::Phase_Parse] = elapsedMicros(parseStart, Clock::now());
+                    sample.bytesParsed = connection->bodyLength;
+                }
+
+                sample.micros[BlueskyMetrics::Phase_Total] = elapsedMicros(start, Clock::now());
+                m_metrics->record(sample);
+                return response->status;
+            }
+            else {
+                retryDelay = m_rate_limiter->backoff(rateLimitRetries++, *response);
+            }
+        }
+
+        sample.micros[BlueskyMetrics::Phase_Total] = elapsedMicros(start, Clock::now());
+        m_metrics->record(sample);
+
+        // Both happen without holding on to the connection
+        if (refreshFirst) {
+            if (!refreshSessionFrom(session))
+                return sample.status;
+
+            refreshed = true;
+        }
+        else {
+            std::this_thread::sleep_for(retryDelay);
+        }
     }
-    
-    return words;
 }
 
-std::string BlueskyClient::urlEncode(const std::string& str) {
-    std::string escaped;
+httplib::Result BlueskyClient::sendRequest(
+    BlueskyConnection& connection,
+    RequestMethod method,
+    const std::string& path,
+    const httplib::Headers& headers,
+    const std::string& body,
+    const DataHandler& stream,
+    BlueskyMetrics::Sample& sample
+) {
+    static const char* const methodNames[RequestMethod_Max] = { "GET", "POST", "DELETE" };
 
-    for (unsigned char c : str) {
-        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~')
-            escaped += c;
-        else if (c == ' ')
-            escaped += '+';
-        else {
-            escaped += '%';
-            escaped += "0123456789ABCDEF"[c / 16];
-            escaped += "0123456789ABCDEF"[c % 16];
+    // Let go of a buffer an unusually large response left behind
+    if (connection.body.capacity() > MAX_RETAINED_BODY_SIZE)
+        std::string().swap(connection.body);
+
+    connection.body.clear();
+    connection.bodyLength = 0;
+
+    httplib::Request request;
+    request.method = methodNames[method];
+    request.path = path;
+    request.headers = headers;
+    request.body = body;
+
+    sample.newConnection = !connection.client.is_socket_open();
+
+    const Clock::time_point sent = Clock::now();
+    Clock::time_point headersReceived = sent;
+
+    // Only successful responses are streamed; errors still land in the buffer
+    bool streaming = false;
+    size_t streamed = 0;
+
+    request.response_handler = [&](const httplib::Response& response) {
+        headersReceived = Clock::now();
+
+        streaming = stream && response.status == 200;
+        if (streaming)
+            return true;
+
+        // Content-Length of a compressed body says little about its decoded size
+        if (response.has_header("Content-Encoding"))
+            return true;
+
+        const size_t length = (size_t)std::strtoull(response.get_header_value("Content-Length").c_str(), nullptr, 10);
+        if (length > 0 && length <= MAX_RETAINED_BODY_SIZE)
+            connection.body.reserve(length + YYJSON_PADDING_SIZE);
+        return true;
+    };
+    request.content_receiver = [&](const char* data, size_t length, uint64_t, uint64_t) {
+        if (streaming) {
+            streamed += length;
+            return stream(data, length);
         }
+
+        connection.body.append(data, length);
+        return true;
+    };
+
+    httplib::Result response = connection.client.send(request);
+
+    const Clock::time_point received = Clock::now();
+    if (response) {
+        const BlueskyMetrics::Phase headerPhase =
+            sample.newConnection ? BlueskyMetrics::Phase_Connect : BlueskyMetrics::Phase_FirstByte;
+
+        sample.micros[headerPhase] = elapsedMicros(sent, headersReceived);
+        sample.micros[BlueskyMetrics::Phase_Transfer] = elapsedMicros(headersReceived, received);
     }
 
-    return escaped;
+    connection.bodyLength = connection.body.size();
+    sample.responseBytes = streaming ? streamed : connection.bodyLength;
+    connection.body.append(YYJSON_PADDING_SIZE, '\0');
+
+    return response;
+}
+
+std::string BlueskyClient::filterText(const std::string& str) {
+    return BlueskyText::toAscii(str);
+}
+
+std::vector<std::string> BlueskyClient::splitIntoWords(const std::string& str) {
+    return BlueskyText::splitWords(str);
+}
+
+std::string BlueskyClient::urlEncode(const std::string& str) {
+    return BlueskyText::urlEncode(str);
 }
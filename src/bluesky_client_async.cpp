@@ -0,0 +1,108 @@
+#include "bluesky_client.hpp"
+#include "bluesky_executor.hpp"
+
+BlueskyExecutor& BlueskyClient::executorLocked() {
+    if (!m_executor)
+        m_executor.reset(new BlueskyExecutor(m_worker_threads));
+
+    return *m_executor;
+}
+
+void BlueskyClient::postTask(std::function<void()> task, bool first) {
+    std::lock_guard<std::mutex> lock(m_executor_mutex);
+    if (first)
+        executorLocked().postFront(std::move(task));
+    else
+        executorLocked().post(std::move(task));
+}
+
+template <typename Fn>
+auto BlueskyClient::submitTask(Fn fn) -> std::future<decltype(fn())> {
+    std::lock_guard<std::mutex> lock(m_executor_mutex);
+    return executorLocked().submit(std::move(fn));
+}
+
+void BlueskyClient::drainExecutor() {
+    // A finishing call may queue another one (a session refresh) on a fresh
+    // executor, so keep going until none is left
+    for (;;) {
+        std::unique_ptr<BlueskyExecutor> executor;
+        {
+            std::lock_guard<std::mutex> lock(m_executor_mutex);
+            executor = std::move(m_executor);
+        }
+        if (!executor)
+            return;
+    }
+}
+
+void BlueskyClient::setWorkerThreads(unsigned threads) {
+    std::unique_ptr<BlueskyExecutor> previous;
+    {
+        std::lock_guard<std::mutex> lock(m_executor_mutex);
+        m_worker_threads = threads > 0 ? threads : 1;
+        previous = std::move(m_executor);
+    }
+    // Destroying the old executor outside the lock lets its pending calls
+    // finish while new calls start on a fresh one. Calls are only queued
+    // under the lock, so none can reach it any more.
+}
+
+std::future<bool> BlueskyClient::loginAsync(const std::string& identifier, const std::string& password) {
+    return submitTask([this, identifier, password] { return login(identifier, password); });
+}
+
+std::future<BlueskyClient::Error> BlueskyClient::createPostAsync(const std::string& text) {
+    return submitTask([this, text] { return createPost(text); });
+}
+
+std::future<BlueskyClient::PostsResult> BlueskyClient::getFeedPostsAsync(const std::string& feedUri, int limit, const std::string& cursor) {
+    return submitTask([this, feedUri, limit, cursor] { return getFeedPosts(feedUri, limit, cursor); });
+}
+
+std::future<BlueskyClient::PostsResult> BlueskyClient::getAuthorPostsAsync(const std::string& atId, int limit, const std::string& cursor) {
+    return submitTask([this, atId, limit, cursor] { return getAuthorPosts(atId, limit, cursor); });
+}
+
+std::future<int> BlueskyClient::getUnreadCountAsync() {
+    return submitTask([this] { return getUnreadCount(); });
+}
+
+void BlueskyClient::loginAsync(const std::string& identifier, const std::string& password, std::function<void(bool)> callback) {
+    postTask([this, identifier, password, callback] { callback(login(identifier, password)); });
+}
+
+void BlueskyClient::createPostAsync(const std::string& text, std::function<void(Error)> callback) {
+    postTask([this, text, callback] { callback(createPost(text)); });
+}
+
+void BlueskyClient::getFeedPostsAsync(const std::string& feedUri, int limit, const std::string& cursor, std::function<void(PostsResult)> callback) {
+    postTask([this, feedUri, limit, cursor, callback] { callback(getFeedPosts(feedUri, limit, cursor)); });
+}
+
+void BlueskyClient::getAuthorPostsAsync(const std::string& atId, int limit, const std::string& cursor, std::function<void(PostsResult)> callback) {
+    postTask([this, atId, limit, cursor, callback] { callback(getAuthorPosts(atId, limit, cursor)); });
+}
+
+void BlueskyClient::getUnreadCountAsync(std::function<void(int)> callback) {
+    postTask([this, callback] { callback(getUnreadCount()); });
+}
+
+std::vector<BlueskyClient::PostsResult> BlueskyClient::getAuthorPostsBatch(const std::vector<std::string>& atIds, int limit) {
+    std::vector<std::future<PostsResult>> futures;
+    futures.reserve(atIds.size());
+
+    // atIds outlives the calls, since they are all waited for below
+    for (const std::string& atId : atIds) {
+        const std::string* atIdPtr = &atId;
+        futures.push_back(submitTask([this, atIdPtr, limit] { return getAuthorPosts(*atIdPtr, limit); }));
+    }
+
+    std::vector<PostsResult> results;
+    results.reserve(futures.size());
+
+    for (auto& future : futures)
+        results.push_back(future.get());
+
+    return results;
+}
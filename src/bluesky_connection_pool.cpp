@@ -0,0 +1,61 @@
+#include "bluesky_connection_pool.hpp"
+
+#include <yyjson.h>
+
+BlueskyConnection::BlueskyConnection(const std::string& baseUrl)
+    : client(baseUrl)
+    , bodyLength(0)
+    , alc(yyjson_alc_dyn_new())
+{}
+
+BlueskyConnection::~BlueskyConnection() {
+    if (alc)
+        yyjson_alc_dyn_free(alc);
+}
+
+BlueskyConnectionPool::Lease::~Lease() {
+    if (m_pool && m_connection)
+        m_pool->release(std::move(m_connection));
+}
+
+BlueskyConnectionPool::BlueskyConnectionPool(const std::string& baseUrl, unsigned maxConnections)
+    : m_base_url(baseUrl)
+    , m_max_connections(maxConnections > 0 ? maxConnections : 1)
+    , m_open(0)
+{}
+
+BlueskyConnectionPool::~BlueskyConnectionPool() = default;
+
+BlueskyConnectionPool::Lease BlueskyConnectionPool::acquire() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_available.wait(lock, [this] { return !m_idle.empty() || m_open < m_max_connections; });
+
+    if (!m_idle.empty()) {
+        std::unique_ptr<Connection> connection = std::move(m_idle.back());
+        m_idle.pop_back();
+        return Lease(this, std::move(connection));
+    }
+
+    m_open++;
+    lock.unlock();
+
+    std::unique_ptr<Connection> connection(new Connection(m_base_url));
+
+    httplib::Client& client = connection->client;
+    client.set_connection_timeout(10);
+    client.set_read_timeout(10);
+    client.enable_server_certificate_verification(false);
+    client.set_follow_location(true);
+    client.set_keep_alive(true);
+    client.set_decompress(true);
+
+    return Lease(this, std::move(connection));
+}
+
+void BlueskyConnectionPool::release(std::unique_ptr<Connection> connection) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_idle.push_back(std::move(connection));
+    }
+    m_available.notify_one();
+}
@@ -0,0 +1,57 @@
+#include "bluesky_executor.hpp"
+
+BlueskyExecutor::BlueskyExecutor(unsigned threads)
+    : m_stopping(false)
+{
+    if (threads == 0)
+        threads = 1;
+
+    m_threads.reserve(threads);
+    for (unsigned i = 0; i < threads; i++)
+        m_threads.emplace_back(&BlueskyExecutor::run, this);
+}
+
+BlueskyExecutor::~BlueskyExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    for (auto& thread : m_threads)
+        thread.join();
+}
+
+void BlueskyExecutor::post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_wake.notify_one();
+}
+
+void BlueskyExecutor::postFront(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_front(std::move(task));
+    }
+    m_wake.notify_one();
+}
+
+void BlueskyExecutor::run() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+
+            if (m_tasks.empty())
+                return;
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        task();
+    }
+}
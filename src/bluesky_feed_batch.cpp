@@ -0,0 +1,381 @@
+#include "bluesky_feed_batch.hpp"
+
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BLUESKY_FEED_BATCH_X86 1
+#include <immintrin.h>
+#endif
+
+const BlueskyFeedBatch::AuthorId BlueskyFeedBatch::NO_AUTHOR;
+
+// Fields of an author in m_author_sizes
+enum AuthorField {
+    AuthorField_Did = 0,
+    AuthorField_Handle,
+    AuthorField_DisplayName,
+    AuthorField_AvatarUrl,
+    AuthorField_Count,
+};
+
+static void scoresScalar(
+    const uint32_t* likes, const uint32_t* reposts, const uint32_t* replies, const uint32_t* quotes,
+    size_t start, size_t count, const BlueskyFeedBatch::Weights& weights, float* out
+) {
+    for (size_t i = start; i < count; i++) {
+        out[i] = likes[i] * weights.likes + reposts[i] * weights.reposts +
+            replies[i] * weights.replies + quotes[i] * weights.quotes;
+    }
+}
+
+static size_t windowScalar(const int64_t* times, size_t start, size_t count, int64_t from, int64_t to, uint32_t* out) {
+    size_t found = 0;
+    for (size_t i = start; i < count; i++) {
+        out[found] = (uint32_t)i;
+        found += times[i] >= from && times[i] < to;
+    }
+
+    return found;
+}
+
+#if defined(BLUESKY_FEED_BATCH_X86)
+// Built for AVX2 regardless of compiler flags, only called when the CPU has it
+__attribute__((target("avx2")))
+static void scoresAvx2(
+    const uint32_t* likes, const uint32_t* reposts, const uint32_t* replies, const uint32_t* quotes,
+    size_t count, const BlueskyFeedBatch::Weights& weights, float* out
+) {
+    const __m256 likeWeight = _mm256_set1_ps(weights.likes);
+    const __m256 repostWeight = _mm256_set1_ps(weights.reposts);
+    const __m256 replyWeight = _mm256_set1_ps(weights.replies);
+    const __m256 quoteWeight = _mm256_set1_ps(weights.quotes);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // Counts stay far below 2^31, so the signed conversion is exact enough
+        __m256 score = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(likes + i))), likeWeight);
+        score = _mm256_add_ps(score,
+            _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(reposts + i))), repostWeight));
+        score = _mm256_add_ps(score,
+            _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(replies + i))), replyWeight));
+        score = _mm256_add_ps(score,
+            _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(quotes + i))), quoteWeight));
+
+        _mm256_storeu_ps(out + i, score);
+    }
+
+    scoresScalar(likes, reposts, replies, quotes, i, count, weights, out);
+}
+
+__attribute__((target("avx2")))
+static size_t windowAvx2(const int64_t* times, size_t count, int64_t from, int64_t to, uint32_t* out) {
+    const __m256i fromVec = _mm256_set1_epi64x(from);
+    const __m256i toVec = _mm256_set1_epi64x(to);
+
+    size_t found = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256i time = _mm256_loadu_si256((const __m256i*)(times + i));
+
+        // from <= time && time < to
+        const __m256i inside = _mm256_andnot_si256(
+            _mm256_cmpgt_epi64(fromVec, time), _mm256_cmpgt_epi64(toVec, time)
+        );
+
+        unsigned mask = (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(inside));
+        while (mask != 0) {
+            out[found++] = (uint32_t)(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    return found + windowScalar(times, i, count, from, to, out + found);
+}
+
+static bool hasAvx2() {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+#endif
+
+static std::vector<uint32_t> window(const std::vector<int64_t>& times, BlueskyTimestamp from, BlueskyTimestamp to) {
+    std::vector<uint32_t> indexes(times.size());
+
+    size_t found;
+#if defined(BLUESKY_FEED_BATCH_X86)
+    if (hasAvx2())
+        found = windowAvx2(times.data(), times.size(), from.microseconds(), to.microseconds(), indexes.data());
+    else
+#endif
+        found = windowScalar(times.data(), 0, times.size(), from.microseconds(), to.microseconds(), indexes.data());
+
+    indexes.resize(found);
+    return indexes;
+}
+
+BlueskyFeedBatch::BlueskyFeedBatch() {}
+
+void BlueskyFeedBatch::reserve(size_t posts) {
+    m_likes.reserve(posts);
+    m_reposts.reserve(posts);
+    m_replies.reserve(posts);
+    m_quotes.reserve(posts);
+    m_indexed_at.reserve(posts);
+    m_created_at.reserve(posts);
+    m_authors.reserve(posts);
+    m_string_offsets.reserve(posts);
+    m_uri_sizes.reserve(posts);
+    m_cid_sizes.reserve(posts);
+    m_text_sizes.reserve(posts);
+}
+
+void BlueskyFeedBatch::clear() {
+    m_likes.clear();
+    m_reposts.clear();
+    m_replies.clear();
+    m_quotes.clear();
+    m_indexed_at.clear();
+    m_created_at.clear();
+    m_authors.clear();
+
+    m_heap.clear();
+    m_string_offsets.clear();
+    m_uri_sizes.clear();
+    m_cid_sizes.clear();
+    m_text_sizes.clear();
+
+    m_author_offsets.clear();
+    m_author_sizes.clear();
+    m_author_ids.clear();
+}
+
+BlueskyFeedBatch::AuthorId BlueskyFeedBatch::internAuthor(
+    BlueskyClient::StringRef did,
+    BlueskyClient::StringRef handle,
+    BlueskyClient::StringRef displayName,
+    BlueskyClient::StringRef avatarUrl
+) {
+    // Consecutive posts are often by the same author
+    if (!m_authors.empty() && authorDid(m_authors.back()) == did)
+        return m_authors.back();
+
+    bool added;
+    const AuthorId id = m_author_ids.intern(did.data(), did.size(), added);
+    if (!added)
+        return id;
+
+    m_author_offsets.push_back(m_heap.size());
+    for (const BlueskyClient::StringRef& field : { did, handle, displayName, avatarUrl }) {
+        m_heap.append(field.data(), field.size());
+        m_author_sizes.push_back((uint32_t)field.size());
+    }
+
+    return id;
+}
+
+void BlueskyFeedBatch::appendStrings(
+    BlueskyClient::StringRef uri,
+    BlueskyClient::StringRef cid,
+    BlueskyClient::StringRef text
+) {
+    m_string_offsets.push_back(m_heap.size());
+
+    m_heap.append(uri.data(), uri.size());
+    m_heap.append(cid.data(), cid.size());
+    m_heap.append(text.data(), text.size());
+
+    m_uri_sizes.push_back((uint32_t)uri.size());
+    m_cid_sizes.push_back((uint32_t)cid.size());
+    m_text_sizes.push_back((uint32_t)text.size());
+}
+
+// Posts built by hand may only have the time_t fields
+static inline int64_t postTime(BlueskyTimestamp time, time_t fallback) {
+    if (time.valid())
+        return time.microseconds();
+
+    return fallback > 0 ? BlueskyTimestamp::fromTimeT(fallback).microseconds() : INT64_MIN;
+}
+
+static inline BlueskyClient::StringRef ref(const std::string& str) {
+    return BlueskyClient::StringRef(str.data(), str.size());
+}
+
+void BlueskyFeedBatch::append(const BlueskyClient::Post& post) {
+    const BlueskyClient::PostAuthor& author = post.author;
+    m_authors.push_back(internAuthor(ref(author.did), ref(author.handle), ref(author.displayName), ref(author.avatarUrl)));
+
+    m_likes.push_back(post.likeCount);
+    m_reposts.push_back(post.repostCount);
+    m_replies.push_back(post.replyCount);
+    m_quotes.push_back(post.quoteCount);
+
+    m_indexed_at.push_back(postTime(post.indexedAtTime, post.indexedAt));
+    m_created_at.push_back(postTime(post.createdAtTime, post.createdAt));
+
+    appendStrings(ref(post.uri), ref(post.cid), ref(post.text));
+}
+
+void BlueskyFeedBatch::append(const BlueskyClient::PostsResult& result) {
+    reserve(size() + result.posts.size());
+
+    for (const BlueskyClient::Post& post : result.posts)
+        append(post);
+}
+
+void BlueskyFeedBatch::append(const BlueskyClient::FeedView& page) {
+    reserve(size() + page.size());
+
+    for (const BlueskyClient::PostView& post : page.posts()) {
+        const BlueskyClient::AuthorView author = post.author();
+        m_authors.push_back(internAuthor(author.did(), author.handle(), author.displayName(), author.avatarUrl()));
+
+        m_likes.push_back(post.likeCount());
+        m_reposts.push_back(post.repostCount());
+        m_replies.push_back(post.replyCount());
+        m_quotes.push_back(post.quoteCount());
+
+        // Missing times are invalid timestamps, INT64_MIN
+        m_indexed_at.push_back(post.indexedAtTime().microseconds());
+        m_created_at.push_back(post.createdAtTime().microseconds());
+
+        appendStrings(post.uri(), post.cid(), post.text());
+    }
+}
+
+BlueskyClient::StringRef BlueskyFeedBatch::heapString(uint64_t offset, uint32_t size) const {
+    return BlueskyClient::StringRef(m_heap.data() + offset, size);
+}
+
+BlueskyClient::StringRef BlueskyFeedBatch::uri(size_t i) const {
+    return heapString(m_string_offsets[i], m_uri_sizes[i]);
+}
+
+BlueskyClient::StringRef BlueskyFeedBatch::cid(size_t i) const {
+    return heapString(m_string_offsets[i] + m_uri_sizes[i], m_cid_sizes[i]);
+}
+
+BlueskyClient::StringRef BlueskyFeedBatch::text(size_t i) const {
+    return heapString(m_string_offsets[i] + m_uri_sizes[i] + m_cid_sizes[i], m_text_sizes[i]);
+}
+
+BlueskyFeedBatch::AuthorId BlueskyFeedBatch::findAuthor(const std::string& did) const {
+    return m_author_ids.find(did);
+}
+
+static inline BlueskyClient::StringRef authorField(
+    const std::string& heap,
+    const std::vector<uint64_t>& offsets,
+    const std::vector<uint32_t>& sizes,
+    BlueskyFeedBatch::AuthorId id,
+    int field
+) {
+    const uint32_t* fieldSizes = &sizes[(size_t)id * AuthorField_Count];
+
+    uint64_t offset = offsets[id];
+    for (int i = 0; i < field; i++)
+        offset += fieldSizes[i];
+
+    return BlueskyClient::StringRef(heap.data() + offset, fieldSizes[field]);
+}
+
+BlueskyClient::StringRef BlueskyFeedBatch::authorDid(AuthorId id) const {
+    return authorField(m_heap, m_author_offsets, m_author_sizes, id, AuthorField_Did);
+}
+
+BlueskyClient::StringRef BlueskyFeedBatch::authorHandle(AuthorId id) const {
+    return authorField(m_heap, m_author_offsets, m_author_sizes, id, AuthorField_Handle);
+}
+
+BlueskyClient::StringRef BlueskyFeedBatch::authorDisplayName(AuthorId id) const {
+    return authorField(m_heap, m_author_offsets, m_author_sizes, id, AuthorField_DisplayName);
+}
+
+BlueskyClient::StringRef BlueskyFeedBatch::authorAvatarUrl(AuthorId id) const {
+    return authorField(m_heap, m_author_offsets, m_author_sizes, id, AuthorField_AvatarUrl);
+}
+
+BlueskyClient::Post BlueskyFeedBatch::post(size_t i) const {
+    BlueskyClient::Post post = BlueskyClient::Post();
+
+    post.uri = uri(i).str();
+    post.cid = cid(i).str();
+    post.text = text(i).str();
+
+    post.indexedAtTime = BlueskyTimestamp::fromMicroseconds(m_indexed_at[i]);
+    post.indexedAt = post.indexedAtTime.toTimeT();
+    post.createdAtTime = BlueskyTimestamp::fromMicroseconds(m_created_at[i]);
+    post.createdAt = post.createdAtTime.toTimeT();
+
+    post.likeCount = m_likes[i];
+    post.repostCount = m_reposts[i];
+    post.replyCount = m_replies[i];
+    post.quoteCount = m_quotes[i];
+
+    const AuthorId author = m_authors[i];
+    post.author.did = authorDid(author).str();
+    post.author.handle = authorHandle(author).str();
+    post.author.displayName = authorDisplayName(author).str();
+    post.author.avatarUrl = authorAvatarUrl(author).str();
+    post.author.createdAt = (time_t)(-1);
+
+    return post;
+}
+
+void BlueskyFeedBatch::scores(const Weights& weights, std::vector<float>& out) const {
+    out.resize(size());
+    if (out.empty())
+        return;
+
+#if defined(BLUESKY_FEED_BATCH_X86)
+    if (hasAvx2()) {
+        scoresAvx2(m_likes.data(), m_reposts.data(), m_replies.data(), m_quotes.data(), size(), weights, out.data());
+        return;
+    }
+#endif
+
+    scoresScalar(m_likes.data(), m_reposts.data(), m_replies.data(), m_quotes.data(), 0, size(), weights, out.data());
+}
+
+std::vector<uint32_t> BlueskyFeedBatch::topK(size_t k, const Weights& weights) const {
+    std::vector<float> score;
+    scores(weights, score);
+
+    std::vector<uint32_t> indexes(size());
+    for (size_t i = 0; i < indexes.size(); i++)
+        indexes[i] = (uint32_t)i;
+
+    k = std::min(k, indexes.size());
+
+    // Ties go to the earlier post, so the order is stable
+    std::partial_sort(indexes.begin(), indexes.begin() + k, indexes.end(), [&score](uint32_t a, uint32_t b) {
+        return score[a] > score[b] || (score[a] == score[b] && a < b);
+    });
+
+    indexes.resize(k);
+    return indexes;
+}
+
+std::vector<uint32_t> BlueskyFeedBatch::indexedBetween(BlueskyTimestamp from, BlueskyTimestamp to) const {
+    return window(m_indexed_at, from, to);
+}
+
+std::vector<uint32_t> BlueskyFeedBatch::createdBetween(BlueskyTimestamp from, BlueskyTimestamp to) const {
+    return window(m_created_at, from, to);
+}
+
+std::vector<BlueskyFeedBatch::AuthorTotals> BlueskyFeedBatch::authorTotals() const {
+    std::vector<AuthorTotals> totals(authorCount(), AuthorTotals());
+
+    const size_t count = size();
+    for (size_t i = 0; i < count; i++) {
+        AuthorTotals& author = totals[m_authors[i]];
+        author.posts++;
+        author.likes += m_likes[i];
+        author.reposts += m_reposts[i];
+        author.replies += m_replies[i];
+        author.quotes += m_quotes[i];
+    }
+
+    return totals;
+}
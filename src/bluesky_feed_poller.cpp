@@ -0,0 +1,172 @@
+#include "bluesky_feed_poller.hpp"
+
+#include <algorithm>
+
+// Largest limit getFeed and getAuthorFeed accept
+static const int MAX_PAGE_LIMIT = 100;
+
+static BlueskyFeedPoller::PageFetcher clientFetcher(
+    BlueskyClient& client,
+    BlueskyFeedStream::Source source,
+    const std::string& id
+) {
+    BlueskyClient* clientPtr = &client;
+
+    if (source == BlueskyFeedStream::Source_Feed) {
+        return [clientPtr, id](int limit, const std::string& cursor) {
+            return clientPtr->getFeedPostsView(id, limit, cursor);
+        };
+    }
+
+    return [clientPtr, id](int limit, const std::string& cursor) {
+        return clientPtr->getAuthorPostsView(id, limit, cursor);
+    };
+}
+
+BlueskyFeedPoller::BlueskyFeedPoller(
+    BlueskyClient& client,
+    BlueskyFeedStream::Source source,
+    const std::string& id,
+    int minLimit,
+    unsigned maxPages,
+    size_t seenCapacity
+)
+    : BlueskyFeedPoller(clientFetcher(client, source, id), minLimit, maxPages, seenCapacity)
+{}
+
+BlueskyFeedPoller::BlueskyFeedPoller(PageFetcher fetcher, int minLimit, unsigned maxPages, size_t seenCapacity)
+    : m_fetch(std::move(fetcher))
+    , m_min_limit(std::min(std::max(minLimit, 1), MAX_PAGE_LIMIT))
+    , m_max_pages(std::max(maxPages, 1u))
+    , m_limit(m_min_limit)
+    , m_polled(false)
+    , m_seen(seenCapacity)
+    , m_fetched(0)
+    , m_new(0)
+{}
+
+BlueskyFeedPoller::Walk BlueskyFeedPoller::walk(
+    std::string& cursor,
+    int limit,
+    unsigned maxPages,
+    const BlueskyTimestamp& floor,
+    const std::string& floorUri,
+    bool skipSeen,
+    Result& result,
+    BlueskyTimestamp& newest,
+    std::string& newestUri
+) {
+    for (unsigned pages = 1; ; pages++) {
+        const BlueskyClient::FeedView page = m_fetch(limit, cursor);
+        result.pages++;
+
+        if (page.error() != BlueskyClient::Error_None) {
+            result.error = page.error();
+            return Walk_Failed;
+        }
+
+        result.fetched += page.size();
+
+        bool reachedSeen = false;
+
+        // New posts are the ones in front of the first post of an earlier
+        // poll. The seen set recognizes those; the floor catches the ones it
+        // already forgot.
+        for (const BlueskyClient::PostView& post : page.posts()) {
+            const BlueskyClient::StringRef cid = post.cid();
+            const uint64_t hash = BlueskySeenSet::hash(cid.data(), cid.size());
+            const BlueskyTimestamp indexedAt = post.indexedAtTime();
+
+            if (floor.valid() && (indexedAt < floor || post.uri() == floorUri)) {
+                reachedSeen = true;
+                break;
+            }
+
+            if (m_seen.contains(hash)) {
+                if (skipSeen)
+                    continue;
+
+                reachedSeen = true;
+                break;
+            }
+
+            m_seen.insert(hash);
+
+            if (indexedAt > newest) {
+                newest = indexedAt;
+                newestUri = post.uri().str();
+            }
+
+            result.posts.push_back(post.toPost());
+        }
+
+        if (reachedSeen || page.size() == 0 || page.cursor().empty())
+            return Walk_Closed;
+
+        cursor = page.cursor().str();
+        if (pages == maxPages)
+            return Walk_OutOfPages;
+
+        // Every post was new, so there is a gap to the last poll; close it
+        // with full pages
+        limit = MAX_PAGE_LIMIT;
+    }
+}
+
+BlueskyFeedPoller::Result BlueskyFeedPoller::poll() {
+    Result result { .error = BlueskyClient::Error_None, .pages = 0, .fetched = 0, .complete = true };
+
+    const bool first = !m_polled;
+    BlueskyTimestamp newest = m_high_water;
+    std::string newestUri;
+
+    std::string cursor;
+    const Walk head = walk(
+        cursor, m_limit, first ? 1 : m_max_pages, m_high_water, m_high_water_uri, false,
+        result, newest, newestUri
+    );
+
+    if (head == Walk_Failed && result.pages > 1) {
+        // The posts above the failed page are seen now, so the next poll
+        // stops at them. It resumes here afterwards, down to where this poll
+        // should have stopped, or where an earlier unclosed gap would have.
+        if (m_gap_cursor.empty()) {
+            m_gap_floor = m_high_water;
+            m_gap_floor_uri = m_high_water_uri;
+        }
+        m_gap_cursor = cursor;
+        result.complete = false;
+    }
+    else if (head == Walk_OutOfPages && !first) {
+        result.complete = false;
+    }
+    else if (head == Walk_Closed && !m_gap_cursor.empty()) {
+        // Posts a later poll saw already may sit in the gap, so they are
+        // passed over instead of ending it, unless there is no floor to stop at
+        const Walk gap = walk(
+            m_gap_cursor, MAX_PAGE_LIMIT, m_max_pages, m_gap_floor, m_gap_floor_uri, m_gap_floor.valid(),
+            result, newest, newestUri
+        );
+
+        if (gap == Walk_Closed)
+            m_gap_cursor.clear();
+        else
+            result.complete = false;
+    }
+
+    if (result.error == BlueskyClient::Error_None)
+        m_polled = true;
+
+    if (newest > m_high_water) {
+        m_high_water = newest;
+        m_high_water_uri = newestUri;
+    }
+
+    // Size the next first page after this poll's new posts, with headroom
+    m_limit = std::min(std::max(m_min_limit, (int)result.posts.size() * 2), MAX_PAGE_LIMIT);
+
+    m_fetched += result.fetched;
+    m_new += result.posts.size();
+
+    return result;
+}
@@ -0,0 +1,96 @@
+#include "bluesky_feed_stream.hpp"
+
+BlueskyFeedStream::BlueskyFeedStream(
+    BlueskyClient& client,
+    Source source,
+    const std::string& id,
+    int pageSize,
+    unsigned maxQueuedPages,
+    const std::string& cursor
+)
+    : m_client(client)
+    , m_source(source)
+    , m_id(id)
+    , m_page_size(pageSize)
+    , m_max_queued(maxQueuedPages > 0 ? maxQueuedPages : 1)
+    , m_cursor(cursor)
+    , m_finished(false)
+    , m_stopped(false)
+{
+    m_thread = std::thread(&BlueskyFeedStream::run, this, cursor);
+}
+
+BlueskyFeedStream::~BlueskyFeedStream() {
+    stop();
+}
+
+bool BlueskyFeedStream::next(BlueskyClient::PostsResult& page) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_ready.wait(lock, [this] { return m_stopped || m_finished || !m_pages.empty(); });
+
+    if (m_stopped || m_pages.empty())
+        return false;
+
+    page = std::move(m_pages.front());
+    m_pages.pop_front();
+
+    if (page.error == BlueskyClient::Error_None)
+        m_cursor = page.cursor;
+
+    lock.unlock();
+    m_space.notify_one();
+
+    return true;
+}
+
+void BlueskyFeedStream::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+        m_pages.clear();
+    }
+    m_space.notify_all();
+    m_ready.notify_all();
+
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+std::string BlueskyFeedStream::cursor() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cursor;
+}
+
+void BlueskyFeedStream::run(std::string cursor) {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_space.wait(lock, [this] { return m_stopped || m_pages.size() < m_max_queued; });
+            if (m_stopped)
+                return;
+        }
+
+        BlueskyClient::PostsResult page = m_source == Source_Feed ?
+            m_client.getFeedPosts(m_id, m_page_size, cursor) :
+            m_client.getAuthorPosts(m_id, m_page_size, cursor);
+
+        // Feed generators may hand back a cursor with an empty page at the end
+        const bool last = page.error != BlueskyClient::Error_None ||
+            page.posts.empty() || page.cursor.empty() || page.cursor == cursor;
+
+        cursor = page.cursor;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopped)
+                return;
+
+            m_pages.push_back(std::move(page));
+            m_finished = last;
+        }
+        m_ready.notify_one();
+
+        if (last)
+            return;
+    }
+}
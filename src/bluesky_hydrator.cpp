@@ -0,0 +1,196 @@
+#include "bluesky_hydrator.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+BlueskyHydrator::BlueskyHydrator(
+    BlueskyClient& client,
+    std::chrono::milliseconds maxDelay,
+    size_t batchSize,
+    unsigned threads
+)
+    : m_client(client)
+    , m_max_delay(maxDelay)
+    , m_batch_size(std::min(std::max<size_t>(batchSize, 1), BlueskyClient::MAX_HYDRATION_BATCH))
+    , m_stop(false)
+{
+    const unsigned count = threads > 0 ? threads : 1;
+    for (unsigned i = 0; i < count; i++)
+        m_threads.emplace_back(&BlueskyHydrator::run, this);
+}
+
+BlueskyHydrator::~BlueskyHydrator() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for (std::thread& thread : m_threads)
+        thread.join();
+}
+
+std::future<BlueskyHydrator::PostResult> BlueskyHydrator::getPost(const std::string& uri) {
+    return enqueue(m_posts, uri);
+}
+
+std::future<BlueskyHydrator::ProfileResult> BlueskyHydrator::getProfile(const std::string& actor) {
+    return enqueue(m_profiles, actor);
+}
+
+template <typename Result>
+std::future<Result> BlueskyHydrator::enqueue(Queue<Result>& queue, const std::string& key) {
+    std::promise<Result> promise;
+    std::future<Result> future = promise.get_future();
+
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        std::vector<std::promise<Result>>& waiters = queue.waiters[key];
+        if (waiters.empty()) {
+            queue.order.emplace_back(key, Clock::now());
+
+            // A new deadline to wait for, or a full batch to send
+            wake = queue.order.size() == 1 || queue.order.size() >= m_batch_size;
+        }
+        waiters.push_back(std::move(promise));
+    }
+
+    if (wake)
+        m_wake.notify_one();
+
+    return future;
+}
+
+template <typename Result>
+bool BlueskyHydrator::ready(const Queue<Result>& queue, Clock::time_point now) const {
+    if (queue.order.empty())
+        return false;
+
+    return m_stop || queue.order.size() >= m_batch_size || now >= queue.order.front().second + m_max_delay;
+}
+
+template <typename Result>
+BlueskyHydrator::Batch<Result> BlueskyHydrator::take(Queue<Result>& queue) {
+    Batch<Result> batch;
+
+    const size_t count = std::min(queue.order.size(), m_batch_size);
+    batch.keys.reserve(count);
+    batch.waiters.reserve(count);
+
+    for (size_t i = 0; i < count; i++) {
+        const std::string& key = queue.order.front().first;
+
+        auto it = queue.waiters.find(key);
+        batch.keys.push_back(key);
+        batch.waiters.push_back(std::move(it->second));
+
+        queue.waiters.erase(it);
+        queue.order.pop_front();
+    }
+
+    return batch;
+}
+
+void BlueskyHydrator::sendPosts(Batch<PostResult>& batch) {
+    BlueskyClient::PostsResult response = m_client.getPosts(batch.keys);
+
+    std::unordered_map<std::string, BlueskyClient::Post*> byUri;
+    for (BlueskyClient::Post& post : response.posts)
+        byUri.emplace(post.uri, &post);
+
+    for (size_t i = 0; i < batch.keys.size(); i++) {
+        PostResult result = PostResult();
+        result.error = response.error;
+
+        if (response.error == BlueskyClient::Error_None) {
+            auto it = byUri.find(batch.keys[i]);
+            if (it != byUri.end())
+                result.post = *it->second;
+            else
+                result.error = BlueskyClient::Error_NotFound;
+        }
+
+        for (std::promise<PostResult>& waiter : batch.waiters[i])
+            waiter.set_value(result);
+    }
+}
+
+void BlueskyHydrator::sendProfiles(Batch<ProfileResult>& batch) {
+    BlueskyClient::ProfilesResult response = m_client.getProfiles(batch.keys);
+
+    // Actors may be asked for by DID or by handle
+    std::unordered_map<std::string, BlueskyClient::PostAuthor*> byActor;
+    for (BlueskyClient::PostAuthor& profile : response.profiles) {
+        byActor.emplace(profile.did, &profile);
+        byActor.emplace(profile.handle, &profile);
+    }
+
+    for (size_t i = 0; i < batch.keys.size(); i++) {
+        ProfileResult result = ProfileResult();
+        result.error = response.error;
+
+        if (response.error == BlueskyClient::Error_None) {
+            auto it = byActor.find(batch.keys[i]);
+
+            // Handles come back lowercase, whatever case they were asked in
+            if (it == byActor.end() && batch.keys[i].compare(0, 4, "did:") != 0) {
+                std::string handle = batch.keys[i];
+                std::transform(handle.begin(), handle.end(), handle.begin(), [](char c) {
+                    return (char)std::tolower((unsigned char)c);
+                });
+                it = byActor.find(handle);
+            }
+
+            if (it != byActor.end())
+                result.profile = *it->second;
+            else
+                result.error = BlueskyClient::Error_NotFound;
+        }
+
+        for (std::promise<ProfileResult>& waiter : batch.waiters[i])
+            waiter.set_value(result);
+    }
+}
+
+void BlueskyHydrator::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (;;) {
+        const Clock::time_point now = Clock::now();
+
+        if (ready(m_posts, now)) {
+            Batch<PostResult> batch = take(m_posts);
+
+            lock.unlock();
+            sendPosts(batch);
+            lock.lock();
+            continue;
+        }
+
+        if (ready(m_profiles, now)) {
+            Batch<ProfileResult> batch = take(m_profiles);
+
+            lock.unlock();
+            sendProfiles(batch);
+            lock.lock();
+            continue;
+        }
+
+        if (m_stop)
+            return;
+
+        // Sleep until the oldest pending lookup is due
+        Clock::time_point deadline = Clock::time_point::max();
+        if (!m_posts.order.empty())
+            deadline = std::min(deadline, m_posts.order.front().second + m_max_delay);
+        if (!m_profiles.order.empty())
+            deadline = std::min(deadline, m_profiles.order.front().second + m_max_delay);
+
+        if (deadline == Clock::time_point::max())
+            m_wake.wait(lock);
+        else
+            m_wake.wait_until(lock, deadline);
+    }
+}
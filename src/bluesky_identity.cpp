@@ -0,0 +1,269 @@
+#include "bluesky_identity.hpp"
+#include "bluesky_connection_pool.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include <yyjson.h>
+
+static const char* const PLC_DIRECTORY_URL = "https://plc.directory";
+
+// Handles are case-insensitive and often written with a leading @
+static std::string normalizeHandle(const std::string& handle) {
+    std::string normalized = handle;
+    if (!normalized.empty() && normalized[0] == '@')
+        normalized.erase(0, 1);
+
+    std::transform(normalized.begin(), normalized.end(), normalized.begin(), [](char c) {
+        return (char)std::tolower((unsigned char)c);
+    });
+
+    return normalized;
+}
+
+// did:web:example.com -> https://example.com/.well-known/did.json
+// did:web:example.com:u:alice -> https://example.com/u/alice/did.json
+static bool didWebLocation(const std::string& did, std::string& baseUrl, std::string& path) {
+    static const char PREFIX[] = "did:web:";
+    const std::string rest = did.substr(sizeof(PREFIX) - 1);
+    if (rest.empty())
+        return false;
+
+    const size_t hostEnd = rest.find(':');
+    std::string host = rest.substr(0, hostEnd);
+
+    // A port is percent-encoded in the DID
+    const size_t port = host.find("%3A");
+    if (port != std::string::npos)
+        host.replace(port, 3, ":");
+
+    baseUrl = "https://" + host;
+
+    if (hostEnd == std::string::npos) {
+        path = "/.well-known/did.json";
+        return true;
+    }
+
+    path = "/" + rest.substr(hostEnd + 1);
+    std::replace(path.begin(), path.end(), ':', '/');
+    path += "/did.json";
+
+    return true;
+}
+
+BlueskyIdentity::BlueskyIdentity(
+    const std::string& resolver,
+    size_t capacity,
+    std::chrono::seconds ttl,
+    std::chrono::seconds negativeTtl,
+    unsigned connectionsPerHost
+)
+    : m_resolver_url(resolver.find("://") != std::string::npos ? resolver : "https://" + resolver)
+    , m_ttl(ttl)
+    , m_negative_ttl(negativeTtl)
+    , m_connections_per_host(connectionsPerHost)
+    , m_handles(capacity)
+    , m_documents(capacity)
+{}
+
+BlueskyIdentity::~BlueskyIdentity() = default;
+
+bool BlueskyIdentity::isDid(const std::string& atId) {
+    return atId.compare(0, 4, "did:") == 0;
+}
+
+BlueskyClient::Error BlueskyIdentity::resolveHandle(const std::string& handle, std::string& did) {
+    const std::string key = normalizeHandle(handle);
+    if (key.empty())
+        return BlueskyClient::Error_BadInput;
+
+    bool found = false;
+    if (m_handles.get(key, did, found))
+        return found ? BlueskyClient::Error_None : BlueskyClient::Error_NotFound;
+
+    const Lookup<std::string> lookup = m_handle_flights.run(key, [this, &key] { return fetchHandle(key); });
+    if (lookup.error == BlueskyClient::Error_None)
+        did = lookup.value;
+
+    return lookup.error;
+}
+
+BlueskyClient::Error BlueskyIdentity::resolveDid(const std::string& did, DidDocument& document) {
+    if (!isDid(did))
+        return BlueskyClient::Error_BadInput;
+
+    bool found = false;
+    if (m_documents.get(did, document, found))
+        return found ? BlueskyClient::Error_None : BlueskyClient::Error_NotFound;
+
+    const Lookup<DidDocument> lookup = m_document_flights.run(did, [this, &did] { return fetchDidDocument(did); });
+    if (lookup.error == BlueskyClient::Error_None)
+        document = lookup.value;
+
+    return lookup.error;
+}
+
+BlueskyClient::Error BlueskyIdentity::resolve(const std::string& atId, DidDocument& document) {
+    if (isDid(atId))
+        return resolveDid(atId, document);
+
+    std::string did;
+    const BlueskyClient::Error error = resolveHandle(atId, did);
+    if (error != BlueskyClient::Error_None)
+        return error;
+
+    return resolveDid(did, document);
+}
+
+BlueskyClient* BlueskyIdentity::pdsClient(const std::string& atId) {
+    DidDocument document;
+    if (resolve(atId, document) != BlueskyClient::Error_None || document.pdsEndpoint.empty())
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(m_hosts_mutex);
+
+    std::unique_ptr<BlueskyClient>& client = m_pds_clients[document.pdsEndpoint];
+    if (!client)
+        client.reset(new BlueskyClient(document.pdsEndpoint, m_connections_per_host));
+
+    return client.get();
+}
+
+void BlueskyIdentity::invalidate(const std::string& atId) {
+    if (isDid(atId))
+        m_documents.erase(atId);
+    else
+        m_handles.erase(normalizeHandle(atId));
+}
+
+BlueskyIdentity::Lookup<std::string> BlueskyIdentity::fetchHandle(const std::string& handle) {
+    Lookup<std::string> lookup;
+
+    std::string body;
+    const int status = get(
+        m_resolver_url, "/xrpc/com.atproto.identity.resolveHandle?handle=" + BlueskyClient::urlEncode(handle), body
+    );
+
+    // The server answers 400 for handles that do not resolve; anything else
+    // may be transient and is not cached
+    if (status == 400 || status == 404) {
+        m_handles.putNegative(handle, m_negative_ttl);
+        lookup.error = BlueskyClient::Error_NotFound;
+        return lookup;
+    }
+    if (status != 200) {
+        lookup.error = BlueskyClient::Error_ResponseFail;
+        return lookup;
+    }
+
+    yyjson_doc* doc = yyjson_read(body.c_str(), body.length(), 0);
+    yyjson_val* did = yyjson_obj_get(yyjson_doc_get_root(doc), "did");
+
+    if (yyjson_is_str(did)) {
+        lookup.value = yyjson_get_str(did);
+        m_handles.put(handle, lookup.value, m_ttl);
+    }
+    else {
+        lookup.error = BlueskyClient::Error_ResponseParseFail;
+    }
+
+    yyjson_doc_free(doc);
+    return lookup;
+}
+
+BlueskyIdentity::Lookup<BlueskyIdentity::DidDocument> BlueskyIdentity::fetchDidDocument(const std::string& did) {
+    Lookup<DidDocument> lookup;
+
+    std::string baseUrl, path;
+    if (did.compare(0, 8, "did:plc:") == 0) {
+        baseUrl = PLC_DIRECTORY_URL;
+        path = "/" + did;
+    }
+    else if (did.compare(0, 8, "did:web:") != 0 || !didWebLocation(did, baseUrl, path)) {
+        lookup.error = BlueskyClient::Error_BadInput;
+        return lookup;
+    }
+
+    std::string body;
+    const int status = get(baseUrl, path, body);
+
+    // plc.directory answers 404 for unknown and 410 for tombstoned DIDs
+    if (status == 404 || status == 410) {
+        m_documents.putNegative(did, m_negative_ttl);
+        lookup.error = BlueskyClient::Error_NotFound;
+        return lookup;
+    }
+    if (status != 200) {
+        lookup.error = BlueskyClient::Error_ResponseFail;
+        return lookup;
+    }
+
+    yyjson_doc* doc = yyjson_read(body.c_str(), body.length(), 0);
+    if (!doc) {
+        lookup.error = BlueskyClient::Error_ResponseParseFail;
+        return lookup;
+    }
+
+    yyjson_val* root = yyjson_doc_get_root(doc);
+    DidDocument& document = lookup.value;
+
+    const char* id = yyjson_get_str(yyjson_obj_get(root, "id"));
+    document.did = id ? id : did;
+
+    size_t idx, max;
+    yyjson_val* value;
+
+    yyjson_arr_foreach(yyjson_obj_get(root, "alsoKnownAs"), idx, max, value) {
+        const char* alias = yyjson_get_str(value);
+        if (alias && std::strncmp(alias, "at://", 5) == 0) {
+            document.handle = alias + 5;
+            break;
+        }
+    }
+
+    yyjson_arr_foreach(yyjson_obj_get(root, "service"), idx, max, value) {
+        const char* serviceId = yyjson_get_str(yyjson_obj_get(value, "id"));
+        const char* endpoint = yyjson_get_str(yyjson_obj_get(value, "serviceEndpoint"));
+        if (!serviceId || !endpoint)
+            continue;
+
+        // The id is "#atproto_pds", or fully qualified with the DID in front
+        const size_t idLength = std::strlen(serviceId);
+        if (idLength >= 12 && std::strcmp(serviceId + idLength - 12, "#atproto_pds") == 0) {
+            document.pdsEndpoint = endpoint;
+            break;
+        }
+    }
+
+    yyjson_doc_free(doc);
+
+    m_documents.put(did, document, m_ttl);
+    return lookup;
+}
+
+int BlueskyIdentity::get(const std::string& baseUrl, const std::string& path, std::string& body) {
+    BlueskyConnectionPool::Lease connection = hostPool(baseUrl).acquire();
+
+    const httplib::Headers headers = {
+        { "User-Agent", BlueskyClient::USER_AGENT },
+        { "Accept", "application/json" }
+    };
+
+    httplib::Result response = connection->client.Get(path, headers);
+    if (!response)
+        return -1;
+
+    body = std::move(response->body);
+    return response->status;
+}
+
+BlueskyConnectionPool& BlueskyIdentity::hostPool(const std::string& baseUrl) {
+    std::lock_guard<std::mutex> lock(m_hosts_mutex);
+
+    std::unique_ptr<BlueskyConnectionPool>& pool = m_host_pools[baseUrl];
+    if (!pool)
+        pool.reset(new BlueskyConnectionPool(baseUrl, m_connections_per_host));
+
+    return *pool;
+}
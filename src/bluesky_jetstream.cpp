@@ -0,0 +1,428 @@
+#include "bluesky_jetstream.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <yyjson.h>
+
+static const char* const DEFAULT_ENDPOINT = "wss://jetstream2.us-east.bsky.network";
+static const char* const POST_COLLECTION = "app.bsky.feed.post";
+
+// Wait for the TCP and TLS handshakes of a connection attempt
+static const std::chrono::seconds CONNECT_TIMEOUT(10);
+
+BlueskyJetstream::Options::Options()
+    : endpoint(DEFAULT_ENDPOINT)
+    , cursor(0)
+    , workers(4)
+    , queueCapacity(4096)
+    , overflow(Overflow_Block)
+    , reconnectDelay(1000)
+    , maxReconnectDelay(30000)
+    , idleTimeout(60000)
+{}
+
+static uint64_t nowMicros() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+}
+
+// FNV-1a, to pick a worker by DID without copying it out of the frame
+static uint64_t hashBytes(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Finds the string value of a top-level field without parsing the frame.
+// Jetstream writes did and time_us first, so the search ends early.
+static bool scanString(const std::string& frame, const char* field, const char*& value, size_t& length) {
+    const size_t start = frame.find(field);
+    if (start == std::string::npos)
+        return false;
+
+    const size_t valueStart = start + std::strlen(field);
+    const size_t valueEnd = frame.find('"', valueStart);
+    if (valueEnd == std::string::npos)
+        return false;
+
+    value = frame.data() + valueStart;
+    length = valueEnd - valueStart;
+    return true;
+}
+
+static bool scanNumber(const std::string& frame, const char* field, uint64_t& value) {
+    const size_t start = frame.find(field);
+    if (start == std::string::npos)
+        return false;
+
+    value = 0;
+    size_t digits = 0;
+    for (size_t i = start + std::strlen(field); i < frame.size() && frame[i] >= '0' && frame[i] <= '9'; i++, digits++)
+        value = value * 10 + (uint64_t)(frame[i] - '0');
+
+    return digits > 0;
+}
+
+static inline void assignStr(std::string& out, yyjson_val* val) {
+    if (yyjson_is_str(val))
+        out.assign(yyjson_get_str(val), yyjson_get_len(val));
+    else
+        out.clear();
+}
+
+BlueskyJetstream::BlueskyJetstream(EventHandler handler, const Options& options)
+    : m_handler(std::move(handler))
+    , m_options(options)
+    , m_worker_capacity(std::max<size_t>(options.queueCapacity / std::max(options.workers, 1u), 1))
+    , m_running(false)
+    , m_stopping(false)
+    , m_connected(false)
+    , m_last_read(options.cursor)
+    , m_last_delivered(0)
+    , m_received(0)
+    , m_delivered(0)
+    , m_dropped(0)
+    , m_malformed(0)
+    , m_reconnects(0)
+    , m_queued(0)
+    , m_max_queued(0)
+{
+    for (unsigned i = 0; i < std::max(options.workers, 1u); i++)
+        m_workers.emplace_back(new Worker());
+}
+
+BlueskyJetstream::~BlueskyJetstream() {
+    stop();
+}
+
+void BlueskyJetstream::start() {
+    std::lock_guard<std::mutex> lock(m_state_mutex);
+    if (m_running)
+        return;
+
+    m_running = true;
+    m_stopping = false;
+
+    for (auto& worker : m_workers)
+        worker->thread = std::thread(&BlueskyJetstream::work, this, std::ref(*worker));
+
+    m_reader = std::thread(&BlueskyJetstream::read, this);
+}
+
+void BlueskyJetstream::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_state_mutex);
+        if (!m_running)
+            return;
+
+        m_running = false;
+        m_stopping = true;
+    }
+    m_state_changed.notify_all();
+    m_socket.interrupt();
+
+    for (auto& worker : m_workers) {
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+        }
+        worker->ready.notify_all();
+        worker->space.notify_all();
+    }
+
+    if (m_reader.joinable())
+        m_reader.join();
+
+    for (auto& worker : m_workers) {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+}
+
+uint64_t BlueskyJetstream::cursor() const {
+    uint64_t cursor = m_last_read;
+
+    for (const auto& worker : m_workers) {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+
+        if (worker->current != 0)
+            cursor = std::min(cursor, worker->current);
+        if (!worker->frames.empty())
+            cursor = std::min(cursor, worker->frames.front().timeUs);
+    }
+
+    return cursor;
+}
+
+BlueskyJetstream::Stats BlueskyJetstream::stats() const {
+    Stats stats;
+    stats.received = m_received;
+    stats.delivered = m_delivered;
+    stats.dropped = m_dropped;
+    stats.malformed = m_malformed;
+    stats.reconnects = m_reconnects;
+    stats.queued = m_queued;
+    stats.maxQueued = m_max_queued;
+    stats.connected = m_connected;
+
+    const uint64_t lastDelivered = m_last_delivered;
+    const uint64_t now = nowMicros();
+    stats.lagMicros = lastDelivered != 0 && now > lastDelivered ? now - lastDelivered : 0;
+
+    return stats;
+}
+
+std::string BlueskyJetstream::url(uint64_t cursor) const {
+    std::string url = m_options.endpoint;
+    if (!url.empty() && url.back() == '/')
+        url.pop_back();
+
+    url += "/subscribe";
+
+    char separator = '?';
+    for (const std::string& collection : m_options.collections) {
+        url += separator;
+        url += "wantedCollections=" + BlueskyClient::urlEncode(collection);
+        separator = '&';
+    }
+    for (const std::string& did : m_options.dids) {
+        url += separator;
+        url += "wantedDids=" + BlueskyClient::urlEncode(did);
+        separator = '&';
+    }
+    if (cursor != 0) {
+        url += separator;
+        url += "cursor=" + std::to_string(cursor);
+    }
+
+    return url;
+}
+
+bool BlueskyJetstream::backoff(std::chrono::milliseconds delay) {
+    std::unique_lock<std::mutex> lock(m_state_mutex);
+    return !m_state_changed.wait_for(lock, delay, [this] { return m_stopping.load(); });
+}
+
+void BlueskyJetstream::read() {
+    std::chrono::milliseconds delay = m_options.reconnectDelay;
+    std::string data;
+
+    for (bool first = true; !m_stopping; first = false) {
+        if (!first) {
+            m_reconnects++;
+            if (!backoff(delay))
+                break;
+            delay = std::min(delay * 2, m_options.maxReconnectDelay);
+        }
+
+        // Frames already queued will still be handled, so pick up right
+        // after the newest one read. The event at the cursor comes again.
+        const bool connected = m_socket.connect(url(m_last_read), CONNECT_TIMEOUT, m_options.idleTimeout);
+
+        // stop() may have run while connecting, before there was a socket to interrupt
+        if (!connected || m_stopping) {
+            m_socket.close();
+            continue;
+        }
+
+        m_connected = true;
+
+        while (!m_stopping && m_socket.read(data) == BlueskyWebSocket::Result_Message) {
+            delay = m_options.reconnectDelay;
+            if (!dispatch(data))
+                break;
+        }
+
+        m_connected = false;
+        m_socket.close();
+    }
+}
+
+bool BlueskyJetstream::dispatch(std::string& data) {
+    m_received++;
+
+    const char* did = nullptr;
+    size_t didLength = 0;
+    uint64_t timeUs = 0;
+
+    if (!scanString(data, "\"did\":\"", did, didLength) || !scanNumber(data, "\"time_us\":", timeUs)) {
+        m_malformed++;
+        return true;
+    }
+
+    Worker& worker = *m_workers[hashBytes(did, didLength) % m_workers.size()];
+
+    // data keeps its capacity for the next frame
+    Frame frame;
+    frame.data.reserve(data.size() + YYJSON_PADDING_SIZE);
+    frame.data.assign(data);
+    frame.data.append(YYJSON_PADDING_SIZE, '\0');
+    frame.timeUs = timeUs;
+
+    m_last_read = timeUs;
+
+    {
+        std::unique_lock<std::mutex> lock(worker.mutex);
+
+        if (worker.frames.size() >= m_worker_capacity) {
+            if (m_options.overflow == Overflow_Drop) {
+                m_dropped++;
+                return true;
+            }
+
+            worker.space.wait(lock, [this, &worker] {
+                return m_stopping || worker.frames.size() < m_worker_capacity;
+            });
+            if (m_stopping)
+                return false;
+        }
+
+        worker.frames.push_back(std::move(frame));
+    }
+    worker.ready.notify_one();
+
+    const size_t queued = ++m_queued;
+    size_t maxQueued = m_max_queued;
+    while (queued > maxQueued && !m_max_queued.compare_exchange_weak(maxQueued, queued)) {}
+
+    return true;
+}
+
+void BlueskyJetstream::work(Worker& worker) {
+    // Reused between frames so its strings keep their capacity
+    Event event;
+
+    for (;;) {
+        Frame frame;
+        {
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            worker.ready.wait(lock, [this, &worker] { return m_stopping || !worker.frames.empty(); });
+            if (m_stopping)
+                return;
+
+            frame = std::move(worker.frames.front());
+            worker.frames.pop_front();
+            worker.current = frame.timeUs;
+        }
+        worker.space.notify_one();
+        m_queued--;
+
+        if (decodeEvent(&frame.data[0], frame.data.size() - YYJSON_PADDING_SIZE, event)) {
+            m_handler(event);
+            m_delivered++;
+            m_last_delivered = event.timeUs;
+        }
+        else {
+            m_malformed++;
+        }
+
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.current = 0;
+    }
+}
+
+static void decodeCommit(yyjson_val* commit, BlueskyJetstream::Event& event) {
+    yyjson_val* operation = yyjson_obj_get(commit, "operation");
+    if (yyjson_equals_str(operation, "update"))
+        event.operation = BlueskyJetstream::Operation_Update;
+    else if (yyjson_equals_str(operation, "delete"))
+        event.operation = BlueskyJetstream::Operation_Delete;
+    else
+        event.operation = BlueskyJetstream::Operation_Create;
+
+    assignStr(event.collection, yyjson_obj_get(commit, "collection"));
+    assignStr(event.rkey, yyjson_obj_get(commit, "rkey"));
+    assignStr(event.rev, yyjson_obj_get(commit, "rev"));
+    assignStr(event.cid, yyjson_obj_get(commit, "cid"));
+
+    yyjson_val* record = yyjson_obj_get(commit, "record");
+    if (!yyjson_is_obj(record))
+        return;
+
+    size_t length = 0;
+    char* json = yyjson_val_write(record, YYJSON_WRITE_NOFLAG, &length);
+    if (json) {
+        event.record.assign(json, length);
+        free(json);
+    }
+
+    if (event.collection != POST_COLLECTION)
+        return;
+
+    BlueskyClient::Post& post = event.post;
+    post.uri = "at://" + event.did + "/" + event.collection + "/" + event.rkey;
+    post.cid = event.cid;
+    post.indexedAtTime = BlueskyTimestamp::fromMicroseconds((int64_t)event.timeUs);
+    post.indexedAt = post.indexedAtTime.toTimeT();
+    post.author.did = event.did;
+    assignStr(post.text, yyjson_obj_get(record, "text"));
+
+    yyjson_val* createdAt = yyjson_obj_get(record, "createdAt");
+    post.createdAtTime = BlueskyTimestamp::parse(yyjson_get_str(createdAt), yyjson_get_len(createdAt));
+    post.createdAt = post.createdAtTime.toTimeT();
+
+    event.isPost = true;
+}
+
+bool BlueskyJetstream::decodeEvent(char* frame, size_t size, Event& event) {
+    yyjson_doc* doc = yyjson_read_opts(frame, size, YYJSON_READ_INSITU, nullptr, nullptr);
+    if (!doc)
+        return false;
+
+    yyjson_val* root = yyjson_doc_get_root(doc);
+    yyjson_val* did = yyjson_obj_get(root, "did");
+    yyjson_val* timeUs = yyjson_obj_get(root, "time_us");
+    yyjson_val* kind = yyjson_obj_get(root, "kind");
+
+    if (!yyjson_is_str(did) || !yyjson_is_uint(timeUs) || !yyjson_is_str(kind)) {
+        yyjson_doc_free(doc);
+        return false;
+    }
+
+    assignStr(event.did, did);
+    event.timeUs = yyjson_get_uint(timeUs);
+    event.operation = Operation_Create;
+    event.collection.clear();
+    event.rkey.clear();
+    event.rev.clear();
+    event.cid.clear();
+    event.record.clear();
+    event.isPost = false;
+    event.post = BlueskyClient::Post();
+    event.handle.clear();
+    event.active = true;
+    event.status.clear();
+
+    bool ok = true;
+
+    if (yyjson_equals_str(kind, "commit")) {
+        event.kind = Kind_Commit;
+        yyjson_val* commit = yyjson_obj_get(root, "commit");
+        if (yyjson_is_obj(commit))
+            decodeCommit(commit, event);
+        else
+            ok = false;
+    }
+    else if (yyjson_equals_str(kind, "identity")) {
+        event.kind = Kind_Identity;
+        assignStr(event.handle, yyjson_obj_get(yyjson_obj_get(root, "identity"), "handle"));
+    }
+    else if (yyjson_equals_str(kind, "account")) {
+        event.kind = Kind_Account;
+        yyjson_val* account = yyjson_obj_get(root, "account");
+        event.active = !yyjson_is_bool(yyjson_obj_get(account, "active")) ||
+            yyjson_get_bool(yyjson_obj_get(account, "active"));
+        assignStr(event.status, yyjson_obj_get(account, "status"));
+    }
+    else {
+        ok = false;
+    }
+
+    yyjson_doc_free(doc);
+    return ok;
+}
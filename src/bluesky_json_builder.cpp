@@ -0,0 +1,132 @@
+#include "bluesky_json_builder.hpp"
+
+#include <cstdlib>
+
+#include <yyjson.h>
+
+BlueskyJsonBuilder::BlueskyJsonBuilder()
+    : m_alc(yyjson_alc_dyn_new())
+    , m_doc(nullptr)
+{}
+
+BlueskyJsonBuilder::~BlueskyJsonBuilder() {
+    releaseDocument();
+
+    if (m_alc)
+        yyjson_alc_dyn_free(m_alc);
+}
+
+void BlueskyJsonBuilder::releaseDocument() {
+    // Chunks freed by the document go back to the dynamic allocator's free
+    // list and are handed out again to the next document
+    if (m_doc)
+        yyjson_mut_doc_free(m_doc);
+
+    m_doc = nullptr;
+}
+
+BlueskyJsonBuilder::Object BlueskyJsonBuilder::begin() {
+    releaseDocument();
+
+    m_doc = yyjson_mut_doc_new(m_alc);
+
+    yyjson_mut_val* root = yyjson_mut_obj(m_doc);
+    yyjson_mut_doc_set_root(m_doc, root);
+
+    return Object(this, root);
+}
+
+const std::string& BlueskyJsonBuilder::finish() {
+    m_output.clear();
+
+    if (!m_doc)
+        return m_output;
+
+    size_t length = 0;
+    char* json = yyjson_mut_write_opts(m_doc, YYJSON_WRITE_NOFLAG, m_alc, &length, nullptr);
+    if (json) {
+        m_output.assign(json, length);
+
+        if (m_alc)
+            m_alc->free(m_alc->ctx, json);
+        else
+            free(json);
+    }
+
+    releaseDocument();
+    return m_output;
+}
+
+BlueskyJsonBuilder::Object& BlueskyJsonBuilder::Object::addString(const char* key, const std::string& value) {
+    yyjson_mut_obj_add_strncpy(m_builder->m_doc, m_val, key, value.data(), value.size());
+    return *this;
+}
+
+BlueskyJsonBuilder::Object& BlueskyJsonBuilder::Object::addString(const char* key, const char* value) {
+    yyjson_mut_obj_add_strcpy(m_builder->m_doc, m_val, key, value);
+    return *this;
+}
+
+BlueskyJsonBuilder::Object& BlueskyJsonBuilder::Object::addInt(const char* key, int64_t value) {
+    yyjson_mut_obj_add_int(m_builder->m_doc, m_val, key, value);
+    return *this;
+}
+
+BlueskyJsonBuilder::Object& BlueskyJsonBuilder::Object::addBool(const char* key, bool value) {
+    yyjson_mut_obj_add_bool(m_builder->m_doc, m_val, key, value);
+    return *this;
+}
+
+BlueskyJsonBuilder::Object BlueskyJsonBuilder::Object::addObject(const char* key) {
+    return Object(m_builder, yyjson_mut_obj_add_obj(m_builder->m_doc, m_val, key));
+}
+
+BlueskyJsonBuilder::Array BlueskyJsonBuilder::Object::addArray(const char* key) {
+    return Array(m_builder, yyjson_mut_obj_add_arr(m_builder->m_doc, m_val, key));
+}
+
+bool BlueskyJsonBuilder::Object::addJson(const char* key, const std::string& json) {
+    return addParsed(key, json, false);
+}
+
+bool BlueskyJsonBuilder::Object::addJsonObject(const char* key, const std::string& json) {
+    return addParsed(key, json, true);
+}
+
+bool BlueskyJsonBuilder::Object::addParsed(const char* key, const std::string& json, bool objectOnly) {
+    // Parsed with the builder's allocator so the temporary document reuses
+    // arena memory as well
+    yyjson_doc* parsed = yyjson_read_opts(
+        const_cast<char*>(json.c_str()), json.length(), YYJSON_READ_NOFLAG, m_builder->m_alc, nullptr
+    );
+    if (!parsed)
+        return false;
+
+    yyjson_val* root = yyjson_doc_get_root(parsed);
+    if (objectOnly && !yyjson_is_obj(root)) {
+        yyjson_doc_free(parsed);
+        return false;
+    }
+
+    yyjson_mut_val* copy = yyjson_val_mut_copy(m_builder->m_doc, root);
+    yyjson_doc_free(parsed);
+
+    if (!copy)
+        return false;
+
+    return yyjson_mut_obj_add_val(m_builder->m_doc, m_val, key, copy);
+}
+
+BlueskyJsonBuilder::Array& BlueskyJsonBuilder::Array::addString(const std::string& value) {
+    yyjson_mut_arr_add_strncpy(m_builder->m_doc, m_val, value.data(), value.size());
+    return *this;
+}
+
+BlueskyJsonBuilder::Array& BlueskyJsonBuilder::Array::addInt(int64_t value) {
+    yyjson_mut_arr_add_val(m_val, yyjson_mut_sint(m_builder->m_doc, value));
+    return *this;
+}
+
+BlueskyJsonBuilder::Object BlueskyJsonBuilder::Array::addObject() {
+    return Object(m_builder, yyjson_mut_arr_add_obj(m_builder->m_doc, m_val));
+}
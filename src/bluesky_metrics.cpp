@@ -0,0 +1,130 @@
+#include "bluesky_metrics.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+BlueskyMetrics::Histogram::Histogram()
+    : count(0)
+    , sum(0)
+    , max(0)
+{
+    std::memset(buckets, 0, sizeof(buckets));
+}
+
+void BlueskyMetrics::Histogram::add(uint64_t value) {
+    size_t bucket = 0;
+    while (bucket < BUCKETS - 1 && (value >> bucket) != 0)
+        bucket++;
+
+    buckets[bucket]++;
+    count++;
+    sum += value;
+    max = std::max(max, value);
+}
+
+uint64_t BlueskyMetrics::Histogram::quantile(double q) const {
+    if (count == 0)
+        return 0;
+
+    const uint64_t rank = (uint64_t)(std::min(std::max(q, 0.0), 1.0) * (count - 1));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen > rank)
+            return std::min(max, (uint64_t(1) << i) - 1);
+    }
+
+    return max;
+}
+
+BlueskyMetrics::Sample::Sample()
+    : status(-1)
+    , attempt(0)
+    , refreshRetry(false)
+    , newConnection(false)
+    , responseBytes(0)
+    , bytesParsed(0)
+{
+    std::memset(micros, 0, sizeof(micros));
+}
+
+BlueskyMetrics::EndpointStats::EndpointStats()
+    : requests(0)
+    , retries(0)
+    , refreshRetries(0)
+    , failures(0)
+    , newConnections(0)
+    , responseBytes(0)
+    , bytesParsed(0)
+{}
+
+BlueskyMetrics::BlueskyMetrics() = default;
+
+void BlueskyMetrics::record(const Sample& sample) {
+    std::shared_ptr<Sink> sink;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        EndpointStats& stats = m_stats[sample.endpoint];
+        stats.requests++;
+        if (sample.refreshRetry)
+            stats.refreshRetries++;
+        else if (sample.attempt > 0)
+            stats.retries++;
+        if (sample.status < 0)
+            stats.failures++;
+        if (sample.newConnection)
+            stats.newConnections++;
+
+        stats.responseBytes += sample.responseBytes;
+        stats.bytesParsed += sample.bytesParsed;
+        stats.statuses[sample.status]++;
+
+        // Zeros for phases that never ran would drag their quantiles down
+        stats.latency[Phase_Wait].add(sample.micros[Phase_Wait]);
+        stats.latency[Phase_Total].add(sample.micros[Phase_Total]);
+
+        if (sample.status >= 0) {
+            // Only one of the two header phases applies to an attempt
+            const Phase headers = sample.newConnection ? Phase_Connect : Phase_FirstByte;
+            stats.latency[headers].add(sample.micros[headers]);
+            stats.latency[Phase_Transfer].add(sample.micros[Phase_Transfer]);
+        }
+
+        // Only a successful response is parsed
+        if (sample.status == 200)
+            stats.latency[Phase_Parse].add(sample.micros[Phase_Parse]);
+
+        if (sample.status >= 0)
+            stats.responseSize.add(sample.responseBytes);
+
+        sink = m_sink;
+    }
+
+    if (sink)
+        sink->record(sample);
+}
+
+void BlueskyMetrics::setSink(std::shared_ptr<Sink> sink) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sink = std::move(sink);
+}
+
+BlueskyMetrics::Snapshot BlueskyMetrics::snapshot() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void BlueskyMetrics::reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.clear();
+}
+
+const char* BlueskyMetrics::phaseName(Phase phase) {
+    static const char* const names[Phase_Max] = {
+        "wait", "connect", "first_byte", "transfer", "parse", "total"
+    };
+
+    return phase < Phase_Max ? names[phase] : "";
+}
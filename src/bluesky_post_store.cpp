@@ -0,0 +1,797 @@
+#include "bluesky_post_store.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Files are written in host byte order
+
+// Log file: header, then records of
+//   uint32 payload size, uint32 FNV-1a checksum of the payload, payload
+static const char LOG_MAGIC[8] = { 'B', 'S', 'K', 'Y', 'P', 'O', 'S', 'T' };
+static const uint32_t LOG_VERSION = 1;
+static const uint64_t LOG_HEADER_SIZE = 16;
+static const uint64_t RECORD_HEADER_SIZE = 8;
+
+// Payload: six int64 times, four uint32 counts, a flags byte, then seven
+// strings as uint32 length and bytes, uri and cid first
+static const size_t FIXED_FIELDS_SIZE = 6 * 8 + 4 * 4 + 1;
+static const uint32_t MAX_RECORD_SIZE = 64 * 1024 * 1024;
+
+static const uint8_t FLAG_BLOCKED_BY_VIEWER = 0x01;
+static const uint8_t FLAG_MUTED_BY_VIEWER = 0x02;
+
+// The log is mapped in steps, past its end, so appends rarely remap
+static const uint64_t LOG_MAP_STEP = 64 * 1024 * 1024;
+
+// Index file: header, then an open-addressed table of slots, at most half
+// full. Every post has a slot for its CID and one for its URI.
+static const char INDEX_MAGIC[8] = { 'B', 'S', 'K', 'Y', 'I', 'D', 'X', '2' };
+static const uint64_t INITIAL_INDEX_CAPACITY = 4096;
+
+struct IndexHeader {
+    char magic[8];
+    uint64_t capacity; // Slots, a power of two
+    uint64_t entries; // Slots in use
+    uint64_t logSize; // Log bytes the index covers
+    uint64_t lastRecord; // Offset of the last record covered, 0 if none
+    uint64_t posts;
+    uint64_t syncedLogSize; // Log bytes known to be on disk, set only by sync()
+};
+
+struct IndexSlot {
+    uint64_t hash; // 0 marks an empty slot
+    uint64_t offset; // Of the record
+};
+
+static inline IndexHeader* indexHeader(char* index) { return (IndexHeader*)index; }
+static inline IndexSlot* indexSlots(char* index) { return (IndexSlot*)(index + sizeof(IndexHeader)); }
+
+static uint32_t checksum(const char* data, size_t size) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static uint64_t keyHash(int key, const char* data, size_t size) {
+    // FNV-1a over the key type and the key
+    uint64_t hash = 14695981039346656037ULL;
+    hash ^= (uint64_t)key;
+    hash *= 1099511628211ULL;
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash != 0 ? hash : 1;
+}
+
+static inline uint64_t homeSlot(uint64_t hash, uint64_t capacity) {
+    // Fibonacci hashing, the top bits of the product
+    return (hash * 0x9E3779B97F4A7C15ULL) >> (64 - __builtin_ctzll(capacity));
+}
+
+template <typename T>
+static inline void put(std::string& out, T value) {
+    out.append((const char*)&value, sizeof(value));
+}
+
+static inline void putString(std::string& out, const std::string& str) {
+    put(out, (uint32_t)str.size());
+    out += str;
+}
+
+template <typename T>
+static inline T get(const char*& p) {
+    T value;
+    std::memcpy(&value, p, sizeof(value));
+    p += sizeof(value);
+    return value;
+}
+
+static inline bool getString(const char*& p, const char* end, const char*& data, size_t& size) {
+    if (end - p < 4)
+        return false;
+
+    const uint32_t length = get<uint32_t>(p);
+    if ((size_t)(end - p) < length)
+        return false;
+
+    data = p;
+    size = length;
+    p += length;
+    return true;
+}
+
+static inline int64_t timestampUs(const BlueskyTimestamp& time) {
+    return time.valid() ? time.microseconds() : INT64_MIN;
+}
+
+static inline BlueskyTimestamp timestampFromUs(int64_t us) {
+    return us != INT64_MIN ? BlueskyTimestamp::fromMicroseconds(us) : BlueskyTimestamp();
+}
+
+static void encodeRecord(std::string& out, const BlueskyClient::Post& post) {
+    const size_t start = out.size();
+    out.append(RECORD_HEADER_SIZE, '\0');
+
+    put(out, (int64_t)post.indexedAt);
+    put(out, timestampUs(post.indexedAtTime));
+    put(out, (int64_t)post.createdAt);
+    put(out, timestampUs(post.createdAtTime));
+    put(out, (int64_t)post.author.createdAt);
+    put(out, timestampUs(post.author.createdAtTime));
+
+    put(out, (uint32_t)post.likeCount);
+    put(out, (uint32_t)post.quoteCount);
+    put(out, (uint32_t)post.replyCount);
+    put(out, (uint32_t)post.repostCount);
+
+    uint8_t flags = 0;
+    if (post.author.blockedByViewer)
+        flags |= FLAG_BLOCKED_BY_VIEWER;
+    if (post.author.mutedByViewer)
+        flags |= FLAG_MUTED_BY_VIEWER;
+    put(out, flags);
+
+    putString(out, post.uri);
+    putString(out, post.cid);
+    putString(out, post.text);
+    putString(out, post.author.did);
+    putString(out, post.author.handle);
+    putString(out, post.author.displayName);
+    putString(out, post.author.avatarUrl);
+
+    const uint32_t size = (uint32_t)(out.size() - start - RECORD_HEADER_SIZE);
+    const uint32_t sum = checksum(&out[start + RECORD_HEADER_SIZE], size);
+    std::memcpy(&out[start], &size, sizeof(size));
+    std::memcpy(&out[start + 4], &sum, sizeof(sum));
+}
+
+static bool decodeRecord(const char* payload, size_t size, BlueskyClient::Post& post) {
+    if (size < FIXED_FIELDS_SIZE)
+        return false;
+
+    const char* p = payload;
+    const char* end = payload + size;
+
+    post.indexedAt = (time_t)get<int64_t>(p);
+    post.indexedAtTime = timestampFromUs(get<int64_t>(p));
+    post.createdAt = (time_t)get<int64_t>(p);
+    post.createdAtTime = timestampFromUs(get<int64_t>(p));
+    post.author.createdAt = (time_t)get<int64_t>(p);
+    post.author.createdAtTime = timestampFromUs(get<int64_t>(p));
+
+    post.likeCount = get<uint32_t>(p);
+    post.quoteCount = get<uint32_t>(p);
+    post.replyCount = get<uint32_t>(p);
+    post.repostCount = get<uint32_t>(p);
+
+    const uint8_t flags = get<uint8_t>(p);
+    post.author.blockedByViewer = (flags & FLAG_BLOCKED_BY_VIEWER) != 0;
+    post.author.mutedByViewer = (flags & FLAG_MUTED_BY_VIEWER) != 0;
+
+    std::string* const strings[] = {
+        &post.uri, &post.cid, &post.text,
+        &post.author.did, &post.author.handle, &post.author.displayName, &post.author.avatarUrl,
+    };
+
+    for (std::string* str : strings) {
+        const char* data;
+        size_t length;
+        if (!getString(p, end, data, length))
+            return false;
+
+        str->assign(data, length);
+    }
+
+    return p == end;
+}
+
+// Size of the intact record at offset, 0 if it is torn or corrupt
+static uint32_t checkRecord(const char* log, uint64_t logSize, uint64_t offset) {
+    if (offset < LOG_HEADER_SIZE || logSize - offset < RECORD_HEADER_SIZE)
+        return 0;
+
+    const char* p = log + offset;
+    const uint32_t size = get<uint32_t>(p);
+    const uint32_t sum = get<uint32_t>(p);
+
+    if (size < FIXED_FIELDS_SIZE || size > MAX_RECORD_SIZE || logSize - offset - RECORD_HEADER_SIZE < size)
+        return 0;
+    if (checksum(p, size) != sum)
+        return 0;
+
+    // All seven strings have to fit
+    const char* end = p + size;
+    p += FIXED_FIELDS_SIZE;
+    for (int i = 0; i < 7; i++) {
+        const char* data;
+        size_t length;
+        if (!getString(p, end, data, length))
+            return 0;
+    }
+
+    return p == end ? size : 0;
+}
+
+BlueskyPostStore::BlueskyPostStore()
+    : m_log_fd(-1)
+    , m_log(nullptr)
+    , m_log_mapped(0)
+    , m_log_size(0)
+    , m_index_fd(-1)
+    , m_index(nullptr)
+    , m_index_size(0)
+{}
+
+BlueskyPostStore::~BlueskyPostStore() {
+    close();
+}
+
+bool BlueskyPostStore::fail(const std::string& message) {
+    m_error = message + ": " + std::strerror(errno);
+    return false;
+}
+
+bool BlueskyPostStore::open(const std::string& path) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    closeLocked();
+    m_error.clear();
+    m_path = path;
+
+    m_log_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_log_fd < 0)
+        return fail("cannot open " + path);
+
+    // Two writers would interleave appends and index updates. Held until
+    // the descriptor is closed.
+    if (flock(m_log_fd, LOCK_EX | LOCK_NB) != 0) {
+        if (errno == EWOULDBLOCK)
+            m_error = path + " is already open in another store";
+        else
+            fail("cannot lock " + path);
+
+        closeLocked();
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(m_log_fd, &st) != 0) {
+        fail("cannot stat " + path);
+        closeLocked();
+        return false;
+    }
+
+    m_log_size = (uint64_t)st.st_size;
+
+    if (m_log_size == 0) {
+        char header[LOG_HEADER_SIZE] = {};
+        std::memcpy(header, LOG_MAGIC, sizeof(LOG_MAGIC));
+        std::memcpy(header + sizeof(LOG_MAGIC), &LOG_VERSION, sizeof(LOG_VERSION));
+
+        if (pwrite(m_log_fd, header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+            fail("cannot write " + path);
+            closeLocked();
+            return false;
+        }
+
+        m_log_size = LOG_HEADER_SIZE;
+    }
+    else {
+        char header[LOG_HEADER_SIZE] = {};
+        if (m_log_size >= LOG_HEADER_SIZE && pread(m_log_fd, header, sizeof(header), 0) != (ssize_t)sizeof(header))
+            m_log_size = 0;
+
+        uint32_t version;
+        std::memcpy(&version, header + sizeof(LOG_MAGIC), sizeof(version));
+
+        if (m_log_size < LOG_HEADER_SIZE || std::memcmp(header, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 ||
+            version != LOG_VERSION) {
+            m_error = path + " is not a post store";
+            closeLocked();
+            return false;
+        }
+    }
+
+    if (!mapLog(m_log_size) || !openIndex() || !recover()) {
+        closeLocked();
+        return false;
+    }
+
+    return true;
+}
+
+void BlueskyPostStore::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    closeLocked();
+}
+
+void BlueskyPostStore::closeLocked() {
+    unmapIndex();
+
+    if (m_log)
+        munmap(m_log, m_log_mapped);
+    if (m_log_fd >= 0)
+        ::close(m_log_fd);
+
+    m_log = nullptr;
+    m_log_mapped = 0;
+    m_log_size = 0;
+    m_log_fd = -1;
+
+    m_pending.clear();
+    m_pending_cids.clear();
+}
+
+void BlueskyPostStore::unmapIndex() {
+    if (m_index)
+        munmap(m_index, m_index_size);
+    if (m_index_fd >= 0)
+        ::close(m_index_fd);
+
+    m_index = nullptr;
+    m_index_size = 0;
+    m_index_fd = -1;
+}
+
+bool BlueskyPostStore::isOpen() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return isOpenLocked();
+}
+
+bool BlueskyPostStore::mapLog(uint64_t size) {
+    if (size <= m_log_mapped)
+        return true;
+
+    // Pages past the end of the file are never touched
+    const uint64_t mapped = (size + LOG_MAP_STEP - 1) / LOG_MAP_STEP * LOG_MAP_STEP;
+    void* log = mmap(nullptr, mapped, PROT_READ, MAP_SHARED, m_log_fd, 0);
+    if (log == MAP_FAILED)
+        return fail("cannot map " + m_path);
+
+    if (m_log)
+        munmap(m_log, m_log_mapped);
+
+    m_log = (char*)log;
+    m_log_mapped = mapped;
+    return true;
+}
+
+bool BlueskyPostStore::openIndex() {
+    const std::string path = m_path + ".idx";
+
+    m_index_fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (m_index_fd < 0)
+        return createIndex(INITIAL_INDEX_CAPACITY, false);
+
+    struct stat st;
+    if (fstat(m_index_fd, &st) == 0 && (uint64_t)st.st_size > sizeof(IndexHeader)) {
+        m_index_size = (size_t)st.st_size;
+        void* index = mmap(nullptr, m_index_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_index_fd, 0);
+
+        if (index != MAP_FAILED) {
+            m_index = (char*)index;
+
+            const IndexHeader* header = indexHeader(m_index);
+            const uint64_t capacity = header->capacity;
+            if (std::memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+                capacity > 0 && (capacity & (capacity - 1)) == 0 &&
+                sizeof(IndexHeader) + capacity * sizeof(IndexSlot) == m_index_size &&
+                header->entries < capacity)
+                return true;
+        }
+    }
+
+    // Unreadable; it is rebuilt from the log
+    return createIndex(INITIAL_INDEX_CAPACITY, false);
+}
+
+bool BlueskyPostStore::createIndex(uint64_t capacity, bool rehash) {
+    const std::string path = m_path + ".idx";
+    const std::string tempPath = path + ".tmp";
+    const size_t size = sizeof(IndexHeader) + capacity * sizeof(IndexSlot);
+
+    const int fd = ::open(tempPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return fail("cannot create " + tempPath);
+
+    void* mapped = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) != 0 ||
+        (mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        fail("cannot size " + tempPath);
+        ::close(fd);
+        return false;
+    }
+
+    char* index = (char*)mapped;
+    IndexHeader* header = indexHeader(index);
+    std::memcpy(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header->capacity = capacity;
+    header->entries = 0;
+    header->logSize = LOG_HEADER_SIZE;
+    header->lastRecord = 0;
+    header->posts = 0;
+    header->syncedLogSize = LOG_HEADER_SIZE;
+
+    if (rehash && m_index) {
+        const IndexHeader* oldHeader = indexHeader(m_index);
+        const IndexSlot* oldSlots = indexSlots(m_index);
+
+        header->entries = oldHeader->entries;
+        header->logSize = oldHeader->logSize;
+        header->lastRecord = oldHeader->lastRecord;
+        header->posts = oldHeader->posts;
+        header->syncedLogSize = oldHeader->syncedLogSize;
+
+        IndexSlot* slots = indexSlots(index);
+        for (uint64_t i = 0; i < oldHeader->capacity; i++) {
+            if (oldSlots[i].hash == 0)
+                continue;
+
+            uint64_t slot = homeSlot(oldSlots[i].hash, capacity);
+            while (slots[slot].hash != 0)
+                slot = (slot + 1) & (capacity - 1);
+
+            slots[slot] = oldSlots[i];
+        }
+    }
+
+    // The new index has to be complete on disk before it replaces the old
+    if (msync(index, size, MS_SYNC) != 0 || rename(tempPath.c_str(), path.c_str()) != 0) {
+        fail("cannot write " + path);
+        munmap(index, size);
+        ::close(fd);
+        unlink(tempPath.c_str());
+        return false;
+    }
+
+    unmapIndex();
+    m_index = index;
+    m_index_size = size;
+    m_index_fd = fd;
+
+    return true;
+}
+
+bool BlueskyPostStore::recover() {
+    IndexHeader* header = indexHeader(m_index);
+
+    // Records before syncedLogSize were on disk when the index said so. The
+    // kernel may have written back later log pages in any order, so every
+    // record after it is checked, not only the last; an index that covers
+    // a torn record was flushed before the log was, and is started over.
+    bool intact = header->syncedLogSize >= LOG_HEADER_SIZE && header->syncedLogSize <= header->logSize &&
+        header->logSize <= m_log_size;
+
+    uint64_t checked = header->syncedLogSize;
+    while (intact && checked < header->logSize) {
+        const uint32_t size = checkRecord(m_log, m_log_size, checked);
+        if (size == 0)
+            intact = false;
+        else
+            checked += RECORD_HEADER_SIZE + size;
+    }
+    intact = intact && checked == header->logSize;
+
+    if (!intact && !createIndex(INITIAL_INDEX_CAPACITY, false))
+        return false;
+
+    // Index the records appended after the index was last written, up to
+    // the first one a crash tore
+    uint64_t offset = indexHeader(m_index)->logSize;
+    while (offset < m_log_size) {
+        const uint32_t size = checkRecord(m_log, m_log_size, offset);
+        if (size == 0)
+            break;
+
+        if (!indexRecord(offset))
+            return false;
+
+        header = indexHeader(m_index);
+        header->lastRecord = offset;
+        header->posts++;
+
+        offset += RECORD_HEADER_SIZE + size;
+        header->logSize = offset;
+    }
+
+    if (offset < m_log_size) {
+        if (ftruncate(m_log_fd, (off_t)offset) != 0)
+            return fail("cannot truncate " + m_path);
+
+        m_log_size = offset;
+    }
+
+    return true;
+}
+
+bool BlueskyPostStore::recordKey(uint64_t offset, Key key, const char*& data, size_t& size) const {
+    if (offset < LOG_HEADER_SIZE || offset >= m_log_size || m_log_size - offset < RECORD_HEADER_SIZE + FIXED_FIELDS_SIZE)
+        return false;
+
+    const char* p = m_log + offset;
+    const uint32_t payloadSize = get<uint32_t>(p);
+    p += 4; // Checksum
+
+    if (payloadSize < FIXED_FIELDS_SIZE || m_log_size - offset - RECORD_HEADER_SIZE < payloadSize)
+        return false;
+
+    const char* end = p + payloadSize;
+    p += FIXED_FIELDS_SIZE;
+
+    if (!getString(p, end, data, size))
+        return false;
+
+    return key == Key_Uri || getString(p, end, data, size);
+}
+
+uint64_t BlueskyPostStore::findLocked(Key key, const char* data, size_t size) const {
+    if (!isOpenLocked() || size == 0)
+        return 0;
+
+    IndexHeader* header = indexHeader(m_index);
+    const IndexSlot* slots = indexSlots(m_index);
+    const uint64_t hash = keyHash(key, data, size);
+
+    for (uint64_t slot = homeSlot(hash, header->capacity); slots[slot].hash != 0;
+         slot = (slot + 1) & (header->capacity - 1)) {
+        if (slots[slot].hash != hash)
+            continue;
+
+        // Slots may point past the log after a crash, or at a post whose key
+        // only shares the hash
+        const char* storedKey;
+        size_t storedSize;
+        if (recordKey(slots[slot].offset, key, storedKey, storedSize) &&
+            storedSize == size && std::memcmp(storedKey, data, size) == 0)
+            return slots[slot].offset;
+    }
+
+    return 0;
+}
+
+bool BlueskyPostStore::insertKey(Key key, const char* data, size_t size, uint64_t offset) {
+    if ((indexHeader(m_index)->entries + 1) * 2 > indexHeader(m_index)->capacity &&
+        !createIndex(indexHeader(m_index)->capacity * 2, true))
+        return false;
+
+    IndexHeader* header = indexHeader(m_index);
+    IndexSlot* slots = indexSlots(m_index);
+    const uint64_t hash = keyHash(key, data, size);
+
+    for (uint64_t slot = homeSlot(hash, header->capacity);; slot = (slot + 1) & (header->capacity - 1)) {
+        if (slots[slot].hash == 0) {
+            slots[slot].offset = offset;
+            slots[slot].hash = hash;
+            header->entries++;
+            return true;
+        }
+
+        // A key stored again points at its newest record
+        const char* storedKey;
+        size_t storedSize;
+        if (slots[slot].hash == hash && recordKey(slots[slot].offset, key, storedKey, storedSize) &&
+            storedSize == size && std::memcmp(storedKey, data, size) == 0) {
+            slots[slot].offset = offset;
+            return true;
+        }
+    }
+}
+
+bool BlueskyPostStore::indexRecord(uint64_t offset) {
+    const char* uri;
+    size_t uriSize;
+    const char* cid;
+    size_t cidSize;
+
+    if (!recordKey(offset, Key_Uri, uri, uriSize) || !recordKey(offset, Key_Cid, cid, cidSize))
+        return true;
+
+    if (uriSize > 0 && !insertKey(Key_Uri, uri, uriSize, offset))
+        return false;
+
+    return cidSize == 0 || insertKey(Key_Cid, cid, cidSize, offset);
+}
+
+bool BlueskyPostStore::stage(const BlueskyClient::Post& post) {
+    if (post.cid.empty() || findLocked(Key_Cid, post.cid.data(), post.cid.size()) != 0)
+        return false;
+
+    for (const std::string& cid : m_pending_cids) {
+        if (cid == post.cid)
+            return false;
+    }
+
+    encodeRecord(m_pending, post);
+    m_pending_cids.push_back(post.cid);
+    return true;
+}
+
+size_t BlueskyPostStore::commit() {
+    const size_t count = m_pending_cids.size();
+    if (count == 0)
+        return 0;
+
+    const std::string pending = std::move(m_pending);
+    m_pending.clear();
+    m_pending_cids.clear();
+
+    // One write for the whole batch; a torn one is cut off here or on the
+    // next open
+    size_t written = 0;
+    while (written < pending.size()) {
+        const ssize_t n = pwrite(m_log_fd, pending.data() + written, pending.size() - written,
+            (off_t)(m_log_size + written));
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n <= 0) {
+            fail("cannot append to " + m_path);
+
+            // Drop what made it, so the log ends on a whole record again
+            if (ftruncate(m_log_fd, (off_t)m_log_size) != 0)
+                m_error += ", nor truncate it";
+
+            return 0;
+        }
+
+        written += (size_t)n;
+    }
+
+    const uint64_t end = m_log_size + pending.size();
+    if (!mapLog(end))
+        return 0;
+
+    uint64_t offset = m_log_size;
+    m_log_size = end;
+
+    while (offset < end) {
+        uint32_t size;
+        std::memcpy(&size, m_log + offset, sizeof(size));
+
+        if (!indexRecord(offset))
+            break;
+
+        IndexHeader* header = indexHeader(m_index);
+        header->lastRecord = offset;
+        header->posts++;
+
+        offset += RECORD_HEADER_SIZE + size;
+        header->logSize = offset;
+    }
+
+    return count;
+}
+
+bool BlueskyPostStore::append(const BlueskyClient::Post& post) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!isOpenLocked() || !stage(post))
+        return false;
+
+    return commit() == 1;
+}
+
+size_t BlueskyPostStore::append(const BlueskyClient::PostsResult& result) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!isOpenLocked())
+        return 0;
+
+    for (const BlueskyClient::Post& post : result.posts)
+        stage(post);
+
+    return commit();
+}
+
+size_t BlueskyPostStore::append(const BlueskyClient::FeedView& page) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!isOpenLocked())
+        return 0;
+
+    for (const BlueskyClient::PostView& post : page.posts()) {
+        const BlueskyClient::StringRef cid = post.cid();
+        if (cid.empty() || findLocked(Key_Cid, cid.data(), cid.size()) != 0)
+            continue;
+
+        stage(post.toPost());
+    }
+
+    return commit();
+}
+
+bool BlueskyPostStore::containsUri(const char* uri, size_t size) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return findLocked(Key_Uri, uri, size) != 0;
+}
+
+bool BlueskyPostStore::containsCid(const char* cid, size_t size) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return findLocked(Key_Cid, cid, size) != 0;
+}
+
+bool BlueskyPostStore::findByUri(const std::string& uri, BlueskyClient::Post& post) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const uint64_t offset = findLocked(Key_Uri, uri.data(), uri.size());
+    if (offset == 0)
+        return false;
+
+    uint32_t size;
+    std::memcpy(&size, m_log + offset, sizeof(size));
+    return decodeRecord(m_log + offset + RECORD_HEADER_SIZE, size, post);
+}
+
+bool BlueskyPostStore::findByCid(const std::string& cid, BlueskyClient::Post& post) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const uint64_t offset = findLocked(Key_Cid, cid.data(), cid.size());
+    if (offset == 0)
+        return false;
+
+    uint32_t size;
+    std::memcpy(&size, m_log + offset, sizeof(size));
+    return decodeRecord(m_log + offset + RECORD_HEADER_SIZE, size, post);
+}
+
+void BlueskyPostStore::forEach(const PostHandler& handler) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!isOpenLocked())
+        return;
+
+    BlueskyClient::Post post = BlueskyClient::Post();
+
+    uint64_t offset = LOG_HEADER_SIZE;
+    while (offset < m_log_size) {
+        uint32_t size;
+        std::memcpy(&size, m_log + offset, sizeof(size));
+
+        if (!decodeRecord(m_log + offset + RECORD_HEADER_SIZE, size, post) || !handler(post))
+            return;
+
+        offset += RECORD_HEADER_SIZE + size;
+    }
+}
+
+bool BlueskyPostStore::sync() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!isOpenLocked())
+        return false;
+
+    if (fdatasync(m_log_fd) != 0)
+        return fail("cannot sync " + m_path);
+
+    // Only now is the log known to be on disk up to here
+    indexHeader(m_index)->syncedLogSize = indexHeader(m_index)->logSize;
+
+    if (msync(m_index, m_index_size, MS_SYNC) != 0)
+        return fail("cannot sync " + m_path + ".idx");
+
+    return true;
+}
+
+uint64_t BlueskyPostStore::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return isOpenLocked() ? indexHeader(m_index)->posts : 0;
+}
+
+uint64_t BlueskyPostStore::logBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_log_size;
+}
+
+std::string BlueskyPostStore::error() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_error;
+}
@@ -0,0 +1,182 @@
+#include "bluesky_rate_limiter.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+
+static const std::chrono::milliseconds BACKOFF_BASE(500);
+static const std::chrono::milliseconds BACKOFF_MAX(30000);
+
+// Returns false if the header is missing or not a number
+static bool headerToInt(const httplib::Response& response, const char* name, long long& out) {
+    if (!response.has_header(name))
+        return false;
+
+    const std::string value = response.get_header_value(name);
+
+    char* end = nullptr;
+    out = std::strtoll(value.c_str(), &end, 10);
+
+    return end != value.c_str();
+}
+
+BlueskyRateLimiter::EndpointClass BlueskyRateLimiter::classify(const std::string& endpoint) {
+    static const char* const sessionEndpoints[] = {
+        "com.atproto.server.createSession",
+        "com.atproto.server.refreshSession",
+    };
+    static const char* const writeEndpoints[] = {
+        "com.atproto.repo.createRecord",
+        "com.atproto.repo.putRecord",
+        "com.atproto.repo.deleteRecord",
+        "com.atproto.repo.applyWrites",
+        "com.atproto.repo.uploadBlob",
+    };
+
+    for (const char* name : sessionEndpoints) {
+        if (endpoint.find(name) != std::string::npos)
+            return EndpointClass_Session;
+    }
+    for (const char* name : writeEndpoints) {
+        if (endpoint.find(name) != std::string::npos)
+            return EndpointClass_Write;
+    }
+
+    return EndpointClass_Read;
+}
+
+BlueskyRateLimiter::BlueskyRateLimiter()
+    : m_random(std::random_device()())
+{
+    const Clock::time_point now = Clock::now();
+
+    for (Bucket& bucket : m_buckets) {
+        bucket.known = false;
+        bucket.resetPending = false;
+        bucket.capacity = 0;
+        bucket.tokens = 0;
+        bucket.refillPerSecond = 0;
+        bucket.refilledAt = now;
+        bucket.resetAt = now;
+    }
+}
+
+void BlueskyRateLimiter::refill(Bucket& bucket, Clock::time_point now) {
+    if (bucket.resetPending && now >= bucket.resetAt) {
+        // The server's window rolled over; callers still queued from the old
+        // window were scheduled for this moment and use up the new one
+        bucket.tokens = bucket.capacity + std::min(bucket.tokens, 0.0);
+        bucket.resetPending = false;
+    }
+    else {
+        const double elapsed = std::chrono::duration<double>(now - bucket.refilledAt).count();
+        bucket.tokens = std::min(bucket.capacity, bucket.tokens + elapsed * bucket.refillPerSecond);
+    }
+
+    bucket.refilledAt = now;
+}
+
+std::chrono::milliseconds BlueskyRateLimiter::reserve(EndpointClass endpointClass) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Bucket& bucket = m_buckets[endpointClass];
+    if (!bucket.known)
+        return std::chrono::milliseconds(0);
+
+    const Clock::time_point now = Clock::now();
+    refill(bucket, now);
+
+    // Tokens may go negative: that is the queue of callers already waiting
+    bucket.tokens -= 1;
+    if (bucket.tokens >= 0)
+        return std::chrono::milliseconds(0);
+
+    double waitSeconds = bucket.refillPerSecond > 0 ? -bucket.tokens / bucket.refillPerSecond : 0;
+
+    // A queue that fits into the next window only has to wait for the reset
+    if (bucket.resetPending && -bucket.tokens <= bucket.capacity) {
+        const double untilReset = std::chrono::duration<double>(bucket.resetAt - now).count();
+        if (bucket.refillPerSecond <= 0 || untilReset < waitSeconds)
+            waitSeconds = untilReset;
+    }
+
+    return std::chrono::milliseconds((long long)(waitSeconds * 1000));
+}
+
+void BlueskyRateLimiter::acquire(EndpointClass endpointClass) {
+    const std::chrono::milliseconds wait = reserve(endpointClass);
+    if (wait.count() > 0)
+        std::this_thread::sleep_for(wait);
+}
+
+void BlueskyRateLimiter::update(EndpointClass endpointClass, const httplib::Response& response) {
+    long long limit = 0, remaining = 0, reset = 0;
+
+    const bool hasLimit = headerToInt(response, "RateLimit-Limit", limit) && limit > 0;
+    const bool hasRemaining = headerToInt(response, "RateLimit-Remaining", remaining);
+    const bool hasReset = headerToInt(response, "RateLimit-Reset", reset);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Bucket& bucket = m_buckets[endpointClass];
+    const Clock::time_point now = Clock::now();
+
+    if (hasReset) {
+        // RateLimit-Reset is a Unix timestamp in seconds
+        const long long untilReset = std::max(0LL, reset - (long long)time(nullptr));
+        bucket.resetAt = now + std::chrono::seconds(untilReset);
+        bucket.resetPending = untilReset > 0;
+    }
+
+    if (hasLimit && hasRemaining) {
+        // RateLimit-Policy looks like "3000;w=300"; without it, assume the
+        // budget is spread over the time left until the reset
+        double windowSeconds = 0;
+
+        const std::string policy = response.get_header_value("RateLimit-Policy");
+        const size_t windowPos = policy.find("w=");
+        if (windowPos != std::string::npos)
+            windowSeconds = std::atof(policy.c_str() + windowPos + 2);
+        if (windowSeconds <= 0 && bucket.resetAt > now)
+            windowSeconds = std::chrono::duration<double>(bucket.resetAt - now).count();
+        if (windowSeconds <= 0)
+            windowSeconds = 1;
+
+        if (bucket.known)
+            refill(bucket, now);
+        else
+            bucket.tokens = (double)remaining;
+
+        bucket.known = true;
+        bucket.capacity = (double)limit;
+        bucket.refillPerSecond = limit / windowSeconds;
+        bucket.tokens = std::min(bucket.tokens, (double)remaining);
+        bucket.refilledAt = now;
+    }
+
+    if (response.status == 429 && bucket.known) {
+        bucket.tokens = std::min(bucket.tokens, 0.0);
+        bucket.refilledAt = now;
+    }
+}
+
+std::chrono::milliseconds BlueskyRateLimiter::backoff(unsigned attempt, const httplib::Response& response) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    long long retryAfter = 0;
+    if (headerToInt(response, "Retry-After", retryAfter) && retryAfter >= 0) {
+        // Spread out callers that were told the same instant
+        std::uniform_int_distribution<long long> jitter(0, 250);
+        return std::chrono::seconds(retryAfter) + std::chrono::milliseconds(jitter(m_random));
+    }
+
+    // Random delay in the upper half of an exponentially growing window
+    const long long cap = std::min<long long>(
+        BACKOFF_MAX.count(),
+        BACKOFF_BASE.count() << std::min(attempt, 16u)
+    );
+    std::uniform_int_distribution<long long> delay(cap / 2, cap);
+
+    return std::chrono::milliseconds(delay(m_random));
+}
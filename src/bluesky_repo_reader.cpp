@@ -0,0 +1,227 @@
+#include "bluesky_repo_reader.hpp"
+
+#include <cstring>
+#include <ctime>
+
+// Top-level keys that tell the kinds of repo blocks apart
+struct BlockShape {
+    std::string type; // $type of a record
+    bool hasEntries; // "e" of an MST node
+    bool hasLeft; // "l" of an MST node
+    bool hasDid; // "did" of a commit
+    bool hasData; // "data" of a commit
+
+    BlockShape() : hasEntries(false), hasLeft(false), hasDid(false), hasData(false) {}
+};
+
+static bool readShape(const uint8_t* data, size_t size, BlockShape& shape) {
+    BlueskyCborReader reader(data, size);
+
+    uint64_t entries = 0;
+    if (!reader.readMap(entries))
+        return false;
+
+    for (uint64_t i = 0; i < entries; i++) {
+        std::string key;
+        if (!reader.readText(key))
+            return false;
+
+        if (key == "$type") {
+            if (!reader.readText(shape.type))
+                return false;
+            continue;
+        }
+
+        if (key == "e")
+            shape.hasEntries = true;
+        else if (key == "l")
+            shape.hasLeft = true;
+        else if (key == "did")
+            shape.hasDid = true;
+        else if (key == "data")
+            shape.hasData = true;
+
+        if (!reader.skip())
+            return false;
+    }
+
+    return true;
+}
+
+BlueskyRepoReader::BlueskyRepoReader(PostHandler handler, bool verifyCids)
+    : m_handler(std::move(handler))
+    , m_car([this](const BlueskyCarReader::Block& block) { return onBlock(block); }, verifyCids)
+    , m_posts(0)
+{}
+
+bool BlueskyRepoReader::feed(const char* data, size_t size) {
+    return m_car.feed(data, size);
+}
+
+bool BlueskyRepoReader::finish() {
+    return m_car.finish();
+}
+
+std::string BlueskyRepoReader::uriOf(const std::string& cid) const {
+    auto it = m_paths.find(cid);
+    if (it == m_paths.end() || m_did.empty())
+        return std::string();
+
+    return "at://" + m_did + "/" + it->second;
+}
+
+bool BlueskyRepoReader::onBlock(const BlueskyCarReader::Block& block) {
+    // Raw blocks are blobs, not records
+    if (block.cid.codec != BlueskyCid::Codec_DagCbor)
+        return true;
+
+    BlockShape shape;
+    if (!readShape(block.data, block.size, shape))
+        return true; // Not a map, so not something we decode
+
+    if (shape.type == "app.bsky.feed.post")
+        return readPost(block.cid, block.data, block.size);
+    if (shape.type.empty() && shape.hasEntries && shape.hasLeft)
+        return readMstNode(block.data, block.size);
+    if (shape.type.empty() && shape.hasDid && shape.hasData)
+        return readCommit(block.data, block.size);
+
+    return true;
+}
+
+bool BlueskyRepoReader::readCommit(const uint8_t* data, size_t size) {
+    BlueskyCborReader reader(data, size);
+
+    uint64_t entries = 0;
+    reader.readMap(entries);
+
+    for (uint64_t i = 0; i < entries; i++) {
+        std::string key;
+        if (!reader.readText(key))
+            break;
+
+        if (key == "did") {
+            reader.readText(m_did);
+            break;
+        }
+        if (!reader.skip())
+            break;
+    }
+
+    return true;
+}
+
+bool BlueskyRepoReader::readMstNode(const uint8_t* data, size_t size) {
+    BlueskyCborReader reader(data, size);
+
+    uint64_t fields = 0;
+    if (!reader.readMap(fields))
+        return true;
+
+    for (uint64_t f = 0; f < fields; f++) {
+        std::string key;
+        if (!reader.readText(key))
+            return true;
+
+        if (key != "e") {
+            if (!reader.skip())
+                return true;
+            continue;
+        }
+
+        uint64_t count = 0;
+        if (!reader.readArray(count))
+            return true;
+
+        // Keys are prefix-compressed against the previous entry of the node
+        std::string path;
+
+        for (uint64_t e = 0; e < count; e++) {
+            uint64_t entryFields = 0;
+            if (!reader.readMap(entryFields))
+                return true;
+
+            int64_t prefix = 0;
+            std::string suffix;
+            BlueskyCid value;
+
+            for (uint64_t i = 0; i < entryFields; i++) {
+                std::string name;
+                if (!reader.readText(name))
+                    return true;
+
+                if (name == "p") {
+                    if (!reader.readInt(prefix))
+                        return true;
+                }
+                else if (name == "k") {
+                    BlueskyCborReader::Item item;
+                    if (!reader.read(item) || item.type != BlueskyCborReader::Type_Bytes)
+                        return true;
+                    suffix.assign((const char*)item.data, (size_t)item.value);
+                }
+                else if (name == "v") {
+                    if (!reader.readCid(value))
+                        return true;
+                }
+                else if (!reader.skip()) {
+                    return true;
+                }
+            }
+
+            if (prefix < 0 || (size_t)prefix > path.size())
+                return true;
+
+            path.resize((size_t)prefix);
+            path += suffix;
+
+            if (!value.empty())
+                m_paths[value.toString()] = path;
+        }
+    }
+
+    return true;
+}
+
+bool BlueskyRepoReader::readPost(const BlueskyCid& cid, const uint8_t* data, size_t size) {
+    BlueskyCborReader reader(data, size);
+
+    uint64_t entries = 0;
+    if (!reader.readMap(entries))
+        return true;
+
+    BlueskyClient::Post post = BlueskyClient::Post();
+    post.cid = cid.toString();
+    post.indexedAt = (time_t)(-1);
+    post.createdAt = (time_t)(-1);
+    post.author.did = m_did;
+    post.author.createdAt = (time_t)(-1);
+
+    for (uint64_t i = 0; i < entries; i++) {
+        std::string key;
+        if (!reader.readText(key))
+            return true;
+
+        if (key == "text") {
+            if (!reader.readText(post.text))
+                return true;
+        }
+        else if (key == "createdAt") {
+            std::string createdAt;
+            if (!reader.readText(createdAt))
+                return true;
+            post.createdAtTime = BlueskyTimestamp::parse(createdAt);
+            post.createdAt = post.createdAtTime.toTimeT();
+        }
+        else if (!reader.skip()) {
+            return true;
+        }
+    }
+
+    auto it = m_paths.find(post.cid);
+    if (it != m_paths.end() && !m_did.empty())
+        post.uri = "at://" + m_did + "/" + it->second;
+
+    m_posts++;
+    return m_handler(post);
+}
@@ -0,0 +1,138 @@
+#include "bluesky_response_cache.hpp"
+
+const size_t BlueskyResponseCache::DEFAULT_MAX_BYTES;
+
+BlueskyResponseCache::BlueskyResponseCache(size_t maxBytes, std::chrono::milliseconds defaultTtl)
+    : m_max_bytes(maxBytes)
+    , m_default_ttl(defaultTtl)
+    , m_bytes(0)
+    , m_stats()
+{}
+
+BlueskyResponseCache::~BlueskyResponseCache() {}
+
+void BlueskyResponseCache::setTtl(const std::string& endpoint, std::chrono::milliseconds ttl) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ttls[endpoint] = ttl;
+}
+
+std::chrono::milliseconds BlueskyResponseCache::ttl(const std::string& endpoint) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_ttls.find(endpoint);
+    return it != m_ttls.end() ? it->second : m_default_ttl;
+}
+
+bool BlueskyResponseCache::get(const std::string& key, Entry& entry) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_index.find(key);
+    if (it == m_index.end())
+        return false;
+
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    entry = it->second->entry;
+    return true;
+}
+
+void BlueskyResponseCache::put(const std::string& key, const Entry& entry) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_index.find(key);
+
+    // Would push out everything else and still not fit
+    if (entry.bytes > m_max_bytes) {
+        if (it != m_index.end()) {
+            m_bytes -= it->second->entry.bytes;
+            m_entries.erase(it->second);
+            m_index.erase(it);
+        }
+        return;
+    }
+
+    if (it != m_index.end()) {
+        m_bytes -= it->second->entry.bytes;
+        it->second->entry = entry;
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+    }
+    else {
+        Node node = { key, entry };
+        m_entries.push_front(std::move(node));
+        m_index.emplace(key, m_entries.begin());
+    }
+
+    m_bytes += entry.bytes;
+    evictLocked();
+}
+
+void BlueskyResponseCache::evictLocked() {
+    while (m_bytes > m_max_bytes && !m_entries.empty()) {
+        m_bytes -= m_entries.back().entry.bytes;
+        m_index.erase(m_entries.back().key);
+        m_entries.pop_back();
+        m_stats.evictions++;
+    }
+}
+
+void BlueskyResponseCache::erase(const std::string& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_index.find(key);
+    if (it == m_index.end())
+        return;
+
+    m_bytes -= it->second->entry.bytes;
+    m_entries.erase(it->second);
+    m_index.erase(it);
+}
+
+void BlueskyResponseCache::erasePrefix(const std::string& prefix) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+        if (it->key.compare(0, prefix.size(), prefix) != 0) {
+            it++;
+            continue;
+        }
+
+        m_bytes -= it->entry.bytes;
+        m_index.erase(it->key);
+        it = m_entries.erase(it);
+    }
+}
+
+void BlueskyResponseCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_index.clear();
+    m_bytes = 0;
+}
+
+void BlueskyResponseCache::recordHit() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.hits++;
+}
+
+void BlueskyResponseCache::recordRevalidated() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.revalidated++;
+}
+
+void BlueskyResponseCache::recordMiss() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.misses++;
+}
+
+BlueskyResponseCache::Stats BlueskyResponseCache::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Stats stats = m_stats;
+    stats.entries = m_entries.size();
+    stats.bytes = m_bytes;
+    return stats;
+}
+
+void BlueskyResponseCache::resetStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats = Stats();
+}
@@ -0,0 +1,114 @@
+#include "bluesky_seen_set.hpp"
+
+#include <algorithm>
+
+BlueskySeenSet::BlueskySeenSet(size_t capacity)
+    : m_mask(0)
+    , m_shift(64)
+    , m_order(std::max<size_t>(capacity, 1), 0)
+    , m_next(0)
+    , m_size(0)
+{
+    // At most half full, so probe sequences stay short
+    size_t slots = 2;
+    while (slots < m_order.size() * 2) {
+        slots *= 2;
+        m_shift--;
+    }
+    m_shift--;
+
+    m_table.assign(slots, 0);
+    m_mask = slots - 1;
+}
+
+uint64_t BlueskySeenSet::hash(const char* data, size_t size) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+
+    // 0 marks empty slots
+    return hash != 0 ? hash : 1;
+}
+
+size_t BlueskySeenSet::home(uint64_t hash) const {
+    // Fibonacci hashing spreads the high bits of the product over the table
+    return (size_t)((hash * 0x9E3779B97F4A7C15ULL) >> m_shift) & m_mask;
+}
+
+size_t BlueskySeenSet::find(uint64_t hash) const {
+    size_t slot = home(hash);
+    while (m_table[slot] != 0 && m_table[slot] != hash)
+        slot = (slot + 1) & m_mask;
+
+    return slot;
+}
+
+bool BlueskySeenSet::contains(uint64_t hash) const {
+    if (hash == 0)
+        hash = 1;
+
+    return m_table[find(hash)] == hash;
+}
+
+bool BlueskySeenSet::insert(uint64_t hash) {
+    if (hash == 0)
+        hash = 1;
+
+    const size_t slot = find(hash);
+    if (m_table[slot] == hash)
+        return false;
+
+    if (m_size == m_order.size()) {
+        erase(m_order[m_next]);
+        m_size--;
+
+        // The erase may have shifted entries into the free slot
+        m_table[find(hash)] = hash;
+    }
+    else {
+        m_table[slot] = hash;
+    }
+
+    m_order[m_next] = hash;
+    m_next = (m_next + 1) % m_order.size();
+    m_size++;
+
+    return true;
+}
+
+void BlueskySeenSet::erase(uint64_t hash) {
+    size_t slot = find(hash);
+    if (m_table[slot] != hash)
+        return;
+
+    // Backward shift: pull later entries of the probe run into the hole, so
+    // lookups never stop early at it
+    size_t next = slot;
+    for (;;) {
+        next = (next + 1) & m_mask;
+        if (m_table[next] == 0)
+            break;
+
+        const size_t wanted = home(m_table[next]);
+        const bool between = slot <= next ?
+            (slot < wanted && wanted <= next) :
+            (slot < wanted || wanted <= next);
+
+        if (!between) {
+            m_table[slot] = m_table[next];
+            slot = next;
+        }
+    }
+
+    m_table[slot] = 0;
+}
+
+void BlueskySeenSet::clear() {
+    std::fill(m_table.begin(), m_table.end(), 0);
+    std::fill(m_order.begin(), m_order.end(), 0);
+    m_next = 0;
+    m_size = 0;
+}
@@ -0,0 +1,727 @@
+#include "bluesky_text.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BLUESKY_TEXT_X86 1
+#include <immintrin.h>
+#endif
+
+// Bytes that end a run in runLength
+enum Stop {
+    Stop_NonAscii = 0,
+    Stop_Unprintable, // Outside printable ASCII
+    Stop_Reserved, // Not an unreserved URL character
+    Stop_Space, // ASCII whitespace
+    Stop_NonSpace,
+    Stop_NonAsciiOrCr, // Where the grapheme fast path has to look closer
+};
+
+template <Stop S>
+static inline bool isStop(unsigned char c) {
+    switch (S) {
+    case Stop_NonAscii:
+        return c >= 0x80;
+    case Stop_Unprintable:
+        return c < 0x20 || c >= 0x7F;
+    case Stop_Reserved:
+        return !((c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') ||
+            c == '-' || c == '_' || c == '.' || c == '~');
+    case Stop_Space:
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    case Stop_NonSpace:
+        return !(c == ' ' || (c >= '\t' && c <= '\r'));
+    case Stop_NonAsciiOrCr:
+        return c >= 0x80 || c == '\r';
+    }
+    return true;
+}
+
+template <Stop S>
+static size_t runScalar(const unsigned char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        if (isStop<S>(data[i]))
+            return i;
+    }
+    return size;
+}
+
+#if defined(BLUESKY_TEXT_X86) && defined(__SSE2__)
+// Bytes compare as signed, so everything outside ASCII is negative and
+// fails the range checks below
+template <Stop S>
+static size_t runSse2(const unsigned char* data, size_t size) {
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        unsigned mask = 0;
+
+        switch (S) {
+        case Stop_NonAscii:
+            mask = (unsigned)_mm_movemask_epi8(v);
+            break;
+        case Stop_Unprintable:
+            mask = (unsigned)_mm_movemask_epi8(_mm_or_si128(
+                _mm_cmplt_epi8(v, _mm_set1_epi8(0x20)), _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7F))
+            ));
+            break;
+        case Stop_Reserved: {
+            const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+            const __m128i digit = _mm_and_si128(
+                _mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1))
+            );
+            const __m128i alpha = _mm_and_si128(
+                _mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1))
+            );
+            const __m128i symbol = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('-')), _mm_cmpeq_epi8(v, _mm_set1_epi8('_'))),
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('.')), _mm_cmpeq_epi8(v, _mm_set1_epi8('~')))
+            );
+            mask = ~(unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(digit, alpha), symbol)) & 0xFFFF;
+            break;
+        }
+        case Stop_Space:
+        case Stop_NonSpace: {
+            const __m128i space = _mm_or_si128(
+                _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)))
+            );
+            mask = (unsigned)_mm_movemask_epi8(space);
+            if (S == Stop_NonSpace)
+                mask = ~mask & 0xFFFF;
+            break;
+        }
+        case Stop_NonAsciiOrCr:
+            mask = (unsigned)_mm_movemask_epi8(_mm_or_si128(v, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+            break;
+        }
+
+        if (mask != 0)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+
+    return i + runScalar<S>(data + i, size - i);
+}
+#endif
+
+#if defined(BLUESKY_TEXT_X86)
+// Built for AVX2 regardless of compiler flags, only called when the CPU has it
+template <Stop S>
+__attribute__((target("avx2")))
+static size_t runAvx2(const unsigned char* data, size_t size) {
+    size_t i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        uint32_t mask = 0;
+
+        switch (S) {
+        case Stop_NonAscii:
+            mask = (uint32_t)_mm256_movemask_epi8(v);
+            break;
+        case Stop_Unprintable:
+            mask = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(
+                _mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), v), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7F))
+            ));
+            break;
+        case Stop_Reserved: {
+            const __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+            const __m256i digit = _mm256_and_si256(
+                _mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v)
+            );
+            const __m256i alpha = _mm256_and_si256(
+                _mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower)
+            );
+            const __m256i symbol = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('-')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('.')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('~')))
+            );
+            mask = ~(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(digit, alpha), symbol));
+            break;
+        }
+        case Stop_Space:
+        case Stop_NonSpace: {
+            const __m256i space = _mm256_or_si256(
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                _mm256_and_si256(
+                    _mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v)
+                )
+            );
+            mask = (uint32_t)_mm256_movemask_epi8(space);
+            if (S == Stop_NonSpace)
+                mask = ~mask;
+            break;
+        }
+        case Stop_NonAsciiOrCr:
+            mask = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(v, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+            break;
+        }
+
+        if (mask != 0)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+
+    return i + runScalar<S>(data + i, size - i);
+}
+
+static bool hasAvx2() {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+#endif
+
+// Length of the run at data that has no stop bytes
+template <Stop S>
+static inline size_t runLength(const char* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+
+#if defined(BLUESKY_TEXT_X86)
+    if (size >= 32 && hasAvx2())
+        return runAvx2<S>(bytes, size);
+#endif
+#if defined(BLUESKY_TEXT_X86) && defined(__SSE2__)
+    return runSse2<S>(bytes, size);
+#else
+    return runScalar<S>(bytes, size);
+#endif
+}
+
+const char* BlueskyText::simdLevel() {
+#if defined(BLUESKY_TEXT_X86)
+    if (hasAvx2())
+        return "avx2";
+#endif
+#if defined(BLUESKY_TEXT_X86) && defined(__SSE2__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+size_t BlueskyText::decode(const char* data, size_t size, uint32_t& codePoint) {
+    const unsigned char* p = (const unsigned char*)data;
+    if (size == 0)
+        return 0;
+
+    const unsigned char lead = p[0];
+    if (lead < 0x80) {
+        codePoint = lead;
+        return 1;
+    }
+
+    size_t length;
+    unsigned char low = 0x80, high = 0xBF; // Allowed range of the second byte
+
+    if (lead < 0xC2) {
+        return 0; // Continuation byte or overlong 2-byte form
+    }
+    else if (lead < 0xE0) {
+        length = 2;
+        codePoint = lead & 0x1F;
+    }
+    else if (lead < 0xF0) {
+        length = 3;
+        codePoint = lead & 0x0F;
+        if (lead == 0xE0)
+            low = 0xA0; // Overlong
+        else if (lead == 0xED)
+            high = 0x9F; // Surrogates
+    }
+    else if (lead < 0xF5) {
+        length = 4;
+        codePoint = lead & 0x07;
+        if (lead == 0xF0)
+            low = 0x90; // Overlong
+        else if (lead == 0xF4)
+            high = 0x8F; // Past U+10FFFF
+    }
+    else {
+        return 0;
+    }
+
+    if (size < length || p[1] < low || p[1] > high)
+        return 0;
+
+    for (size_t i = 1; i < length; i++) {
+        if ((p[i] & 0xC0) != 0x80)
+            return 0;
+        codePoint = (codePoint << 6) | (p[i] & 0x3F);
+    }
+
+    return length;
+}
+
+bool BlueskyText::isValidUtf8(const char* data, size_t size) {
+    size_t i = 0;
+
+    while (i < size) {
+        i += runLength<Stop_NonAscii>(data + i, size - i);
+        if (i == size)
+            break;
+
+        uint32_t codePoint;
+        const size_t length = decode(data + i, size - i, codePoint);
+        if (length == 0)
+            return false;
+
+        i += length;
+    }
+
+    return true;
+}
+
+std::string BlueskyText::repairUtf8(const std::string& str) {
+    if (isValidUtf8(str))
+        return str;
+
+    std::string out;
+    out.reserve(str.size() + 16);
+
+    const char* data = str.data();
+    const size_t size = str.size();
+    size_t i = 0;
+
+    while (i < size) {
+        const size_t run = runLength<Stop_NonAscii>(data + i, size - i);
+        out.append(data + i, run);
+        i += run;
+        if (i == size)
+            break;
+
+        uint32_t codePoint;
+        const size_t length = decode(data + i, size - i, codePoint);
+        if (length == 0) {
+            out += "\xEF\xBF\xBD";
+            i++;
+        }
+        else {
+            out.append(data + i, length);
+            i += length;
+        }
+    }
+
+    return out;
+}
+
+std::string BlueskyText::toAscii(const std::string& str) {
+    std::string out;
+    out.reserve(str.size());
+
+    const char* data = str.data();
+    const size_t size = str.size();
+    size_t i = 0;
+
+    while (i < size) {
+        const size_t run = runLength<Stop_Unprintable>(data + i, size - i);
+        out.append(data + i, run);
+        i += run;
+        if (i == size)
+            break;
+
+        // Control characters and DEL
+        if ((unsigned char)data[i] < 0x80) {
+            i++;
+            continue;
+        }
+
+        uint32_t codePoint;
+        const size_t length = decode(data + i, size - i, codePoint);
+        if (length == 0) {
+            i++;
+            continue;
+        }
+
+        switch (codePoint) {
+        case 0x2018: // Left single quote
+        case 0x2019: // Right single quote
+            out += '\'';
+            break;
+        case 0x201C: // Left double quote
+        case 0x201D: // Right double quote
+            out += '"';
+            break;
+        }
+
+        i += length;
+    }
+
+    return out;
+}
+
+std::string BlueskyText::urlEncode(const std::string& str) {
+    static const char HEX[] = "0123456789ABCDEF";
+
+    const char* data = str.data();
+    const size_t size = str.size();
+
+    // Room for the worst case, trimmed at the end
+    std::string out(size * 3, '\0');
+    char* dst = &out[0];
+    size_t i = 0;
+
+    while (i < size) {
+        const size_t run = runLength<Stop_Reserved>(data + i, size - i);
+        memcpy(dst, data + i, run);
+        dst += run;
+        i += run;
+
+        // Reserved characters tend to come alone, e.g. the spaces between
+        // words, so encode the next few before scanning again
+        for (; i < size && isStop<Stop_Reserved>((unsigned char)data[i]); i++) {
+            const unsigned char c = (unsigned char)data[i];
+            if (c == ' ') {
+                *dst++ = '+';
+            }
+            else {
+                *dst++ = '%';
+                *dst++ = HEX[c >> 4];
+                *dst++ = HEX[c & 0x0F];
+            }
+        }
+    }
+
+    out.resize(dst - out.data());
+    return out;
+}
+
+std::vector<std::string> BlueskyText::splitWords(const std::string& str) {
+    std::vector<std::string> words;
+
+    const char* data = str.data();
+    const size_t size = str.size();
+    size_t i = 0;
+
+    for (;;) {
+        i += runLength<Stop_NonSpace>(data + i, size - i);
+        if (i == size)
+            break;
+
+        const size_t length = runLength<Stop_Space>(data + i, size - i);
+        words.emplace_back(data + i, length);
+        i += length;
+    }
+
+    return words;
+}
+
+size_t BlueskyText::byteOffsetOfCodePoint(const char* data, size_t size, size_t index) {
+    size_t i = 0;
+
+    while (i < size) {
+        const size_t run = runLength<Stop_NonAscii>(data + i, size - i);
+        if (index < run)
+            return i + index;
+
+        index -= run;
+        i += run;
+        if (i == size)
+            break;
+
+        if (index == 0)
+            return i;
+
+        // Invalid bytes count as one code point each
+        uint32_t codePoint;
+        const size_t length = decode(data + i, size - i, codePoint);
+        i += length > 0 ? length : 1;
+        index--;
+    }
+
+    return size;
+}
+
+size_t BlueskyText::byteOffsetOfUtf16(const char* data, size_t size, size_t index) {
+    size_t i = 0;
+
+    while (i < size) {
+        const size_t run = runLength<Stop_NonAscii>(data + i, size - i);
+        if (index < run)
+            return i + index;
+
+        index -= run;
+        i += run;
+        if (i == size)
+            break;
+
+        if (index == 0)
+            return i;
+
+        uint32_t codePoint = 0;
+        const size_t length = decode(data + i, size - i, codePoint);
+        const size_t units = length > 0 && codePoint >= 0x10000 ? 2 : 1;
+
+        // An index inside a surrogate pair maps to the start of its character
+        if (index < units)
+            return i;
+
+        i += length > 0 ? length : 1;
+        index -= units;
+    }
+
+    return size;
+}
+
+struct CodePointRange {
+    uint32_t first;
+    uint32_t last;
+};
+
+// Grapheme_Cluster_Break=Extend and SpacingMark: combining marks (Mn, Me,
+// Mc), ZWNJ, halfwidth sound marks, emoji modifiers and tags
+static const CodePointRange EXTEND_RANGES[] = {
+    { 0x0300, 0x036F }, { 0x0483, 0x0489 }, { 0x0591, 0x05BD }, { 0x05BF, 0x05BF },
+    { 0x05C1, 0x05C2 }, { 0x05C4, 0x05C5 }, { 0x05C7, 0x05C7 }, { 0x0610, 0x061A },
+    { 0x064B, 0x065F }, { 0x0670, 0x0670 }, { 0x06D6, 0x06DC }, { 0x06DF, 0x06E4 },
+    { 0x06E7, 0x06E8 }, { 0x06EA, 0x06ED }, { 0x0711, 0x0711 }, { 0x0730, 0x074A },
+    { 0x07A6, 0x07B0 }, { 0x07EB, 0x07F3 }, { 0x07FD, 0x07FD }, { 0x0816, 0x0819 },
+    { 0x081B, 0x0823 }, { 0x0825, 0x0827 }, { 0x0829, 0x082D }, { 0x0859, 0x085B },
+    { 0x0898, 0x089F }, { 0x08CA, 0x08E1 }, { 0x08E3, 0x0903 }, { 0x093A, 0x093C },
+    { 0x093E, 0x094F }, { 0x0951, 0x0957 }, { 0x0962, 0x0963 }, { 0x0981, 0x0983 },
+    { 0x09BC, 0x09BC }, { 0x09BE, 0x09C4 }, { 0x09C7, 0x09C8 }, { 0x09CB, 0x09CD },
+    { 0x09D7, 0x09D7 }, { 0x09E2, 0x09E3 }, { 0x09FE, 0x09FE }, { 0x0A01, 0x0A03 },
+    { 0x0A3C, 0x0A3C }, { 0x0A3E, 0x0A42 }, { 0x0A47, 0x0A48 }, { 0x0A4B, 0x0A4D },
+    { 0x0A51, 0x0A51 }, { 0x0A70, 0x0A71 }, { 0x0A75, 0x0A75 }, { 0x0A81, 0x0A83 },
+    { 0x0ABC, 0x0ABC }, { 0x0ABE, 0x0AC5 }, { 0x0AC7, 0x0AC9 }, { 0x0ACB, 0x0ACD },
+    { 0x0AE2, 0x0AE3 }, { 0x0AFA, 0x0AFF }, { 0x0B01, 0x0B03 }, { 0x0B3C, 0x0B3C },
+    { 0x0B3E, 0x0B44 }, { 0x0B47, 0x0B48 }, { 0x0B4B, 0x0B4D }, { 0x0B55, 0x0B57 },
+    { 0x0B62, 0x0B63 }, { 0x0B82, 0x0B82 }, { 0x0BBE, 0x0BC2 }, { 0x0BC6, 0x0BC8 },
+    { 0x0BCA, 0x0BCD }, { 0x0BD7, 0x0BD7 }, { 0x0C00, 0x0C04 }, { 0x0C3C, 0x0C3C },
+    { 0x0C3E, 0x0C44 }, { 0x0C46, 0x0C48 }, { 0x0C4A, 0x0C4D }, { 0x0C55, 0x0C56 },
+    { 0x0C62, 0x0C63 }, { 0x0C81, 0x0C83 }, { 0x0CBC, 0x0CBC }, { 0x0CBE, 0x0CC4 },
+    { 0x0CC6, 0x0CC8 }, { 0x0CCA, 0x0CCD }, { 0x0CD5, 0x0CD6 }, { 0x0CE2, 0x0CE3 },
+    { 0x0D00, 0x0D03 }, { 0x0D3B, 0x0D3C }, { 0x0D3E, 0x0D44 }, { 0x0D46, 0x0D48 },
+    { 0x0D4A, 0x0D4D }, { 0x0D57, 0x0D57 }, { 0x0D62, 0x0D63 }, { 0x0D81, 0x0D83 },
+    { 0x0DCA, 0x0DCA }, { 0x0DCF, 0x0DD4 }, { 0x0DD6, 0x0DD6 }, { 0x0DD8, 0x0DDF },
+    { 0x0DF2, 0x0DF3 }, { 0x0E31, 0x0E31 }, { 0x0E34, 0x0E3A }, { 0x0E47, 0x0E4E },
+    { 0x0EB1, 0x0EB1 }, { 0x0EB4, 0x0EBC }, { 0x0EC8, 0x0ECD }, { 0x0F18, 0x0F19 },
+    { 0x0F35, 0x0F35 }, { 0x0F37, 0x0F37 }, { 0x0F39, 0x0F39 }, { 0x0F3E, 0x0F3F },
+    { 0x0F71, 0x0F84 }, { 0x0F86, 0x0F87 }, { 0x0F8D, 0x0F97 }, { 0x0F99, 0x0FBC },
+    { 0x0FC6, 0x0FC6 }, { 0x102B, 0x103E }, { 0x1056, 0x1059 }, { 0x105E, 0x1060 },
+    { 0x1062, 0x1064 }, { 0x1067, 0x106D }, { 0x1071, 0x1074 }, { 0x1082, 0x108D },
+    { 0x108F, 0x108F }, { 0x109A, 0x109D }, { 0x135D, 0x135F }, { 0x1712, 0x1715 },
+    { 0x1732, 0x1734 }, { 0x1752, 0x1753 }, { 0x1772, 0x1773 }, { 0x17B4, 0x17D3 },
+    { 0x17DD, 0x17DD }, { 0x180B, 0x180D }, { 0x180F, 0x180F }, { 0x1885, 0x1886 },
+    { 0x18A9, 0x18A9 }, { 0x1920, 0x192B }, { 0x1930, 0x193B }, { 0x1A17, 0x1A1B },
+    { 0x1A55, 0x1A5E }, { 0x1A60, 0x1A7C }, { 0x1A7F, 0x1A7F }, { 0x1AB0, 0x1ACE },
+    { 0x1B00, 0x1B04 }, { 0x1B34, 0x1B44 }, { 0x1B6B, 0x1B73 }, { 0x1B80, 0x1B82 },
+    { 0x1BA1, 0x1BAD }, { 0x1BE6, 0x1BF3 }, { 0x1C24, 0x1C37 }, { 0x1CD0, 0x1CD2 },
+    { 0x1CD4, 0x1CE8 }, { 0x1CED, 0x1CED }, { 0x1CF4, 0x1CF4 }, { 0x1CF7, 0x1CF9 },
+    { 0x1DC0, 0x1DFF }, { 0x200C, 0x200C }, { 0x20D0, 0x20F0 }, { 0x2CEF, 0x2CF1 },
+    { 0x2D7F, 0x2D7F }, { 0x2DE0, 0x2DFF }, { 0x302A, 0x302F }, { 0x3099, 0x309A },
+    { 0xA66F, 0xA672 }, { 0xA674, 0xA67D }, { 0xA69E, 0xA69F }, { 0xA6F0, 0xA6F1 },
+    { 0xA802, 0xA802 }, { 0xA806, 0xA806 }, { 0xA80B, 0xA80B }, { 0xA823, 0xA827 },
+    { 0xA82C, 0xA82C }, { 0xA880, 0xA881 }, { 0xA8B4, 0xA8C5 }, { 0xA8E0, 0xA8F1 },
+    { 0xA8FF, 0xA8FF }, { 0xA926, 0xA92D }, { 0xA947, 0xA953 }, { 0xA980, 0xA983 },
+    { 0xA9B3, 0xA9C0 }, { 0xA9E5, 0xA9E5 }, { 0xAA29, 0xAA36 }, { 0xAA43, 0xAA43 },
+    { 0xAA4C, 0xAA4D }, { 0xAA7B, 0xAA7D }, { 0xAAB0, 0xAAB0 }, { 0xAAB2, 0xAAB4 },
+    { 0xAAB7, 0xAAB8 }, { 0xAABE, 0xAABF }, { 0xAAC1, 0xAAC1 }, { 0xAAEB, 0xAAEF },
+    { 0xAAF5, 0xAAF6 }, { 0xABE3, 0xABEA }, { 0xABEC, 0xABED }, { 0xFB1E, 0xFB1E },
+    { 0xFE00, 0xFE0F }, { 0xFE20, 0xFE2F }, { 0xFF9E, 0xFF9F }, { 0x101FD, 0x101FD },
+    { 0x102E0, 0x102E0 }, { 0x10376, 0x1037A }, { 0x10A01, 0x10A03 }, { 0x10A05, 0x10A06 },
+    { 0x10A0C, 0x10A0F }, { 0x10A38, 0x10A3A }, { 0x10A3F, 0x10A3F }, { 0x10AE5, 0x10AE6 },
+    { 0x10D24, 0x10D27 }, { 0x10EAB, 0x10EAC }, { 0x10F46, 0x10F50 }, { 0x10F82, 0x10F85 },
+    { 0x11000, 0x11002 }, { 0x11038, 0x11046 }, { 0x11070, 0x11070 }, { 0x11073, 0x11074 },
+    { 0x1107F, 0x11082 }, { 0x110B0, 0x110BA }, { 0x110C2, 0x110C2 }, { 0x11100, 0x11102 },
+    { 0x11127, 0x11134 }, { 0x11145, 0x11146 }, { 0x11173, 0x11173 }, { 0x11180, 0x11182 },
+    { 0x111B3, 0x111C0 }, { 0x111C9, 0x111CC }, { 0x111CE, 0x111CF }, { 0x1122C, 0x11237 },
+    { 0x1123E, 0x1123E }, { 0x112DF, 0x112EA }, { 0x11300, 0x11303 }, { 0x1133B, 0x1133C },
+    { 0x1133E, 0x11344 }, { 0x11347, 0x11348 }, { 0x1134B, 0x1134D }, { 0x11357, 0x11357 },
+    { 0x11362, 0x11363 }, { 0x11366, 0x1136C }, { 0x11370, 0x11374 }, { 0x11435, 0x11446 },
+    { 0x1145E, 0x1145E }, { 0x114B0, 0x114C3 }, { 0x115AF, 0x115B5 }, { 0x115B8, 0x115C0 },
+    { 0x115DC, 0x115DD }, { 0x11630, 0x11640 }, { 0x116AB, 0x116B7 }, { 0x1171D, 0x1172B },
+    { 0x1182C, 0x1183A }, { 0x11930, 0x11935 }, { 0x11937, 0x11938 }, { 0x1193B, 0x1193E },
+    { 0x11940, 0x11940 }, { 0x11942, 0x11943 }, { 0x119D1, 0x119D7 }, { 0x119DA, 0x119E0 },
+    { 0x119E4, 0x119E4 }, { 0x11A01, 0x11A0A }, { 0x11A33, 0x11A39 }, { 0x11A3B, 0x11A3E },
+    { 0x11A47, 0x11A47 }, { 0x11A51, 0x11A5B }, { 0x11A8A, 0x11A99 }, { 0x11C2F, 0x11C36 },
+    { 0x11C38, 0x11C3F }, { 0x11C92, 0x11CA7 }, { 0x11CA9, 0x11CB6 }, { 0x11D31, 0x11D36 },
+    { 0x11D3A, 0x11D3A }, { 0x11D3C, 0x11D3D }, { 0x11D3F, 0x11D45 }, { 0x11D47, 0x11D47 },
+    { 0x11D8A, 0x11D8E }, { 0x11D90, 0x11D91 }, { 0x11D93, 0x11D97 }, { 0x11EF3, 0x11EF6 },
+    { 0x16AF0, 0x16AF4 }, { 0x16B30, 0x16B36 }, { 0x16F4F, 0x16F4F }, { 0x16F51, 0x16F87 },
+    { 0x16F8F, 0x16F92 }, { 0x16FE4, 0x16FE4 }, { 0x16FF0, 0x16FF1 }, { 0x1BC9D, 0x1BC9E },
+    { 0x1CF00, 0x1CF2D }, { 0x1CF30, 0x1CF46 }, { 0x1D165, 0x1D169 }, { 0x1D16D, 0x1D172 },
+    { 0x1D17B, 0x1D182 }, { 0x1D185, 0x1D18B }, { 0x1D1AA, 0x1D1AD }, { 0x1D242, 0x1D244 },
+    { 0x1DA00, 0x1DA36 }, { 0x1DA3B, 0x1DA6C }, { 0x1DA75, 0x1DA75 }, { 0x1DA84, 0x1DA84 },
+    { 0x1DA9B, 0x1DA9F }, { 0x1DAA1, 0x1DAAF }, { 0x1E000, 0x1E006 }, { 0x1E008, 0x1E018 },
+    { 0x1E01B, 0x1E021 }, { 0x1E023, 0x1E024 }, { 0x1E026, 0x1E02A }, { 0x1E130, 0x1E136 },
+    { 0x1E2AE, 0x1E2AE }, { 0x1E2EC, 0x1E2EF }, { 0x1E8D0, 0x1E8D6 }, { 0x1E944, 0x1E94A },
+    { 0x1F3FB, 0x1F3FF }, { 0xE0020, 0xE007F }, { 0xE0100, 0xE01EF },
+};
+
+// Extended_Pictographic, in the ranges emoji are actually drawn from
+static const CodePointRange PICTOGRAPHIC_RANGES[] = {
+    { 0x00A9, 0x00A9 }, { 0x00AE, 0x00AE }, { 0x203C, 0x203C }, { 0x2049, 0x2049 },
+    { 0x2122, 0x2122 }, { 0x2139, 0x2139 }, { 0x2194, 0x2199 }, { 0x21A9, 0x21AA },
+    { 0x231A, 0x231B }, { 0x2328, 0x2328 }, { 0x23CF, 0x23CF }, { 0x23E9, 0x23F3 },
+    { 0x23F8, 0x23FA }, { 0x24C2, 0x24C2 }, { 0x25AA, 0x25AB }, { 0x25B6, 0x25B6 },
+    { 0x25C0, 0x25C0 }, { 0x25FB, 0x25FE }, { 0x2600, 0x27BF }, { 0x2934, 0x2935 },
+    { 0x2B05, 0x2B07 }, { 0x2B1B, 0x2B1C }, { 0x2B50, 0x2B50 }, { 0x2B55, 0x2B55 },
+    { 0x3030, 0x3030 }, { 0x303D, 0x303D }, { 0x3297, 0x3297 }, { 0x3299, 0x3299 },
+    { 0x1F000, 0x1F1E5 }, { 0x1F200, 0x1F3FA }, { 0x1F400, 0x1FAFF }, { 0x1FC00, 0x1FFFD },
+};
+
+template <size_t N>
+static bool inRanges(const CodePointRange (&ranges)[N], uint32_t codePoint) {
+    const CodePointRange* end = ranges + N;
+    const CodePointRange* it = std::upper_bound(ranges, end, codePoint,
+        [](uint32_t cp, const CodePointRange& range) { return cp < range.last; });
+
+    // upper_bound finds the first range ending after codePoint; the one
+    // ending on it sits just before
+    if (it != ranges && (it - 1)->last == codePoint)
+        return true;
+
+    return it != end && it->first <= codePoint;
+}
+
+enum GraphemeBreak {
+    Break_Other = 0,
+    Break_Cr,
+    Break_Lf,
+    Break_Control,
+    Break_Extend,
+    Break_Zwj,
+    Break_RegionalIndicator,
+    Break_Pictographic,
+    Break_L, // Hangul leading consonant
+    Break_V, // Hangul vowel
+    Break_T, // Hangul trailing consonant
+    Break_LV,
+    Break_LVT,
+};
+
+static GraphemeBreak graphemeBreak(uint32_t cp) {
+    if (cp < 0x300) {
+        if (cp == '\r')
+            return Break_Cr;
+        if (cp == '\n')
+            return Break_Lf;
+        if (cp < 0x20 || (cp >= 0x7F && cp <= 0x9F) || cp == 0xAD)
+            return Break_Control;
+
+        return cp == 0xA9 || cp == 0xAE ? Break_Pictographic : Break_Other;
+    }
+
+    if (cp == 0x200D)
+        return Break_Zwj;
+    if (inRanges(EXTEND_RANGES, cp))
+        return Break_Extend;
+
+    // Format characters that always stand alone
+    if (cp == 0x061C || cp == 0x180E || cp == 0x200B || cp == 0x200E || cp == 0x200F ||
+        (cp >= 0x2028 && cp <= 0x202E) || (cp >= 0x2060 && cp <= 0x206F) ||
+        cp == 0xFEFF || (cp >= 0xFFF0 && cp <= 0xFFFB))
+        return Break_Control;
+
+    if (cp >= 0x1F1E6 && cp <= 0x1F1FF)
+        return Break_RegionalIndicator;
+
+    if (cp >= 0x1100 && cp <= 0x11FF) {
+        if (cp < 0x1160)
+            return Break_L;
+
+        return cp < 0x11A8 ? Break_V : Break_T;
+    }
+    if (cp >= 0xA960 && cp <= 0xA97C)
+        return Break_L;
+    if (cp >= 0xD7B0 && cp <= 0xD7C6)
+        return Break_V;
+    if (cp >= 0xD7CB && cp <= 0xD7FB)
+        return Break_T;
+    if (cp >= 0xAC00 && cp <= 0xD7A3)
+        return (cp - 0xAC00) % 28 == 0 ? Break_LV : Break_LVT;
+
+    return inRanges(PICTOGRAPHIC_RANGES, cp) ? Break_Pictographic : Break_Other;
+}
+
+// Counts graphemes up to maxGraphemes; end is where the next one starts
+static size_t segmentGraphemes(const char* data, size_t size, size_t maxGraphemes, size_t& end) {
+    size_t count = 0;
+    size_t i = 0;
+
+    GraphemeBreak prev = Break_Control; // Nothing attaches to the start of text
+    bool pictographic = false; // The current grapheme started with an emoji
+    bool openFlag = false; // The previous regional indicator started a pair
+
+    while (i < size) {
+        // Printable ASCII and LF each start a grapheme of their own, save for
+        // LF after CR, and nothing attaches to them but marks
+        if (prev != Break_Cr) {
+            const size_t run = runLength<Stop_NonAsciiOrCr>(data + i, size - i);
+            if (run > 0) {
+                if (run > maxGraphemes - count) {
+                    end = i + (maxGraphemes - count);
+                    return maxGraphemes;
+                }
+
+                count += run;
+                i += run;
+
+                const unsigned char last = (unsigned char)data[i - 1];
+                prev = last < 0x20 || last == 0x7F ? Break_Control : Break_Other;
+                pictographic = false;
+                openFlag = false;
+                continue;
+            }
+        }
+
+        uint32_t cp = 0xFFFD;
+        size_t length = BlueskyText::decode(data + i, size - i, cp);
+        const GraphemeBreak next = length > 0 ? graphemeBreak(cp) : Break_Other;
+        if (length == 0)
+            length = 1; // An invalid byte stands alone
+
+        bool join;
+        if (prev == Break_Cr)
+            join = next == Break_Lf;
+        else if (prev == Break_Control || prev == Break_Lf)
+            join = false;
+        else if (next == Break_Cr || next == Break_Lf || next == Break_Control)
+            join = false;
+        else if (next == Break_Extend || next == Break_Zwj)
+            join = true;
+        else if (prev == Break_Zwj)
+            join = pictographic && next == Break_Pictographic;
+        else if (next == Break_RegionalIndicator)
+            join = openFlag;
+        else if (prev == Break_L)
+            join = next == Break_L || next == Break_V || next == Break_LV || next == Break_LVT;
+        else if (prev == Break_V || prev == Break_LV)
+            join = next == Break_V || next == Break_T;
+        else if (prev == Break_T || prev == Break_LVT)
+            join = next == Break_T;
+        else
+            join = false;
+
+        if (!join) {
+            if (count == maxGraphemes) {
+                end = i;
+                return count;
+            }
+
+            count++;
+            pictographic = next == Break_Pictographic;
+        }
+
+        // Flags pair up: a regional indicator that joined closes its pair
+        openFlag = next == Break_RegionalIndicator && !join;
+        prev = next;
+
+        i += length;
+    }
+
+    end = size;
+    return count;
+}
+
+size_t BlueskyText::countGraphemes(const char* data, size_t size) {
+    size_t end;
+    return segmentGraphemes(data, size, (size_t)-1, end);
+}
+
+size_t BlueskyText::graphemePrefix(const char* data, size_t size, size_t maxGraphemes) {
+    size_t end;
+    segmentGraphemes(data, size, maxGraphemes, end);
+    return end;
+}
@@ -0,0 +1,208 @@
+#include "bluesky_timestamp.hpp"
+
+#include <chrono>
+#include <cstring>
+
+static const int64_t US_PER_SECOND = 1000000;
+static const int64_t SECONDS_PER_DAY = 86400;
+
+// Days between 1970-01-01 and the given date of the proleptic Gregorian
+// calendar; the era arithmetic from Howard Hinnant's date algorithms
+static int64_t daysFromCivil(int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yearOfEra = (unsigned)(year - era * 400);
+    const unsigned dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+    return era * 146097 + (int64_t)dayOfEra - 719468;
+}
+
+static void civilFromDays(int64_t days, int64_t& year, unsigned& month, unsigned& day) {
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned dayOfEra = (unsigned)(days - era * 146097);
+    const unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    const unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    const unsigned shiftedMonth = (5 * dayOfYear + 2) / 153; // March is 0
+
+    day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+    month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+    year = yearOfEra + era * 400 + (month <= 2);
+}
+
+static unsigned daysInMonth(unsigned year, unsigned month) {
+    static const unsigned char DAYS[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+    if (month == 2 && year % 4 == 0 && (year % 100 != 0 || year % 400 == 0))
+        return 29;
+
+    return DAYS[month - 1];
+}
+
+// Reads count decimal digits
+static inline bool readDigits(const char* p, unsigned count, unsigned& value) {
+    value = 0;
+    for (unsigned i = 0; i < count; i++) {
+        const unsigned digit = (unsigned)(p[i] - '0');
+        if (digit > 9)
+            return false;
+
+        value = value * 10 + digit;
+    }
+
+    return true;
+}
+
+static inline void writeDigits(char* out, unsigned value, unsigned count) {
+    for (unsigned i = count; i > 0; i--) {
+        out[i - 1] = (char)('0' + value % 10);
+        value /= 10;
+    }
+}
+
+BlueskyTimestamp BlueskyTimestamp::now() {
+    const std::chrono::system_clock::duration sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+    return BlueskyTimestamp(std::chrono::duration_cast<std::chrono::microseconds>(sinceEpoch).count());
+}
+
+BlueskyTimestamp BlueskyTimestamp::parse(const char* str) {
+    if (str == nullptr)
+        return BlueskyTimestamp();
+
+    return parse(str, std::strlen(str));
+}
+
+BlueskyTimestamp BlueskyTimestamp::parse(const char* str, size_t size) {
+    // YYYY-MM-DDTHH:MM:SS
+    if (str == nullptr || size < 19)
+        return BlueskyTimestamp();
+
+    unsigned year, month, day, hour, minute, second;
+    if (!readDigits(str, 4, year) || str[4] != '-' ||
+        !readDigits(str + 5, 2, month) || str[7] != '-' ||
+        !readDigits(str + 8, 2, day) ||
+        (str[10] != 'T' && str[10] != 't' && str[10] != ' ') ||
+        !readDigits(str + 11, 2, hour) || str[13] != ':' ||
+        !readDigits(str + 14, 2, minute) || str[16] != ':' ||
+        !readDigits(str + 17, 2, second))
+        return BlueskyTimestamp();
+
+    // Second 60 is a leap second; it lands on the next minute's first
+    if (month < 1 || month > 12 || day < 1 || day > daysInMonth(year, month) ||
+        hour > 23 || minute > 59 || second > 60)
+        return BlueskyTimestamp();
+
+    size_t pos = 19;
+
+    int64_t fraction = 0;
+    if (pos < size && str[pos] == '.') {
+        pos++;
+
+        const size_t start = pos;
+        int64_t scale = US_PER_SECOND;
+        for (; pos < size && (unsigned)(str[pos] - '0') <= 9; pos++) {
+            if (scale > 1) {
+                scale /= 10;
+                fraction += (str[pos] - '0') * scale;
+            }
+        }
+
+        if (pos == start)
+            return BlueskyTimestamp();
+    }
+
+    int64_t offset = 0; // Seconds east of UTC
+    if (pos < size) {
+        const char zone = str[pos++];
+
+        if (zone == '+' || zone == '-') {
+            unsigned offsetHours, offsetMinutes;
+            if (size - pos < 5 || !readDigits(str + pos, 2, offsetHours) || str[pos + 2] != ':' ||
+                !readDigits(str + pos + 3, 2, offsetMinutes) || offsetHours > 23 || offsetMinutes > 59)
+                return BlueskyTimestamp();
+
+            offset = offsetHours * 3600 + offsetMinutes * 60;
+            if (zone == '-')
+                offset = -offset;
+
+            pos += 5;
+        }
+        else if (zone != 'Z' && zone != 'z') {
+            return BlueskyTimestamp();
+        }
+    }
+
+    if (pos != size)
+        return BlueskyTimestamp();
+
+    const int64_t seconds = daysFromCivil(year, month, day) * SECONDS_PER_DAY +
+        hour * 3600 + minute * 60 + second - offset;
+
+    return BlueskyTimestamp(seconds * US_PER_SECOND + fraction);
+}
+
+time_t BlueskyTimestamp::toTimeT() const {
+    if (!valid())
+        return (time_t)(-1);
+
+    // Rounds down, also before the epoch
+    int64_t seconds = m_us / US_PER_SECOND;
+    if (m_us % US_PER_SECOND < 0)
+        seconds--;
+
+    return (time_t)seconds;
+}
+
+size_t BlueskyTimestamp::format(char* out) const {
+    out[0] = '\0';
+    if (!valid())
+        return 0;
+
+    int64_t seconds = m_us / US_PER_SECOND;
+    int64_t us = m_us % US_PER_SECOND;
+    if (us < 0) {
+        us += US_PER_SECOND;
+        seconds--;
+    }
+
+    int64_t days = seconds / SECONDS_PER_DAY;
+    int64_t secondOfDay = seconds % SECONDS_PER_DAY;
+    if (secondOfDay < 0) {
+        secondOfDay += SECONDS_PER_DAY;
+        days--;
+    }
+
+    int64_t year;
+    unsigned month, day;
+    civilFromDays(days, year, month, day);
+
+    // RFC 3339 only has four-digit years
+    if (year < 0 || year > 9999)
+        return 0;
+
+    writeDigits(out, (unsigned)year, 4);
+    out[4] = '-';
+    writeDigits(out + 5, month, 2);
+    out[7] = '-';
+    writeDigits(out + 8, day, 2);
+    out[10] = 'T';
+    writeDigits(out + 11, (unsigned)(secondOfDay / 3600), 2);
+    out[13] = ':';
+    writeDigits(out + 14, (unsigned)(secondOfDay / 60 % 60), 2);
+    out[16] = ':';
+    writeDigits(out + 17, (unsigned)(secondOfDay % 60), 2);
+    out[19] = '.';
+    writeDigits(out + 20, (unsigned)(us / 1000), 3);
+    out[23] = 'Z';
+    out[24] = '\0';
+
+    return 24;
+}
+
+std::string BlueskyTimestamp::format() const {
+    char buffer[MAX_FORMAT_SIZE];
+    const size_t length = format(buffer);
+
+    return std::string(buffer, length);
+}
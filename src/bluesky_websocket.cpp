@@ -0,0 +1,527 @@
+#include "bluesky_websocket.hpp"
+#include "bluesky_client.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+static const char* const WEBSOCKET_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// Bytes requested from the socket per read
+static const size_t READ_CHUNK_SIZE = 64 * 1024;
+
+// Longest handshake response accepted
+static const size_t MAX_HANDSHAKE_SIZE = 16 * 1024;
+
+enum Opcode {
+    Opcode_Continuation = 0x0,
+    Opcode_Text = 0x1,
+    Opcode_Binary = 0x2,
+    Opcode_Close = 0x8,
+    Opcode_Ping = 0x9,
+    Opcode_Pong = 0xA,
+};
+
+static std::string base64Encode(const unsigned char* data, size_t length) {
+    std::string out(4 * ((length + 2) / 3) + 1, '\0');
+    const int written = EVP_EncodeBlock((unsigned char*)&out[0], data, (int)length);
+    out.resize(written > 0 ? (size_t)written : 0);
+    return out;
+}
+
+// Sec-WebSocket-Accept the server must answer for key
+static std::string acceptKey(const std::string& key) {
+    const std::string input = key + WEBSOCKET_GUID;
+
+    unsigned char digest[SHA_DIGEST_LENGTH];
+    SHA1((const unsigned char*)input.data(), input.size(), digest);
+
+    return base64Encode(digest, sizeof(digest));
+}
+
+static void setTimeout(int socket, int option, std::chrono::milliseconds timeout) {
+    struct timeval tv;
+    tv.tv_sec = (time_t)(timeout.count() / 1000);
+    tv.tv_usec = (suseconds_t)((timeout.count() % 1000) * 1000);
+    setsockopt(socket, SOL_SOCKET, option, &tv, sizeof(tv));
+}
+
+// Socket writes that never raise SIGPIPE. OpenSSL's socket BIO writes with
+// plain write(), which kills the process when the peer has gone away.
+static int sendNoSignal(BIO* bio, const char* data, int size) {
+    int fd = -1;
+    BIO_get_fd(bio, &fd);
+
+    errno = 0;
+    const int sent = (int)::send(fd, data, (size_t)size, MSG_NOSIGNAL);
+
+    BIO_clear_retry_flags(bio);
+    if (sent <= 0 && BIO_sock_should_retry(sent))
+        BIO_set_retry_write(bio);
+
+    return sent;
+}
+
+static int putsNoSignal(BIO* bio, const char* text) {
+    return sendNoSignal(bio, text, (int)std::strlen(text));
+}
+
+// BIO_s_socket with its writes replaced; created once and never freed
+static BIO_METHOD* socketMethod() {
+    static BIO_METHOD* const method = [] {
+        const BIO_METHOD* base = BIO_s_socket();
+
+        BIO_METHOD* created = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK | BIO_TYPE_DESCRIPTOR, "socket without SIGPIPE");
+        if (!created)
+            return created;
+
+        BIO_meth_set_write(created, sendNoSignal);
+        BIO_meth_set_puts(created, putsNoSignal);
+        BIO_meth_set_read(created, BIO_meth_get_read(base));
+        BIO_meth_set_ctrl(created, BIO_meth_get_ctrl(base));
+        BIO_meth_set_create(created, BIO_meth_get_create(base));
+        BIO_meth_set_destroy(created, BIO_meth_get_destroy(base));
+        return created;
+    }();
+
+    return method;
+}
+
+static int connectSocket(const std::string& host, const std::string& port, std::chrono::milliseconds timeout) {
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo* addresses = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0)
+        return -1;
+
+    int result = -1;
+
+    for (struct addrinfo* address = addresses; address && result < 0; address = address->ai_next) {
+        const int fd = ::socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd < 0)
+            continue;
+
+        // Connect without blocking, to bound the wait
+        const int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+        bool connected = ::connect(fd, address->ai_addr, address->ai_addrlen) == 0;
+        if (!connected && errno == EINPROGRESS) {
+            struct pollfd pfd = { fd, POLLOUT, 0 };
+            if (poll(&pfd, 1, (int)timeout.count()) == 1) {
+                int error = 0;
+                socklen_t length = sizeof(error);
+                connected = getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0;
+            }
+        }
+
+        if (!connected) {
+            ::close(fd);
+            continue;
+        }
+
+        fcntl(fd, F_SETFL, flags);
+
+        const int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        result = fd;
+    }
+
+    freeaddrinfo(addresses);
+    return result;
+}
+
+BlueskyWebSocket::BlueskyWebSocket()
+    : m_socket(-1)
+    , m_ssl_ctx(nullptr)
+    , m_ssl(nullptr)
+    , m_offset(0)
+    , m_end(0)
+{}
+
+BlueskyWebSocket::~BlueskyWebSocket() {
+    disconnect();
+}
+
+bool BlueskyWebSocket::fail(const std::string& error) {
+    m_error = error;
+    disconnect();
+    return false;
+}
+
+void BlueskyWebSocket::disconnect() {
+    if (m_ssl) {
+        SSL_free(m_ssl);
+        m_ssl = nullptr;
+    }
+    if (m_ssl_ctx) {
+        SSL_CTX_free(m_ssl_ctx);
+        m_ssl_ctx = nullptr;
+    }
+
+    const int fd = m_socket.exchange(-1);
+    if (fd >= 0)
+        ::close(fd);
+
+    m_offset = 0;
+    m_end = 0;
+}
+
+void BlueskyWebSocket::interrupt() {
+    const int fd = m_socket.load();
+    if (fd >= 0)
+        ::shutdown(fd, SHUT_RDWR);
+}
+
+bool BlueskyWebSocket::connect(
+    const std::string& url,
+    std::chrono::milliseconds connectTimeout,
+    std::chrono::milliseconds idleTimeout
+) {
+    disconnect();
+    m_error.clear();
+
+    bool secure;
+    size_t rest;
+    if (url.compare(0, 6, "wss://") == 0) {
+        secure = true;
+        rest = 6;
+    }
+    else if (url.compare(0, 5, "ws://") == 0) {
+        secure = false;
+        rest = 5;
+    }
+    else {
+        return fail("unsupported URL scheme");
+    }
+
+    const size_t pathStart = url.find('/', rest);
+    const std::string authority = url.substr(rest, pathStart == std::string::npos ? std::string::npos : pathStart - rest);
+    const std::string path = pathStart == std::string::npos ? "/" : url.substr(pathStart);
+
+    std::string host = authority;
+    std::string port = secure ? "443" : "80";
+
+    const size_t colon = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']', colon) == std::string::npos) {
+        host = authority.substr(0, colon);
+        port = authority.substr(colon + 1);
+    }
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']')
+        host = host.substr(1, host.size() - 2);
+
+    if (host.empty())
+        return fail("missing host");
+
+    const int fd = connectSocket(host, port, connectTimeout);
+    if (fd < 0)
+        return fail("could not connect to " + authority);
+
+    m_socket = fd;
+    setTimeout(fd, SO_RCVTIMEO, connectTimeout);
+    setTimeout(fd, SO_SNDTIMEO, connectTimeout);
+
+    if (secure) {
+        m_ssl_ctx = SSL_CTX_new(TLS_client_method());
+        if (!m_ssl_ctx)
+            return fail("could not create TLS context");
+
+        SSL_CTX_set_default_verify_paths(m_ssl_ctx);
+        SSL_CTX_set_verify(m_ssl_ctx, SSL_VERIFY_PEER, nullptr);
+
+        m_ssl = SSL_new(m_ssl_ctx);
+        if (!m_ssl)
+            return fail("could not create TLS session");
+
+        BIO* bio = socketMethod() ? BIO_new(socketMethod()) : nullptr;
+        if (!bio)
+            return fail("could not create TLS session");
+
+        BIO_set_fd(bio, fd, BIO_NOCLOSE);
+        SSL_set_bio(m_ssl, bio, bio);
+        SSL_set_tlsext_host_name(m_ssl, host.c_str());
+        SSL_set1_host(m_ssl, host.c_str());
+
+        if (SSL_connect(m_ssl) != 1)
+            return fail("TLS handshake with " + authority + " failed");
+    }
+
+    unsigned char nonce[16];
+    RAND_bytes(nonce, sizeof(nonce));
+    const std::string key = base64Encode(nonce, sizeof(nonce));
+
+    std::string request;
+    request.reserve(256 + path.size());
+    request += "GET " + path + " HTTP/1.1\r\n";
+    request += "Host: " + authority + "\r\n";
+    request += "Upgrade: websocket\r\n";
+    request += "Connection: Upgrade\r\n";
+    request += "Sec-WebSocket-Key: " + key + "\r\n";
+    request += "Sec-WebSocket-Version: 13\r\n";
+    request += std::string("User-Agent: ") + BlueskyClient::USER_AGENT + "\r\n";
+    request += "\r\n";
+
+    if (!writeAll(request.data(), request.size()))
+        return false;
+
+    // Read up to the end of the response headers; frames may follow directly
+    size_t headersEnd = std::string::npos;
+    while (headersEnd == std::string::npos) {
+        if (m_end >= MAX_HANDSHAKE_SIZE)
+            return fail("handshake response too large");
+        if (!fill())
+            return false;
+
+        headersEnd = std::string(m_buffer.data(), m_end).find("\r\n\r\n");
+    }
+
+    std::string headers(m_buffer.data(), headersEnd);
+    m_offset = headersEnd + 4;
+
+    if (headers.compare(0, 12, "HTTP/1.1 101") != 0)
+        return fail("server refused upgrade: " + headers.substr(0, headers.find("\r\n")));
+
+    std::transform(headers.begin(), headers.end(), headers.begin(), [](char c) {
+        return (char)std::tolower((unsigned char)c);
+    });
+
+    static const char ACCEPT_HEADER[] = "\r\nsec-websocket-accept:";
+    const size_t accept = headers.find(ACCEPT_HEADER);
+    if (accept == std::string::npos)
+        return fail("handshake response without Sec-WebSocket-Accept");
+
+    // Header names were lowercased, so take the value from the original bytes
+    size_t valueStart = accept + sizeof(ACCEPT_HEADER) - 1;
+    while (valueStart < headers.size() && headers[valueStart] == ' ')
+        valueStart++;
+
+    const size_t valueEnd = headers.find("\r\n", valueStart);
+    const std::string value(m_buffer.data() + valueStart, (valueEnd == std::string::npos ? headers.size() : valueEnd) - valueStart);
+
+    if (value != acceptKey(key))
+        return fail("handshake response with wrong Sec-WebSocket-Accept");
+
+    setTimeout(fd, SO_RCVTIMEO, idleTimeout);
+    return true;
+}
+
+bool BlueskyWebSocket::fill() {
+    const int fd = m_socket.load();
+    if (fd < 0)
+        return fail("not connected");
+
+    if (m_end == m_buffer.size()) {
+        // Move unread data to the front, or grow if it already starts there
+        if (m_offset > 0) {
+            std::memmove(&m_buffer[0], m_buffer.data() + m_offset, m_end - m_offset);
+            m_end -= m_offset;
+            m_offset = 0;
+        }
+        else {
+            m_buffer.resize(std::max(m_buffer.size() * 2, READ_CHUNK_SIZE));
+        }
+    }
+
+    const size_t space = m_buffer.size() - m_end;
+    const int wanted = (int)std::min(space, (size_t)1 << 30);
+
+    int received;
+    if (m_ssl)
+        received = SSL_read(m_ssl, &m_buffer[m_end], wanted);
+    else
+        received = (int)::recv(fd, &m_buffer[m_end], (size_t)wanted, 0);
+
+    if (received <= 0) {
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return fail("timed out");
+        return fail("connection lost");
+    }
+
+    m_end += (size_t)received;
+    return true;
+}
+
+bool BlueskyWebSocket::writeAll(const char* data, size_t size) {
+    const int fd = m_socket.load();
+    if (fd < 0)
+        return fail("not connected");
+
+    while (size > 0) {
+        int sent;
+        if (m_ssl)
+            sent = SSL_write(m_ssl, data, (int)std::min(size, (size_t)1 << 30));
+        else
+            sent = (int)::send(fd, data, size, MSG_NOSIGNAL);
+
+        if (sent <= 0)
+            return fail("connection lost");
+
+        data += sent;
+        size -= (size_t)sent;
+    }
+
+    return true;
+}
+
+bool BlueskyWebSocket::sendFrame(uint8_t opcode, const char* data, size_t size) {
+    std::string frame;
+    frame.reserve(14 + size);
+
+    // Client frames are always final and masked
+    frame += (char)(0x80 | opcode);
+
+    if (size < 126) {
+        frame += (char)(0x80 | size);
+    }
+    else if (size <= 0xFFFF) {
+        frame += (char)(0x80 | 126);
+        frame += (char)(size >> 8);
+        frame += (char)size;
+    }
+    else {
+        frame += (char)(0x80 | 127);
+        for (int shift = 56; shift >= 0; shift -= 8)
+            frame += (char)((uint64_t)size >> shift);
+    }
+
+    unsigned char mask[4];
+    RAND_bytes(mask, sizeof(mask));
+    frame.append((const char*)mask, sizeof(mask));
+
+    for (size_t i = 0; i < size; i++)
+        frame += (char)(data[i] ^ mask[i & 3]);
+
+    return writeAll(frame.data(), frame.size());
+}
+
+BlueskyWebSocket::Result BlueskyWebSocket::read(std::string& message, bool* binary) {
+    bool inMessage = false;
+
+    for (;;) {
+        // Frame header: 2 bytes, then an extended length and a mask key
+        while (m_end - m_offset < 2) {
+            if (!fill())
+                return Result_Error;
+        }
+
+        const uint8_t* header = (const uint8_t*)m_buffer.data() + m_offset;
+        const bool final = (header[0] & 0x80) != 0;
+        const uint8_t opcode = header[0] & 0x0F;
+        const bool masked = (header[1] & 0x80) != 0;
+        uint64_t length = header[1] & 0x7F;
+
+        size_t headerSize = 2 + (length == 126 ? 2 : length == 127 ? 8 : 0) + (masked ? 4 : 0);
+        while (m_end - m_offset < headerSize) {
+            if (!fill())
+                return Result_Error;
+        }
+
+        header = (const uint8_t*)m_buffer.data() + m_offset;
+
+        if (length == 126) {
+            length = ((uint64_t)header[2] << 8) | header[3];
+        }
+        else if (length == 127) {
+            length = 0;
+            for (int i = 0; i < 8; i++)
+                length = (length << 8) | header[2 + i];
+        }
+
+        const size_t pending = inMessage ? message.size() : 0;
+        if (length > MAX_MESSAGE_SIZE - pending) {
+            fail("message too large");
+            return Result_Error;
+        }
+
+        while (m_end - m_offset < headerSize + length) {
+            if (!fill())
+                return Result_Error;
+        }
+
+        char* payload = &m_buffer[m_offset + headerSize];
+
+        // Servers must not mask, but unmasking costs nothing to support
+        if (masked) {
+            const uint8_t* mask = (const uint8_t*)payload - 4;
+            for (uint64_t i = 0; i < length; i++)
+                payload[i] ^= (char)mask[i & 3];
+        }
+
+        m_offset += headerSize + (size_t)length;
+
+        switch (opcode) {
+        case Opcode_Text:
+        case Opcode_Binary:
+            if (inMessage) {
+                fail("new message inside a fragmented one");
+                return Result_Error;
+            }
+
+            message.assign(payload, (size_t)length);
+            if (binary)
+                *binary = opcode == Opcode_Binary;
+
+            inMessage = true;
+            break;
+
+        case Opcode_Continuation:
+            if (!inMessage) {
+                fail("continuation without a message");
+                return Result_Error;
+            }
+
+            message.append(payload, (size_t)length);
+            break;
+
+        case Opcode_Ping:
+            if (!sendFrame(Opcode_Pong, payload, (size_t)length))
+                return Result_Error;
+            continue;
+
+        case Opcode_Pong:
+            continue;
+
+        case Opcode_Close:
+            // Echo the status code, then drop the connection
+            sendFrame(Opcode_Close, payload, std::min<size_t>((size_t)length, 2));
+            disconnect();
+            return Result_Closed;
+
+        default:
+            fail("unknown opcode");
+            return Result_Error;
+        }
+
+        if (final)
+            return Result_Message;
+    }
+}
+
+void BlueskyWebSocket::close() {
+    if (m_socket.load() >= 0) {
+        // 1000, normal closure
+        const char status[2] = { (char)0x03, (char)0xE8 };
+        sendFrame(Opcode_Close, status, sizeof(status));
+    }
+
+    disconnect();
+}
@@ -0,0 +1,95 @@
+#include "bluesky_write_batch.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+BlueskyWriteBatch::BlueskyWriteBatch(BlueskyClient& client, size_t chunkSize)
+    : m_client(client)
+    , m_chunk_size(chunkSize == 0 || chunkSize > BlueskyClient::MAX_WRITES_PER_REQUEST ?
+        BlueskyClient::MAX_WRITES_PER_REQUEST : chunkSize)
+{}
+
+bool BlueskyWriteBatch::create(const std::string& collection, const std::string& record, const std::string& rkey) {
+    if (!isRecord(record))
+        return false;
+
+    BlueskyClient::WriteOp op = { BlueskyClient::WriteAction_Create, collection, rkey, record };
+    m_pending.push_back(std::move(op));
+    return true;
+}
+
+bool BlueskyWriteBatch::update(const std::string& collection, const std::string& rkey, const std::string& record) {
+    if (!isRecord(record))
+        return false;
+
+    BlueskyClient::WriteOp op = { BlueskyClient::WriteAction_Update, collection, rkey, record };
+    m_pending.push_back(std::move(op));
+    return true;
+}
+
+void BlueskyWriteBatch::remove(const std::string& collection, const std::string& rkey) {
+    BlueskyClient::WriteOp op = { BlueskyClient::WriteAction_Delete, collection, rkey, std::string() };
+    m_pending.push_back(std::move(op));
+}
+
+void BlueskyWriteBatch::createPost(const std::string& text) {
+    BlueskyClient::PostRecord record;
+    record.text = text;
+
+    createPost(record);
+}
+
+void BlueskyWriteBatch::createPost(const BlueskyClient::PostRecord& record) {
+    BlueskyJsonBuilder::Object root = m_builder.begin();
+    BlueskyClient::writePostRecord(root, record);
+
+    // Built here, so known to be an object; create() would check it with the
+    // same builder that holds it
+    BlueskyClient::WriteOp op = { BlueskyClient::WriteAction_Create, "app.bsky.feed.post", std::string(), m_builder.finish() };
+    m_pending.push_back(std::move(op));
+}
+
+bool BlueskyWriteBatch::isRecord(const std::string& json) {
+    // The check applyWrites makes, done up front so one bad record cannot
+    // fail its whole chunk
+    return m_builder.begin().addJsonObject("value", json);
+}
+
+std::vector<BlueskyClient::WriteResult> BlueskyWriteBatch::flush() {
+    std::vector<BlueskyClient::WriteResult> results;
+    results.reserve(m_pending.size());
+
+    std::vector<BlueskyClient::WriteOp> chunk;
+    size_t start = 0;
+    while (start < m_pending.size()) {
+        const size_t end = std::min(start + m_chunk_size, m_pending.size());
+
+        chunk.assign(
+            std::make_move_iterator(m_pending.begin() + start),
+            std::make_move_iterator(m_pending.begin() + end)
+        );
+
+        std::vector<BlueskyClient::WriteResult> chunkResults = m_client.applyWrites(chunk);
+        for (auto& result : chunkResults)
+            results.push_back(std::move(result));
+
+        // Every result of a chunk carries the same error
+        const BlueskyClient::WriteResult& last = results.back();
+        if (last.error != BlueskyClient::Error_None) {
+            // Put the operations back only if none of them were applied;
+            // resending after a timeout could create every record twice.
+            // Later ones wait either way, so writes are never applied out of
+            // order.
+            if (last.retryable)
+                std::move(chunk.begin(), chunk.end(), m_pending.begin() + start);
+            else
+                start = end;
+            break;
+        }
+
+        start = end;
+    }
+
+    m_pending.erase(m_pending.begin(), m_pending.begin() + start);
+    return results;
+}
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+# Writes repo.car, a small atproto repo export used by the CAR/DAG-CBOR tests:
+# a commit, one MST node listing two posts and a like, and their records.
+# The first post comes before the MST node, the second one after it.
+
+import hashlib
+import os
+import struct
+
+
+def varint(n):
+    out = bytearray()
+    while True:
+        byte = n & 0x7F
+        n >>= 7
+        if n:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def head(major, n):
+    if n < 24:
+        return bytes([major << 5 | n])
+    for minor, fmt in ((24, '>B'), (25, '>H'), (26, '>I'), (27, '>Q')):
+        if n < 1 << (8 * struct.calcsize(fmt)):
+            return bytes([major << 5 | minor]) + struct.pack(fmt, n)
+
+
+class Cid:
+    def __init__(self, data):
+        self.raw = b'\x01\x71\x12\x20' + hashlib.sha256(data).digest()
+
+
+def cbor(value):
+    if value is None:
+        return b'\xf6'
+    if value is True:
+        return b'\xf5'
+    if value is False:
+        return b'\xf4'
+    if isinstance(value, int):
+        return head(0, value) if value >= 0 else head(1, -1 - value)
+    if isinstance(value, bytes):
+        return head(2, len(value)) + value
+    if isinstance(value, str):
+        data = value.encode()
+        return head(3, len(data)) + data
+    if isinstance(value, list):
+        return head(4, len(value)) + b''.join(cbor(v) for v in value)
+    if isinstance(value, dict):
+        # DAG-CBOR orders keys by length, then bytewise
+        keys = sorted(value, key=lambda k: (len(k.encode()), k.encode()))
+        return head(5, len(keys)) + b''.join(cbor(k) + cbor(value[k]) for k in keys)
+    if isinstance(value, Cid):
+        return b'\xd8\x2a' + cbor(b'\x00' + value.raw)
+    raise TypeError(value)
+
+
+def block(value):
+    data = cbor(value)
+    return Cid(data), data
+
+
+did = 'did:plc:fixture'
+
+post1 = block({'$type': 'app.bsky.feed.post', 'text': 'First post', 'langs': ['en'],
+               'createdAt': '2024-10-17T08:15:10.123Z'})
+post2 = block({'$type': 'app.bsky.feed.post', 'text': 'Second post',
+               'createdAt': '2024-10-18T09:30:00.000Z',
+               'reply': {'root': {'uri': 'at://did:plc:other/app.bsky.feed.post/1', 'cid': 'bafy'},
+                         'parent': {'uri': 'at://did:plc:other/app.bsky.feed.post/1', 'cid': 'bafy'}}})
+like = block({'$type': 'app.bsky.feed.like', 'createdAt': '2024-10-18T09:31:00.000Z',
+              'subject': {'uri': 'at://did:plc:other/app.bsky.feed.post/1', 'cid': 'bafy'}})
+
+node = block({'l': None, 'e': [
+    {'p': 0, 'k': b'app.bsky.feed.like/3kaaa', 'v': like[0], 't': None},
+    {'p': 14, 'k': b'post/3kabc', 'v': post1[0], 't': None},
+    {'p': 23, 'k': b'd', 'v': post2[0], 't': None},
+]})
+
+commit = block({'did': did, 'version': 3, 'data': node[0], 'rev': '3l6oveexb3j2l',
+                'prev': None, 'sig': b'\x00' * 64})
+
+out = bytearray()
+header = cbor({'version': 1, 'roots': [commit[0]]})
+out += varint(len(header)) + header
+
+for cid, data in (commit, post1, node, post2, like):
+    section = cid.raw + data
+    out += varint(len(section)) + section
+
+with open(os.path.join(os.path.dirname(os.path.abspath(__file__)), 'repo.car'), 'wb') as f:
+    f.write(out)
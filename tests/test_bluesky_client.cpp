@@ -1,6 +1,48 @@
 // tests/test_bluesky_client.cpp
 #include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <yyjson.h>
+
+#include "bluesky_author_ids.hpp"
+#include "bluesky_author_table.hpp"
+#include "bluesky_car.hpp"
 #include "bluesky_client.hpp"
+#include "bluesky_connection_pool.hpp"
+#include "bluesky_executor.hpp"
+#include "bluesky_feed_batch.hpp"
+#include "bluesky_feed_poller.hpp"
+#include "bluesky_feed_stream.hpp"
+#include "bluesky_hydrator.hpp"
+#include "bluesky_identity.hpp"
+#include "bluesky_jetstream.hpp"
+#include "bluesky_json_builder.hpp"
+#include "bluesky_metrics.hpp"
+#include "bluesky_post_store.hpp"
+#include "bluesky_rate_limiter.hpp"
+#include "bluesky_repo_reader.hpp"
+#include "bluesky_response_cache.hpp"
+#include "bluesky_seen_set.hpp"
+#include "bluesky_single_flight.hpp"
+#include "bluesky_text.hpp"
+#include "bluesky_timestamp.hpp"
+#include "bluesky_ttl_cache.hpp"
+#include "bluesky_write_batch.hpp"
+
+#include "mock_pds_server.hpp"
+#include "ws_replay_server.hpp"
 
 class BlueskyClientTest : public ::testing::Test {
 protected:
@@ -15,8 +57,31 @@ protected:
     }
 };
 
+// A feed page as MockPdsServer would serve it, with posts first to
+// first + count - 1 by one author
+static std::string mockFeedPage(int first, int count, const std::string& cursor) {
+    std::ostringstream ss;
+
+    ss << "{\"feed\":[";
+    for (int i = first; i < first + count; i++) {
+        if (i != first)
+            ss << ',';
+
+        ss << "{\"post\":{\"uri\":\"at://did:plc:a/app.bsky.feed.post/" << i << "\",\"cid\":\"cid" << i << "\","
+           << "\"author\":{\"did\":\"did:plc:a\",\"handle\":\"a.bsky.social\"},"
+           << "\"record\":{\"text\":\"post " << i << "\",\"createdAt\":\"2024-01-01T00:00:00.000Z\"},"
+           << "\"indexedAt\":\"2024-01-01T00:00:01.000Z\"}}";
+    }
+    ss << ']';
+    if (!cursor.empty())
+        ss << ",\"cursor\":\"" << cursor << '"';
+    ss << '}';
+
+    return ss.str();
+}
+
 TEST_F(BlueskyClientTest, FilterTextTest) {
-    std::string input = "Hello 'world' with "quotes" and emoji 👋";
+    std::string input = "Hello ‘world’ with “quotes” and emoji 👋";
     std::string expected = "Hello 'world' with \"quotes\" and emoji ";
     EXPECT_EQ(BlueskyClient::filterText(input), expected);
 }
@@ -36,3 +101,1977 @@ TEST_F(BlueskyClientTest, LoginFailureTest) {
 TEST_F(BlueskyClientTest, UnreadCountNoLoginTest) {
     EXPECT_EQ(client.getUnreadCount(), -1);
 }
+
+TEST_F(BlueskyClientTest, FeedStreamNoLoginTest) {
+    BlueskyFeedStream stream(client, BlueskyFeedStream::Source_Author, "bsky.app", 10);
+
+    BlueskyClient::PostsResult page;
+    ASSERT_TRUE(stream.next(page));
+    EXPECT_EQ(page.error, BlueskyClient::Error_NotLoggedIn);
+    EXPECT_FALSE(stream.next(page));
+    EXPECT_TRUE(stream.cursor().empty());
+}
+
+TEST_F(BlueskyClientTest, FeedStreamMockTest) {
+    MockPdsServer pds;
+    pds.get("app.bsky.feed.getAuthorFeed", [](const httplib::Request& request, httplib::Response& response) {
+        const std::string cursor = request.get_param_value("cursor");
+        if (cursor.empty())
+            response.set_content(mockFeedPage(0, 2, "c1"), "application/json");
+        else if (cursor == "c1")
+            response.set_content(mockFeedPage(2, 2, "c2"), "application/json");
+        else
+            response.set_content(mockFeedPage(4, 1, std::string()), "application/json");
+    });
+
+    BlueskyClient mock(pds.url());
+    ASSERT_TRUE(mock.login("user0.bsky.social", "password"));
+
+    {
+        BlueskyFeedStream stream(mock, BlueskyFeedStream::Source_Author, "a.bsky.social", 2);
+
+        BlueskyClient::PostsResult page;
+        ASSERT_TRUE(stream.next(page));
+        EXPECT_EQ(page.error, BlueskyClient::Error_None);
+        ASSERT_EQ(page.posts.size(), 2u);
+        EXPECT_EQ(page.posts[0].text, "post 0");
+        EXPECT_EQ(page.posts[1].text, "post 1");
+        EXPECT_EQ(stream.cursor(), "c1");
+
+        ASSERT_TRUE(stream.next(page));
+        ASSERT_EQ(page.posts.size(), 2u);
+        EXPECT_EQ(page.posts[0].text, "post 2");
+        EXPECT_EQ(stream.cursor(), "c2");
+
+        // The last page comes without a cursor and ends the stream
+        ASSERT_TRUE(stream.next(page));
+        ASSERT_EQ(page.posts.size(), 1u);
+        EXPECT_EQ(page.posts[0].text, "post 4");
+        EXPECT_FALSE(stream.next(page));
+    }
+
+    // Each request carried the cursor of the page before it
+    std::vector<std::string> cursors;
+    for (const MockPdsServer::Request& request : pds.requests()) {
+        if (request.endpoint != "app.bsky.feed.getAuthorFeed")
+            continue;
+
+        auto cursor = request.params.find("cursor");
+        cursors.push_back(cursor != request.params.end() ? cursor->second : std::string());
+
+        auto actor = request.params.find("actor");
+        ASSERT_NE(actor, request.params.end());
+        EXPECT_EQ(actor->second, "a.bsky.social");
+    }
+    EXPECT_EQ(cursors, std::vector<std::string>({ "", "c1", "c2" }));
+
+    // Resuming from a saved cursor skips the pages before it
+    BlueskyFeedStream resumed(mock, BlueskyFeedStream::Source_Author, "a.bsky.social", 2, 2, "c1");
+
+    BlueskyClient::PostsResult page;
+    ASSERT_TRUE(resumed.next(page));
+    ASSERT_EQ(page.posts.size(), 2u);
+    EXPECT_EQ(page.posts[0].text, "post 2");
+    EXPECT_EQ(resumed.cursor(), "c2");
+}
+
+TEST_F(BlueskyClientTest, ParseFeedTest) {
+    const std::string json =
+        "{\"cursor\":\"abc\",\"feed\":["
+        "{\"post\":{\"uri\":\"at://did:plc:a/app.bsky.feed.post/1\",\"cid\":\"cid1\","
+        "\"author\":{\"did\":\"did:plc:a\",\"handle\":\"a.bsky.social\",\"viewer\":{\"muted\":true}},"
+        "\"record\":{\"text\":\"first\",\"createdAt\":\"2024-01-01T00:00:00.000Z\"},"
+        "\"likeCount\":3,\"replyCount\":1,\"indexedAt\":\"2024-01-01T00:00:01.000Z\"}},"
+        "{\"post\":{\"uri\":\"at://did:plc:b/app.bsky.feed.post/2\",\"cid\":\"cid2\","
+        "\"author\":{\"did\":\"did:plc:b\",\"handle\":\"b.bsky.social\",\"displayName\":\"B\"},"
+        "\"record\":{\"text\":\"second\"}}}"
+        "]}";
+
+    BlueskyClient::PostsResult result = BlueskyClient::parseFeed(json);
+    ASSERT_EQ(result.error, BlueskyClient::Error_None);
+    ASSERT_EQ(result.posts.size(), 2u);
+    EXPECT_EQ(result.cursor, "abc");
+
+    EXPECT_EQ(result.posts[0].uri, "at://did:plc:a/app.bsky.feed.post/1");
+    EXPECT_EQ(result.posts[0].text, "first");
+    EXPECT_EQ(result.posts[0].likeCount, 3u);
+    EXPECT_EQ(result.posts[0].replyCount, 1u);
+    EXPECT_EQ(result.posts[0].createdAt, 1704067200);
+    EXPECT_EQ(result.posts[0].indexedAt, 1704067201);
+    EXPECT_EQ(result.posts[0].indexedAtTime.microseconds(), 1704067201000000LL);
+    EXPECT_TRUE(result.posts[0].author.mutedByViewer);
+
+    EXPECT_EQ(result.posts[1].author.displayName, "B");
+    EXPECT_EQ(result.posts[1].text, "second");
+    EXPECT_EQ(result.posts[1].likeCount, 0u);
+    EXPECT_FALSE(result.posts[1].createdAtTime.valid());
+
+    EXPECT_EQ(BlueskyClient::parseFeed("{not json").error, BlueskyClient::Error_ResponseParseFail);
+}
+
+TEST_F(BlueskyClientTest, FeedViewTest) {
+    std::string json =
+        "{\"feed\":[{\"post\":{\"uri\":\"at://did:plc:a/app.bsky.feed.post/1\","
+        "\"author\":{\"did\":\"did:plc:a\",\"handle\":\"a.bsky.social\"},"
+        "\"record\":{\"text\":\"hello \\\"world\\\"\"},\"likeCount\":7}}],\"cursor\":\"next\"}";
+
+    BlueskyClient::FeedView view = BlueskyClient::FeedView::parse(json);
+    ASSERT_EQ(view.error(), BlueskyClient::Error_None);
+    ASSERT_EQ(view.size(), 1u);
+    EXPECT_EQ(view.cursor(), std::string("next"));
+
+    BlueskyClient::FeedView moved(std::move(view));
+    EXPECT_EQ(moved[0].author().did(), std::string("did:plc:a"));
+    EXPECT_EQ(moved[0].text(), std::string("hello \"world\""));
+    EXPECT_TRUE(moved[0].author().displayName().empty());
+    EXPECT_EQ(moved[0].likeCount(), 7u);
+
+    BlueskyClient::Post post = moved[0].toPost();
+    EXPECT_EQ(post.uri, "at://did:plc:a/app.bsky.feed.post/1");
+    EXPECT_EQ(post.author.handle, "a.bsky.social");
+
+    EXPECT_EQ(BlueskyClient::FeedView::parse("[").error(), BlueskyClient::Error_ResponseParseFail);
+}
+
+TEST_F(BlueskyClientTest, ConnectionPoolBoundTest) {
+    BlueskyConnectionPool pool("https://bsky.social", 2);
+
+    std::unique_ptr<BlueskyConnectionPool::Lease> first(new BlueskyConnectionPool::Lease(pool.acquire()));
+    BlueskyConnectionPool::Lease second = pool.acquire();
+
+    std::atomic<bool> acquired(false);
+    std::thread waiter([&] {
+        BlueskyConnectionPool::Lease third = pool.acquire();
+        acquired = true;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(acquired);
+
+    first.reset();
+    waiter.join();
+    EXPECT_TRUE(acquired);
+}
+
+TEST_F(BlueskyClientTest, ConcurrentNoLoginTest) {
+    std::vector<std::thread> threads;
+    std::atomic<int> failures(0);
+
+    for (int i = 0; i < 8; i++) {
+        threads.emplace_back([&] {
+            if (client.getUnreadCount() != -1 || client.isLoggedIn())
+                failures++;
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(failures, 0);
+}
+
+TEST_F(BlueskyClientTest, ExecutorMapTest) {
+    BlueskyExecutor executor(3);
+
+    std::vector<int> inputs;
+    for (int i = 0; i < 50; i++)
+        inputs.push_back(i);
+
+    std::vector<int> squares = executor.map(inputs, [](int i) { return i * i; });
+    ASSERT_EQ(squares.size(), inputs.size());
+    for (int i = 0; i < 50; i++)
+        EXPECT_EQ(squares[i], i * i);
+
+    EXPECT_EQ(executor.submit([] { return 42; }).get(), 42);
+}
+
+TEST_F(BlueskyClientTest, AsyncNoLoginTest) {
+    EXPECT_EQ(client.getUnreadCountAsync().get(), -1);
+    EXPECT_EQ(client.createPostAsync("hello").get(), BlueskyClient::Error_NotLoggedIn);
+
+    std::promise<BlueskyClient::Error> done;
+    client.getFeedPostsAsync("feed", 1, "", [&](BlueskyClient::PostsResult result) {
+        done.set_value(result.error);
+    });
+    EXPECT_EQ(done.get_future().get(), BlueskyClient::Error_NotLoggedIn);
+
+    std::vector<BlueskyClient::PostsResult> results = client.getAuthorPostsBatch({ "a", "b", "c" });
+    ASSERT_EQ(results.size(), 3u);
+    for (const auto& result : results)
+        EXPECT_EQ(result.error, BlueskyClient::Error_NotLoggedIn);
+}
+
+TEST_F(BlueskyClientTest, AsyncWorkerThreadsTest) {
+    // Replacing the executor while calls are queued on it
+    std::atomic<bool> stop(false);
+    std::thread resizer([&] {
+        for (unsigned i = 0; !stop; i++)
+            client.setWorkerThreads(1 + i % 4);
+    });
+
+    std::vector<std::future<int>> counts;
+    for (int i = 0; i < 200; i++)
+        counts.push_back(client.getUnreadCountAsync());
+    for (auto& count : counts)
+        EXPECT_EQ(count.get(), -1);
+
+    stop = true;
+    resizer.join();
+
+    // Calls still pending when the client goes away finish before the rest
+    // of it is torn down
+    std::atomic<int> finished(0);
+    {
+        BlueskyClient doomed;
+        for (int i = 0; i < 50; i++) {
+            doomed.createPostAsync("hello", [&finished](BlueskyClient::Error error) {
+                if (error == BlueskyClient::Error_NotLoggedIn)
+                    finished++;
+            });
+        }
+    }
+    EXPECT_EQ(finished, 50);
+}
+
+TEST_F(BlueskyClientTest, RateLimiterTest) {
+    EXPECT_EQ(BlueskyRateLimiter::classify("xrpc/com.atproto.server.createSession"), BlueskyRateLimiter::EndpointClass_Session);
+    EXPECT_EQ(BlueskyRateLimiter::classify("xrpc/com.atproto.repo.createRecord"), BlueskyRateLimiter::EndpointClass_Write);
+    EXPECT_EQ(BlueskyRateLimiter::classify("xrpc/app.bsky.feed.getFeed"), BlueskyRateLimiter::EndpointClass_Read);
+
+    BlueskyRateLimiter limiter;
+
+    // Nothing reported yet, nothing to wait for
+    EXPECT_EQ(limiter.reserve(BlueskyRateLimiter::EndpointClass_Read).count(), 0);
+
+    httplib::Response response;
+    response.status = 200;
+    response.set_header("RateLimit-Limit", "10");
+    response.set_header("RateLimit-Remaining", "1");
+    response.set_header("RateLimit-Reset", std::to_string(time(nullptr) + 10));
+    response.set_header("RateLimit-Policy", "10;w=10");
+    limiter.update(BlueskyRateLimiter::EndpointClass_Read, response);
+
+    EXPECT_EQ(limiter.reserve(BlueskyRateLimiter::EndpointClass_Read).count(), 0);
+    auto wait = limiter.reserve(BlueskyRateLimiter::EndpointClass_Read).count();
+    EXPECT_GT(wait, 500);
+    EXPECT_LE(wait, 10000);
+
+    // Other classes are unaffected
+    EXPECT_EQ(limiter.reserve(BlueskyRateLimiter::EndpointClass_Write).count(), 0);
+
+    httplib::Response tooMany;
+    tooMany.status = 429;
+    tooMany.set_header("Retry-After", "3");
+    auto retry = limiter.backoff(0, tooMany).count();
+    EXPECT_GE(retry, 3000);
+    EXPECT_LE(retry, 3250);
+
+    httplib::Response bare;
+    bare.status = 429;
+    EXPECT_LE(limiter.backoff(0, bare).count(), 500);
+    EXPECT_GE(limiter.backoff(3, bare).count(), 2000);
+    EXPECT_LE(limiter.backoff(20, bare).count(), 30000);
+}
+
+TEST_F(BlueskyClientTest, WriteBatchNoLoginTest) {
+    BlueskyWriteBatch batch(client);
+
+    for (int i = 0; i < 450; i++)
+        batch.createPost("post " + std::to_string(i));
+    batch.remove("app.bsky.feed.post", "3kabc");
+    EXPECT_EQ(batch.size(), 451u);
+
+    // Records that are not objects are never queued
+    EXPECT_FALSE(batch.create("app.bsky.feed.post", "42"));
+    EXPECT_FALSE(batch.update("app.bsky.feed.post", "3kabc", "{"));
+    EXPECT_TRUE(batch.update("app.bsky.feed.post", "3kabc", "{\"text\":\"edited\"}"));
+    EXPECT_EQ(batch.size(), 452u);
+
+    // The first chunk was never sent, so nothing after it is sent and all
+    // stay queued
+    std::vector<BlueskyClient::WriteResult> results = batch.flush();
+    ASSERT_EQ(results.size(), BlueskyClient::MAX_WRITES_PER_REQUEST);
+    for (const auto& result : results) {
+        EXPECT_EQ(result.error, BlueskyClient::Error_NotLoggedIn);
+        EXPECT_TRUE(result.retryable);
+    }
+    EXPECT_EQ(batch.size(), 452u);
+
+    batch.clear();
+    EXPECT_TRUE(batch.empty());
+
+    std::vector<BlueskyClient::WriteOp> tooMany(BlueskyClient::MAX_WRITES_PER_REQUEST + 1);
+    EXPECT_EQ(client.applyWrites(tooMany).size(), tooMany.size());
+}
+
+TEST_F(BlueskyClientTest, WriteBatchMockTest) {
+    MockPdsServer pds;
+
+    // Answers with one result per write, named after its rkey. The second
+    // request fails with a 500, after which the writes may have been applied;
+    // the third is refused with a 400, so nothing was.
+    std::atomic<int> requests(0);
+    pds.post("com.atproto.repo.applyWrites", [&requests](const httplib::Request& request, httplib::Response& response) {
+        const int number = ++requests;
+        if (number == 2) {
+            MockPdsServer::fail(500)(request, response);
+            return;
+        }
+        if (number == 3) {
+            MockPdsServer::fail(400, "InvalidRequest")(request, response);
+            return;
+        }
+
+        std::string results;
+        for (size_t at = request.body.find("\"rkey\":\""); at != std::string::npos; at = request.body.find("\"rkey\":\"", at + 1)) {
+            const size_t start = at + 8;
+            const std::string rkey = request.body.substr(start, request.body.find('"', start) - start);
+
+            if (!results.empty())
+                results += ',';
+            results += "{\"uri\":\"at://did:plc:a/app.bsky.feed.post/" + rkey + "\",\"cid\":\"cid-" + rkey + "\"}";
+        }
+        response.set_content("{\"results\":[" + results + "]}", "application/json");
+    });
+
+    BlueskyClient mock(pds.url());
+    ASSERT_TRUE(mock.login("user0.bsky.social", "password"));
+
+    BlueskyWriteBatch batch(mock, 3);
+    for (int i = 0; i < 7; i++)
+        batch.create("app.bsky.feed.post", "{\"text\":\"post " + std::to_string(i) + "\"}", "r" + std::to_string(i));
+
+    // The first chunk goes through and the second fails; it may have been
+    // applied, so it is dropped instead of resent. The third waits.
+    std::vector<BlueskyClient::WriteResult> results = batch.flush();
+    ASSERT_EQ(results.size(), 6u);
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(results[i].error, BlueskyClient::Error_None);
+        EXPECT_EQ(results[i].uri, "at://did:plc:a/app.bsky.feed.post/r" + std::to_string(i));
+    }
+    for (int i = 3; i < 6; i++) {
+        EXPECT_EQ(results[i].error, BlueskyClient::Error_ResponseFail);
+        EXPECT_FALSE(results[i].retryable);
+    }
+    EXPECT_EQ(batch.size(), 1u);
+
+    // A refused chunk stays queued
+    results = batch.flush();
+    ASSERT_EQ(results.size(), 1u);
+    EXPECT_EQ(results[0].error, BlueskyClient::Error_ResponseFail);
+    EXPECT_TRUE(results[0].retryable);
+    EXPECT_EQ(batch.size(), 1u);
+
+    results = batch.flush();
+    ASSERT_EQ(results.size(), 1u);
+    EXPECT_EQ(results[0].error, BlueskyClient::Error_None);
+    EXPECT_EQ(results[0].uri, "at://did:plc:a/app.bsky.feed.post/r6");
+    EXPECT_TRUE(batch.empty());
+
+    // Chunks of at most three, in the order the operations were added
+    std::vector<std::string> sent;
+    for (const MockPdsServer::Request& request : pds.requests()) {
+        if (request.endpoint != "com.atproto.repo.applyWrites")
+            continue;
+
+        // rkeys in the order they appear in the request
+        std::string rkeys;
+        for (size_t at = request.body.find("\"rkey\":\"r"); at != std::string::npos; at = request.body.find("\"rkey\":\"r", at + 1))
+            rkeys += request.body[at + 9];
+        sent.push_back(rkeys);
+    }
+    EXPECT_EQ(sent, std::vector<std::string>({ "012", "345", "6", "6" }));
+}
+
+TEST_F(BlueskyClientTest, JsonBuilderTest) {
+    EXPECT_EQ(
+        BlueskyClient::createJsonString({ { "a", "quote \" and\nnewline" }, { "b", "" } }),
+        "{\"a\":\"quote \\\" and\\nnewline\",\"b\":\"\"}"
+    );
+
+    BlueskyClient::PostRecord record;
+    record.text = "Hi @alice \"quoted\"";
+    record.langs.push_back("en");
+    record.facets.push_back({ BlueskyClient::Facet::Type_Mention, 3, 9, "did:plc:alice" });
+    record.replyParent = { "at://did:plc:a/app.bsky.feed.post/1", "cid1" };
+    record.quote = { "at://did:plc:b/app.bsky.feed.post/2", "cid2" };
+
+    BlueskyJsonBuilder builder;
+    for (int i = 0; i < 3; i++) {
+        BlueskyJsonBuilder::Object root = builder.begin();
+        BlueskyClient::writePostRecord(root, record);
+        const std::string& json = builder.finish();
+
+        EXPECT_NE(json.find("\"text\":\"Hi @alice \\\"quoted\\\"\""), std::string::npos);
+        EXPECT_NE(json.find("\"langs\":[\"en\"]"), std::string::npos);
+        EXPECT_NE(json.find("\"index\":{\"byteStart\":3,\"byteEnd\":9}"), std::string::npos);
+        EXPECT_NE(json.find("\"features\":[{\"$type\":\"app.bsky.richtext.facet#mention\",\"did\":\"did:plc:alice\"}]"), std::string::npos);
+        EXPECT_NE(json.find("\"root\":{\"uri\":\"at://did:plc:a/app.bsky.feed.post/1\",\"cid\":\"cid1\"}"), std::string::npos);
+        EXPECT_NE(json.find("\"embed\":{\"$type\":\"app.bsky.embed.record\""), std::string::npos);
+    }
+
+    BlueskyJsonBuilder::Object root = builder.begin();
+    EXPECT_TRUE(root.addJson("value", "{\"nested\":[1,2,{\"x\":null}]}"));
+    EXPECT_FALSE(root.addJson("broken", "{"));
+    EXPECT_FALSE(root.addJsonObject("number", "42"));
+    EXPECT_FALSE(root.addJsonObject("array", "[]"));
+    EXPECT_TRUE(root.addJsonObject("object", "{}"));
+    EXPECT_EQ(builder.finish(), "{\"value\":{\"nested\":[1,2,{\"x\":null}]},\"object\":{}}");
+}
+
+TEST_F(BlueskyClientTest, ApplyWritesRecordTest) {
+    MockPdsServer pds;
+    pds.post("com.atproto.repo.applyWrites", MockPdsServer::reply("{\"results\":[{}]}"));
+
+    BlueskyClient mock(pds.url());
+    ASSERT_TRUE(mock.login("user0.bsky.social", "password"));
+
+    // Records that are not objects never reach the server
+    for (const char* record : { "42", "[]", "\"text\"", "{" }) {
+        std::vector<BlueskyClient::WriteOp> ops(1);
+        ops[0].action = BlueskyClient::WriteAction_Create;
+        ops[0].collection = "app.bsky.feed.post";
+        ops[0].record = record;
+
+        std::vector<BlueskyClient::WriteResult> results = mock.applyWrites(ops);
+        ASSERT_EQ(results.size(), 1u);
+        EXPECT_EQ(results[0].error, BlueskyClient::Error_BadInput) << record;
+    }
+    EXPECT_EQ(pds.count("com.atproto.repo.applyWrites"), 0u);
+
+    std::vector<BlueskyClient::WriteOp> ops(1);
+    ops[0].action = BlueskyClient::WriteAction_Create;
+    ops[0].collection = "app.bsky.feed.post";
+    ops[0].record = "{\"text\":\"hi\"}";
+    EXPECT_EQ(mock.applyWrites(ops)[0].error, BlueskyClient::Error_None);
+    EXPECT_EQ(pds.count("com.atproto.repo.applyWrites"), 1u);
+}
+
+TEST_F(BlueskyClientTest, MetricsTest) {
+    struct CountingSink : BlueskyMetrics::Sink {
+        std::atomic<int> samples{0};
+        void record(const BlueskyMetrics::Sample&) override { samples++; }
+    };
+
+    BlueskyMetrics metrics;
+    std::shared_ptr<CountingSink> sink(new CountingSink());
+    metrics.setSink(sink);
+
+    BlueskyMetrics::Sample sample;
+    sample.endpoint = "xrpc/app.bsky.feed.getFeed";
+    sample.status = 200;
+    sample.newConnection = true;
+    sample.micros[BlueskyMetrics::Phase_Connect] = 1000;
+    sample.micros[BlueskyMetrics::Phase_Total] = 3000;
+    sample.responseBytes = 4096;
+    metrics.record(sample);
+
+    sample.status = 429;
+    sample.attempt = 1;
+    sample.newConnection = false;
+    metrics.record(sample);
+
+    EXPECT_EQ(sink->samples.load(), 2);
+
+    BlueskyMetrics::Snapshot snapshot = metrics.snapshot();
+    ASSERT_EQ(snapshot.count("xrpc/app.bsky.feed.getFeed"), 1u);
+
+    const BlueskyMetrics::EndpointStats& stats = snapshot["xrpc/app.bsky.feed.getFeed"];
+    EXPECT_EQ(stats.requests, 2u);
+    EXPECT_EQ(stats.retries, 1u);
+    EXPECT_EQ(stats.newConnections, 1u);
+    EXPECT_EQ(stats.responseBytes, 8192u);
+    EXPECT_EQ(stats.statuses.at(429), 1u);
+    EXPECT_EQ(stats.latency[BlueskyMetrics::Phase_Connect].count, 1u);
+    EXPECT_EQ(stats.latency[BlueskyMetrics::Phase_FirstByte].count, 1u);
+    EXPECT_EQ(stats.latency[BlueskyMetrics::Phase_Total].max, 3000u);
+    EXPECT_EQ(stats.latency[BlueskyMetrics::Phase_Total].quantile(0.5), 3000u);
+
+    // The 429 was not parsed; neither attempt got a parse of zero
+    EXPECT_EQ(stats.latency[BlueskyMetrics::Phase_Transfer].count, 2u);
+    EXPECT_EQ(stats.latency[BlueskyMetrics::Phase_Parse].count, 1u);
+
+    // Without a response only the wait and the total ran; a resend after a
+    // refresh is not a rate-limit retry
+    sample.status = -1;
+    sample.attempt = 1;
+    sample.refreshRetry = true;
+    metrics.record(sample);
+
+    snapshot = metrics.snapshot();
+    const BlueskyMetrics::EndpointStats& failed = snapshot["xrpc/app.bsky.feed.getFeed"];
+    EXPECT_EQ(failed.requests, 3u);
+    EXPECT_EQ(failed.retries, 1u);
+    EXPECT_EQ(failed.refreshRetries, 1u);
+    EXPECT_EQ(failed.failures, 1u);
+    EXPECT_EQ(failed.latency[BlueskyMetrics::Phase_Wait].count, 3u);
+    EXPECT_EQ(failed.latency[BlueskyMetrics::Phase_Total].count, 3u);
+    EXPECT_EQ(failed.latency[BlueskyMetrics::Phase_FirstByte].count, 1u);
+    EXPECT_EQ(failed.latency[BlueskyMetrics::Phase_Transfer].count, 2u);
+
+    // The client records every attempt, including ones without a response
+    client.login("invalid-user", "invalid-password");
+    EXPECT_EQ(client.metrics().snapshot().count("xrpc/com.atproto.server.createSession"), 1u);
+}
+
+TEST_F(BlueskyClientTest, SessionImportExportTest) {
+    // Payload is {"sub":"did:plc:test","exp":4102444800}
+    const std::string accessJwt = "eyJhbGciOiJIUzI1NiJ9.eyJzdWIiOiJkaWQ6cGxjOnRlc3QiLCJleHAiOjQxMDI0NDQ4MDB9.c2ln";
+
+    EXPECT_EQ(client.exportSession(), "");
+    EXPECT_FALSE(client.importSession("{\"did\":\"did:plc:test\"}"));
+    EXPECT_FALSE(client.importSession("{not json"));
+    EXPECT_FALSE(client.isLoggedIn());
+
+    const std::string session =
+        "{\"accessJwt\":\"" + accessJwt + "\",\"refreshJwt\":\"refresh\","
+        "\"did\":\"did:plc:test\",\"handle\":\"test.bsky.social\"}";
+
+    ASSERT_TRUE(client.importSession(session));
+    EXPECT_TRUE(client.isLoggedIn());
+    EXPECT_EQ(client.getDid(), "did:plc:test");
+    EXPECT_EQ(client.getHandle(), "test.bsky.social");
+    EXPECT_EQ(client.getSessionExpiry(), (time_t)4102444800);
+
+    BlueskyClient restored;
+    ASSERT_TRUE(restored.importSession(client.exportSession()));
+    EXPECT_EQ(restored.getDid(), "did:plc:test");
+    EXPECT_EQ(restored.getSessionExpiry(), (time_t)4102444800);
+}
+
+// A session whose access token expires at expiry
+static std::string sessionExpiringAt(time_t expiry) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+    const std::string payload = "{\"sub\":\"did:plc:test\",\"exp\":" + std::to_string(expiry) + "}";
+
+    // Unpadded base64url
+    std::string encoded;
+    for (size_t i = 0; i < payload.size(); i += 3) {
+        const size_t count = std::min(payload.size() - i, (size_t)3);
+
+        uint32_t bits = 0;
+        for (size_t j = 0; j < 3; j++)
+            bits = bits << 8 | (j < count ? (unsigned char)payload[i + j] : 0);
+
+        for (size_t j = 0; j <= count; j++)
+            encoded += alphabet[bits >> (18 - 6 * j) & 63];
+    }
+
+    return "{\"accessJwt\":\"eyJhbGciOiJIUzI1NiJ9." + encoded + ".c2ln\",\"refreshJwt\":\"refresh\","
+           "\"did\":\"did:plc:test\",\"handle\":\"test.bsky.social\"}";
+}
+
+TEST_F(BlueskyClientTest, SessionRefreshMockTest) {
+    MockPdsServer pds;
+    pds.post("com.atproto.server.refreshSession", MockPdsServer::fail(500));
+    pds.get("app.bsky.notification.getUnreadCount", MockPdsServer::reply("{\"count\":3}"));
+
+    BlueskyClient mock(pds.url());
+
+    // Expired, and the server fails the refresh: calls after the first one
+    // fail fast instead of asking again
+    ASSERT_TRUE(mock.importSession(sessionExpiringAt(time(nullptr) - 60)));
+    ASSERT_NE(mock.getSessionExpiry(), 0);
+    for (int i = 0; i < 5; i++)
+        mock.getUnreadCount();
+    EXPECT_EQ(pds.count("com.atproto.server.refreshSession"), 1u);
+
+    // An explicit refresh always asks
+    EXPECT_FALSE(mock.refreshSession());
+    EXPECT_EQ(pds.count("com.atproto.server.refreshSession"), 2u);
+
+    // About to expire: the background refresh goes ahead of the async calls
+    // queued behind the one that noticed
+    pds.post("com.atproto.server.refreshSession", MockPdsServer::reply(MockPdsServer::session()));
+    pds.setLatency(std::chrono::milliseconds(10));
+    mock.setWorkerThreads(1);
+    ASSERT_TRUE(mock.importSession(sessionExpiringAt(time(nullptr) + 60)));
+
+    const size_t before = pds.requests().size();
+
+    std::vector<std::future<int>> counts;
+    for (int i = 0; i < 20; i++)
+        counts.push_back(mock.getUnreadCountAsync());
+    for (auto& count : counts)
+        EXPECT_EQ(count.get(), 3);
+
+    const std::vector<MockPdsServer::Request> requests = pds.requests();
+    ASSERT_EQ(requests.size(), before + 21);
+    EXPECT_EQ(requests[before].endpoint, "app.bsky.notification.getUnreadCount");
+    EXPECT_EQ(requests[before + 1].endpoint, "com.atproto.server.refreshSession");
+    EXPECT_EQ(mock.getDid(), "did:plc:abcdefghijklmnopqrstu0");
+}
+
+TEST_F(BlueskyClientTest, TtlCacheTest) {
+    BlueskyTtlCache<std::string> cache(2);
+    std::string value;
+    bool found = false;
+
+    EXPECT_FALSE(cache.get("alice.bsky.social", value, found));
+
+    cache.put("alice.bsky.social", "did:plc:alice", std::chrono::seconds(60));
+    cache.putNegative("nobody.bsky.social", std::chrono::seconds(60));
+
+    ASSERT_TRUE(cache.get("alice.bsky.social", value, found));
+    EXPECT_TRUE(found);
+    EXPECT_EQ(value, "did:plc:alice");
+
+    ASSERT_TRUE(cache.get("nobody.bsky.social", value, found));
+    EXPECT_FALSE(found);
+
+    // alice was used least recently and makes room for bob
+    cache.get("nobody.bsky.social", value, found);
+    cache.put("bob.bsky.social", "did:plc:bob", std::chrono::seconds(60));
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_FALSE(cache.get("alice.bsky.social", value, found));
+
+    cache.put("expired.bsky.social", "did:plc:expired", std::chrono::seconds(0));
+    EXPECT_FALSE(cache.get("expired.bsky.social", value, found));
+}
+
+TEST_F(BlueskyClientTest, SingleFlightTest) {
+    BlueskySingleFlight<int> flight;
+    std::atomic<int> calls(0);
+    std::atomic<bool> release(false);
+
+    std::vector<std::thread> threads;
+    std::vector<int> results(4, 0);
+
+    for (size_t i = 0; i < results.size(); i++) {
+        threads.emplace_back([&, i] {
+            results[i] = flight.run("did:plc:alice", [&] {
+                calls++;
+                while (!release)
+                    std::this_thread::yield();
+                return 42;
+            });
+        });
+    }
+
+    // Let the other threads queue up behind the first call
+    while (flight.inFlight() == 0)
+        std::this_thread::yield();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    release = true;
+
+    for (auto& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(calls.load(), 1);
+    for (int result : results)
+        EXPECT_EQ(result, 42);
+    EXPECT_EQ(flight.inFlight(), 0u);
+}
+
+TEST_F(BlueskyClientTest, SingleFlightThrowTest) {
+    BlueskySingleFlight<int> flight;
+    std::atomic<bool> release(false);
+
+    std::vector<std::thread> threads;
+    std::atomic<int> thrown(0);
+
+    // Callers waiting on a call that throws get the same exception
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&] {
+            try {
+                flight.run("did:plc:alice", [&] () -> int {
+                    while (!release)
+                        std::this_thread::yield();
+                    throw std::runtime_error("lookup failed");
+                });
+            }
+            catch (const std::runtime_error& error) {
+                if (std::string(error.what()) == "lookup failed")
+                    thrown++;
+            }
+        });
+    }
+
+    while (flight.inFlight() == 0)
+        std::this_thread::yield();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    release = true;
+
+    for (auto& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(thrown.load(), 4);
+    EXPECT_EQ(flight.inFlight(), 0u);
+    EXPECT_EQ(flight.run("did:plc:alice", [] { return 1; }), 1);
+}
+
+TEST_F(BlueskyClientTest, SingleFlightWindowTest) {
+    BlueskySingleFlight<int> flight;
+    flight.setWindow(std::chrono::milliseconds(200));
+
+    int calls = 0;
+    const auto fn = [&calls] { return ++calls; };
+
+    bool shared = true;
+    EXPECT_EQ(flight.run("getUnreadCount", fn, &shared), 1);
+    EXPECT_FALSE(shared);
+    EXPECT_EQ(flight.inFlight(), 0u);
+
+    // Finished, but still within the window
+    EXPECT_EQ(flight.run("getUnreadCount", fn, &shared), 1);
+    EXPECT_TRUE(shared);
+    EXPECT_EQ(flight.run("getFeed", fn, &shared), 2);
+    EXPECT_FALSE(shared);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    EXPECT_EQ(flight.run("getUnreadCount", fn, &shared), 3);
+    EXPECT_FALSE(shared);
+
+    // A call that throws is not kept
+    EXPECT_THROW(flight.run("throws", [] () -> int { throw 1; }), int);
+    EXPECT_EQ(flight.run("throws", fn), 4);
+
+    flight.setWindow(std::chrono::milliseconds(0));
+    EXPECT_EQ(flight.run("getUnreadCount", fn), 5);
+    EXPECT_EQ(flight.run("getUnreadCount", fn), 6);
+
+    // Coalescing on a client is opt-in and can take a window
+    client.setRequestCoalescing(true, std::chrono::milliseconds(100));
+    EXPECT_EQ(client.getUnreadCount(), -1);
+    EXPECT_EQ(client.coalescedRequests(), 0u);
+}
+
+TEST_F(BlueskyClientTest, CoalescingMockTest) {
+    MockPdsServer pds;
+    pds.get("app.bsky.feed.getAuthorFeed", MockPdsServer::reply(mockFeedPage(0, 3, "next")));
+    pds.get("app.bsky.feed.getFeed", MockPdsServer::fail(500));
+
+    BlueskyClient mock(pds.url(), 8);
+    ASSERT_TRUE(mock.login("user0.bsky.social", "password"));
+    mock.setRequestCoalescing(true);
+
+    // Slow enough that every caller arrives while the first request runs
+    pds.setLatency(std::chrono::milliseconds(300));
+
+    const auto callTogether = [](const std::function<void(int)>& call) {
+        std::atomic<int> ready(0);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 8; i++) {
+            threads.emplace_back([&, i] {
+                ready++;
+                while (ready < 8)
+                    std::this_thread::yield();
+                call(i);
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+    };
+
+    std::vector<BlueskyClient::PostsResult> pages(8);
+    callTogether([&](int i) { pages[i] = mock.getAuthorPosts("a.bsky.social", 3); });
+
+    EXPECT_EQ(pds.count("app.bsky.feed.getAuthorFeed"), 1u);
+    EXPECT_EQ(mock.coalescedRequests(), 7u);
+    for (const BlueskyClient::PostsResult& page : pages) {
+        ASSERT_EQ(page.error, BlueskyClient::Error_None);
+        ASSERT_EQ(page.posts.size(), 3u);
+        EXPECT_EQ(page.posts[2].text, "post 2");
+        EXPECT_EQ(page.cursor, "next");
+    }
+
+    // A failure is shared the same way
+    callTogether([&](int i) { pages[i] = mock.getFeedPosts("at://did:plc:a/app.bsky.feed.generator/x", 3); });
+
+    EXPECT_EQ(pds.count("app.bsky.feed.getFeed"), 1u);
+    for (const BlueskyClient::PostsResult& page : pages)
+        EXPECT_EQ(page.error, BlueskyClient::Error_ResponseFail);
+
+    // Different parameters are different requests
+    pds.setLatency(std::chrono::milliseconds(0));
+    mock.getAuthorPosts("a.bsky.social", 3, "next");
+    EXPECT_EQ(pds.count("app.bsky.feed.getAuthorFeed"), 2u);
+
+    // Off again, every call sends its own request
+    mock.setRequestCoalescing(false);
+    mock.getAuthorPosts("a.bsky.social", 3);
+    mock.getAuthorPosts("a.bsky.social", 3);
+    EXPECT_EQ(pds.count("app.bsky.feed.getAuthorFeed"), 4u);
+}
+
+TEST_F(BlueskyClientTest, ResponseCacheTest) {
+    BlueskyResponseCache cache(1000, std::chrono::milliseconds(0));
+    cache.setTtl("xrpc/app.bsky.notification.getUnreadCount", std::chrono::milliseconds(5000));
+
+    EXPECT_EQ(cache.ttl("xrpc/app.bsky.notification.getUnreadCount").count(), 5000);
+    EXPECT_EQ(cache.ttl("xrpc/app.bsky.feed.getFeed").count(), 0);
+
+    const auto makeEntry = [](int value, size_t bytes) {
+        BlueskyResponseCache::Entry entry;
+        entry.value = std::make_shared<int>(value);
+        entry.etag = "\"v" + std::to_string(value) + "\"";
+        entry.bytes = bytes;
+        entry.expiresAt = BlueskyResponseCache::Clock::now();
+        return entry;
+    };
+
+    BlueskyResponseCache::Entry entry;
+    EXPECT_FALSE(cache.get("a", entry));
+
+    cache.put("a", makeEntry(1, 400));
+    cache.put("b", makeEntry(2, 400));
+    ASSERT_TRUE(cache.get("a", entry)); // Now more recent than b
+    EXPECT_EQ(*std::static_pointer_cast<const int>(entry.value), 1);
+    EXPECT_EQ(entry.etag, "\"v1\"");
+
+    // Over 1000 bytes: the least recently used entry goes
+    cache.put("c", makeEntry(3, 400));
+    EXPECT_FALSE(cache.get("b", entry));
+    EXPECT_TRUE(cache.get("a", entry));
+    EXPECT_TRUE(cache.get("c", entry));
+
+    // Replacing an entry frees its old size
+    cache.put("c", makeEntry(4, 100));
+    ASSERT_TRUE(cache.get("c", entry));
+    EXPECT_EQ(*std::static_pointer_cast<const int>(entry.value), 4);
+
+    // An entry larger than the cache is not kept, and pushes nothing out
+    cache.put("huge", makeEntry(5, 2000));
+    EXPECT_FALSE(cache.get("huge", entry));
+    EXPECT_TRUE(cache.get("a", entry));
+
+    cache.recordHit();
+    cache.recordHit();
+    cache.recordRevalidated();
+    cache.recordMiss();
+
+    BlueskyResponseCache::Stats stats = cache.stats();
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.revalidated, 1u);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.evictions, 1u);
+    EXPECT_EQ(stats.entries, 2u);
+    EXPECT_EQ(stats.bytes, 500u);
+
+    cache.put("a", makeEntry(1, 10));
+    cache.erase("a");
+    EXPECT_FALSE(cache.get("a", entry));
+
+    cache.put("feed alice 1", makeEntry(6, 10));
+    cache.put("feed alice 2", makeEntry(7, 10));
+    cache.put("feed alicia", makeEntry(8, 10));
+    cache.erasePrefix("feed alice ");
+    EXPECT_FALSE(cache.get("feed alice 1", entry));
+    EXPECT_FALSE(cache.get("feed alice 2", entry));
+    EXPECT_TRUE(cache.get("feed alicia", entry));
+
+    cache.resetStats();
+    EXPECT_EQ(cache.stats().hits, 0u);
+
+    // Caching is off until a cache is set
+    EXPECT_EQ(client.responseCache(), nullptr);
+    std::shared_ptr<BlueskyResponseCache> shared(new BlueskyResponseCache());
+    client.setResponseCache(shared);
+    EXPECT_EQ(client.responseCache(), shared);
+    EXPECT_EQ(client.getUnreadCount(), -1);
+    EXPECT_EQ(shared->stats().misses, 0u);
+}
+
+TEST_F(BlueskyClientTest, ResponseCacheMockTest) {
+    MockPdsServer pds;
+    pds.get("app.bsky.notification.getUnreadCount", MockPdsServer::reply("{\"count\":3}"));
+    pds.get("app.bsky.feed.getAuthorFeed", MockPdsServer::reply(mockFeedPage(0, 2, "next"), "\"v1\""));
+    pds.get("app.bsky.feed.getFeed", MockPdsServer::fail(500));
+    pds.post("com.atproto.repo.createRecord", MockPdsServer::reply("{\"uri\":\"at://did:plc:abcdefghijklmnopqrstu0/app.bsky.feed.post/1\",\"cid\":\"cid\"}"));
+
+    BlueskyClient mock(pds.url());
+    ASSERT_TRUE(mock.login("user0.bsky.social", "password"));
+
+    // Revalidates everything except the unread count
+    std::shared_ptr<BlueskyResponseCache> cache(new BlueskyResponseCache());
+    cache->setTtl("xrpc/app.bsky.notification.getUnreadCount", std::chrono::seconds(60));
+    mock.setResponseCache(cache);
+
+    // Within the TTL: no request
+    EXPECT_EQ(mock.getUnreadCount(), 3);
+    EXPECT_EQ(mock.getUnreadCount(), 3);
+    EXPECT_EQ(pds.count("app.bsky.notification.getUnreadCount"), 1u);
+
+    BlueskyResponseCache::Stats stats = cache->stats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.revalidated, 0u);
+    EXPECT_EQ(stats.misses, 1u);
+
+    // Past the TTL with an ETag: asked with If-None-Match, reused on 304
+    const std::string self = "did:plc:abcdefghijklmnopqrstu0";
+    const BlueskyClient::PostsResult first = mock.getAuthorPosts(self, 2);
+    const BlueskyClient::PostsResult second = mock.getAuthorPosts(self, 2);
+    ASSERT_EQ(first.error, BlueskyClient::Error_None);
+    ASSERT_EQ(second.error, BlueskyClient::Error_None);
+    ASSERT_EQ(second.posts.size(), 2u);
+    EXPECT_EQ(second.posts[1].text, first.posts[1].text);
+    EXPECT_EQ(second.cursor, "next");
+
+    stats = cache->stats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.revalidated, 1u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.entries, 2u);
+    EXPECT_GT(stats.bytes, 0u);
+
+    // Failures are not cached
+    EXPECT_EQ(mock.getFeedPosts("at://did:plc:a/app.bsky.feed.generator/x", 2).error, BlueskyClient::Error_ResponseFail);
+    EXPECT_EQ(mock.getFeedPosts("at://did:plc:a/app.bsky.feed.generator/x", 2).error, BlueskyClient::Error_ResponseFail);
+    EXPECT_EQ(pds.count("app.bsky.feed.getFeed"), 2u);
+
+    stats = cache->stats();
+    EXPECT_EQ(stats.misses, 4u);
+    EXPECT_EQ(stats.entries, 2u);
+
+    // Another author's feed, to check it survives the post below
+    ASSERT_EQ(mock.getAuthorPosts("other.test", 2).error, BlueskyClient::Error_None);
+
+    // Posting drops the cached pages of the account's own feed, so the next
+    // call fetches it in full
+    EXPECT_EQ(mock.createPost("hello"), BlueskyClient::Error_None);
+    ASSERT_EQ(mock.getAuthorPosts(self, 2).error, BlueskyClient::Error_None);
+    ASSERT_EQ(mock.getAuthorPosts("other.test", 2).error, BlueskyClient::Error_None);
+
+    std::vector<std::string> ifNoneMatch;
+    for (const MockPdsServer::Request& request : pds.requests()) {
+        if (request.endpoint == "app.bsky.feed.getAuthorFeed")
+            ifNoneMatch.push_back(request.ifNoneMatch);
+    }
+    EXPECT_EQ(ifNoneMatch, std::vector<std::string>({ "", "\"v1\"", "", "", "\"v1\"" }));
+
+    stats = cache->stats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.revalidated, 2u);
+    EXPECT_EQ(stats.misses, 6u);
+}
+
+TEST_F(BlueskyClientTest, IdentityBadInputTest) {
+    BlueskyIdentity identity;
+    std::string did;
+    BlueskyIdentity::DidDocument document;
+
+    EXPECT_TRUE(BlueskyIdentity::isDid("did:plc:abc"));
+    EXPECT_FALSE(BlueskyIdentity::isDid("alice.bsky.social"));
+
+    EXPECT_EQ(identity.resolveHandle("@", did), BlueskyClient::Error_BadInput);
+    EXPECT_EQ(identity.resolveDid("alice.bsky.social", document), BlueskyClient::Error_BadInput);
+    EXPECT_EQ(identity.resolveDid("did:key:zQ3sh", document), BlueskyClient::Error_BadInput);
+    EXPECT_EQ(identity.pdsClient("did:key:zQ3sh"), nullptr);
+}
+
+TEST_F(BlueskyClientTest, IdentityNotFoundTest) {
+    MockPdsServer resolver;
+    resolver.get("com.atproto.identity.resolveHandle", [](const httplib::Request& request, httplib::Response& response) {
+        const std::string handle = request.get_param_value("handle");
+        if (handle == "alice.test")
+            response.set_content("{\"did\":\"did:plc:alice\"}", "application/json");
+        else if (handle == "missing.test")
+            MockPdsServer::fail(400, "InvalidRequest")(request, response);
+        else
+            MockPdsServer::fail(502)(request, response);
+    });
+
+    BlueskyIdentity identity(resolver.url());
+    std::string did;
+
+    EXPECT_EQ(identity.resolveHandle("@Alice.test", did), BlueskyClient::Error_None);
+    EXPECT_EQ(did, "did:plc:alice");
+
+    // A handle that does not exist is not found, also once it is cached
+    EXPECT_EQ(identity.resolveHandle("missing.test", did), BlueskyClient::Error_NotFound);
+    EXPECT_EQ(identity.resolveHandle("missing.test", did), BlueskyClient::Error_NotFound);
+
+    // A server error says nothing about the handle and is asked again
+    EXPECT_EQ(identity.resolveHandle("flaky.test", did), BlueskyClient::Error_ResponseFail);
+    EXPECT_EQ(identity.resolveHandle("flaky.test", did), BlueskyClient::Error_ResponseFail);
+
+    std::map<std::string, int> lookups;
+    for (const MockPdsServer::Request& request : resolver.requests()) {
+        auto handle = request.params.find("handle");
+        if (handle != request.params.end())
+            lookups[handle->second]++;
+    }
+    EXPECT_EQ(lookups["alice.test"], 1);
+    EXPECT_EQ(lookups["missing.test"], 1);
+    EXPECT_EQ(lookups["flaky.test"], 2);
+}
+
+TEST_F(BlueskyClientTest, HydratorNoLoginTest) {
+    EXPECT_EQ(client.getPosts(std::vector<std::string>()).error, BlueskyClient::Error_BadInput);
+    EXPECT_EQ(client.getPosts(std::vector<std::string>(26, "at://did:plc:a/app.bsky.feed.post/1")).error, BlueskyClient::Error_BadInput);
+    EXPECT_EQ(client.getProfiles({ "did:plc:a" }).error, BlueskyClient::Error_NotLoggedIn);
+
+    BlueskyHydrator hydrator(client, std::chrono::milliseconds(5));
+
+    // More keys than fit in one batch, with duplicates sharing a slot
+    std::vector<std::future<BlueskyHydrator::PostResult>> posts;
+    for (int i = 0; i < 60; i++)
+        posts.push_back(hydrator.getPost("at://did:plc:a/app.bsky.feed.post/" + std::to_string(i % 40)));
+
+    std::future<BlueskyHydrator::ProfileResult> profile = hydrator.getProfile("alice.bsky.social");
+
+    for (auto& post : posts)
+        EXPECT_EQ(post.get().error, BlueskyClient::Error_NotLoggedIn);
+    EXPECT_EQ(profile.get().error, BlueskyClient::Error_NotLoggedIn);
+}
+
+TEST_F(BlueskyClientTest, HydratorMockTest) {
+    MockPdsServer pds;
+
+    // Answers in reverse order, so results must be matched by URI; URIs
+    // ending in "missing" are left out as if deleted
+    pds.get("app.bsky.feed.getPosts", [](const httplib::Request& request, httplib::Response& response) {
+        std::string posts;
+        auto uris = request.params.equal_range("uris");
+        for (auto it = uris.first; it != uris.second; ++it) {
+            const std::string& uri = it->second;
+            if (uri.size() >= 7 && uri.compare(uri.size() - 7, 7, "missing") == 0)
+                continue;
+
+            const std::string post = "{\"uri\":\"" + uri + "\",\"cid\":\"cid\","
+                "\"author\":{\"did\":\"did:plc:a\",\"handle\":\"a.test\"},"
+                "\"record\":{\"text\":\"text of " + uri.substr(uri.rfind('/') + 1) + "\"}}";
+            posts = posts.empty() ? post : post + "," + posts;
+        }
+        response.set_content("{\"posts\":[" + posts + "]}", "application/json");
+    });
+
+    // Knows did:plc:<name> as <name>.test; handles come back lowercase
+    pds.get("app.bsky.actor.getProfiles", [](const httplib::Request& request, httplib::Response& response) {
+        std::string profiles;
+        auto actors = request.params.equal_range("actors");
+        for (auto it = actors.first; it != actors.second; ++it) {
+            std::string name = it->second;
+            if (name.compare(0, 8, "did:plc:") == 0)
+                name = name.substr(8);
+            else
+                name = name.substr(0, name.find('.'));
+            std::transform(name.begin(), name.end(), name.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+
+            if (!profiles.empty())
+                profiles += ',';
+            profiles += "{\"did\":\"did:plc:" + name + "\",\"handle\":\"" + name + ".test\"}";
+        }
+        response.set_content("{\"profiles\":[" + profiles + "]}", "application/json");
+    });
+
+    BlueskyClient mock(pds.url());
+    ASSERT_TRUE(mock.login("user0.bsky.social", "password"));
+
+    // Uris sent in each getPosts request
+    auto postBatches = [&pds] {
+        std::vector<std::vector<std::string>> batches;
+        for (const MockPdsServer::Request& request : pds.requests()) {
+            if (request.endpoint != "app.bsky.feed.getPosts")
+                continue;
+
+            batches.emplace_back();
+            auto uris = request.params.equal_range("uris");
+            for (auto it = uris.first; it != uris.second; ++it)
+                batches.back().push_back(it->second);
+        }
+        return batches;
+    };
+
+    {
+        BlueskyHydrator hydrator(mock, std::chrono::milliseconds(50));
+
+        // More posts than fit in one request, and one that is gone
+        std::vector<std::future<BlueskyHydrator::PostResult>> posts;
+        for (int i = 0; i < 60; i++)
+            posts.push_back(hydrator.getPost("at://did:plc:a/app.bsky.feed.post/" + std::to_string(i)));
+        std::future<BlueskyHydrator::PostResult> missing = hydrator.getPost("at://did:plc:a/app.bsky.feed.post/missing");
+
+        for (int i = 0; i < 60; i++) {
+            BlueskyHydrator::PostResult result = posts[i].get();
+            ASSERT_EQ(result.error, BlueskyClient::Error_None);
+            EXPECT_EQ(result.post.uri, "at://did:plc:a/app.bsky.feed.post/" + std::to_string(i));
+            EXPECT_EQ(result.post.text, "text of " + std::to_string(i));
+        }
+        EXPECT_EQ(missing.get().error, BlueskyClient::Error_NotFound);
+    }
+
+    std::vector<std::vector<std::string>> batches = postBatches();
+    EXPECT_GE(batches.size(), 3u);
+
+    std::map<std::string, int> asked;
+    for (const std::vector<std::string>& batch : batches) {
+        EXPECT_LE(batch.size(), BlueskyClient::MAX_HYDRATION_BATCH);
+        for (const std::string& uri : batch)
+            asked[uri]++;
+    }
+    EXPECT_EQ(asked.size(), 61u);
+    for (const auto& entry : asked)
+        EXPECT_EQ(entry.second, 1) << entry.first;
+
+    {
+        BlueskyHydrator hydrator(mock, std::chrono::milliseconds(50));
+
+        // Lookups of the same post while it is pending share one slot
+        std::vector<std::future<BlueskyHydrator::PostResult>> posts;
+        for (int round = 0; round < 3; round++) {
+            for (int i = 0; i < 10; i++)
+                posts.push_back(hydrator.getPost("at://did:plc:a/app.bsky.feed.post/" + std::to_string(i)));
+        }
+
+        // The same account by DID and by handle in another case
+        std::future<BlueskyHydrator::ProfileResult> byDid = hydrator.getProfile("did:plc:bob");
+        std::future<BlueskyHydrator::ProfileResult> byHandle = hydrator.getProfile("Bob.Test");
+        std::future<BlueskyHydrator::ProfileResult> other = hydrator.getProfile("did:plc:carol");
+
+        for (size_t i = 0; i < posts.size(); i++) {
+            BlueskyHydrator::PostResult result = posts[i].get();
+            ASSERT_EQ(result.error, BlueskyClient::Error_None);
+            EXPECT_EQ(result.post.text, "text of " + std::to_string(i % 10));
+        }
+
+        BlueskyHydrator::ProfileResult profile = byDid.get();
+        ASSERT_EQ(profile.error, BlueskyClient::Error_None);
+        EXPECT_EQ(profile.profile.handle, "bob.test");
+
+        profile = byHandle.get();
+        ASSERT_EQ(profile.error, BlueskyClient::Error_None);
+        EXPECT_EQ(profile.profile.did, "did:plc:bob");
+
+        profile = other.get();
+        ASSERT_EQ(profile.error, BlueskyClient::Error_None);
+        EXPECT_EQ(profile.profile.handle, "carol.test");
+    }
+
+    batches = postBatches();
+    ASSERT_GE(batches.size(), 1u);
+    EXPECT_EQ(batches.back().size(), 10u);
+    EXPECT_EQ(pds.count("app.bsky.actor.getProfiles"), 1u);
+}
+
+static std::string readFixture(const std::string& name) {
+    std::ifstream file(std::string(BLUESKY_TEST_FIXTURES) + "/" + name, std::ios::binary);
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+TEST_F(BlueskyClientTest, CborTest) {
+    // {"a": [1, -2, "x"], "b": 42(h'00 01711220' + 32 zero bytes), "c": null}
+    std::string cid("\x00\x01\x71\x12\x20", 5);
+    cid.append(32, '\0');
+
+    std::string data("\xa3\x61\x61\x83\x01\x21\x61\x78\x61\x62\xd8\x2a\x58\x25", 14);
+    data += cid;
+    data += "\x61\x63\xf6";
+
+    BlueskyCborReader reader((const uint8_t*)data.data(), data.size());
+
+    uint64_t entries = 0, count = 0;
+    std::string key, text;
+    int64_t value = 0;
+    BlueskyCid parsed;
+
+    ASSERT_TRUE(reader.readMap(entries));
+    EXPECT_EQ(entries, 3u);
+
+    ASSERT_TRUE(reader.readText(key));
+    EXPECT_EQ(key, "a");
+    ASSERT_TRUE(reader.readArray(count));
+    EXPECT_EQ(count, 3u);
+    ASSERT_TRUE(reader.readInt(value));
+    EXPECT_EQ(value, 1);
+    ASSERT_TRUE(reader.readInt(value));
+    EXPECT_EQ(value, -2);
+    ASSERT_TRUE(reader.readText(text));
+    EXPECT_EQ(text, "x");
+
+    ASSERT_TRUE(reader.readText(key));
+    ASSERT_TRUE(reader.readCid(parsed));
+    EXPECT_EQ(parsed.codec, (uint64_t)BlueskyCid::Codec_DagCbor);
+    EXPECT_EQ(parsed.digestLength, 32u);
+    EXPECT_EQ(parsed.toString().substr(0, 6), "bafyre");
+
+    ASSERT_TRUE(reader.readText(key));
+    EXPECT_TRUE(reader.readNull());
+    EXPECT_TRUE(reader.atEnd());
+
+    // Indefinite lengths are not DAG-CBOR
+    BlueskyCborReader indefinite((const uint8_t*)"\x9f\xff", 2);
+    EXPECT_FALSE(indefinite.skip());
+
+    // The int64 range, and one past it at either end
+    const struct {
+        const char* data;
+        bool valid;
+        int64_t value;
+    } ints[] = {
+        { "\x1b\x7f\xff\xff\xff\xff\xff\xff\xff", true, INT64_MAX },
+        { "\x3b\x7f\xff\xff\xff\xff\xff\xff\xff", true, INT64_MIN },
+        { "\x1b\x80\x00\x00\x00\x00\x00\x00\x00", false, 0 }, // 2^63
+        { "\x1b\xff\xff\xff\xff\xff\xff\xff\xff", false, 0 }, // 2^64 - 1
+        { "\x3b\x80\x00\x00\x00\x00\x00\x00\x00", false, 0 }, // -1 - 2^63
+        { "\x3b\xff\xff\xff\xff\xff\xff\xff\xff", false, 0 }, // -2^64, not 0
+    };
+    for (const auto& test : ints) {
+        BlueskyCborReader intReader((const uint8_t*)test.data, 9);
+        value = 0;
+        EXPECT_EQ(intReader.readInt(value), test.valid);
+        EXPECT_EQ(value, test.value);
+        EXPECT_EQ(intReader.failed(), !test.valid);
+    }
+}
+
+TEST_F(BlueskyClientTest, RepoReaderTest) {
+    const std::string car = readFixture("repo.car");
+    ASSERT_FALSE(car.empty());
+
+    // Byte by byte, odd chunks and all at once must give the same result
+    for (size_t chunk : { (size_t)1, (size_t)7, car.size() }) {
+        std::vector<BlueskyClient::Post> posts;
+        BlueskyRepoReader reader([&posts](const BlueskyClient::Post& post) {
+            posts.push_back(post);
+            return true;
+        });
+
+        for (size_t offset = 0; offset < car.size(); offset += chunk)
+            ASSERT_TRUE(reader.feed(car.data() + offset, std::min(chunk, car.size() - offset))) << reader.error();
+        ASSERT_TRUE(reader.finish()) << reader.error();
+
+        EXPECT_EQ(reader.did(), "did:plc:fixture");
+        EXPECT_EQ(reader.blockCount(), 5u);
+        ASSERT_EQ(posts.size(), 2u);
+
+        // The first post comes before the MST node that names it
+        EXPECT_EQ(posts[0].text, "First post");
+        EXPECT_EQ(posts[0].uri, "");
+        EXPECT_EQ(posts[0].createdAt, (time_t)1729152910);
+        EXPECT_EQ(reader.uriOf(posts[0].cid), "at://did:plc:fixture/app.bsky.feed.post/3kabc");
+
+        EXPECT_EQ(posts[1].text, "Second post");
+        EXPECT_EQ(posts[1].uri, "at://did:plc:fixture/app.bsky.feed.post/3kabd");
+        EXPECT_EQ(posts[1].author.did, "did:plc:fixture");
+    }
+
+    std::string corrupt = car;
+    corrupt[corrupt.size() - 5] ^= 1;
+
+    BlueskyRepoReader verifying([](const BlueskyClient::Post&) { return true; });
+    EXPECT_FALSE(verifying.feed(corrupt.data(), corrupt.size()));
+
+    BlueskyRepoReader trusting([](const BlueskyClient::Post&) { return true; }, false);
+    EXPECT_TRUE(trusting.feed(corrupt.data(), corrupt.size()));
+    EXPECT_TRUE(trusting.finish());
+
+    BlueskyRepoReader truncated([](const BlueskyClient::Post&) { return true; });
+    EXPECT_TRUE(truncated.feed(car.data(), car.size() - 3));
+    EXPECT_FALSE(truncated.finish());
+}
+
+static std::vector<std::string> readFixtureLines(const std::string& name) {
+    std::istringstream contents(readFixture(name));
+    std::vector<std::string> lines;
+
+    std::string line;
+    while (std::getline(contents, line))
+        lines.push_back(line);
+
+    return lines;
+}
+
+TEST_F(BlueskyClientTest, JetstreamDecodeTest) {
+    const std::vector<std::string> frames = readFixtureLines("jetstream.jsonl");
+    ASSERT_EQ(frames.size(), 8u);
+
+    BlueskyJetstream::Event event;
+
+    std::string frame = frames[0] + std::string(YYJSON_PADDING_SIZE, '\0');
+    ASSERT_TRUE(BlueskyJetstream::decodeEvent(&frame[0], frames[0].size(), event));
+    EXPECT_EQ(event.kind, BlueskyJetstream::Kind_Commit);
+    EXPECT_EQ(event.operation, BlueskyJetstream::Operation_Create);
+    EXPECT_EQ(event.did, "did:plc:alice");
+    EXPECT_EQ(event.timeUs, 1729152910000001ull);
+    EXPECT_EQ(event.collection, "app.bsky.feed.post");
+    ASSERT_TRUE(event.isPost);
+    EXPECT_EQ(event.post.text, "First post");
+    EXPECT_EQ(event.post.uri, "at://did:plc:alice/app.bsky.feed.post/3l6oveex3ii2k");
+    EXPECT_EQ(event.post.createdAt, (time_t)1729152910);
+    EXPECT_NE(event.record.find("\"langs\""), std::string::npos);
+
+    frame = frames[5] + std::string(YYJSON_PADDING_SIZE, '\0');
+    ASSERT_TRUE(BlueskyJetstream::decodeEvent(&frame[0], frames[5].size(), event));
+    EXPECT_EQ(event.kind, BlueskyJetstream::Kind_Account);
+    EXPECT_FALSE(event.active);
+    EXPECT_EQ(event.status, "deactivated");
+    EXPECT_FALSE(event.isPost);
+
+    frame = frames[6] + std::string(YYJSON_PADDING_SIZE, '\0');
+    ASSERT_TRUE(BlueskyJetstream::decodeEvent(&frame[0], frames[6].size(), event));
+    EXPECT_EQ(event.operation, BlueskyJetstream::Operation_Delete);
+    EXPECT_TRUE(event.record.empty());
+    EXPECT_FALSE(event.isPost);
+
+    frame = frames[3] + std::string(YYJSON_PADDING_SIZE, '\0');
+    EXPECT_FALSE(BlueskyJetstream::decodeEvent(&frame[0], frames[3].size(), event));
+}
+
+TEST_F(BlueskyClientTest, JetstreamReplayTest) {
+    const std::vector<std::string> frames = readFixtureLines("jetstream.jsonl");
+
+    // Dropping the connection every 3 frames makes the stream resume twice
+    WsReplayServer server(frames, 3);
+
+    std::mutex mutex;
+    std::map<std::string, std::vector<uint64_t>> timesByDid;
+    std::set<uint64_t> seen;
+
+    BlueskyJetstream::Options options;
+    options.endpoint = server.url();
+    options.collections.push_back("app.bsky.feed.post");
+    options.workers = 2;
+    options.reconnectDelay = std::chrono::milliseconds(10);
+
+    BlueskyJetstream stream([&](const BlueskyJetstream::Event& event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        timesByDid[event.did].push_back(event.timeUs);
+        seen.insert(event.timeUs);
+    }, options);
+
+    stream.start();
+
+    for (int i = 0; i < 500; i++) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (seen.size() == 7)
+                break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    stream.stop();
+
+    EXPECT_EQ(seen.size(), 7u);
+    EXPECT_EQ(stream.cursor(), 1729152910000007ull);
+
+    // Events of one repo arrive in stream order; a resume may repeat one
+    for (const auto& entry : timesByDid) {
+        for (size_t i = 1; i < entry.second.size(); i++)
+            EXPECT_LE(entry.second[i - 1], entry.second[i]) << entry.first;
+    }
+
+    const std::vector<std::string> requests = server.requests();
+    ASSERT_GE(requests.size(), 2u);
+    EXPECT_EQ(requests[0], "/subscribe?wantedCollections=app.bsky.feed.post");
+    EXPECT_EQ(requests[1], "/subscribe?wantedCollections=app.bsky.feed.post&cursor=1729152910000003");
+
+    const BlueskyJetstream::Stats stats = stream.stats();
+    EXPECT_GE(stats.reconnects, 2u);
+    EXPECT_EQ(stats.queued, 0u);
+    EXPECT_FALSE(stats.connected);
+}
+
+TEST_F(BlueskyClientTest, JetstreamOverflowTest) {
+    const std::vector<std::string> frames = readFixtureLines("jetstream.jsonl");
+    WsReplayServer server(frames);
+
+    // The handler holds the only worker, so the one-frame queue overflows
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+
+    BlueskyJetstream::Options options;
+    options.endpoint = server.url();
+    options.workers = 1;
+    options.queueCapacity = 1;
+    options.overflow = BlueskyJetstream::Overflow_Drop;
+
+    BlueskyJetstream stream([released](const BlueskyJetstream::Event&) { released.wait(); }, options);
+    stream.start();
+
+    for (int i = 0; i < 500 && stream.stats().received < frames.size(); i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    const BlueskyJetstream::Stats stats = stream.stats();
+    EXPECT_EQ(stats.received, frames.size());
+    EXPECT_EQ(stats.malformed, 1u);
+    EXPECT_EQ(stats.maxQueued, 1u);
+
+    // One frame is being handled and at most one waits; 7 events came in
+    EXPECT_GE(stats.dropped, 5u);
+    EXPECT_LE(stats.dropped, 6u);
+    EXPECT_TRUE(stats.connected);
+
+    // Nothing was handled yet, so resuming has to start at the first event
+    EXPECT_EQ(stream.cursor(), 1729152910000001ull);
+
+    release.set_value();
+    stream.stop();
+}
+
+TEST_F(BlueskyClientTest, SeenSetTest) {
+    BlueskySeenSet seen(3);
+
+    EXPECT_TRUE(seen.insert(1));
+    EXPECT_TRUE(seen.insert(2));
+    EXPECT_TRUE(seen.insert(3));
+    EXPECT_FALSE(seen.insert(2));
+    EXPECT_EQ(seen.size(), 3u);
+
+    // Full, so the oldest hash makes room
+    EXPECT_TRUE(seen.insert(4));
+    EXPECT_FALSE(seen.contains(1));
+    EXPECT_TRUE(seen.contains(2));
+    EXPECT_TRUE(seen.contains(4));
+    EXPECT_EQ(seen.size(), 3u);
+
+    const std::string cid = "bafyreify6e5sw4pqwbdpdolumt4xowqccingbgmpzmwtuygwcctteh6zai";
+    EXPECT_EQ(BlueskySeenSet::hash(cid.data(), cid.size()), BlueskySeenSet::hash(cid.c_str(), cid.size()));
+    EXPECT_NE(BlueskySeenSet::hash(cid.data(), cid.size()), BlueskySeenSet::hash(cid.data(), cid.size() - 1));
+
+    seen.clear();
+    EXPECT_EQ(seen.size(), 0u);
+    EXPECT_FALSE(seen.contains(2));
+}
+
+// A feed held in memory, newest post first, served in pages like getFeed
+class FakeFeed {
+public:
+    void publish(unsigned count) {
+        for (unsigned i = 0; i < count; i++) {
+            m_posts.insert(m_posts.begin(), m_next);
+            m_next++;
+        }
+    }
+
+    // The count-th request from now fails
+    void failRequest(unsigned count) { m_fail_in = count; }
+
+    BlueskyClient::FeedView page(int limit, const std::string& cursor) {
+        m_requests.push_back(limit);
+
+        if (m_fail_in > 0 && --m_fail_in == 0)
+            return BlueskyClient::FeedView::parse("{");
+
+        const size_t start = cursor.empty() ? 0 : (size_t)std::stoul(cursor);
+        const size_t end = std::min(m_posts.size(), start + (size_t)limit);
+
+        std::ostringstream json;
+        json << "{\"feed\":[";
+        for (size_t i = start; i < end; i++) {
+            const unsigned n = m_posts[i];
+            json << (i == start ? "" : ",")
+                 << "{\"post\":{\"uri\":\"at://did:plc:a/app.bsky.feed.post/" << n << "\","
+                 << "\"cid\":\"cid" << n << "\",\"author\":{\"did\":\"did:plc:a\"},"
+                 << "\"record\":{\"text\":\"post " << n << "\"},"
+                 << "\"indexedAt\":\"2024-01-01T" << 10 + n / 3600 << ":" << n / 60 % 60 / 10 << n / 60 % 10
+                 << ":" << n % 60 / 10 << n % 10 << ".000Z\"}}";
+        }
+        json << "]";
+        if (end < m_posts.size())
+            json << ",\"cursor\":\"" << end << "\"";
+        json << "}";
+
+        return BlueskyClient::FeedView::parse(json.str());
+    }
+
+    std::vector<int> takeRequests() {
+        std::vector<int> requests;
+        requests.swap(m_requests);
+        return requests;
+    }
+
+private:
+    std::vector<unsigned> m_posts;
+    std::vector<int> m_requests;
+    unsigned m_next = 0;
+    unsigned m_fail_in = 0;
+};
+
+TEST_F(BlueskyClientTest, FeedPollerTest) {
+    FakeFeed feed;
+    feed.publish(30);
+
+    BlueskyFeedPoller poller([&feed](int limit, const std::string& cursor) {
+        return feed.page(limit, cursor);
+    }, 5, 3);
+
+    // The first poll takes one page as it is
+    BlueskyFeedPoller::Result result = poller.poll();
+    ASSERT_EQ(result.error, BlueskyClient::Error_None);
+    ASSERT_EQ(result.posts.size(), 5u);
+    EXPECT_EQ(result.posts[0].text, "post 29");
+    EXPECT_EQ(feed.takeRequests(), std::vector<int>({ 5 }));
+    EXPECT_EQ(poller.highWaterUri(), "at://did:plc:a/app.bsky.feed.post/29");
+
+    // Nothing new: one small page, nothing decoded
+    result = poller.poll();
+    EXPECT_TRUE(result.posts.empty());
+    EXPECT_EQ(result.pages, 1u);
+    EXPECT_TRUE(result.complete);
+    EXPECT_EQ(feed.takeRequests(), std::vector<int>({ 10 }));
+
+    feed.publish(2);
+    result = poller.poll();
+    ASSERT_EQ(result.posts.size(), 2u);
+    EXPECT_EQ(result.posts[0].text, "post 31");
+    EXPECT_EQ(result.posts[1].text, "post 30");
+    EXPECT_EQ(feed.takeRequests(), std::vector<int>({ 5 }));
+
+    // More new posts than the first page holds: page on to close the gap
+    feed.publish(12);
+    result = poller.poll();
+    EXPECT_EQ(result.posts.size(), 12u);
+    EXPECT_EQ(result.pages, 2u);
+    EXPECT_TRUE(result.complete);
+    EXPECT_EQ(feed.takeRequests(), std::vector<int>({ 5, 100 }));
+    EXPECT_EQ(poller.highWaterUri(), "at://did:plc:a/app.bsky.feed.post/43");
+
+    // A gap wider than maxPages is reported
+    feed.publish(500);
+    result = poller.poll();
+    EXPECT_FALSE(result.complete);
+    EXPECT_EQ(result.pages, 3u);
+    EXPECT_EQ(result.posts.size(), 224u);
+
+    EXPECT_EQ(poller.newPosts(), 5u + 2u + 12u + 224u);
+}
+
+TEST_F(BlueskyClientTest, FeedPollerGapTest) {
+    FakeFeed feed;
+    feed.publish(30);
+
+    BlueskyFeedPoller poller([&feed](int limit, const std::string& cursor) {
+        return feed.page(limit, cursor);
+    }, 5, 3);
+
+    ASSERT_EQ(poller.poll().posts.size(), 5u);
+
+    // The first page is all new and the second fails, leaving a gap
+    feed.publish(120);
+    feed.failRequest(2);
+    BlueskyFeedPoller::Result result = poller.poll();
+    EXPECT_NE(result.error, BlueskyClient::Error_None);
+    EXPECT_FALSE(result.complete);
+    ASSERT_EQ(result.posts.size(), 10u);
+    EXPECT_EQ(result.posts[0].text, "post 149");
+    EXPECT_EQ(poller.highWaterUri(), "at://did:plc:a/app.bsky.feed.post/149");
+
+    // The next poll catches up with the head, then closes the gap from the
+    // failed page down to the posts of the first poll. The fake's cursors
+    // are offsets, so the new posts shift the gap by three posts the last
+    // poll returned already; those are passed over.
+    feed.publish(3);
+    result = poller.poll();
+    EXPECT_EQ(result.error, BlueskyClient::Error_None);
+    EXPECT_TRUE(result.complete);
+    ASSERT_EQ(result.posts.size(), 3u + 110u);
+    EXPECT_EQ(result.posts[0].text, "post 152");
+    EXPECT_EQ(result.posts[2].text, "post 150");
+    EXPECT_EQ(result.posts[3].text, "post 139");
+    EXPECT_EQ(result.posts.back().text, "post 30");
+
+    // Nothing is left over
+    result = poller.poll();
+    EXPECT_TRUE(result.posts.empty());
+    EXPECT_TRUE(result.complete);
+    EXPECT_EQ(result.pages, 1u);
+
+    EXPECT_EQ(poller.newPosts(), 5u + 10u + 113u);
+}
+
+TEST_F(BlueskyClientTest, TextTest) {
+    // Long enough that the vector loops run before the tails
+    const std::string ascii(100, 'a');
+
+    EXPECT_TRUE(BlueskyText::isValidUtf8(ascii + "caf\xC3\xA9 \xE2\x80\x9C\xF0\x9F\x91\x8B" + ascii));
+    EXPECT_FALSE(BlueskyText::isValidUtf8(ascii + "\xC0\xAF")); // Overlong '/'
+    EXPECT_FALSE(BlueskyText::isValidUtf8(ascii + "\xED\xA0\x80")); // Surrogate
+    EXPECT_FALSE(BlueskyText::isValidUtf8(ascii + "\xF4\x90\x80\x80")); // Past U+10FFFF
+    EXPECT_FALSE(BlueskyText::isValidUtf8(ascii + "\xE2\x80")); // Truncated
+    EXPECT_FALSE(BlueskyText::isValidUtf8("\x80" + ascii));
+
+    EXPECT_EQ(BlueskyText::repairUtf8("a\xFF" "b\xE2\x80"), "a\xEF\xBF\xBD" "b\xEF\xBF\xBD\xEF\xBF\xBD");
+    EXPECT_EQ(BlueskyText::repairUtf8(ascii), ascii);
+
+    EXPECT_EQ(BlueskyText::toAscii(ascii + "\t\xE2\x80\x98x\xE2\x80\x99 caf\xC3\xA9\x7F\xFF" + ascii), ascii + "'x' caf" + ascii);
+
+    EXPECT_EQ(BlueskyText::urlEncode("a b/c?d=caf\xC3\xA9&e~f-g_h.i"), "a+b%2Fc%3Fd%3Dcaf%C3%A9%26e~f-g_h.i");
+    EXPECT_EQ(BlueskyText::urlEncode(ascii + "Z9 " + ascii), ascii + "Z9+" + ascii);
+
+    const std::vector<std::string> words = BlueskyText::splitWords(" \tone\ntwo\r\n caf\xC3\xA9  " + ascii + "\x0B");
+    ASSERT_EQ(words.size(), 4u);
+    EXPECT_EQ(words[0], "one");
+    EXPECT_EQ(words[2], "caf\xC3\xA9");
+    EXPECT_EQ(words[3], ascii);
+    EXPECT_TRUE(BlueskyText::splitWords(" \n ").empty());
+
+    EXPECT_EQ(BlueskyText::countGraphemes(ascii), 100u);
+    EXPECT_EQ(BlueskyText::countGraphemes("a\r\nb"), 3u);
+    EXPECT_EQ(BlueskyText::countGraphemes("e\xCC\x81"), 1u); // e + combining acute
+    EXPECT_EQ(BlueskyText::countGraphemes("\xF0\x9F\x91\x8B\xF0\x9F\x8F\xBD"), 1u); // Wave, skin tone
+    EXPECT_EQ(BlueskyText::countGraphemes("\xF0\x9F\x87\xA9\xF0\x9F\x87\xAA\xF0\x9F\x87\xAB"), 2u); // DE + half a flag
+    EXPECT_EQ(BlueskyText::countGraphemes("\xED\x95\x9C\xEA\xB8\x80"), 2u); // Hangul syllables
+    EXPECT_EQ(BlueskyText::countGraphemes("\xE1\x84\x80\xE1\x85\xA1\xE1\x86\xA8"), 1u); // Conjoining jamo
+    EXPECT_EQ(BlueskyText::countGraphemes("\n\xCC\x81"), 2u); // Marks don't attach to controls
+
+    // Man, ZWJ, woman, ZWJ, girl: one family emoji
+    const std::string family = "\xF0\x9F\x91\xA8\xE2\x80\x8D\xF0\x9F\x91\xA9\xE2\x80\x8D\xF0\x9F\x91\xA7";
+    EXPECT_EQ(BlueskyText::countGraphemes(family), 1u);
+    EXPECT_EQ(BlueskyText::countGraphemes("a\xE2\x80\x8D" + family), 2u);
+
+    std::string text;
+    for (int i = 0; i < 150; i++)
+        text += "a" + family;
+
+    EXPECT_EQ(BlueskyText::countGraphemes(text), 300u);
+    EXPECT_EQ(BlueskyText::graphemePrefix(text.data(), text.size(), BlueskyText::MAX_POST_GRAPHEMES), text.size());
+    EXPECT_EQ(BlueskyText::graphemePrefix(text.data(), text.size(), 3), 2 + family.size());
+    EXPECT_EQ(BlueskyText::graphemePrefix(ascii.data(), ascii.size(), 30), 30u);
+
+    // "a😀b": 😀 is 1 code point, 2 UTF-16 units and 4 bytes
+    const std::string emoji = "a\xF0\x9F\x98\x80" "b" + ascii;
+    EXPECT_EQ(BlueskyText::byteOffsetOfCodePoint(emoji.data(), emoji.size(), 2), 5u);
+    EXPECT_EQ(BlueskyText::byteOffsetOfUtf16(emoji.data(), emoji.size(), 3), 5u);
+    EXPECT_EQ(BlueskyText::byteOffsetOfUtf16(emoji.data(), emoji.size(), 2), 1u);
+    EXPECT_EQ(BlueskyText::byteOffsetOfCodePoint(emoji.data(), emoji.size(), 50), 53u);
+    EXPECT_EQ(BlueskyText::byteOffsetOfCodePoint(emoji.data(), emoji.size(), 1000), emoji.size());
+}
+
+TEST_F(BlueskyClientTest, TimestampTest) {
+    const BlueskyTimestamp base = BlueskyTimestamp::parse("2024-01-01T00:00:00Z");
+    ASSERT_TRUE(base.valid());
+    EXPECT_EQ(base.toTimeT(), 1704067200);
+
+    // Fractions, offsets and the other separators RFC 3339 allows
+    EXPECT_EQ(BlueskyTimestamp::parse("2024-01-01T00:00:00.123Z").microseconds(), base.microseconds() + 123000);
+    EXPECT_EQ(BlueskyTimestamp::parse("2024-01-01T00:00:00.1234567Z").microseconds(), base.microseconds() + 123456);
+    EXPECT_EQ(BlueskyTimestamp::parse("2024-01-01t01:30:00+01:30"), base);
+    EXPECT_EQ(BlueskyTimestamp::parse("2023-12-31 23:00:00-01:00"), base);
+    EXPECT_EQ(BlueskyTimestamp::parse("2024-01-01T00:00:00"), base);
+    EXPECT_EQ(BlueskyTimestamp::parse("2023-12-31T23:59:60Z"), base); // Leap second
+
+    EXPECT_EQ(BlueskyTimestamp::parse("2024-02-29T12:00:00Z").toTimeT(), 1709208000);
+    EXPECT_EQ(BlueskyTimestamp::parse("1969-12-31T23:59:59.500Z").toTimeT(), -1);
+    EXPECT_EQ(BlueskyTimestamp::parse("1969-12-31T23:59:59.500Z").microseconds(), -500000);
+
+    const char* const invalid[] = {
+        "", "2024-01-01", "2024-01-01T00:00", "2024-13-01T00:00:00Z", "2023-02-29T00:00:00Z",
+        "2024-01-01T24:00:00Z", "2024-01-01T00:00:00.Z", "2024-01-01T00:00:00+0100",
+        "2024-01-01T00:00:00Zjunk", "2024-01-01X00:00:00Z", "2024-1-01T00:00:00Z",
+    };
+    for (const char* str : invalid)
+        EXPECT_FALSE(BlueskyTimestamp::parse(str).valid()) << str;
+
+    EXPECT_FALSE(BlueskyTimestamp::parse(nullptr).valid());
+    EXPECT_EQ(BlueskyTimestamp().toTimeT(), (time_t)(-1));
+    EXPECT_LT(BlueskyTimestamp(), base);
+
+    EXPECT_EQ(BlueskyTimestamp::parse("2024-05-01T12:30:00.123456+02:00").format(), "2024-05-01T10:30:00.123Z");
+    EXPECT_EQ(BlueskyTimestamp::fromMicroseconds(-1).format(), "1969-12-31T23:59:59.999Z");
+    EXPECT_EQ(BlueskyTimestamp().format(), "");
+
+    // Every day of a few centuries round-trips through format
+    for (int64_t day = -80000; day < 80000; day += 7) {
+        const BlueskyTimestamp time = BlueskyTimestamp::fromMicroseconds(day * 86400000000LL + 45296789000LL);
+        EXPECT_EQ(BlueskyTimestamp::parse(time.format()), time);
+    }
+
+    const BlueskyTimestamp now = BlueskyTimestamp::now();
+    EXPECT_LE(std::abs((long long)(now.toTimeT() - time(nullptr))), 1);
+}
+
+static BlueskyClient::Post makeStoredPost(unsigned n) {
+    BlueskyClient::Post post = BlueskyClient::Post();
+    post.uri = "at://did:plc:a/app.bsky.feed.post/" + std::to_string(n);
+    post.cid = "bafy" + std::to_string(n);
+    post.text = "post " + std::to_string(n);
+    post.indexedAtTime = BlueskyTimestamp::fromMicroseconds(1704067200000000LL + n * 1500);
+    post.indexedAt = post.indexedAtTime.toTimeT();
+    post.author.did = "did:plc:a";
+    post.author.handle = "a.bsky.social";
+    post.likeCount = n;
+    return post;
+}
+
+TEST_F(BlueskyClientTest, PostStoreTest) {
+    const std::string path = ::testing::TempDir() + "bluesky_post_store_test";
+    std::remove(path.c_str());
+    std::remove((path + ".idx").c_str());
+
+    BlueskyPostStore store;
+    ASSERT_TRUE(store.open(path)) << store.error();
+
+    BlueskyClient::Post first = makeStoredPost(0);
+    first.createdAtTime = BlueskyTimestamp::parse("2024-01-01T00:00:00.250Z");
+    first.createdAt = first.createdAtTime.toTimeT();
+    first.author.mutedByViewer = true;
+
+    EXPECT_TRUE(store.append(first));
+    EXPECT_FALSE(store.append(first)); // Same CID
+
+    BlueskyClient::Post found;
+    ASSERT_TRUE(store.findByUri(first.uri, found));
+    EXPECT_EQ(found.cid, first.cid);
+    EXPECT_EQ(found.text, first.text);
+    EXPECT_EQ(found.createdAtTime, first.createdAtTime);
+    EXPECT_EQ(found.createdAt, first.createdAt);
+    EXPECT_FALSE(found.author.createdAtTime.valid());
+    EXPECT_TRUE(found.author.mutedByViewer);
+    EXPECT_FALSE(store.findByCid("bafy-missing", found));
+
+    // Enough posts to grow the index a few times; duplicates in the batch
+    // are stored once
+    BlueskyClient::PostsResult batch;
+    for (unsigned n = 1; n <= 3000; n++)
+        batch.posts.push_back(makeStoredPost(n));
+    batch.posts.push_back(makeStoredPost(7));
+
+    EXPECT_EQ(store.append(batch), 3000u);
+    EXPECT_EQ(store.size(), 3001u);
+    EXPECT_TRUE(store.containsCid("bafy2999"));
+    ASSERT_TRUE(store.sync()) << store.error();
+
+    const uint64_t syncedBytes = store.logBytes();
+    store.close();
+
+    // A post torn by a crash is cut off on open
+    {
+        std::ofstream log(path, std::ios::binary | std::ios::app);
+        log.write("\x40\x00\x00\x00garbage", 11);
+    }
+
+    ASSERT_TRUE(store.open(path)) << store.error();
+    EXPECT_EQ(store.size(), 3001u);
+    EXPECT_EQ(store.logBytes(), syncedBytes);
+    ASSERT_TRUE(store.findByCid("bafy1234", found));
+    EXPECT_EQ(found.likeCount, 1234u);
+    EXPECT_EQ(found.indexedAtTime.microseconds(), 1704067200000000LL + 1234 * 1500);
+
+    // Posts of a feed page the store has already are skipped
+    std::ostringstream json;
+    json << "{\"feed\":[";
+    for (unsigned n = 2999; n < 3003; n++) {
+        json << (n == 2999 ? "" : ",")
+             << "{\"post\":{\"uri\":\"at://did:plc:a/app.bsky.feed.post/" << n << "\","
+             << "\"cid\":\"bafy" << n << "\",\"author\":{\"did\":\"did:plc:a\"},"
+             << "\"record\":{\"text\":\"post " << n << "\"},\"indexedAt\":\"2024-06-01T00:00:00Z\"}}";
+    }
+    json << "]}";
+
+    EXPECT_EQ(store.append(BlueskyClient::FeedView::parse(json.str())), 2u);
+    EXPECT_TRUE(store.containsUri("at://did:plc:a/app.bsky.feed.post/3002"));
+    store.close();
+
+    // Without its index, the store reindexes the log
+    std::remove((path + ".idx").c_str());
+    ASSERT_TRUE(store.open(path)) << store.error();
+    EXPECT_EQ(store.size(), 3003u);
+    EXPECT_TRUE(store.containsUri("at://did:plc:a/app.bsky.feed.post/3001"));
+
+    unsigned visited = 0;
+    store.forEach([&visited](const BlueskyClient::Post& post) {
+        EXPECT_EQ(post.cid, "bafy" + std::to_string(visited));
+        return ++visited < 10;
+    });
+    EXPECT_EQ(visited, 10u);
+
+    // A second store on the same path would corrupt both files
+    BlueskyPostStore other;
+    EXPECT_FALSE(other.open(path));
+    EXPECT_FALSE(other.error().empty());
+
+    // Unsynced appends may reach the disk in any order. A record a crash
+    // zeroed before the last one cuts the log there, even though the index
+    // already covered the records after it.
+    ASSERT_TRUE(store.sync()) << store.error();
+    const uint64_t synced = store.logBytes();
+
+    BlueskyClient::PostsResult unsynced;
+    for (unsigned n = 3003; n < 3006; n++)
+        unsynced.posts.push_back(makeStoredPost(n));
+    EXPECT_EQ(store.append(unsynced), 3u);
+    store.close();
+
+    {
+        std::fstream log(path, std::ios::binary | std::ios::in | std::ios::out);
+        log.seekp((std::streamoff)synced);
+        log.write("\0\0\0\0\0\0\0\0", 8);
+    }
+
+    ASSERT_TRUE(store.open(path)) << store.error();
+    EXPECT_EQ(store.size(), 3003u);
+    EXPECT_EQ(store.logBytes(), synced);
+    EXPECT_TRUE(store.containsCid("bafy3002"));
+    EXPECT_FALSE(store.containsCid("bafy3005"));
+
+    store.close();
+    EXPECT_TRUE(other.open(path)) << other.error();
+    other.close();
+
+    std::remove(path.c_str());
+    std::remove((path + ".idx").c_str());
+
+    std::ofstream(path) << "not a store";
+    EXPECT_FALSE(store.open(path));
+    EXPECT_FALSE(store.isOpen());
+    std::remove(path.c_str());
+}
+
+TEST_F(BlueskyClientTest, FeedBatchTest) {
+    BlueskyFeedBatch batch;
+
+    // Two pages of posts by three authors; c's profile changes on page two
+    std::ostringstream json;
+    json << "{\"feed\":[";
+    for (unsigned n = 0; n < 20; n++) {
+        const char author = "abc"[n % 3];
+        json << (n == 0 ? "" : ",")
+             << "{\"post\":{\"uri\":\"at://did:plc:" << author << "/app.bsky.feed.post/" << n << "\","
+             << "\"cid\":\"bafy" << n << "\",\"author\":{\"did\":\"did:plc:" << author << "\","
+             << "\"handle\":\"" << author << ".bsky.social\"},"
+             << "\"record\":{\"text\":\"post " << n << "\",\"createdAt\":\"2024-06-01T00:00:" << (10 + n) << "Z\"},"
+             << "\"likeCount\":" << n << ",\"replyCount\":" << (n % 4) << ","
+             << "\"indexedAt\":\"2024-06-01T00:01:" << (10 + n) << "Z\"}}";
+    }
+    json << "]}";
+
+    batch.append(BlueskyClient::FeedView::parse(json.str()));
+    ASSERT_EQ(batch.size(), 20u);
+
+    BlueskyClient::PostsResult page;
+    for (unsigned n = 20; n < 23; n++)
+        page.posts.push_back(makeStoredPost(n));
+    page.posts[1].author.did = "did:plc:c";
+    page.posts[1].author.handle = "renamed.bsky.social";
+    batch.append(page);
+
+    ASSERT_EQ(batch.size(), 23u);
+    EXPECT_EQ(batch.authorCount(), 3u);
+
+    EXPECT_EQ(batch.uri(4), "at://did:plc:b/app.bsky.feed.post/4");
+    EXPECT_EQ(batch.cid(4), "bafy4");
+    EXPECT_EQ(batch.text(4), "post 4");
+    EXPECT_EQ(batch.text(22), "post 22");
+
+    const BlueskyFeedBatch::AuthorId c = batch.findAuthor("did:plc:c");
+    ASSERT_NE(c, BlueskyFeedBatch::NO_AUTHOR);
+    EXPECT_EQ(batch.authors()[21], c);
+    EXPECT_EQ(batch.authorHandle(c), "c.bsky.social");
+    EXPECT_EQ(batch.findAuthor("did:plc:z"), BlueskyFeedBatch::NO_AUTHOR);
+
+    // Scores run 8 posts at a time; 23 leaves a scalar tail
+    std::vector<float> scores;
+    batch.scores(BlueskyFeedBatch::Weights(1, 0, 2, 0), scores);
+    ASSERT_EQ(scores.size(), 23u);
+    for (size_t i = 0; i < scores.size(); i++)
+        EXPECT_FLOAT_EQ(scores[i], batch.likeCounts()[i] + 2.0f * batch.replyCounts()[i]);
+
+    // Posts 19 and 22 tie on 22; the earlier post goes first
+    const std::vector<uint32_t> top = batch.topK(3);
+    ASSERT_EQ(top.size(), 3u);
+    EXPECT_EQ(top[0], 19u);
+    EXPECT_EQ(top[1], 22u);
+    EXPECT_EQ(top[2], 21u);
+    EXPECT_EQ(batch.topK(100).size(), 23u);
+
+    // Half-open windows; hand-built posts have no creation time
+    const std::vector<uint32_t> indexed = batch.indexedBetween(
+        BlueskyTimestamp::parse("2024-06-01T00:01:15Z"), BlueskyTimestamp::parse("2024-06-01T00:01:20Z"));
+    EXPECT_EQ(indexed, std::vector<uint32_t>({ 5, 6, 7, 8, 9 }));
+
+    const std::vector<uint32_t> created = batch.createdBetween(
+        BlueskyTimestamp::parse("2024-06-01T00:00:27Z"), BlueskyTimestamp::parse("2030-01-01T00:00:00Z"));
+    EXPECT_EQ(created, std::vector<uint32_t>({ 17, 18, 19 }));
+
+    const std::vector<BlueskyFeedBatch::AuthorTotals> totals = batch.authorTotals();
+    ASSERT_EQ(totals.size(), 3u);
+
+    const BlueskyFeedBatch::AuthorId a = batch.findAuthor("did:plc:a");
+    EXPECT_EQ(totals[a].posts, 9u); // 0, 3, ..., 18, then 20 and 22
+    EXPECT_EQ(totals[a].likes, 0u + 3 + 6 + 9 + 12 + 15 + 18 + 20 + 22);
+    EXPECT_EQ(totals[c].posts, 7u);
+
+    const BlueskyClient::Post copy = batch.post(4);
+    EXPECT_EQ(copy.cid, "bafy4");
+    EXPECT_EQ(copy.author.handle, "b.bsky.social");
+    EXPECT_EQ(copy.likeCount, 4u);
+    EXPECT_EQ(copy.indexedAtTime, BlueskyTimestamp::parse("2024-06-01T00:01:14Z"));
+
+    batch.clear();
+    EXPECT_EQ(batch.size(), 0u);
+    EXPECT_EQ(batch.authorCount(), 0u);
+    EXPECT_TRUE(batch.topK(5).empty());
+}
+
+TEST_F(BlueskyClientTest, AuthorIdsTest) {
+    BlueskyAuthorIds ids;
+
+    bool added = false;
+    EXPECT_EQ(ids.intern("did:plc:a", 9, added), 0u);
+    EXPECT_TRUE(added);
+    EXPECT_EQ(ids.intern("did:plc:b", 9, added), 1u);
+    EXPECT_TRUE(added);
+    EXPECT_EQ(ids.intern("did:plc:a", 9, added), 0u);
+    EXPECT_FALSE(added);
+
+    EXPECT_EQ(ids.size(), 2u);
+    EXPECT_EQ(ids.find("did:plc:b"), 1u);
+    EXPECT_EQ(ids.find("did:plc:c"), BlueskyAuthorIds::NO_AUTHOR);
+
+    // The table and the batch hand out the same kind of id
+    EXPECT_EQ(BlueskyAuthorTable::NO_AUTHOR, BlueskyFeedBatch::NO_AUTHOR);
+
+    ids.clear();
+    EXPECT_EQ(ids.size(), 0u);
+    EXPECT_EQ(ids.intern("did:plc:b", 9, added), 0u);
+}
+
+TEST_F(BlueskyClientTest, AuthorTableTest) {
+    BlueskyAuthorTable table;
+
+    BlueskyClient::PostsResult page;
+    for (unsigned n = 0; n < 3; n++)
+        page.posts.push_back(makeStoredPost(n));
+    page.posts[2].author.did = "did:plc:b";
+
+    const BlueskyTimestamp first = BlueskyTimestamp::parse("2024-06-01T00:00:00Z");
+    const std::vector<BlueskyAuthorTable::Post> posts = table.intern(page, first);
+    ASSERT_EQ(posts.size(), 3u);
+    EXPECT_EQ(table.size(), 2u);
+    EXPECT_EQ(posts[0].author, posts[1].author);
+    EXPECT_NE(posts[0].author, posts[2].author);
+    EXPECT_EQ(posts[1].cid, "bafy1");
+    EXPECT_EQ(table.find("did:plc:b"), posts[2].author);
+    EXPECT_EQ(table.find("did:plc:z"), BlueskyAuthorTable::NO_AUTHOR);
+
+    // A newer page renames a; its posts see the change in place
+    const std::string json =
+        "{\"feed\":[{\"post\":{\"uri\":\"at://did:plc:a/app.bsky.feed.post/9\",\"cid\":\"bafy9\","
+        "\"author\":{\"did\":\"did:plc:a\",\"handle\":\"new.bsky.social\",\"displayName\":\"A\","
+        "\"viewer\":{\"muted\":true}},\"record\":{\"text\":\"post 9\"},\"likeCount\":9,"
+        "\"indexedAt\":\"2024-06-01T00:05:00Z\"}}]}";
+
+    const std::vector<BlueskyAuthorTable::Post> later = table.intern(
+        BlueskyClient::FeedView::parse(json), BlueskyTimestamp::parse("2024-06-01T00:10:00Z"));
+    ASSERT_EQ(later.size(), 1u);
+    EXPECT_EQ(later[0].author, posts[0].author);
+    EXPECT_EQ(later[0].likeCount, 9u);
+    EXPECT_EQ(table.size(), 2u);
+
+    BlueskyClient::Post expanded = table.expand(posts[0]);
+    EXPECT_EQ(expanded.uri, page.posts[0].uri);
+    EXPECT_EQ(expanded.author.did, "did:plc:a");
+    EXPECT_EQ(expanded.author.handle, "new.bsky.social");
+    EXPECT_EQ(expanded.author.displayName, "A");
+    EXPECT_TRUE(expanded.author.mutedByViewer);
+
+    // An older copy does not overwrite it
+    table.intern(page.posts[0], first);
+    BlueskyClient::PostAuthor author;
+    ASSERT_TRUE(table.author(posts[0].author, author));
+    EXPECT_EQ(author.handle, "new.bsky.social");
+    EXPECT_FALSE(table.author(BlueskyAuthorTable::NO_AUTHOR, author));
+
+    // Authors without a DID are not interned
+    BlueskyClient::Post anonymous = makeStoredPost(3);
+    anonymous.author.did.clear();
+    EXPECT_EQ(table.intern(anonymous).author, BlueskyAuthorTable::NO_AUTHOR);
+    EXPECT_TRUE(table.expand(table.intern(anonymous)).author.did.empty());
+
+    table.clear();
+    EXPECT_EQ(table.size(), 0u);
+}
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+
+// Local stand-in for a Jetstream server. Accepts WebSocket connections on
+// 127.0.0.1 and replays recorded frames, starting at the cursor the client
+// asked for. With framesPerConnection, a connection is dropped after that
+// many frames, so the client has to resume; otherwise it stays open and
+// quiet once every frame was sent.
+class WsReplayServer {
+public:
+    explicit WsReplayServer(const std::vector<std::string>& frames, size_t framesPerConnection = 0)
+        : m_frames(frames)
+        , m_frames_per_connection(framesPerConnection)
+        , m_listener(-1)
+        , m_port(0)
+    {
+        m_listener = ::socket(AF_INET, SOCK_STREAM, 0);
+
+        const int reuse = 1;
+        setsockopt(m_listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        struct sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        socklen_t length = sizeof(address);
+        if (::bind(m_listener, (struct sockaddr*)&address, sizeof(address)) == 0 &&
+            ::listen(m_listener, 8) == 0 &&
+            getsockname(m_listener, (struct sockaddr*)&address, &length) == 0)
+            m_port = ntohs(address.sin_port);
+
+        m_acceptor = std::thread(&WsReplayServer::accept, this);
+    }
+
+    ~WsReplayServer() {
+        ::shutdown(m_listener, SHUT_RDWR);
+        m_acceptor.join();
+        ::close(m_listener);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (int client : m_clients)
+                ::shutdown(client, SHUT_RDWR);
+        }
+
+        for (std::thread& thread : m_threads)
+            thread.join();
+        for (int client : m_clients)
+            ::close(client);
+    }
+
+    int port() const { return m_port; }
+    std::string url() const { return "ws://127.0.0.1:" + std::to_string(m_port); }
+
+    // Request targets of every connection, in order
+    std::vector<std::string> requests() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_requests;
+    }
+
+private:
+    static uint64_t timeOf(const std::string& frame) {
+        const size_t start = frame.find("\"time_us\":");
+        return start == std::string::npos ? 0 : std::strtoull(frame.c_str() + start + 10, nullptr, 10);
+    }
+
+    static bool sendAll(int client, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            const ssize_t n = ::send(client, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+                return false;
+            sent += (size_t)n;
+        }
+        return true;
+    }
+
+    static bool sendFrame(int client, uint8_t opcode, const std::string& payload) {
+        std::string frame(1, (char)(0x80 | opcode));
+
+        if (payload.size() < 126) {
+            frame += (char)payload.size();
+        }
+        else if (payload.size() <= 0xFFFF) {
+            frame += (char)126;
+            frame += (char)(payload.size() >> 8);
+            frame += (char)payload.size();
+        }
+        else {
+            frame += (char)127;
+            for (int shift = 56; shift >= 0; shift -= 8)
+                frame += (char)((uint64_t)payload.size() >> shift);
+        }
+
+        return sendAll(client, frame + payload);
+    }
+
+    void accept() {
+        for (;;) {
+            const int client = ::accept(m_listener, nullptr, nullptr);
+            if (client < 0)
+                return;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_clients.push_back(client);
+            m_threads.push_back(std::thread(&WsReplayServer::serve, this, client));
+        }
+    }
+
+    void serve(int client) {
+        std::string request;
+        char buffer[4096];
+
+        while (request.find("\r\n\r\n") == std::string::npos) {
+            const ssize_t n = ::recv(client, buffer, sizeof(buffer), 0);
+            if (n <= 0)
+                return;
+            request.append(buffer, (size_t)n);
+        }
+
+        const size_t targetStart = request.find(' ') + 1;
+        const std::string target = request.substr(targetStart, request.find(' ', targetStart) - targetStart);
+
+        uint64_t cursor = 0;
+        const size_t cursorStart = target.find("cursor=");
+        if (cursorStart != std::string::npos)
+            cursor = std::strtoull(target.c_str() + cursorStart + 7, nullptr, 10);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_requests.push_back(target);
+        }
+
+        const size_t keyStart = request.find("Sec-WebSocket-Key: ") + 19;
+        const std::string key = request.substr(keyStart, request.find("\r\n", keyStart) - keyStart) +
+            "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+        unsigned char digest[SHA_DIGEST_LENGTH];
+        SHA1((const unsigned char*)key.data(), key.size(), digest);
+
+        char accept[64];
+        EVP_EncodeBlock((unsigned char*)accept, digest, sizeof(digest));
+
+        const std::string response =
+            "HTTP/1.1 101 Switching Protocols\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Accept: " + std::string(accept) + "\r\n\r\n";
+
+        // A ping up front, which the client has to answer on its own
+        if (!sendAll(client, response) || !sendFrame(client, 0x9, "ping"))
+            return;
+
+        size_t sent = 0;
+        for (const std::string& frame : m_frames) {
+            const uint64_t time = timeOf(frame);
+            if (cursor != 0 && time < cursor)
+                continue;
+
+            if (m_frames_per_connection != 0 && sent == m_frames_per_connection) {
+                ::shutdown(client, SHUT_RDWR);
+                return;
+            }
+
+            if (!sendFrame(client, 0x1, frame))
+                return;
+            sent++;
+        }
+
+        // Stay open like a quiet stream, reading the client's pongs
+        while (::recv(client, buffer, sizeof(buffer), 0) > 0) {}
+    }
+
+    const std::vector<std::string> m_frames;
+    const size_t m_frames_per_connection;
+
+    int m_listener;
+    int m_port;
+    std::thread m_acceptor;
+
+    mutable std::mutex m_mutex;
+    std::vector<int> m_clients;
+    std::vector<std::thread> m_threads;
+    std::vector<std::string> m_requests;
+};